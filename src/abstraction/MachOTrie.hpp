@@ -389,6 +389,136 @@ inline void parseTrie(const uint8_t* start, const uint8_t* end, std::vector<Entr
 }
 
 
+// Decodes the terminal info of the node at p, which must have a non-zero terminal size.
+static inline void parseTerminalInfo(const uint8_t* p, const uint8_t* const end, Entry& entry)
+{
+	entry.flags = read_uleb128(p, end);
+	if ( entry.flags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
+		entry.address = 0;
+		entry.other = read_uleb128(p, end); // dylib ordinal
+		entry.importName = (char*)p;
+	}
+	else {
+		entry.address = read_uleb128(p, end);
+		if ( entry.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER )
+			entry.other = read_uleb128(p, end);
+		else
+			entry.other = 0;
+		entry.importName = NULL;
+	}
+}
+
+
+// Follows the edges spelling out prefix.  Returns the first node whose path covers all of prefix, or
+// NULL if no exported name starts with prefix.  The full path to the returned node, which may extend
+// past prefix when prefix ends inside an edge, is stored in cummulativeString.
+static inline const uint8_t* findPrefixNode(const uint8_t* const start, const uint8_t* const end, const char* prefix,
+											char* cummulativeString, int& curStrOffset)
+{
+	const uint8_t* p = start;
+	const size_t prefixLen = strlen(prefix);
+	curStrOffset = 0;
+	while ( (size_t)curStrOffset < prefixLen ) {
+		if ( p >= end )
+			throw "malformed trie, node past end";
+		const uint64_t terminalSize = read_uleb128(p, end);
+		const uint8_t* children = p + terminalSize;
+		if ( children >= end )
+			throw "malformed trie, terminalSize extends beyond trie data";
+		const uint8_t childrenCount = *children++;
+		const uint8_t* s = children;
+		const uint8_t* next = NULL;
+		for (uint8_t i=0; (i < childrenCount) && (next == NULL); ++i) {
+			const char* edge = (char*)s;
+			size_t edgeLen = strnlen(edge, end-s);
+			if ( s+edgeLen >= end )
+				throw "malformed trie, edge string extends beyond trie data";
+			s += edgeLen+1;
+			uint32_t childNodeOffset = read_uleb128(s, end);
+			if ( childNodeOffset == 0 )
+				throw "malformed trie, childNodeOffset==0";
+			// sibling edges never share a first character, so at most one edge can match
+			size_t cmpLen = std::min(edgeLen, prefixLen-curStrOffset);
+			if ( strncmp(edge, &prefix[curStrOffset], cmpLen) == 0 ) {
+				memcpy(&cummulativeString[curStrOffset], edge, edgeLen+1);
+				curStrOffset += edgeLen;
+				next = start + childNodeOffset;
+			}
+		}
+		if ( next == NULL )
+			return NULL;
+		p = next;
+	}
+	cummulativeString[curStrOffset] = '\0';
+	return p;
+}
+
+
+// Looks up a single exported name without expanding the trie.
+inline bool findTrieEntry(const uint8_t* start, const uint8_t* end, const char* name, Entry& entry)
+{
+	if ( start == end )
+		return false;
+	const uint8_t* p = start;
+	const char* s = name;
+	while ( true ) {
+		if ( p >= end )
+			throw "malformed trie, node past end";
+		const uint64_t terminalSize = read_uleb128(p, end);
+		if ( *s == '\0' ) {
+			if ( terminalSize == 0 )
+				return false;
+			entry.name = name;
+			parseTerminalInfo(p, end, entry);
+			return true;
+		}
+		const uint8_t* children = p + terminalSize;
+		if ( children >= end )
+			throw "malformed trie, terminalSize extends beyond trie data";
+		const uint8_t childrenCount = *children++;
+		const uint8_t* e = children;
+		const uint8_t* next = NULL;
+		for (uint8_t i=0; (i < childrenCount) && (next == NULL); ++i) {
+			const uint8_t* edge = e;
+			while ( (e < end) && (*e != '\0') )
+				++e;
+			if ( e >= end )
+				throw "malformed trie, edge string extends beyond trie data";
+			size_t edgeLen = e - edge;
+			++e;
+			uint32_t childNodeOffset = read_uleb128(e, end);
+			if ( childNodeOffset == 0 )
+				throw "malformed trie, childNodeOffset==0";
+			if ( (edge[0] == (uint8_t)*s) && (strncmp((char*)edge, s, edgeLen) == 0) ) {
+				s += edgeLen;
+				next = start + childNodeOffset;
+			}
+		}
+		if ( next == NULL )
+			return false;
+		p = next;
+	}
+}
+
+
+// Like parseTrie(), but only expands the exports whose names start with prefix.
+inline void parseTrieWithPrefix(const uint8_t* start, const uint8_t* end, const char* prefix, std::vector<Entry>& output)
+{
+	if ( start == end )
+		return;
+	char* cummulativeString = new char[end-start+strlen(prefix)+1];
+	int curStrOffset;
+	std::vector<EntryWithOffset> entries;
+	if ( const uint8_t* node = findPrefixNode(start, end, prefix, cummulativeString, curStrOffset) )
+		processExportNode(start, node, end, cummulativeString, curStrOffset, entries);
+	std::sort(entries.begin(), entries.end());
+	output.reserve(output.size() + entries.size());
+	for (std::vector<EntryWithOffset>::iterator it=entries.begin(); it != entries.end(); ++it)
+		output.push_back(it->entry);
+	delete [] cummulativeString;
+}
+
+
 
 
 }; // namespace trie
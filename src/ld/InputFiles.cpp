@@ -70,6 +70,7 @@
 #include "Containers.h"
 #include "Snapshot.h"
 #include "FatFile.h"
+#include "Trace.h"
 
 const bool _s_logPThreads = false;
 
@@ -231,6 +232,7 @@ const char* InputFiles::extractFileInfo(const uint8_t* p, unsigned len, const ch
 
 ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib)
 {
+	ld::trace::Scope traceScope("parse", info.path);
 	bool fromSDK = _options.fromSDK(info.path);
 	// handle inlined framework first.
 	if (info.isInlined) {
@@ -359,6 +361,7 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 		}
 	}
 	::close(fd);
+	traceScope.counter("bytes", len);
 
 	// see if it is an object file
 	mach_o::relocatable::ParserOptions objOpts;
@@ -384,6 +387,15 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 	objOpts.forceHidden			= false;
 	objOpts.platformMismatchesAreWarning = _options.platformMismatchesAreWarning();
 	objOpts.avoidMisalignedPointers  = (_options.architecture() & CPU_ARCH_ABI64) && _options.makeChainedFixups() && _options.dyldLoadsOutput();
+	objOpts.cachePath			= _options.objectCachePath();
+	if ( objOpts.cachePath != NULL ) {
+		objOpts.fileIdentity.path			= info.path;
+		objOpts.fileIdentity.device			= stat_buf.st_dev;
+		objOpts.fileIdentity.inode			= stat_buf.st_ino;
+		objOpts.fileIdentity.size			= stat_buf.st_size;
+		objOpts.fileIdentity.modTimeSec		= stat_buf.st_mtimespec.tv_sec;
+		objOpts.fileIdentity.modTimeNSec	= stat_buf.st_mtimespec.tv_nsec;
+	}
 
 	ld::relocatable::File* objResult = mach_o::relocatable::parse(p, len, info.path, info.modTime, info.ordinal, objOpts);
 	if ( objResult != NULL ) {
@@ -952,7 +964,7 @@ void InputFiles::checkDylibClientRestrictions(ld::dylib::File* dylib)
 
 InputFiles::InputFiles(Options& opts) 
  : _totalObjectSize(0), _totalArchiveSize(0), 
-   _totalObjectLoaded(0), _totalArchivesLoaded(0), _totalDylibsLoaded(0),
+   _totalObjectLoaded(0), _totalArchivesLoaded(0), _totalDylibsLoaded(0), _resolverStallTime(0),
 	_options(opts), _bundleLoader(NULL), 
 	_exception(NULL), 
 	_indirectDylibOrdinal(ld::File::Ordinal::indirectDylibBase()),
@@ -972,29 +984,34 @@ InputFiles::InputFiles(Options& opts)
 	_inputFiles.reserve(files.size());
 #if HAVE_LIBDISPATCH
 	_inputFiles.resize(files.size(), nullptr);
+	// the pthread work loop is not used, forEachInitialAtom() must never try to start a worker
+	_availableInputFiles = 0;
+	_availableWorkers = 0;
+	if ( _options.resolveWhileParsing() ) {
+		// parse in the background and let forEachInitialAtom() consume each file as soon as it is ready
+		_remainingInputFiles = (int)files.size();
+		_parseErrors.resize(files.size(), nullptr);
+		dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+			const std::vector<Options::FileInfo>& inputs = _options.getInputFiles();
+			ld::trace::apply("parse input file", inputs.size(), ^(size_t index) {
+				const char* errorMsg = nullptr;
+				ld::File* file = makeFileOrIgnored(inputs[index], errorMsg);
+				pthread_mutex_lock(&_parseLock);
+				_parseErrors[index] = errorMsg;
+				_inputFiles[index] = file;
+				--_remainingInputFiles;
+				pthread_cond_broadcast(&_newFileAvailable);
+				pthread_mutex_unlock(&_parseLock);
+			});
+		});
+		return;
+	}
 	__block const char* firstError = nullptr;
-	dispatch_apply(files.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
-		try {
-			_inputFiles[index] = makeFile(files[index], false);
-		}
-		catch (const char *msg) {
-			if ( ((strstr(msg, "architecture") != NULL)  || (strstr(msg, "attempting to link") != NULL)) && !_options.errorOnOtherArchFiles() ) {
-				if ( _options.ignoreOtherArchInputFiles() ) {
-					// ignore, because this is about an architecture not in use
-				}
-				else {
-					warning("ignoring file %s, %s", files[index].path, msg);
-				}
-			}
-			else if ( strstr(msg, "ignoring unexpected") != NULL ) {
-				warning("%s, %s", files[index].path, msg);
-			}
-			else {
-				if ( firstError == nullptr )
-					asprintf((char**)&firstError, "%s file '%s'", msg, files[index].path);
-			}
-			_inputFiles[index] = new IgnoredFile(files[index].path, files[index].modTime, files[index].ordinal, ld::File::Other);
-		}
+	ld::trace::apply("parse input file", files.size(), ^(size_t index) {
+		const char* errorMsg = nullptr;
+		_inputFiles[index] = makeFileOrIgnored(files[index], errorMsg);
+		if ( (errorMsg != nullptr) && (firstError == nullptr) )
+			firstError = errorMsg;
 	});
 	if ( firstError != nullptr )
 		throw firstError;
@@ -1055,6 +1072,33 @@ InputFiles::InputFiles(Options& opts)
 }
 
 
+// Parses one input file on a worker thread.  Files that cannot be used are replaced with an
+// IgnoredFile so that slot ordering is preserved.  Fatal problems are returned in errorMsg.
+ld::File* InputFiles::makeFileOrIgnored(const Options::FileInfo& info, const char*& errorMsg)
+{
+	try {
+		return makeFile(info, false);
+	}
+	catch (const char *msg) {
+		if ( ((strstr(msg, "architecture") != NULL)  || (strstr(msg, "attempting to link") != NULL)) && !_options.errorOnOtherArchFiles() ) {
+			if ( _options.ignoreOtherArchInputFiles() ) {
+				// ignore, because this is about an architecture not in use
+			}
+			else {
+				warning("ignoring file %s, %s", info.path, msg);
+			}
+		}
+		else if ( strstr(msg, "ignoring unexpected") != NULL ) {
+			warning("%s, %s", info.path, msg);
+		}
+		else {
+			asprintf((char**)&errorMsg, "%s file '%s'", msg, info.path);
+		}
+	}
+	return new IgnoredFile(info.path, info.modTime, info.ordinal, ld::File::Other);
+}
+
+
 #if HAVE_PTHREADS
 void InputFiles::startThread(void (*threadFunc)(InputFiles *)) const {
 	pthread_t thread;
@@ -1281,6 +1325,7 @@ void InputFiles::forEachInitialAtom(ld::File::AtomHandler& handler, ld::Internal
 		pthread_mutex_lock(&_parseLock);
 		
 		// this loop waits for the needed file to be ready (parsed by worker thread)
+		uint64_t stallStart = mach_absolute_time();
 		while (_inputFiles[fileIndex] == NULL && _exception == NULL) {
 			// We are starved for input. If there are still files to parse and we have
 			// not maxed out the worker thread count start a new worker thread.
@@ -1293,6 +1338,15 @@ void InputFiles::forEachInitialAtom(ld::File::AtomHandler& handler, ld::Internal
 			if (_s_logPThreads) printf("consumer blocking for %lu: %s\n", fileIndex, files[fileIndex].path);
 			pthread_cond_wait(&_newFileAvailable, &_parseLock);
 		}
+		_resolverStallTime += (mach_absolute_time() - stallStart);
+
+		// with -resolve_while_parsing, parse errors are reported in command line order
+		if ( !_parseErrors.empty() && (_parseErrors[fileIndex] != nullptr) && (_exception == NULL) ) {
+			_exception = _parseErrors[fileIndex];
+			// let the remaining parses finish so we don't exit out from under the worker threads
+			while ( _remainingInputFiles > 0 )
+				pthread_cond_wait(&_newFileAvailable, &_parseLock);
+		}
 
 		if (_exception) {
 			// <rdar://problem/16525216> the tool is erroring out.  wait for other threads to finish so we don't destruct global objects out from under them
@@ -1414,76 +1468,87 @@ void InputFiles::forEachInitialAtom(ld::File::AtomHandler& handler, ld::Internal
 }
 
 
+// Returns true if the search for name is over.  A weak definition found in a dylib does not end the search.
+bool InputFiles::searchLibrary(const LibraryInfo& lib, const char* name, bool searchDylibs, bool searchArchives,
+							   bool dataSymbolOnly, bool mayBeWeakDef, ld::File::AtomHandler& handler) const
+{
+	if (lib.isDylib()) {
+		if (searchDylibs)
+			return searchDylib(lib.dylib(), name, mayBeWeakDef, handler);
+	} else {
+		if (searchArchives) {
+			ld::archive::File *archiveFile = lib.archive();
+			if ( dataSymbolOnly ) {
+				if ( archiveFile->justInTimeDataOnlyforEachAtom(name, handler) ) {
+					if ( _options.traceArchives() || _options.traceEmitJSON())
+						logArchive(archiveFile);
+					_options.snapshot().recordArchive(archiveFile->path());
+					// DALLAS _state.archives.push_back(archiveFile);
+					// found data definition in static library, done
+				   return true;
+				}
+			}
+			else {
+				if ( archiveFile->justInTimeforEachAtom(name, handler) ) {
+					if ( _options.traceArchives() || _options.traceEmitJSON())
+						logArchive(archiveFile);
+					_options.snapshot().recordArchive(archiveFile->path());
+					// found definition in static library, done
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+
+bool InputFiles::searchDylib(ld::dylib::File* dylibFile, const char* name, bool mayBeWeakDef, ld::File::AtomHandler& handler) const
+{
+	//fprintf(stderr, "searchLibraries(%s), looking in %s\n", name, dylibFile->path() );
+	if ( dylibFile->justInTimeforEachAtom(name, handler) ) {
+		// we found a definition in this dylib
+		// done, unless it is a weak definition in which case we keep searching
+		_options.snapshot().recordDylibSymbol(dylibFile, name);
+		if ( !mayBeWeakDef || !dylibFile->hasWeakExternals() || !dylibFile->hasWeakDefinition(name) ) {
+			return true;
+		}
+		// else continue search for a non-weak definition
+	}
+	return false;
+}
+
+
+bool InputFiles::searchIndirectDylib(const ld::dylib::File* dylibFile) const
+{
+	if ( _options.nameSpace() == Options::kTwoLevelNameSpace ) {
+		// for two level namesapce, just check all implicitly linked dylibs
+		return dylibFile->implicitlyLinked() && !dylibFile->explicitlyLinked();
+	}
+	else {
+		// for flat namespace, check all indirect dylibs
+		return ! dylibFile->explicitlyLinked();
+	}
+}
+
+
 bool InputFiles::searchLibraries(const char* name, bool searchDylibs, bool searchArchives, bool dataSymbolOnly, ld::File::AtomHandler& handler) const
 {
+	if ( _options.librarySymbolIndex() )
+		return searchLibrariesUsingIndex(name, searchDylibs, searchArchives, dataSymbolOnly, handler);
+
 	// Check each input library.
-    for (std::vector<LibraryInfo>::const_iterator it=_searchLibraries.begin(); it != _searchLibraries.end(); ++it) {
-        LibraryInfo lib = *it;
-        if (lib.isDylib()) {
-            if (searchDylibs) {
-                ld::dylib::File *dylibFile = lib.dylib();
-                //fprintf(stderr, "searchLibraries(%s), looking in linked %s\n", name, dylibFile->path() );
-                if ( dylibFile->justInTimeforEachAtom(name, handler) ) {
-                    // we found a definition in this dylib
-                    // done, unless it is a weak definition in which case we keep searching
-                    _options.snapshot().recordDylibSymbol(dylibFile, name);
-                    if ( !dylibFile->hasWeakExternals() || !dylibFile->hasWeakDefinition(name)) {
-                        return true;
-                    }
-                    // else continue search for a non-weak definition
-                }
-            }
-        } else {
-            if (searchArchives) {
-                ld::archive::File *archiveFile = lib.archive();
-                if ( dataSymbolOnly ) {
-                    if ( archiveFile->justInTimeDataOnlyforEachAtom(name, handler) ) {
-                        if ( _options.traceArchives() || _options.traceEmitJSON())
-                            logArchive(archiveFile);
-                        _options.snapshot().recordArchive(archiveFile->path());
-						// DALLAS _state.archives.push_back(archiveFile);
-                        // found data definition in static library, done
-                       return true;
-                    }
-                }
-                else {
-                    if ( archiveFile->justInTimeforEachAtom(name, handler) ) {
-                        if ( _options.traceArchives() || _options.traceEmitJSON())
-                            logArchive(archiveFile);
-                        _options.snapshot().recordArchive(archiveFile->path());
-                        // found definition in static library, done
-                        return true;
-                    }
-                }
-            }
-        }
-    }
+	for (const LibraryInfo& lib : _searchLibraries) {
+		if ( searchLibrary(lib, name, searchDylibs, searchArchives, dataSymbolOnly, true, handler) )
+			return true;
+	}
 
 	// search indirect dylibs
 	if ( searchDylibs ) {
 		for (InstallNameToDylib::const_iterator it=_installPathToDylibs.begin(); it != _installPathToDylibs.end(); ++it) {
 			ld::dylib::File* dylibFile = it->second;
-			bool searchThisDylib = false;
-			if ( _options.nameSpace() == Options::kTwoLevelNameSpace ) {
-				// for two level namesapce, just check all implicitly linked dylibs
-				searchThisDylib = dylibFile->implicitlyLinked() && !dylibFile->explicitlyLinked();
-			}
-			else {
-				// for flat namespace, check all indirect dylibs
-				searchThisDylib = ! dylibFile->explicitlyLinked();
-			}
-			if ( searchThisDylib ) {
-				//fprintf(stderr, "searchLibraries(%s), looking in implicitly linked %s\n", name, dylibFile->path() );
-				if ( dylibFile->justInTimeforEachAtom(name, handler) ) {
-					// we found a definition in this dylib
-					// done, unless it is a weak definition in which case we keep searching
-                    _options.snapshot().recordDylibSymbol(dylibFile, name);
-					if ( !dylibFile->hasWeakExternals() || !dylibFile->hasWeakDefinition(name)) {
-						return true;
-                    }
-					// else continue search for a non-weak definition
-				}
-			}			
+			if ( searchIndirectDylib(dylibFile) && searchDylib(dylibFile, name, true, handler) )
+				return true;
 		}
 	}
 
@@ -1491,6 +1556,198 @@ bool InputFiles::searchLibraries(const char* name, bool searchDylibs, bool searc
 }
 
 
+// Same search order and result as the linear search in searchLibraries(), but only libraries
+// whose exports or table of contents contain name are asked for it.
+bool InputFiles::searchLibrariesUsingIndex(const char* name, bool searchDylibs, bool searchArchives, bool dataSymbolOnly, ld::File::AtomHandler& handler) const
+{
+	updateLibrarySymbolIndex();
+
+	// Check each input library that might define name, in command line order.
+	// Libraries which could not be indexed are always checked.
+	const auto pos = _searchLibraryIndex.find(name);
+	uint32_t candidate = (pos != _searchLibraryIndex.end()) ? pos->second.first : 0;
+	auto unindexed = _unindexedSearchLibraries.begin();
+	while ( (candidate != 0) || (unindexed != _unindexedSearchLibraries.end()) ) {
+		uint32_t libIndex;
+		bool     mayBeWeakDef;
+		if ( (unindexed != _unindexedSearchLibraries.end()) && ((candidate == 0) || (*unindexed < _libraryCandidates[candidate].library)) ) {
+			libIndex     = *unindexed++;
+			mayBeWeakDef = true;
+		}
+		else {
+			libIndex     = _libraryCandidates[candidate].library;
+			mayBeWeakDef = _libraryCandidates[candidate].weakDef;
+			candidate    = _libraryCandidates[candidate].next;
+		}
+		if ( searchLibrary(_searchLibraries[libIndex], name, searchDylibs, searchArchives, dataSymbolOnly, mayBeWeakDef, handler) )
+			return true;
+	}
+
+	// search indirect dylibs, in the install name order of _installPathToDylibs
+	if ( searchDylibs ) {
+		std::vector<std::pair<ld::dylib::File*, bool>> dylibs;
+		auto addIfSearched = [&](ld::dylib::File* dylibFile, bool mayBeWeakDef) {
+			if ( (dylibFile->installPath() == NULL) || !searchIndirectDylib(dylibFile) )
+				return;
+			InstallNameToDylib::const_iterator it = _installPathToDylibs.find(dylibFile->installPath());
+			if ( (it != _installPathToDylibs.end()) && (it->second == dylibFile) )
+				dylibs.push_back({ dylibFile, mayBeWeakDef });
+		};
+		const auto dpos = _dylibSymbolIndex.find(name);
+		if ( dpos != _dylibSymbolIndex.end() ) {
+			for (uint32_t c = dpos->second.first; c != 0; c = _libraryCandidates[c].next)
+				addIfSearched(_indexedDylibs[_libraryCandidates[c].library], _libraryCandidates[c].weakDef);
+		}
+		for (ld::dylib::File* dylibFile : _unindexedDylibs)
+			addIfSearched(dylibFile, true);
+		std::sort(dylibs.begin(), dylibs.end(), [](const std::pair<ld::dylib::File*, bool>& lhs, const std::pair<ld::dylib::File*, bool>& rhs) {
+			return strcmp(lhs.first->installPath(), rhs.first->installPath()) < 0;
+		});
+		for (const auto& entry : dylibs) {
+			if ( searchDylib(entry.first, name, entry.second, handler) )
+				return true;
+		}
+	}
+
+	return false;
+}
+
+
+// Only the first library in search order that might define a name is considered, so a member is
+// parsed early only if the coming search would reach its archive.  Knowing that order needs the
+// library symbol index.
+void InputFiles::speculativelyParseArchiveMembers(const std::vector<std::string_view>& names) const
+{
+	if ( !_options.speculativeArchiveParsing() || !_options.librarySymbolIndex() )
+		return;
+	updateLibrarySymbolIndex();
+
+	std::map<uint32_t, std::vector<const char*>> namesByArchive;
+	for (const std::string_view& name : names) {
+		const auto pos = _searchLibraryIndex.find(name.data());
+		if ( pos == _searchLibraryIndex.end() )
+			continue;
+		const uint32_t libIndex = _libraryCandidates[pos->second.first].library;
+		if ( _searchLibraries[libIndex].isDylib() )
+			continue;
+		// a dylib that could not be indexed is searched first if it comes earlier
+		bool definedEarlier = false;
+		for (uint32_t unindexed : _unindexedSearchLibraries) {
+			if ( unindexed > libIndex )
+				break;
+			if ( _searchLibraries[unindexed].isDylib() && _searchLibraries[unindexed].dylib()->hasDefinition(name.data()) ) {
+				definedEarlier = true;
+				break;
+			}
+		}
+		if ( !definedEarlier )
+			namesByArchive[libIndex].push_back(name.data());
+	}
+	for (const auto& entry : namesByArchive)
+		_searchLibraries[entry.first].archive()->speculativelyParseMembers(entry.second);
+}
+
+// Background parses record trace scopes and use parser state that is torn down at exit, so
+// none may still be running once resolving is over.
+void InputFiles::finishSpeculativeArchiveParses() const
+{
+	for (const LibraryInfo& lib : _searchLibraries) {
+		if ( !lib.isDylib() )
+			lib.archive()->finishSpeculativeParses();
+	}
+}
+
+
+void InputFiles::addLibraryCandidate(NameToLibraryCandidates& index, const char* name, uint32_t library, bool weakDef) const
+{
+	auto pos = index.find(name);
+	if ( pos == index.end() ) {
+		_libraryCandidates.push_back({ 0, library, weakDef });
+		uint32_t c = (uint32_t)_libraryCandidates.size() - 1;
+		index[name] = { c, c };
+	}
+	else if ( _libraryCandidates[pos->second.last].library == library ) {
+		// same name exported by a dylib and something it re-exports
+		_libraryCandidates[pos->second.last].weakDef |= weakDef;
+	}
+	else {
+		_libraryCandidates.push_back({ 0, library, weakDef });
+		uint32_t c = (uint32_t)_libraryCandidates.size() - 1;
+		_libraryCandidates[pos->second.last].next = c;
+		pos->second.last = c;
+	}
+}
+
+
+// A dylib also provides every symbol of the dylibs it re-exports.  Returns false if the re-export
+// tree is not known yet, or has exports that are looked up in place, in which case the dylib must
+// always be searched.
+bool InputFiles::addDylibToLibraryIndex(NameToLibraryCandidates& index, const ld::dylib::File* dylib, uint32_t library) const
+{
+	std::vector<const ld::dylib::File*> tree;
+	__block std::vector<const ld::dylib::File*> pending = { dylib };
+	while ( !pending.empty() ) {
+		const ld::dylib::File* d = pending.back();
+		pending.pop_back();
+		if ( std::find(tree.begin(), tree.end(), d) != tree.end() )
+			continue;
+		if ( !d->indirectLibrariesProcessed() )
+			return false;
+		// enumerating would expand an export trie that is otherwise only probed, and probing is cheap
+		if ( d->exportsLookedUpInPlace() )
+			return false;
+		tree.push_back(d);
+		d->forEachReExportedDylib(^(const ld::dylib::File* reExportedDylib) {
+			pending.push_back(reExportedDylib);
+		});
+	}
+	NameToLibraryCandidates* names = &index;
+	for (const ld::dylib::File* d : tree) {
+		d->forEachExportedSymbol(^(const char* symbolName, bool weakDef) {
+			addLibraryCandidate(*names, symbolName, library, weakDef);
+		});
+	}
+	return true;
+}
+
+
+// Libraries are only ever added to the search list, so the index is extended with whatever was
+// loaded since the previous search.
+void InputFiles::updateLibrarySymbolIndex() const
+{
+	// candidate zero terminates the lists
+	if ( _libraryCandidates.empty() )
+		_libraryCandidates.push_back({ 0, 0, false });
+
+	for ( ; _indexedSearchLibraryCount < _searchLibraries.size(); ++_indexedSearchLibraryCount) {
+		uint32_t libIndex = (uint32_t)_indexedSearchLibraryCount;
+		const LibraryInfo& lib = _searchLibraries[libIndex];
+		if ( lib.isDylib() ) {
+			if ( !addDylibToLibraryIndex(_searchLibraryIndex, lib.dylib(), libIndex) )
+				_unindexedSearchLibraries.push_back(libIndex);
+		}
+		else {
+			lib.archive()->forEachTableOfContentsSymbol(^(const char* symbolName) {
+				addLibraryCandidate(_searchLibraryIndex, symbolName, libIndex, false);
+			});
+		}
+	}
+
+	if ( _indexedDylibCount != _allDylibs.size() ) {
+		for (ld::dylib::File* dylib : _allDylibs) {
+			if ( _dylibsSeenByIndex.count(dylib) != 0 )
+				continue;
+			_dylibsSeenByIndex.insert(dylib);
+			uint32_t dylibIndex = (uint32_t)_indexedDylibs.size();
+			_indexedDylibs.push_back(dylib);
+			if ( !addDylibToLibraryIndex(_dylibSymbolIndex, dylib, dylibIndex) )
+				_unindexedDylibs.push_back(dylib);
+		}
+		_indexedDylibCount = _allDylibs.size();
+	}
+}
+
+
 static bool vectorContains(const std::vector<ld::dylib::File*>& vec, ld::dylib::File* key)
 {
 	return std::find(vec.begin(), vec.end(), key) != vec.end();
@@ -76,6 +76,11 @@ public:
 	void						addLinkerOptionLibraries(ld::Internal& state, ld::File::AtomHandler& handler);
 	void						createIndirectDylibs();
 	size_t						count() const { return _inputFiles.size(); }
+	// starts parsing archive members that searchLibraries() is likely to load for these names
+	void						speculativelyParseArchiveMembers(const std::vector<std::string_view>& names) const;
+	void						finishSpeculativeArchiveParses() const;
+	// changes whenever libraries are added, so that names searchLibraries() could not find may be found now
+	size_t						librarySearchGeneration() const { return _searchLibraries.size() + _allDylibs.size(); }
 
 	// for -print_statistics
 	volatile int64_t			_totalObjectSize;
@@ -83,12 +88,14 @@ public:
 	volatile int32_t			_totalObjectLoaded;
 	volatile int32_t			_totalArchivesLoaded;
 	         int32_t			_totalDylibsLoaded;
+	         uint64_t			_resolverStallTime;		// time forEachInitialAtom() spent waiting for a file to be parsed
 	
 	
 private:
 	void						inferArchitecture(Options& opts, const char** archName);
 	const char* 				extractFileInfo(const uint8_t* p, unsigned len, const char* path, ld::Platform& platform);
 	ld::File*					makeFile(const Options::FileInfo& info, bool indirectDylib);
+	ld::File*					makeFileOrIgnored(const Options::FileInfo& info, const char*& errorMsg);
 	ld::File*					addDylib(ld::dylib::File* f,        const Options::FileInfo& info);
 	void						logTraceInfo (const char* format, ...) const;
 	void						logDylib(ld::File*, bool indirect, bool speculative);
@@ -100,6 +107,28 @@ private:
 	bool						libraryAlreadyLoaded(const char* path);
 	bool						frameworkAlreadyLoaded(const char* path, const char* frameworkName);
 
+	// for searchLibraries()
+	struct LibraryCandidate {
+		uint32_t				next;			// next candidate for the same name, zero ends the list
+		uint32_t				library;		// index into _searchLibraries or _indexedDylibs
+		bool					weakDef;		// the library might have a weak definition of the name
+	};
+	struct LibraryCandidateList {
+		uint32_t				first;
+		uint32_t				last;
+	};
+	using NameToLibraryCandidates = ld::CStringMap<LibraryCandidateList>;
+	class LibraryInfo;
+	bool						searchLibrariesUsingIndex(const char* name, bool searchDylibs, bool searchArchives,
+														  bool dataSymbolOnly, ld::File::AtomHandler&) const;
+	bool						searchLibrary(const LibraryInfo& lib, const char* name, bool searchDylibs, bool searchArchives,
+											  bool dataSymbolOnly, bool mayBeWeakDef, ld::File::AtomHandler&) const;
+	bool						searchDylib(ld::dylib::File* dylib, const char* name, bool mayBeWeakDef, ld::File::AtomHandler&) const;
+	bool						searchIndirectDylib(const ld::dylib::File* dylib) const;
+	void						updateLibrarySymbolIndex() const;
+	bool						addDylibToLibraryIndex(NameToLibraryCandidates& index, const ld::dylib::File* dylib, uint32_t library) const;
+	void						addLibraryCandidate(NameToLibraryCandidates& index, const char* name, uint32_t library, bool weakDef) const;
+
 	// for pipelined linking
     void						waitForInputFiles();
 	static void					waitForInputFiles(InputFiles *inputFiles);
@@ -135,6 +164,7 @@ private:
 	int							_availableInputFiles;	// number of input fileinfos with readyToParse==true
 #endif
 	const char *				_exception;				// passes an exception message from parse thread to main thread
+	std::vector<const char*>	_parseErrors;			// per slot parse error, only used with -resolve_while_parsing
 	int							_remainingInputFiles;	// number of input files still to parse
 	
 	ld::File::Ordinal			_indirectDylibOrdinal;
@@ -152,6 +182,17 @@ private:
         ld::archive::File *archive() const { return (ld::archive::File*)_lib; }
     };
     std::vector<LibraryInfo>  _searchLibraries;
+
+	// symbol name to the libraries that might define it, extended lazily by searchLibraries()
+	mutable std::vector<LibraryCandidate>		_libraryCandidates;
+	mutable NameToLibraryCandidates				_searchLibraryIndex;
+	mutable NameToLibraryCandidates				_dylibSymbolIndex;
+	mutable std::vector<uint32_t>				_unindexedSearchLibraries;	// always searched
+	mutable std::vector<ld::dylib::File*>		_unindexedDylibs;			// always searched
+	mutable std::vector<ld::dylib::File*>		_indexedDylibs;
+	mutable std::set<const ld::dylib::File*>	_dylibsSeenByIndex;
+	mutable size_t								_indexedSearchLibraryCount = 0;
+	mutable size_t								_indexedDylibCount = 0;
 };
 
 } // namespace tool 
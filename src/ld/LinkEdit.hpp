@@ -41,6 +41,7 @@
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
 #include "libcodedirectory.h"
+#include "Trace.h"
 
 #ifndef CS_LINKER_SIGNED
 	#define CS_LINKER_SIGNED            0x00020000  /* Automatically signed by the linker */
@@ -59,33 +60,15 @@ public:
 	const uint8_t* start() const { return _data.data(); }
 
 	void append_uleb128(uint64_t value) {
-		uint8_t byte;
-		do {
-			byte = value & 0x7F;
-			value &= ~0x7F;
-			if ( value != 0 )
-				byte |= 0x80;
-			_data.push_back(byte);
-			value = value >> 7;
-		} while( byte >= 0x80 );
+		size_t start = _data.size();
+		_data.resize(start + uleb128_size(value));
+		write_uleb128(&_data[start], value);
 	}
 	
 	void append_sleb128(int64_t value) {
-		bool isNeg = ( value < 0 );
-		uint8_t byte;
-		bool more;
-		do {
-			byte = value & 0x7F;
-			value = value >> 7;
-			if ( isNeg ) 
-				more = ( (value != -1) || ((byte & 0x40) == 0) );
-			else
-				more = ( (value != 0) || ((byte & 0x40) != 0) );
-			if ( more )
-				byte |= 0x80;
-			_data.push_back(byte);
-		} 
-		while( more );
+		size_t start = _data.size();
+		_data.resize(start + sleb128_size(value));
+		write_sleb128(&_data[start], value);
 	}
 	
 	void append_delta_encoded_uleb128_run(uint64_t start, const std::vector<uint64_t>& locations) {
@@ -100,9 +83,7 @@ public:
 	}
 
 	void append_string(const char* str) {
-		for (const char* s = str; *s != '\0'; ++s)
-			_data.push_back(*s);
-		_data.push_back('\0');
+		_data.insert(_data.end(), (uint8_t*)str, (uint8_t*)str + strlen(str) + 1);
 	}
 	
 	void append_byte(uint8_t byte) {
@@ -116,8 +97,7 @@ public:
 	// adds 'len' bytes to buffer and returns pointer to start of block
 	uint8_t* alloc(size_t len) {
 		size_t start = _data.size();
-		for (size_t i=0; i < len; ++i)
-			_data.push_back(0);
+		_data.resize(start + len);
 		return &_data[start];
 	}
 
@@ -130,9 +110,56 @@ public:
 		return result;
 	}
 	
+	static unsigned int	sleb128_size(int64_t value) {
+		uint32_t result = 0;
+		bool more;
+		do {
+			uint8_t byte = value & 0x7F;
+			value = value >> 7;
+			if ( value < 0 )
+				more = ( (value != -1) || ((byte & 0x40) == 0) );
+			else
+				more = ( (value != 0) || ((byte & 0x40) != 0) );
+			++result;
+		} while ( more );
+		return result;
+	}
+
+	// writes value into a buffer presized with uleb128_size() and returns the end of the bytes written
+	static uint8_t* write_uleb128(uint8_t* p, uint64_t value) {
+		uint8_t byte;
+		do {
+			byte = value & 0x7F;
+			value &= ~0x7F;
+			if ( value != 0 )
+				byte |= 0x80;
+			*p++ = byte;
+			value = value >> 7;
+		} while( byte >= 0x80 );
+		return p;
+	}
+
+	static uint8_t* write_sleb128(uint8_t* p, int64_t value) {
+		bool isNeg = ( value < 0 );
+		uint8_t byte;
+		bool more;
+		do {
+			byte = value & 0x7F;
+			value = value >> 7;
+			if ( isNeg ) 
+				more = ( (value != -1) || ((byte & 0x40) == 0) );
+			else
+				more = ( (value != 0) || ((byte & 0x40) != 0) );
+			if ( more )
+				byte |= 0x80;
+			*p++ = byte;
+		} 
+		while( more );
+		return p;
+	}
+
 	void pad_to_size(unsigned int alignment) {
-		while ( (_data.size() % alignment) != 0 )
-			_data.push_back(0);
+		_data.resize((_data.size() + alignment - 1) / alignment * alignment);
 	}
 };
 
@@ -180,107 +207,71 @@ void LinkEditAtom::copyRawContent(uint8_t buffer[]) const
 	memcpy(buffer, _encodedData.start(), _encodedData.size());
 }
 
-
-
-
-template <typename A>
-class RebaseInfoAtom : public LinkEditAtom
+//
+// Opcode steps for rebasing one run of pointers, see RebaseOpcodeCoder::minimizeRun()
+//
+struct OpcodeRunStep
 {
-public:
-												RebaseInfoAtom(const Options& opts, ld::Internal& state, OutputFile& writer)
-													: LinkEditAtom(opts, state, writer, _s_section, sizeof(pint_t)) { _encoded = true; }
-
-	// overrides of ld::Atom
-	virtual const char*							name() const		{ return "rebase info"; }
-	// overrides of LinkEditAtom
-	virtual void								encode() const;
-
-private:
-	void						encodeV1() const;
-
-	struct rebase_tmp
-	{
-		rebase_tmp(uint8_t op, uint64_t p1, uint64_t p2=0) : opcode(op), operand1(p1), operand2(p2) {}
-		uint8_t		opcode;
-		uint64_t	operand1;
-		uint64_t	operand2;
-	};
-
-	typedef typename A::P						P;
-	typedef typename A::P::E					E;
-	typedef typename A::P::uint_t				pint_t;
-	
-	static ld::Section			_s_section;
+	uint8_t		kind;
+	uint64_t	count;
+	size_t		cost;
 };
 
-template <typename A>
-ld::Section RebaseInfoAtom<A>::_s_section("__LINKEDIT", "__rebase", ld::Section::typeLinkEdit, true);
-
 
-template <typename A>
-void RebaseInfoAtom<A>::encode() const
+template <typename A, typename T>
+struct RebaseOpcodeCoder
 {
-	// omit relocs if this was supposed to be PIE but PIE not possible
-	if ( _options.positionIndependentExecutable() && this->_writer.pieDisabled ) 
-		return;
+	typedef typename A::P::uint_t				pint_t;
 
-	// sort rebase info by type, then address
-	std::vector<OutputFile::RebaseInfo>& info = this->_writer._rebaseInfo;
-	if (info.empty())
-		return;
+	static const uint8_t	kDoneOpcode = REBASE_OPCODE_DONE;
+	static const uint64_t	kPointerSize = sizeof(pint_t);
 
-	std::sort(info.begin(), info.end());
-	
-	// use encoding based on target minOS
-	if ( _options.useLinkedListBinding() && !this->_writer._hasUnalignedFixup ) {
-		if ( info.back()._type != REBASE_TYPE_POINTER )
-			throw "unsupported rebase type with linked list opcodes";
-		// As the binding and rebasing are both linked lists, just use the binds
-		// to do everything.
-	} else {
-		encodeV1();
+	static bool startsPiece(const T& op) {
+		return (op.opcode == REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB) || (op.opcode == REBASE_OPCODE_SET_TYPE_IMM);
+	}
+	static bool setsAddress(const T& op) { return (op.opcode == REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB); }
+	static bool usesAddress(const T& op) {
+		return (op.opcode == REBASE_OPCODE_ADD_ADDR_ULEB) || (op.opcode == REBASE_OPCODE_DO_REBASE_ULEB_TIMES);
+	}
+	static uint64_t pointerCount(const T& op) {
+		return (op.opcode == REBASE_OPCODE_DO_REBASE_ULEB_TIMES) ? op.operand1 : 0;
+	}
+	static T immediate(const T& op) {
+		return (op.opcode == REBASE_OPCODE_ADD_ADDR_ULEB) ? addAddr(op.operand1) : op;
 	}
-}
 
+	static void			peephole(std::vector<T>& mid);
+	static void			minimizeRun(const std::vector<uint64_t>& addrs, uint64_t exitAddr, bool exitFree, std::vector<T>& result);
+	static size_t		encodedSize(const std::vector<T>& mid);
+	static uint8_t*		write(uint8_t* p, const std::vector<T>& mid);
 
-template <typename A>
-void RebaseInfoAtom<A>::encodeV1() const
-{
-	std::vector<OutputFile::RebaseInfo>& info = this->_writer._rebaseInfo;
+private:
+	enum { kRebaseTimes, kRebaseAddAddr, kRebaseSkipping };
 
-	// convert to temp encoding that can be more easily optimized
-	std::vector<rebase_tmp> mid;
-	uint64_t curSegStart = 0;
-	uint64_t curSegEnd = 0;
-	uint32_t curSegIndex = 0;	
-	uint8_t type = 0;
-	uint64_t address = (uint64_t)(-1);
-	for (std::vector<OutputFile::RebaseInfo>::iterator it = info.begin(); it != info.end(); ++it) {
-		if ( type != it->_type ) {
-			mid.push_back(rebase_tmp(REBASE_OPCODE_SET_TYPE_IMM, it->_type));
-			type = it->_type;
-		}
-		if ( address != it->_address ) {
-			if ( (it->_address < curSegStart) || ( it->_address >= curSegEnd) ) {
-				if ( ! this->_writer.findSegment(this->_state, it->_address, &curSegStart, &curSegEnd, &curSegIndex) )
-					throw "binding address outside range of any segment";
-				mid.push_back(rebase_tmp(REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB, curSegIndex, it->_address - curSegStart));
-			}
-			else {
-				mid.push_back(rebase_tmp(REBASE_OPCODE_ADD_ADDR_ULEB, it->_address-address));
-			}
-			address = it->_address;
-		}
-		mid.push_back(rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, 1));
-		address += sizeof(pint_t);
-		if ( address >= curSegEnd )
-			address = 0;
+	static T addAddr(uint64_t delta) {
+		if ( (delta < (15*sizeof(pint_t))) && ((delta % sizeof(pint_t)) == 0) )
+			return T(REBASE_OPCODE_ADD_ADDR_IMM_SCALED, delta/sizeof(pint_t));
+		return T(REBASE_OPCODE_ADD_ADDR_ULEB, delta);
 	}
-	mid.push_back(rebase_tmp(REBASE_OPCODE_DONE, 0));
+	static T rebaseTimes(uint64_t count) {
+		if ( count < 15 )
+			return T(REBASE_OPCODE_DO_REBASE_IMM_TIMES, count);
+		return T(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, count);
+	}
+	static size_t		opcodeSize(const T& op);
+	static size_t		moveCost(const std::vector<uint64_t>& addrs, const std::vector<size_t>& best, size_t next,
+								uint64_t landing, uint64_t exitAddr, bool exitFree);
+	static void			move(const std::vector<uint64_t>& addrs, size_t next, uint64_t landing,
+								uint64_t exitAddr, bool exitFree, std::vector<T>& result);
+};
+
 
+template <typename A, typename T>
+void RebaseOpcodeCoder<A,T>::peephole(std::vector<T>& mid)
+{
 	// optimize phase 1, compress packed runs of pointers
-	rebase_tmp* dst = &mid[0];
-	for (const rebase_tmp* src = &mid[0]; src->opcode != REBASE_OPCODE_DONE; ++src) {
+	T* dst = &mid[0];
+	for (const T* src = &mid[0]; src->opcode != REBASE_OPCODE_DONE; ++src) {
 		if ( (src->opcode == REBASE_OPCODE_DO_REBASE_ULEB_TIMES) && (src->operand1 == 1) ) {
 			*dst = *src++;
 			while (src->opcode == REBASE_OPCODE_DO_REBASE_ULEB_TIMES ) {
@@ -298,7 +289,7 @@ void RebaseInfoAtom<A>::encodeV1() const
 
 	// optimize phase 2, combine rebase/add pairs
 	dst = &mid[0];
-	for (const rebase_tmp* src = &mid[0]; src->opcode != REBASE_OPCODE_DONE; ++src) {
+	for (const T* src = &mid[0]; src->opcode != REBASE_OPCODE_DONE; ++src) {
 		if ( (src->opcode == REBASE_OPCODE_DO_REBASE_ULEB_TIMES) 
 				&& (src->operand1 == 1) 
 				&& (src[1].opcode == REBASE_OPCODE_ADD_ADDR_ULEB)) {
@@ -316,7 +307,7 @@ void RebaseInfoAtom<A>::encodeV1() const
 	// optimize phase 3, compress packed runs of REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB with
 	// same addr delta into one REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB
 	dst = &mid[0];
-	for (const rebase_tmp* src = &mid[0]; src->opcode != REBASE_OPCODE_DONE; ++src) {
+	for (const T* src = &mid[0]; src->opcode != REBASE_OPCODE_DONE; ++src) {
 		uint64_t delta = src->operand1;
 		if ( (src->opcode == REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB) 
 				&& (src[1].opcode == REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB) 
@@ -343,7 +334,7 @@ void RebaseInfoAtom<A>::encodeV1() const
 	dst->opcode = REBASE_OPCODE_DONE;
 	
 	// optimize phase 4, use immediate encodings
-	for (rebase_tmp* p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p) {
+	for (T* p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p) {
 		if ( (p->opcode == REBASE_OPCODE_ADD_ADDR_ULEB) 
 			&& (p->operand1 < (15*sizeof(pint_t)))
 			&& ((p->operand1 % sizeof(pint_t)) == 0) ) {
@@ -354,112 +345,702 @@ void RebaseInfoAtom<A>::encodeV1() const
 			p->opcode = REBASE_OPCODE_DO_REBASE_IMM_TIMES;
 		}
 	}
+}
 
-	// convert to compressed encoding
+
+template <typename A, typename T>
+size_t RebaseOpcodeCoder<A,T>::moveCost(const std::vector<uint64_t>& addrs, const std::vector<size_t>& best, size_t next,
+										uint64_t landing, uint64_t exitAddr, bool exitFree)
+{
+	if ( next < addrs.size() )
+		return ((landing == addrs[next]) ? 0 : opcodeSize(addAddr(addrs[next] - landing))) + best[next];
+	if ( exitFree || (landing == exitAddr) )
+		return 0;
+	return opcodeSize(addAddr(exitAddr - landing));
+}
+
+template <typename A, typename T>
+void RebaseOpcodeCoder<A,T>::move(const std::vector<uint64_t>& addrs, size_t next, uint64_t landing,
+								uint64_t exitAddr, bool exitFree, std::vector<T>& result)
+{
+	if ( next < addrs.size() ) {
+		if ( landing != addrs[next] )
+			result.push_back(addAddr(addrs[next] - landing));
+	}
+	else if ( !exitFree && (landing != exitAddr) ) {
+		result.push_back(addAddr(exitAddr - landing));
+	}
+}
+
+//
+// best[i] is the fewest bytes that rebase addrs[i] onward, starting with the address at addrs[i].
+// Each step rebases a packed run of pointers, or one pointer then adds the distance to the next,
+// or an evenly spaced series of pointers, then moves the address to the next pointer if needed.
+// Only the longest packed or spaced series from a pointer, and a few shorter ones that end on an
+// immediate encoding or on the next pointer, need to be tried.
+//
+template <typename A, typename T>
+void RebaseOpcodeCoder<A,T>::minimizeRun(const std::vector<uint64_t>& addrs, uint64_t exitAddr, bool exitFree, std::vector<T>& result)
+{
+	const size_t count = addrs.size();
+	std::vector<size_t> packed(count);
+	std::vector<size_t> spaced(count);
+	for (size_t i=count; i > 0; --i) {
+		const size_t j = i-1;
+		packed[j] = ((i < count) && (addrs[i] == addrs[j]+sizeof(pint_t))) ? packed[i]+1 : 1;
+		if ( i == count )
+			spaced[j] = 1;
+		else if ( (i+1 < count) && ((addrs[i+1] - addrs[i]) == (addrs[i] - addrs[j])) )
+			spaced[j] = spaced[i]+1;
+		else
+			spaced[j] = 2;
+	}
+
+	std::vector<size_t> best(count);
+	std::vector<OpcodeRunStep> steps(count);
+	for (size_t i=count; i > 0; --i) {
+		const size_t j = i-1;
+		OpcodeRunStep choice = { kRebaseTimes, 1, SIZE_MAX };
+		const size_t packedTries[] = { packed[j], std::min<size_t>(packed[j], 14), packed[j]-1 };
+		for (size_t n : packedTries) {
+			if ( n == 0 )
+				continue;
+			size_t cost = opcodeSize(rebaseTimes(n)) + moveCost(addrs, best, j+n, addrs[j+n-1]+sizeof(pint_t), exitAddr, exitFree);
+			if ( cost < choice.cost )
+				choice = { kRebaseTimes, n, cost };
+		}
+		if ( (i < count) || !exitFree ) {
+			uint64_t next = (i < count) ? addrs[i] : exitAddr;
+			size_t cost = opcodeSize(T(REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB, next - addrs[j] - sizeof(pint_t)));
+			if ( i < count )
+				cost += best[i];
+			if ( cost < choice.cost )
+				choice = { kRebaseAddAddr, 1, cost };
+		}
+		const size_t spacedTries[] = { spaced[j], spaced[j]-1 };
+		for (size_t n : spacedTries) {
+			if ( n < 2 )
+				continue;
+			uint64_t stride = addrs[i] - addrs[j];
+			size_t cost = opcodeSize(T(REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB, n, stride - sizeof(pint_t)))
+						+ moveCost(addrs, best, j+n, addrs[j+n-1]+stride, exitAddr, exitFree);
+			if ( cost < choice.cost )
+				choice = { kRebaseSkipping, n, cost };
+		}
+		best[j] = choice.cost;
+		steps[j] = choice;
+	}
+
+	for (size_t i=0; i < count; ) {
+		const OpcodeRunStep& step = steps[i];
+		const size_t next = i + step.count;
+		switch ( step.kind ) {
+			case kRebaseTimes:
+				result.push_back(rebaseTimes(step.count));
+				move(addrs, next, addrs[next-1]+sizeof(pint_t), exitAddr, exitFree, result);
+				break;
+			case kRebaseAddAddr:
+				result.push_back(T(REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB, ((next < count) ? addrs[next] : exitAddr) - addrs[i] - sizeof(pint_t)));
+				break;
+			case kRebaseSkipping: {
+				uint64_t stride = addrs[i+1] - addrs[i];
+				result.push_back(T(REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB, step.count, stride - sizeof(pint_t)));
+				move(addrs, next, addrs[next-1]+stride, exitAddr, exitFree, result);
+				break;
+			}
+		}
+		i = next;
+	}
+}
+
+
+template <typename A, typename T>
+size_t RebaseOpcodeCoder<A,T>::opcodeSize(const T& op)
+{
+	switch ( op.opcode ) {
+		case REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+			return 1 + ByteStream::uleb128_size(op.operand2);
+		case REBASE_OPCODE_ADD_ADDR_ULEB:
+		case REBASE_OPCODE_DO_REBASE_ULEB_TIMES:
+		case REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB:
+			return 1 + ByteStream::uleb128_size(op.operand1);
+		case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB:
+			return 1 + ByteStream::uleb128_size(op.operand1) + ByteStream::uleb128_size(op.operand2);
+		case REBASE_OPCODE_DONE:
+			return 0;
+	}
+	return 1;
+}
+
+template <typename A, typename T>
+size_t RebaseOpcodeCoder<A,T>::encodedSize(const std::vector<T>& mid)
+{
+	size_t size = 0;
+	for (const T* p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p)
+		size += opcodeSize(*p);
+	return size;
+}
+
+template <typename A, typename T>
+uint8_t* RebaseOpcodeCoder<A,T>::write(uint8_t* p, const std::vector<T>& mid)
+{
 	const static bool log = false;
-	this->_encodedData.reserve(info.size()*2);
-	bool done = false;
-	for (typename std::vector<rebase_tmp>::iterator it = mid.begin(); !done && it != mid.end() ; ++it) {
+	for (const T* it = &mid[0]; it->opcode != REBASE_OPCODE_DONE; ++it) {
 		switch ( it->opcode ) {
-			case REBASE_OPCODE_DONE:
-				if ( log ) fprintf(stderr, "REBASE_OPCODE_DONE()\n");
-				done = true;
-				break;
 			case REBASE_OPCODE_SET_TYPE_IMM:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_SET_TYPE_IMM(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(REBASE_OPCODE_SET_TYPE_IMM | it->operand1);
+				*p++ = REBASE_OPCODE_SET_TYPE_IMM | it->operand1;
 				break;
 			case REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB(%lld, 0x%llX)\n", it->operand1, it->operand2);
-				this->_encodedData.append_byte(REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | it->operand1);
-				this->_encodedData.append_uleb128(it->operand2);
+				*p++ = REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | it->operand1;
+				p = ByteStream::write_uleb128(p, it->operand2);
 				break;
 			case REBASE_OPCODE_ADD_ADDR_ULEB:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
-				this->_encodedData.append_byte(REBASE_OPCODE_ADD_ADDR_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
+				*p++ = REBASE_OPCODE_ADD_ADDR_ULEB;
+				p = ByteStream::write_uleb128(p, it->operand1);
 				break;
 			case REBASE_OPCODE_ADD_ADDR_IMM_SCALED:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_ADD_ADDR_IMM_SCALED(%lld=0x%llX)\n", it->operand1, it->operand1*sizeof(pint_t));
-				this->_encodedData.append_byte(REBASE_OPCODE_ADD_ADDR_IMM_SCALED | it->operand1 );
+				*p++ = REBASE_OPCODE_ADD_ADDR_IMM_SCALED | it->operand1;
 				break;
 			case REBASE_OPCODE_DO_REBASE_IMM_TIMES:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_DO_REBASE_IMM_TIMES(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(REBASE_OPCODE_DO_REBASE_IMM_TIMES | it->operand1);
+				*p++ = REBASE_OPCODE_DO_REBASE_IMM_TIMES | it->operand1;
 				break;
 			case REBASE_OPCODE_DO_REBASE_ULEB_TIMES:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_DO_REBASE_ULEB_TIMES(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(REBASE_OPCODE_DO_REBASE_ULEB_TIMES);
-				this->_encodedData.append_uleb128(it->operand1);
+				*p++ = REBASE_OPCODE_DO_REBASE_ULEB_TIMES;
+				p = ByteStream::write_uleb128(p, it->operand1);
 				break;
 			case REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
-				this->_encodedData.append_byte(REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
+				*p++ = REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB;
+				p = ByteStream::write_uleb128(p, it->operand1);
 				break;
 			case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB:
 				if ( log ) fprintf(stderr, "REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB(%lld, %lld)\n", it->operand1, it->operand2);
-				this->_encodedData.append_byte(REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				this->_encodedData.append_uleb128(it->operand2);
+				*p++ = REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB;
+				p = ByteStream::write_uleb128(p, it->operand1);
+				p = ByteStream::write_uleb128(p, it->operand2);
 				break;
 		}
 	}
-	
-		
-	// align to pointer size
-	this->_encodedData.pad_to_size(sizeof(pint_t));
-
-	this->_encoded = true;
-
-	if (log) fprintf(stderr, "total rebase info size = %ld\n", this->_encodedData.size());
+	return p;
 }
 
 
-template <typename A>
-class BindingInfoAtom : public LinkEditAtom
+template <typename A, typename T>
+struct BindOpcodeCoder
 {
-public:
-												BindingInfoAtom(const Options& opts, ld::Internal& state, OutputFile& writer)
-													: LinkEditAtom(opts, state, writer, _s_section, sizeof(pint_t)) { }
-
-	// overrides of ld::Atom
-	virtual const char*							name() const		{ return "binding info"; }
-	// overrides of LinkEditAtom
-	virtual void								encode() const;
+	typedef typename A::P::uint_t				pint_t;
 
+	static const uint8_t	kDoneOpcode = BIND_OPCODE_DONE;
+	static const uint64_t	kPointerSize = sizeof(pint_t);
 
-private:
-	void						encodeV1() const;
-	void						encodeV2() const;
+	static bool startsPiece(const T& op) {
+		switch ( op.opcode ) {
+			case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+			case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+			case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+			case BIND_OPCODE_SET_TYPE_IMM:
+			case BIND_OPCODE_SET_ADDEND_SLEB:
+			case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+				return true;
+		}
+		return false;
+	}
+	static bool setsAddress(const T& op) { return (op.opcode == BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB); }
+	static bool usesAddress(const T& op) {
+		return (op.opcode == BIND_OPCODE_ADD_ADDR_ULEB) || (op.opcode == BIND_OPCODE_DO_BIND);
+	}
+	static uint64_t pointerCount(const T& op) {
+		return (op.opcode == BIND_OPCODE_DO_BIND) ? 1 : 0;
+	}
+	static T immediate(const T& op) {
+		if ( (op.opcode == BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB) && (op.operand1 <= 15) )
+			return T(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM, op.operand1);
+		return op;
+	}
 
-	typedef typename A::P						P;
-	typedef typename A::P::E					E;
-	typedef typename A::P::uint_t				pint_t;
+	static void			peephole(std::vector<T>& mid);
+	static void			minimizeRun(const std::vector<uint64_t>& addrs, uint64_t exitAddr, bool exitFree, std::vector<T>& result);
+	static size_t		encodedSize(const std::vector<T>& mid);
+	static uint8_t*		write(uint8_t* p, const std::vector<T>& mid);
 
-	struct binding_tmp
-	{
-		binding_tmp(uint8_t op, uint64_t p1, uint64_t p2=0, const char* s=NULL) 
-			: opcode(op), operand1(p1), operand2(p2), name(s) {}
-		uint8_t		opcode;
-		uint64_t	operand1;
-		uint64_t	operand2;
-		const char*	name;
-	};
+private:
+	enum { kBind, kBindAddAddr, kBindSkipping };
 
-	static ld::Section			_s_section;
+	static T bindAddAddr(uint64_t delta) {
+		if ( (delta < (15*sizeof(pint_t))) && ((delta % sizeof(pint_t)) == 0) )
+			return T(BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED, delta/sizeof(pint_t));
+		return T(BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB, delta);
+	}
+	static size_t		opcodeSize(const T& op);
+	static size_t		moveCost(const std::vector<uint64_t>& addrs, const std::vector<size_t>& best, size_t next,
+								uint64_t landing, uint64_t exitAddr, bool exitFree);
+	static void			move(const std::vector<uint64_t>& addrs, size_t next, uint64_t landing,
+								uint64_t exitAddr, bool exitFree, std::vector<T>& result);
 };
 
-template <typename A>
-ld::Section BindingInfoAtom<A>::_s_section("__LINKEDIT", "__binding", ld::Section::typeLinkEdit, true);
 
-
-template <typename A>
-void BindingInfoAtom<A>::encode() const
+template <typename A, typename T>
+void BindOpcodeCoder<A,T>::peephole(std::vector<T>& mid)
 {
-	// use encoding based on target minOS
-	if ( _options.useLinkedListBinding() && !this->_writer._hasUnalignedFixup ) {
-		encodeV2();
+	// optimize phase 1, combine bind/add pairs
+	T* dst = &mid[0];
+	for (const T* src = &mid[0]; src->opcode != BIND_OPCODE_DONE; ++src) {
+		if ( (src->opcode == BIND_OPCODE_DO_BIND) 
+				&& (src[1].opcode == BIND_OPCODE_ADD_ADDR_ULEB) ) {
+			dst->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB;
+			dst->operand1 = src[1].operand1;
+			++src;
+			++dst;
+		}
+		else {
+			*dst++ = *src;
+		}
+	}
+	dst->opcode = BIND_OPCODE_DONE;
+
+	// optimize phase 2, compress packed runs of BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB with
+	// same addr delta into one BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB
+	dst = &mid[0];
+	for (const T* src = &mid[0]; src->opcode != BIND_OPCODE_DONE; ++src) {
+		uint64_t delta = src->operand1;
+		if ( (src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
+				&& (src[1].opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
+				&& (src[1].operand1 == delta) ) {
+			// found at least two in a row, this is worth compressing
+			dst->opcode = BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB;
+			dst->operand1 = 1;
+			dst->operand2 = delta;
+			++src;
+			while ( (src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB)
+					&& (src->operand1 == delta) ) {
+				dst->operand1++;
+				++src;
+			}
+			--src;
+			++dst;
+		}
+		else {
+			*dst++ = *src;
+		}
+	}
+	dst->opcode = BIND_OPCODE_DONE;
+	
+	// optimize phase 3, use immediate encodings
+	for (T* p = &mid[0]; p->opcode != BIND_OPCODE_DONE; ++p) {
+		if ( (p->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
+			&& (p->operand1 < (15*sizeof(pint_t)))
+			&& ((p->operand1 % sizeof(pint_t)) == 0) ) {
+			p->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED;
+			p->operand1 = p->operand1/sizeof(pint_t);
+		}
+		else if ( (p->opcode == BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB) && (p->operand1 <= 15) ) {
+			p->opcode = BIND_OPCODE_SET_DYLIB_ORDINAL_IMM;
+		}
+	}	
+}
+
+
+template <typename A, typename T>
+size_t BindOpcodeCoder<A,T>::moveCost(const std::vector<uint64_t>& addrs, const std::vector<size_t>& best, size_t next,
+										uint64_t landing, uint64_t exitAddr, bool exitFree)
+{
+	if ( next < addrs.size() )
+		return ((landing == addrs[next]) ? 0 : opcodeSize(T(BIND_OPCODE_ADD_ADDR_ULEB, addrs[next] - landing))) + best[next];
+	if ( exitFree || (landing == exitAddr) )
+		return 0;
+	return opcodeSize(T(BIND_OPCODE_ADD_ADDR_ULEB, exitAddr - landing));
+}
+
+template <typename A, typename T>
+void BindOpcodeCoder<A,T>::move(const std::vector<uint64_t>& addrs, size_t next, uint64_t landing,
+								uint64_t exitAddr, bool exitFree, std::vector<T>& result)
+{
+	if ( next < addrs.size() ) {
+		if ( landing != addrs[next] )
+			result.push_back(T(BIND_OPCODE_ADD_ADDR_ULEB, addrs[next] - landing));
+	}
+	else if ( !exitFree && (landing != exitAddr) ) {
+		result.push_back(T(BIND_OPCODE_ADD_ADDR_ULEB, exitAddr - landing));
+	}
+}
+
+//
+// Same search as RebaseOpcodeCoder::minimizeRun(), with the bind opcodes: bind one pointer, bind
+// one pointer then add the distance to the next, or bind an evenly spaced (or packed) series.
+//
+template <typename A, typename T>
+void BindOpcodeCoder<A,T>::minimizeRun(const std::vector<uint64_t>& addrs, uint64_t exitAddr, bool exitFree, std::vector<T>& result)
+{
+	const size_t count = addrs.size();
+	std::vector<size_t> spaced(count);
+	for (size_t i=count; i > 0; --i) {
+		const size_t j = i-1;
+		if ( i == count )
+			spaced[j] = 1;
+		else if ( (i+1 < count) && ((addrs[i+1] - addrs[i]) == (addrs[i] - addrs[j])) )
+			spaced[j] = spaced[i]+1;
+		else
+			spaced[j] = 2;
+	}
+
+	std::vector<size_t> best(count);
+	std::vector<OpcodeRunStep> steps(count);
+	for (size_t i=count; i > 0; --i) {
+		const size_t j = i-1;
+		OpcodeRunStep choice = { kBind, 1, opcodeSize(T(BIND_OPCODE_DO_BIND, 0))
+								+ moveCost(addrs, best, i, addrs[j]+sizeof(pint_t), exitAddr, exitFree) };
+		if ( (i < count) || !exitFree ) {
+			uint64_t delta = ((i < count) ? addrs[i] : exitAddr) - addrs[j] - sizeof(pint_t);
+			if ( delta != 0 ) {
+				size_t cost = opcodeSize(bindAddAddr(delta));
+				if ( i < count )
+					cost += best[i];
+				if ( cost < choice.cost )
+					choice = { kBindAddAddr, 1, cost };
+			}
+		}
+		const size_t spacedTries[] = { spaced[j], spaced[j]-1 };
+		for (size_t n : spacedTries) {
+			if ( n < 2 )
+				continue;
+			uint64_t stride = addrs[i] - addrs[j];
+			size_t cost = opcodeSize(T(BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB, n, stride - sizeof(pint_t)))
+						+ moveCost(addrs, best, j+n, addrs[j+n-1]+stride, exitAddr, exitFree);
+			if ( cost < choice.cost )
+				choice = { kBindSkipping, n, cost };
+		}
+		best[j] = choice.cost;
+		steps[j] = choice;
+	}
+
+	for (size_t i=0; i < count; ) {
+		const OpcodeRunStep& step = steps[i];
+		const size_t next = i + step.count;
+		switch ( step.kind ) {
+			case kBind:
+				result.push_back(T(BIND_OPCODE_DO_BIND, 0));
+				move(addrs, next, addrs[i]+sizeof(pint_t), exitAddr, exitFree, result);
+				break;
+			case kBindAddAddr:
+				result.push_back(bindAddAddr(((next < count) ? addrs[next] : exitAddr) - addrs[i] - sizeof(pint_t)));
+				break;
+			case kBindSkipping: {
+				uint64_t stride = addrs[i+1] - addrs[i];
+				result.push_back(T(BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB, step.count, stride - sizeof(pint_t)));
+				move(addrs, next, addrs[next-1]+stride, exitAddr, exitFree, result);
+				break;
+			}
+		}
+		i = next;
+	}
+}
+
+
+template <typename A, typename T>
+size_t BindOpcodeCoder<A,T>::opcodeSize(const T& op)
+{
+	switch ( op.opcode ) {
+		case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+		case BIND_OPCODE_ADD_ADDR_ULEB:
+		case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+			return 1 + ByteStream::uleb128_size(op.operand1);
+		case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+			return 1 + strlen(op.name) + 1;
+		case BIND_OPCODE_SET_ADDEND_SLEB:
+			return 1 + ByteStream::sleb128_size(op.operand1);
+		case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+			return 1 + ByteStream::uleb128_size(op.operand2);
+		case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+			return 1 + ByteStream::uleb128_size(op.operand1) + ByteStream::uleb128_size(op.operand2);
+		case BIND_OPCODE_DONE:
+			return 0;
+	}
+	return 1;
+}
+
+template <typename A, typename T>
+size_t BindOpcodeCoder<A,T>::encodedSize(const std::vector<T>& mid)
+{
+	size_t size = 0;
+	for (const T* p = &mid[0]; p->opcode != BIND_OPCODE_DONE; ++p)
+		size += opcodeSize(*p);
+	return size;
+}
+
+template <typename A, typename T>
+uint8_t* BindOpcodeCoder<A,T>::write(uint8_t* p, const std::vector<T>& mid)
+{
+	const static bool log = false;
+	for (const T* it = &mid[0]; it->opcode != BIND_OPCODE_DONE; ++it) {
+		switch ( it->opcode ) {
+			case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_ORDINAL_IMM(%lld)\n", it->operand1);
+				*p++ = BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | it->operand1;
+				break;
+			case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB(%lld)\n", it->operand1);
+				*p++ = BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB;
+				p = ByteStream::write_uleb128(p, it->operand1);
+				break;
+			case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_SPECIAL_IMM(%lld)\n", it->operand1);
+				*p++ = BIND_OPCODE_SET_DYLIB_SPECIAL_IMM | (it->operand1 & BIND_IMMEDIATE_MASK);
+				break;
+			case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM: {
+				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM(0x%0llX, %s)\n", it->operand1, it->name);
+				*p++ = BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM | it->operand1;
+				size_t len = strlen(it->name) + 1;
+				memcpy(p, it->name, len);
+				p += len;
+				break;
+			}
+			case BIND_OPCODE_SET_TYPE_IMM:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_TYPE_IMM(%lld)\n", it->operand1);
+				*p++ = BIND_OPCODE_SET_TYPE_IMM | it->operand1;
+				break;
+			case BIND_OPCODE_SET_ADDEND_SLEB:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_ADDEND_SLEB(%lld)\n", it->operand1);
+				*p++ = BIND_OPCODE_SET_ADDEND_SLEB;
+				p = ByteStream::write_sleb128(p, it->operand1);
+				break;
+			case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB(%lld, 0x%llX)\n", it->operand1, it->operand2);
+				*p++ = BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | it->operand1;
+				p = ByteStream::write_uleb128(p, it->operand2);
+				break;
+			case BIND_OPCODE_ADD_ADDR_ULEB:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
+				*p++ = BIND_OPCODE_ADD_ADDR_ULEB;
+				p = ByteStream::write_uleb128(p, it->operand1);
+				break;
+			case BIND_OPCODE_DO_BIND:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND()\n");
+				*p++ = BIND_OPCODE_DO_BIND;
+				break;
+			case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
+				*p++ = BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB;
+				p = ByteStream::write_uleb128(p, it->operand1);
+				break;
+			case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED(%lld=0x%llX)\n", it->operand1, it->operand1*sizeof(pint_t));
+				*p++ = BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED | it->operand1;
+				break;
+			case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB(%lld, %lld)\n", it->operand1, it->operand2);
+				*p++ = BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB;
+				p = ByteStream::write_uleb128(p, it->operand1);
+				p = ByteStream::write_uleb128(p, it->operand2);
+				break;
+		}
+	}
+	return p;
+}
+
+
+//
+// Re-encodes each run of address opcodes in a DONE terminated temp encoding with Coder::minimizeRun().
+// A run's addresses are relative to its first pointer, and the run must leave the address where the
+// temp encoding does unless no later opcode uses it.
+//
+template <typename T, typename Coder>
+void minimizeOpcodeRuns(const std::vector<T>& mid, bool exitFree, std::vector<T>& result)
+{
+	std::vector<uint64_t> addrs;
+	for (size_t i=0; mid[i].opcode != Coder::kDoneOpcode; ) {
+		if ( !Coder::usesAddress(mid[i]) || (Coder::pointerCount(mid[i]) == 0) ) {
+			result.push_back(Coder::immediate(mid[i]));
+			++i;
+			continue;
+		}
+		addrs.clear();
+		uint64_t address = 0;
+		for ( ; Coder::usesAddress(mid[i]); ++i) {
+			uint64_t count = Coder::pointerCount(mid[i]);
+			if ( count == 0 ) {
+				address += mid[i].operand1;
+			}
+			else {
+				for (uint64_t j=0; j < count; ++j) {
+					addrs.push_back(address);
+					address += Coder::kPointerSize;
+				}
+			}
+		}
+		bool runExitFree = exitFree;
+		for (size_t j=i; mid[j].opcode != Coder::kDoneOpcode; ++j) {
+			if ( Coder::setsAddress(mid[j]) ) {
+				runExitFree = true;
+				break;
+			}
+			if ( Coder::usesAddress(mid[j]) ) {
+				runExitFree = false;
+				break;
+			}
+		}
+		Coder::minimizeRun(addrs, address, runExitFree, result);
+	}
+	result.push_back(mid.back());
+}
+
+
+
+
+//
+// The classic rebase and bind opcodes are produced from a temp encoding with one opcode per
+// state change, which peephole passes then combine.  Those passes only merge neighboring address
+// opcodes, so the temp encoding can be cut before any opcode that just sets state (such as
+// SET_SEGMENT_AND_OFFSET) and each piece optimized, sized and written on its own thread into one
+// presized buffer.  The result is the same bytes as encoding the whole stream in order.
+//
+// With -optimize_dyld_info_opcodes each run of address opcodes in a piece is also re-encoded with
+// a dynamic program that finds the fewest bytes, and the smaller of the two encodings is used.
+//
+template <typename T, typename Coder>
+void encodeOpcodePieces(const char* traceName, const std::vector<T>& mid, bool minimize, ByteStream& stream)
+{
+	struct Piece {
+		size_t			start;
+		size_t			end;
+		bool			exitFree;
+		size_t			offset;
+		size_t			size;
+		std::vector<T>	ops;
+	};
+	const size_t kOpsPerPiece = 1024;
+
+	// the last temp opcode is always DONE, which no piece includes
+	const size_t opCount = mid.size() - 1;
+	std::vector<Piece> pieces;
+	size_t start = 0;
+	for (size_t i=1; i < opCount; ++i) {
+		if ( ((i - start) >= kOpsPerPiece) && Coder::startsPiece(mid[i]) ) {
+			pieces.push_back({ start, i, false, 0, 0 });
+			start = i;
+		}
+	}
+	pieces.push_back({ start, opCount, false, 0, 0 });
+
+	// the optimizer may leave any address at the end of a piece if the next
+	// opcode to use the address is a SET_SEGMENT_AND_OFFSET, or there is none
+	if ( minimize ) {
+		bool exitFree = true;
+		for (size_t i=pieces.size(); i > 0; --i) {
+			Piece& piece = pieces[i-1];
+			piece.exitFree = exitFree;
+			for (size_t j=piece.start; j < piece.end; ++j) {
+				if ( Coder::setsAddress(mid[j]) ) {
+					exitFree = true;
+					break;
+				}
+				if ( Coder::usesAddress(mid[j]) ) {
+					exitFree = false;
+					break;
+				}
+			}
+		}
+	}
+
+	Piece* piecesArray = pieces.data();
+	const T* midArray = mid.data();
+	ld::trace::apply(traceName, pieces.size(), ^(size_t index) {
+		Piece& piece = piecesArray[index];
+		piece.ops.reserve(piece.end - piece.start + 1);
+		piece.ops.insert(piece.ops.end(), &midArray[piece.start], &midArray[piece.end]);
+		piece.ops.push_back(midArray[opCount]);
+		std::vector<T> smallest;
+		if ( minimize )
+			minimizeOpcodeRuns<T, Coder>(piece.ops, piece.exitFree, smallest);
+		Coder::peephole(piece.ops);
+		piece.size = Coder::encodedSize(piece.ops);
+		if ( minimize ) {
+			size_t smallestSize = Coder::encodedSize(smallest);
+			if ( smallestSize < piece.size ) {
+				piece.ops.swap(smallest);
+				piece.size = smallestSize;
+			}
+		}
+	});
+
+	size_t totalSize = 0;
+	for (typename std::vector<Piece>::iterator it = pieces.begin(); it != pieces.end(); ++it) {
+		it->offset = totalSize;
+		totalSize += it->size;
+	}
+	if ( totalSize == 0 )
+		return;
+	uint8_t* buffer = stream.alloc(totalSize);
+	ld::trace::apply("write dyld info opcodes", pieces.size(), ^(size_t index) {
+		const Piece& piece = piecesArray[index];
+		uint8_t* end = Coder::write(&buffer[piece.offset], piece.ops);
+		assert(end == &buffer[piece.offset + piece.size]);
+		(void)end;
+	});
+}
+
+
+
+
+template <typename A>
+class RebaseInfoAtom : public LinkEditAtom
+{
+public:
+												RebaseInfoAtom(const Options& opts, ld::Internal& state, OutputFile& writer)
+													: LinkEditAtom(opts, state, writer, _s_section, sizeof(pint_t)) { _encoded = true; }
+
+	// overrides of ld::Atom
+	virtual const char*							name() const		{ return "rebase info"; }
+	// overrides of LinkEditAtom
+	virtual void								encode() const;
+
+private:
+	void						encodeV1() const;
+
+	struct rebase_tmp
+	{
+		rebase_tmp(uint8_t op, uint64_t p1, uint64_t p2=0) : opcode(op), operand1(p1), operand2(p2) {}
+		uint8_t		opcode;
+		uint64_t	operand1;
+		uint64_t	operand2;
+	};
+
+	typedef typename A::P						P;
+	typedef typename A::P::E					E;
+	typedef typename A::P::uint_t				pint_t;
+	
+	static ld::Section			_s_section;
+};
+
+template <typename A>
+ld::Section RebaseInfoAtom<A>::_s_section("__LINKEDIT", "__rebase", ld::Section::typeLinkEdit, true);
+
+
+template <typename A>
+void RebaseInfoAtom<A>::encode() const
+{
+	// omit relocs if this was supposed to be PIE but PIE not possible
+	if ( _options.positionIndependentExecutable() && this->_writer.pieDisabled ) 
+		return;
+
+	// sort rebase info by type, then address
+	std::vector<OutputFile::RebaseInfo>& info = this->_writer._rebaseInfo;
+	if (info.empty())
+		return;
+
+	std::sort(info.begin(), info.end());
+	
+	// use encoding based on target minOS
+	if ( _options.useLinkedListBinding() && !this->_writer._hasUnalignedFixup ) {
+		if ( info.back()._type != REBASE_TYPE_POINTER )
+			throw "unsupported rebase type with linked list opcodes";
+		// As the binding and rebasing are both linked lists, just use the binds
+		// to do everything.
 	} else {
 		encodeV1();
 	}
@@ -467,187 +1048,166 @@ void BindingInfoAtom<A>::encode() const
 
 
 template <typename A>
-void BindingInfoAtom<A>::encodeV1() const
+void RebaseInfoAtom<A>::encodeV1() const
 {
-	// sort by library, symbol, type, then address
-	std::vector<OutputFile::BindingInfo>& info = this->_writer._bindingInfo;
-	std::sort(info.begin(), info.end());
+	std::vector<OutputFile::RebaseInfo>& info = this->_writer._rebaseInfo;
 
 	// convert to temp encoding that can be more easily optimized
-	std::vector<binding_tmp> mid;
+	std::vector<rebase_tmp> mid;
 	uint64_t curSegStart = 0;
 	uint64_t curSegEnd = 0;
 	uint32_t curSegIndex = 0;	
-	int ordinal = 0x80000000;
-	const char* symbolName = NULL;
 	uint8_t type = 0;
 	uint64_t address = (uint64_t)(-1);
-	int64_t addend = 0;
-	for (std::vector<OutputFile::BindingInfo>::const_iterator it = info.begin(); it != info.end(); ++it) {
-		if ( ordinal != it->_libraryOrdinal ) {
-			if ( it->_libraryOrdinal <= 0 ) {
-				// special lookups are encoded as negative numbers in BindingInfo
-				mid.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM, it->_libraryOrdinal));
-			}
-			else {
-				mid.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB, it->_libraryOrdinal));
-			}
-			ordinal = it->_libraryOrdinal;
-		}
-		if ( symbolName != it->_symbolName ) {
-			mid.push_back(binding_tmp(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM, it->_flags, 0, it->_symbolName));
-			symbolName = it->_symbolName;
-		}
+	for (std::vector<OutputFile::RebaseInfo>::iterator it = info.begin(); it != info.end(); ++it) {
 		if ( type != it->_type ) {
-			mid.push_back(binding_tmp(BIND_OPCODE_SET_TYPE_IMM, it->_type));
+			mid.push_back(rebase_tmp(REBASE_OPCODE_SET_TYPE_IMM, it->_type));
 			type = it->_type;
 		}
 		if ( address != it->_address ) {
 			if ( (it->_address < curSegStart) || ( it->_address >= curSegEnd) ) {
 				if ( ! this->_writer.findSegment(this->_state, it->_address, &curSegStart, &curSegEnd, &curSegIndex) )
 					throw "binding address outside range of any segment";
-				mid.push_back(binding_tmp(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB, curSegIndex, it->_address - curSegStart));
+				mid.push_back(rebase_tmp(REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB, curSegIndex, it->_address - curSegStart));
 			}
 			else {
-				mid.push_back(binding_tmp(BIND_OPCODE_ADD_ADDR_ULEB, it->_address-address));
+				mid.push_back(rebase_tmp(REBASE_OPCODE_ADD_ADDR_ULEB, it->_address-address));
 			}
 			address = it->_address;
 		}
-		if ( addend != it->_addend ) {
-			mid.push_back(binding_tmp(BIND_OPCODE_SET_ADDEND_SLEB, it->_addend));
-			addend = it->_addend;
-		}
-		mid.push_back(binding_tmp(BIND_OPCODE_DO_BIND, 0));
+		mid.push_back(rebase_tmp(REBASE_OPCODE_DO_REBASE_ULEB_TIMES, 1));
 		address += sizeof(pint_t);
+		if ( address >= curSegEnd )
+			address = 0;
 	}
-	mid.push_back(binding_tmp(BIND_OPCODE_DONE, 0));
+	mid.push_back(rebase_tmp(REBASE_OPCODE_DONE, 0));
 
+	// optimize and convert to compressed encoding
+	const static bool log = false;
+	this->_encodedData.reserve(info.size()*2);
+	encodeOpcodePieces<rebase_tmp, RebaseOpcodeCoder<A, rebase_tmp> >("rebase opcodes", mid,
+								_options.optimizeDyldInfoOpcodes(), this->_encodedData);
+		
+	// align to pointer size
+	this->_encodedData.pad_to_size(sizeof(pint_t));
 
-	// optimize phase 1, combine bind/add pairs
-	binding_tmp* dst = &mid[0];
-	for (const binding_tmp* src = &mid[0]; src->opcode != BIND_OPCODE_DONE; ++src) {
-		if ( (src->opcode == BIND_OPCODE_DO_BIND) 
-				&& (src[1].opcode == BIND_OPCODE_ADD_ADDR_ULEB) ) {
-			dst->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB;
-			dst->operand1 = src[1].operand1;
-			++src;
-			++dst;
-		}
-		else {
-			*dst++ = *src;
-		}
+	this->_encoded = true;
+
+	if (log) fprintf(stderr, "total rebase info size = %ld\n", this->_encodedData.size());
+}
+
+
+template <typename A>
+class BindingInfoAtom : public LinkEditAtom
+{
+public:
+												BindingInfoAtom(const Options& opts, ld::Internal& state, OutputFile& writer)
+													: LinkEditAtom(opts, state, writer, _s_section, sizeof(pint_t)) { }
+
+	// overrides of ld::Atom
+	virtual const char*							name() const		{ return "binding info"; }
+	// overrides of LinkEditAtom
+	virtual void								encode() const;
+
+
+private:
+	void						encodeV1() const;
+	void						encodeV2() const;
+
+	typedef typename A::P						P;
+	typedef typename A::P::E					E;
+	typedef typename A::P::uint_t				pint_t;
+
+	struct binding_tmp
+	{
+		binding_tmp(uint8_t op, uint64_t p1, uint64_t p2=0, const char* s=NULL) 
+			: opcode(op), operand1(p1), operand2(p2), name(s) {}
+		uint8_t		opcode;
+		uint64_t	operand1;
+		uint64_t	operand2;
+		const char*	name;
+	};
+
+	static ld::Section			_s_section;
+};
+
+template <typename A>
+ld::Section BindingInfoAtom<A>::_s_section("__LINKEDIT", "__binding", ld::Section::typeLinkEdit, true);
+
+
+template <typename A>
+void BindingInfoAtom<A>::encode() const
+{
+	// use encoding based on target minOS
+	if ( _options.useLinkedListBinding() && !this->_writer._hasUnalignedFixup ) {
+		encodeV2();
+	} else {
+		encodeV1();
 	}
-	dst->opcode = BIND_OPCODE_DONE;
+}
 
-	// optimize phase 2, compress packed runs of BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB with
-	// same addr delta into one BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB
-	dst = &mid[0];
-	for (const binding_tmp* src = &mid[0]; src->opcode != BIND_OPCODE_DONE; ++src) {
-		uint64_t delta = src->operand1;
-		if ( (src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
-				&& (src[1].opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
-				&& (src[1].operand1 == delta) ) {
-			// found at least two in a row, this is worth compressing
-			dst->opcode = BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB;
-			dst->operand1 = 1;
-			dst->operand2 = delta;
-			++src;
-			while ( (src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB)
-					&& (src->operand1 == delta) ) {
-				dst->operand1++;
-				++src;
+
+template <typename A>
+void BindingInfoAtom<A>::encodeV1() const
+{
+	// sort by library, symbol, type, then address
+	std::vector<OutputFile::BindingInfo>& info = this->_writer._bindingInfo;
+	std::sort(info.begin(), info.end());
+
+	// convert to temp encoding that can be more easily optimized
+	std::vector<binding_tmp> mid;
+	uint64_t curSegStart = 0;
+	uint64_t curSegEnd = 0;
+	uint32_t curSegIndex = 0;	
+	int ordinal = 0x80000000;
+	const char* symbolName = NULL;
+	uint8_t type = 0;
+	uint64_t address = (uint64_t)(-1);
+	int64_t addend = 0;
+	for (std::vector<OutputFile::BindingInfo>::const_iterator it = info.begin(); it != info.end(); ++it) {
+		if ( ordinal != it->_libraryOrdinal ) {
+			if ( it->_libraryOrdinal <= 0 ) {
+				// special lookups are encoded as negative numbers in BindingInfo
+				mid.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM, it->_libraryOrdinal));
+			}
+			else {
+				mid.push_back(binding_tmp(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB, it->_libraryOrdinal));
 			}
-			--src;
-			++dst;
+			ordinal = it->_libraryOrdinal;
 		}
-		else {
-			*dst++ = *src;
+		if ( symbolName != it->_symbolName ) {
+			mid.push_back(binding_tmp(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM, it->_flags, 0, it->_symbolName));
+			symbolName = it->_symbolName;
 		}
-	}
-	dst->opcode = BIND_OPCODE_DONE;
-	
-	// optimize phase 3, use immediate encodings
-	for (binding_tmp* p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p) {
-		if ( (p->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
-			&& (p->operand1 < (15*sizeof(pint_t)))
-			&& ((p->operand1 % sizeof(pint_t)) == 0) ) {
-			p->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED;
-			p->operand1 = p->operand1/sizeof(pint_t);
+		if ( type != it->_type ) {
+			mid.push_back(binding_tmp(BIND_OPCODE_SET_TYPE_IMM, it->_type));
+			type = it->_type;
 		}
-		else if ( (p->opcode == BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB) && (p->operand1 <= 15) ) {
-			p->opcode = BIND_OPCODE_SET_DYLIB_ORDINAL_IMM;
+		if ( address != it->_address ) {
+			if ( (it->_address < curSegStart) || ( it->_address >= curSegEnd) ) {
+				if ( ! this->_writer.findSegment(this->_state, it->_address, &curSegStart, &curSegEnd, &curSegIndex) )
+					throw "binding address outside range of any segment";
+				mid.push_back(binding_tmp(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB, curSegIndex, it->_address - curSegStart));
+			}
+			else {
+				mid.push_back(binding_tmp(BIND_OPCODE_ADD_ADDR_ULEB, it->_address-address));
+			}
+			address = it->_address;
 		}
-	}	
-	dst->opcode = BIND_OPCODE_DONE;
+		if ( addend != it->_addend ) {
+			mid.push_back(binding_tmp(BIND_OPCODE_SET_ADDEND_SLEB, it->_addend));
+			addend = it->_addend;
+		}
+		mid.push_back(binding_tmp(BIND_OPCODE_DO_BIND, 0));
+		address += sizeof(pint_t);
+	}
+	mid.push_back(binding_tmp(BIND_OPCODE_DONE, 0));
 
-	// convert to compressed encoding
+	// optimize and convert to compressed encoding
 	const static bool log = false;
 	this->_encodedData.reserve(info.size()*2);
-	bool done = false;
-	for (typename std::vector<binding_tmp>::iterator it = mid.begin(); !done && it != mid.end() ; ++it) {
-		switch ( it->opcode ) {
-			case BIND_OPCODE_DONE:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DONE()\n");
-				done = true;
-				break;
-			case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_ORDINAL_IMM(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | it->operand1);
-				break;
-			case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				break;
-			case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_SPECIAL_IMM(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM | (it->operand1 & BIND_IMMEDIATE_MASK));
-				break;
-			case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM(0x%0llX, %s)\n", it->operand1, it->name);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM | it->operand1);
-				this->_encodedData.append_string(it->name);
-				break;
-			case BIND_OPCODE_SET_TYPE_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_TYPE_IMM(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_TYPE_IMM | it->operand1);
-				break;
-			case BIND_OPCODE_SET_ADDEND_SLEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_ADDEND_SLEB(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_ADDEND_SLEB);
-				this->_encodedData.append_sleb128(it->operand1);
-				break;
-			case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB(%lld, 0x%llX)\n", it->operand1, it->operand2);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | it->operand1);
-				this->_encodedData.append_uleb128(it->operand2);
-				break;
-			case BIND_OPCODE_ADD_ADDR_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_ADD_ADDR_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				break;
-			case BIND_OPCODE_DO_BIND:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND()\n");
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND);
-				break;
-			case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				break;
-			case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED(%lld=0x%llX)\n", it->operand1, it->operand1*sizeof(pint_t));
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED | it->operand1 );
-				break;
-			case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB(%lld, %lld)\n", it->operand1, it->operand2);
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				this->_encodedData.append_uleb128(it->operand2);
-				break;
-		}
-	}
+	encodeOpcodePieces<binding_tmp, BindOpcodeCoder<A, binding_tmp> >("bind opcodes", mid,
+								_options.optimizeDyldInfoOpcodes(), this->_encodedData);
 	
 	// align to pointer size
 	this->_encodedData.pad_to_size(sizeof(pint_t));
@@ -984,131 +1544,12 @@ void WeakBindingInfoAtom<A>::encode() const
 	}
 	mid.push_back(binding_tmp(BIND_OPCODE_DONE, 0));
 
-
-	// optimize phase 1, combine bind/add pairs
-	binding_tmp* dst = &mid[0];
-	for (const binding_tmp* src = &mid[0]; src->opcode != BIND_OPCODE_DONE; ++src) {
-		if ( (src->opcode == BIND_OPCODE_DO_BIND) 
-				&& (src[1].opcode == BIND_OPCODE_ADD_ADDR_ULEB) ) {
-			dst->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB;
-			dst->operand1 = src[1].operand1;
-			++src;
-			++dst;
-		}
-		else {
-			*dst++ = *src;
-		}
-	}
-	dst->opcode = BIND_OPCODE_DONE;
-
-	// optimize phase 2, compress packed runs of BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB with
-	// same addr delta into one BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB
-	dst = &mid[0];
-	for (const binding_tmp* src = &mid[0]; src->opcode != BIND_OPCODE_DONE; ++src) {
-		uint64_t delta = src->operand1;
-		if ( (src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
-				&& (src[1].opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
-				&& (src[1].operand1 == delta) ) {
-			// found at least two in a row, this is worth compressing
-			dst->opcode = BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB;
-			dst->operand1 = 1;
-			dst->operand2 = delta;
-			++src;
-			while ( (src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB)
-					&& (src->operand1 == delta) ) {
-				dst->operand1++;
-				++src;
-			}
-			--src;
-			++dst;
-		}
-		else {
-			*dst++ = *src;
-		}
-	}
-	dst->opcode = BIND_OPCODE_DONE;
-	
-	// optimize phase 3, use immediate encodings
-	for (binding_tmp* p = &mid[0]; p->opcode != REBASE_OPCODE_DONE; ++p) {
-		if ( (p->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB) 
-			&& (p->operand1 < (15*sizeof(pint_t)))
-			&& ((p->operand1 % sizeof(pint_t)) == 0) ) {
-			p->opcode = BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED;
-			p->operand1 = p->operand1/sizeof(pint_t);
-		}
-	}	
-	dst->opcode = BIND_OPCODE_DONE;
-
-
-	// convert to compressed encoding
+	// optimize and convert to compressed encoding
 	const static bool log = false;
 	this->_encodedData.reserve(info.size()*2);
-	bool done = false;
-	for (typename std::vector<binding_tmp>::iterator it = mid.begin(); !done && it != mid.end() ; ++it) {
-		switch ( it->opcode ) {
-			case BIND_OPCODE_DONE:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DONE()\n");
-				this->_encodedData.append_byte(BIND_OPCODE_DONE);
-				done = true;
-				break;
-			case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_ORDINAL_IMM(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | it->operand1);
-				break;
-			case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				break;
-			case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_DYLIB_SPECIAL_IMM(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM | (it->operand1 & BIND_IMMEDIATE_MASK));
-				break;
-			case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM(0x%0llX, %s)\n", it->operand1, it->name);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM | it->operand1);
-				this->_encodedData.append_string(it->name);
-				break;
-			case BIND_OPCODE_SET_TYPE_IMM:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_TYPE_IMM(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_TYPE_IMM | it->operand1);
-				break;
-			case BIND_OPCODE_SET_ADDEND_SLEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_ADDEND_SLEB(%lld)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_ADDEND_SLEB);
-				this->_encodedData.append_sleb128(it->operand1);
-				break;
-			case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB(%lld, 0x%llX)\n", it->operand1, it->operand2);
-				this->_encodedData.append_byte(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | it->operand1);
-				this->_encodedData.append_uleb128(it->operand2);
-				break;
-			case BIND_OPCODE_ADD_ADDR_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_ADD_ADDR_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				break;
-			case BIND_OPCODE_DO_BIND:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND()\n");
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND);
-				break;
-			case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB(0x%llX)\n", it->operand1);
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				break;
-			case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED(%lld=0x%llX)\n", it->operand1, it->operand1*sizeof(pint_t));
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED | it->operand1 );
-				break;
-			case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
-				if ( log ) fprintf(stderr, "BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB(%lld, %lld)\n", it->operand1, it->operand2);
-				this->_encodedData.append_byte(BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB);
-				this->_encodedData.append_uleb128(it->operand1);
-				this->_encodedData.append_uleb128(it->operand2);
-				break;
-		}
-	}
+	encodeOpcodePieces<binding_tmp, BindOpcodeCoder<A, binding_tmp> >("weak bind opcodes", mid,
+								_options.optimizeDyldInfoOpcodes(), this->_encodedData);
+	this->_encodedData.append_byte(BIND_OPCODE_DONE);
 	
 	// align to pointer size
 	this->_encodedData.pad_to_size(sizeof(pint_t));
@@ -1149,40 +1590,68 @@ ld::Section LazyBindingInfoAtom<A>::_s_section("__LINKEDIT", "__lazy_binding", l
 template <typename A>
 void LazyBindingInfoAtom<A>::encode() const
 {
-	// stream all lazy bindings and record start offsets
+	// stream lazy bindings in ranges on separate threads, each binding is independent of the others
 	std::vector<OutputFile::BindingInfo>& info = this->_writer._lazyBindingInfo;
-	for (std::vector<OutputFile::BindingInfo>::const_iterator it = info.begin(); it != info.end(); ++it) {
-		// record start offset for use by stub helper
-		this->_writer.setLazyBindingInfoOffset(it->_address, this->_encodedData.size());
-
-		// write address to bind
-		uint64_t segStart = 0;
-		uint64_t segEnd = 0;
-		uint32_t segIndex = 0;	
-		if ( ! this->_writer.findSegment(this->_state, it->_address, &segStart, &segEnd, &segIndex) )
-			throw "lazy binding address outside range of any segment";
-		this->_encodedData.append_byte(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | segIndex);
-		this->_encodedData.append_uleb128(it->_address - segStart);
-		
-		// write ordinal
-		if ( it->_libraryOrdinal <= 0 ) {
-			// special lookups are encoded as negative numbers in BindingInfo
-			this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM | (it->_libraryOrdinal & BIND_IMMEDIATE_MASK) );
-		}
-		else if ( it->_libraryOrdinal <= 15 ) {
-			// small ordinals are encoded in opcode
-			this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | it->_libraryOrdinal);
-		}
-		else {
-			this->_encodedData.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB);
-			this->_encodedData.append_uleb128(it->_libraryOrdinal);
+	struct LazyRange {
+		ByteStream				bytes;
+		std::vector<uint32_t>	offsets;
+		const char*				error;
+	};
+	const size_t kBindingsPerRange = 1024;
+	std::vector<LazyRange> ranges((info.size() + kBindingsPerRange - 1) / kBindingsPerRange);
+	LazyRange* rangesArray = ranges.data();
+	const OutputFile::BindingInfo* infoArray = info.data();
+	const size_t infoCount = info.size();
+	ld::trace::apply("lazy bind opcodes", ranges.size(), ^(size_t index) {
+		LazyRange& range = rangesArray[index];
+		range.error = NULL;
+		const size_t end = std::min<size_t>(infoCount, (index + 1) * kBindingsPerRange);
+		for (size_t i=index * kBindingsPerRange; i < end; ++i) {
+			const OutputFile::BindingInfo* it = &infoArray[i];
+			range.offsets.push_back(range.bytes.size());
+
+			// write address to bind
+			uint64_t segStart = 0;
+			uint64_t segEnd = 0;
+			uint32_t segIndex = 0;	
+			if ( ! this->_writer.findSegment(this->_state, it->_address, &segStart, &segEnd, &segIndex) ) {
+				range.error = "lazy binding address outside range of any segment";
+				return;
+			}
+			range.bytes.append_byte(BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | segIndex);
+			range.bytes.append_uleb128(it->_address - segStart);
+			
+			// write ordinal
+			if ( it->_libraryOrdinal <= 0 ) {
+				// special lookups are encoded as negative numbers in BindingInfo
+				range.bytes.append_byte(BIND_OPCODE_SET_DYLIB_SPECIAL_IMM | (it->_libraryOrdinal & BIND_IMMEDIATE_MASK) );
+			}
+			else if ( it->_libraryOrdinal <= 15 ) {
+				// small ordinals are encoded in opcode
+				range.bytes.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | it->_libraryOrdinal);
+			}
+			else {
+				range.bytes.append_byte(BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB);
+				range.bytes.append_uleb128(it->_libraryOrdinal);
+			}
+			// write symbol name
+			range.bytes.append_byte(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM | it->_flags);
+			range.bytes.append_string(it->_symbolName);
+			// write do bind
+			range.bytes.append_byte(BIND_OPCODE_DO_BIND);
+			range.bytes.append_byte(BIND_OPCODE_DONE);
 		}
-		// write symbol name
-		this->_encodedData.append_byte(BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM | it->_flags);
-		this->_encodedData.append_string(it->_symbolName);
-		// write do bind
-		this->_encodedData.append_byte(BIND_OPCODE_DO_BIND);
-		this->_encodedData.append_byte(BIND_OPCODE_DONE);
+	});
+
+	// concatenate in order and record start offsets for use by stub helper
+	for (size_t index=0; index < ranges.size(); ++index) {
+		const LazyRange& range = ranges[index];
+		if ( range.error != NULL )
+			throw range.error;
+		const uint32_t rangeStart = this->_encodedData.size();
+		for (size_t i=0; i < range.offsets.size(); ++i)
+			this->_writer.setLazyBindingInfoOffset(info[index * kBindingsPerRange + i]._address, rangeStart + range.offsets[i]);
+		this->_encodedData.append_mem(range.bytes.start(), range.bytes.size());
 	}
 	
 	// align to pointer size
@@ -1269,6 +1738,8 @@ void ChainedInfoAtom<A>::encode() const
 		}
 	}
 	_writer._chainedFixupBinds.setMaxRebase(maxRebaseAddress);
+	// lay out the starts of each segment, then fill in the page starts of all segments concurrently
+	std::vector<unsigned long> pageStartsOffsets(_writer._chainedFixupSegments.size(), 0);
 	for (OutputFile::ChainedFixupSegInfo& segInfo : _writer._chainedFixupSegments) {
 		if ( !segInfo.pages.empty() ) {
 			uint32_t startBytesPerPage = sizeof(uint16_t);
@@ -1292,20 +1763,24 @@ void ChainedInfoAtom<A>::encode() const
 			dyld_chained_starts_in_image* segHeader = (dyld_chained_starts_in_image*)(this->_encodedData.start()+segsHeaderOffset);
 			segHeader->seg_info_offset[segIndex] = this->_encodedData.size() - segsHeaderOffset;
 			this->_encodedData.append_mem(&aSeg, offsetof(dyld_chained_starts_in_segment, page_start) );
-			std::vector<uint16_t> 	segChainOverflows;
-			for (OutputFile::ChainedFixupPageInfo& pageInfo : segInfo.pages) {
-				uint16_t startOffset = pageInfo.fixupOffsets.empty() ? DYLD_CHAINED_PTR_START_NONE : pageInfo.fixupOffsets.front();
-				this->_encodedData.append_mem(&startOffset, sizeof(startOffset));
-			}
-			if ( segInfo.pointerFormat == DYLD_CHAINED_PTR_32 ) {
-				// zero out chain overflow area
-				long padBytes = (startBytesPerPage-2) * segInfo.pages.size();
-				for (long i=0; i < padBytes; ++i)
-					this->_encodedData.append_byte(0);
-			}
+			pageStartsOffsets[segIndex] = this->_encodedData.size();
+			// page starts, followed by the zeroed chain overflow area of 32-bit formats
+			this->_encodedData.bytes().resize(this->_encodedData.size() + startBytesPerPage * segInfo.pages.size(), 0);
 		}
 		++segIndex;
 	}
+	OutputFile::ChainedFixupSegInfo* segments = _writer._chainedFixupSegments.data();
+	const unsigned long* startsOffsets = pageStartsOffsets.data();
+	uint8_t* encodedBytes = this->_encodedData.bytes().data();
+	ld::trace::apply("chained fixup page starts", _writer._chainedFixupSegments.size(), ^(size_t index) {
+		const OutputFile::ChainedFixupSegInfo& segInfo = segments[index];
+		uint8_t* pageStarts = &encodedBytes[startsOffsets[index]];
+		for (const OutputFile::ChainedFixupPageInfo& pageInfo : segInfo.pages) {
+			uint16_t startOffset = pageInfo.fixupOffsets.empty() ? DYLD_CHAINED_PTR_START_NONE : pageInfo.fixupOffsets.front();
+			memcpy(pageStarts, &startOffset, sizeof(startOffset));
+			pageStarts += sizeof(startOffset);
+		}
+	});
 
 	// build imports and symbol table
 	__block std::vector<dyld_chained_import>  		  imports;
@@ -2209,8 +2684,12 @@ public:
 	// overrides of LinkEditAtom
 	virtual void								encode() const;
 
+			void								prepareEarlyHashes() const;
+			void								hashPage(const uint8_t* wholeFileBuffer, uint64_t pageIndex) const;
 			void								hash(uint8_t* wholeFileBuffer) const;
 
+	static const uint64_t						kPageSize = 4096;	// code signing page size used by libcodedirectory
+
 private:
 	const Options& 				_opts;
 	mutable libcd*				_sigRef = nullptr;
@@ -2296,6 +2775,17 @@ void CodeSignatureAtom::encode() const
 	codeSignSect->size = this->_encodedData.size();
 }
 
+void CodeSignatureAtom::prepareEarlyHashes() const
+{
+	libcd_prepare_page_hashes(_sigRef);
+}
+
+void CodeSignatureAtom::hashPage(const uint8_t* wholeFileBuffer, uint64_t pageIndex) const
+{
+	// if this fails, libcd_serialize() reads and hashes the page again
+	(void)libcd_hash_page(_sigRef, pageIndex, &wholeFileBuffer[pageIndex*kPageSize]);
+}
+
 void CodeSignatureAtom::hash(uint8_t* wholeFileBuffer) const
 {
 	Internal::FinalSection* codeSignSect = _state.sections.back();
@@ -30,12 +30,19 @@
 #include <errno.h>
 #include <limits.h>
 #include <unistd.h>
+#include <dispatch/dispatch.h>
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "Options.h"
 #include "ld.hpp"
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
 #include "Containers.h"
+#include "Trace.h"
 
 namespace ld {
 namespace tool {
@@ -70,6 +77,13 @@ protected:
 
 
 
+//
+// The string pool only records strings while the symbol table is built.  add() and addUnique()
+// return a handle, and layout() then assigns every handle its offset: lengths, de-duplication
+// (sharded by hash) and offsets (a prefix sum over chunks) are all computed in parallel, and
+// the strings are copied straight into the output buffer by copyRawContent().  Offsets only
+// depend on the order strings were added, so they are the same from link to link.
+//
 class StringPoolAtom : public ClassicLinkEditAtom
 {
 public:
@@ -83,22 +97,31 @@ public:
 	// overrides of ClassicLinkEditAtom
 	virtual void								encode() { }
 
-	int32_t										add(const char* name);
-	int32_t										addUnique(const char* name);
-	int32_t										emptyString()			{ return 1; }
-	const char*									stringForIndex(int32_t) const;
-	uint32_t									currentOffset();
+	// strings must stay valid until the content is written
+	uint32_t									add(const char* name);
+	uint32_t									addUnique(const char* name);
+	uint32_t									emptyString()			{ return kEmptyStringHandle; }
+	uint32_t									position() const		{ return (uint32_t)_strings.size(); }
+	// strings added before tailMergeEnd may share the bytes of a longer string they are a suffix of
+	void										layout(uint32_t tailMergeEnd);
+	uint32_t									offset(uint32_t handle) const	{ return _offsets[handle]; }
+	uint32_t									offsetAtPosition(uint32_t position) const { return _runningOffsets[position]; }
 
 private:
-	enum { kBufferSize = 0x01000000 };
-	using StringToOffset = CStringMap<int32_t>;
+	enum { kBurnedHandle = 0, kEmptyStringHandle = 1, kShardCount = 64, kChunkSize = 0x4000 };
+
+	void										tailMerge(uint32_t tailMergeEnd);
 
 	const uint32_t							_pointerSize;
-	std::vector<char*>						_fullBuffers;
-	char*									_currentBuffer;
-	uint32_t								_currentBufferUsed;
-	StringToOffset							_uniqueStrings;
+	std::vector<const char*>				_strings;
+	std::vector<uint8_t>					_unique;
+	std::vector<uint32_t>					_lengths;
+	std::vector<uint32_t>					_owners;			// handle whose bytes a string uses, itself if it has its own
+	std::vector<uint32_t>					_offsets;
+	std::vector<uint32_t>					_runningOffsets;	// bytes before each position
+	uint32_t								_size;
 	bool									_skipUniquing;
+	bool									_tailMerge;
 
 	static ld::Section			_s_section;
 };
@@ -108,100 +131,206 @@ ld::Section StringPoolAtom::_s_section("__LINKEDIT", "__string_pool", ld::Sectio
 
 StringPoolAtom::StringPoolAtom(const Options& opts, ld::Internal& state, OutputFile& writer, int pointerSize)
 	: ClassicLinkEditAtom(opts, state, writer, _s_section, pointerSize), 
-	 _pointerSize(pointerSize), _currentBuffer(NULL), _currentBufferUsed(0), _skipUniquing(false)
+	 _pointerSize(pointerSize), _size(2), _skipUniquing(false), _tailMerge(opts.tailMergeStrings())
 {
-	_currentBuffer = new char[kBufferSize];
-	// burn first byte of string pool (so zero is never a valid string offset)
-	_currentBuffer[_currentBufferUsed++] = ' ';
-	// make offset 1 always point to an empty string
-	_currentBuffer[_currentBufferUsed++] = '\0';
-
 	// guestimate symbol count as being double the number of global symbols
-	_uniqueStrings.reserve(state.indirectBindingTable.size()*2);
+	_strings.reserve(state.indirectBindingTable.size()*2);
+	_unique.reserve(state.indirectBindingTable.size()*2);
+
+	// burn first byte of string pool (so zero is never a valid string offset)
+	this->add(" ");
+	// make offset 1 always point to an empty string, which is the end of the burned string
+	this->add("");
 
 	// to improve linking perfomance, don't dedup symbol strings in debug builds
 	_skipUniquing = !opts.deduplicateFunctions();
+
+	_runningOffsets.assign(1, 0);
 }
 
 uint64_t StringPoolAtom::size() const
 {
 	// pointer size align size
-	return (kBufferSize * _fullBuffers.size() + _currentBufferUsed + _pointerSize-1) & (-_pointerSize);
+	return (_size + _pointerSize-1) & (-_pointerSize);
 }
 
 void StringPoolAtom::copyRawContent(uint8_t buffer[]) const
 {
-	uint64_t offset = 0;
-	for (unsigned int i=0; i < _fullBuffers.size(); ++i) {
-		memcpy(&buffer[offset], _fullBuffers[i], kBufferSize);
-		offset += kBufferSize;
-	}
-	memcpy(&buffer[offset], _currentBuffer, _currentBufferUsed);
+	const char* const* strings = _strings.data();
+	const uint32_t* lengths = _lengths.data();
+	const uint32_t* owners = _owners.data();
+	const uint32_t* runningOffsets = _runningOffsets.data();
+	const size_t count = _strings.size();
+	ld::trace::apply("copy strings", (count + kChunkSize - 1) / kChunkSize, ^(size_t chunk) {
+		const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+		for (size_t i = chunk * kChunkSize; i < chunkEnd; ++i) {
+			if ( owners[i] == i )
+				memcpy(&buffer[runningOffsets[i]], strings[i], lengths[i] + 1);
+		}
+	});
 	// zero fill end to align
-	offset += _currentBufferUsed;
-	while ( (offset % _pointerSize) != 0 )
-		buffer[offset++] = 0;
+	for (uint64_t offset = _size; (offset % _pointerSize) != 0; ++offset)
+		buffer[offset] = 0;
 }
 
-int32_t StringPoolAtom::add(const char* str)
+uint32_t StringPoolAtom::add(const char* str)
 {
-	int32_t offset = kBufferSize * _fullBuffers.size() + _currentBufferUsed;
-	int lenNeeded = strlcpy(&_currentBuffer[_currentBufferUsed], str, kBufferSize-_currentBufferUsed)+1;
-	if ( (_currentBufferUsed+lenNeeded) < kBufferSize ) {
-		_currentBufferUsed += lenNeeded;
-	}
-	else {
-		int copied = kBufferSize-_currentBufferUsed-1;
-		// change trailing '\0' that strlcpy added to real char
-		_currentBuffer[kBufferSize-1] = str[copied];
-		// alloc next buffer
-		_fullBuffers.push_back(_currentBuffer);
-		_currentBuffer = new char[kBufferSize];
-		_currentBufferUsed = 0;
-		// append rest of string
-		this->add(&str[copied+1]);
-	}
-	return offset;
+	_strings.push_back(str);
+	_unique.push_back(false);
+	return (uint32_t)_strings.size() - 1;
 }
 
-uint32_t StringPoolAtom::currentOffset()
+uint32_t StringPoolAtom::addUnique(const char* str)
 {
-	return kBufferSize * _fullBuffers.size() + _currentBufferUsed;
+	_strings.push_back(str);
+	_unique.push_back(!_skipUniquing);
+	return (uint32_t)_strings.size() - 1;
 }
 
-
-int32_t StringPoolAtom::addUnique(const char* str)
+void StringPoolAtom::layout(uint32_t tailMergeEnd)
 {
-	if ( _skipUniquing ) {
-		return this->add(str);
-	}
-	else {
-		StringToOffset::iterator pos = _uniqueStrings.find(str);
-		if ( pos != _uniqueStrings.end() ) {
-			return pos->second;
+	const size_t count = _strings.size();
+	const size_t chunkCount = (count + kChunkSize - 1) / kChunkSize;
+	_lengths.resize(count);
+	_owners.resize(count);
+	_offsets.resize(count);
+	_runningOffsets.resize(count + 1);
+	const char* const* strings = _strings.data();
+	const uint8_t* unique = _unique.data();
+	uint32_t* lengths = _lengths.data();
+	uint32_t* owners = _owners.data();
+	uint32_t* offsets = _offsets.data();
+	uint32_t* runningOffsets = _runningOffsets.data();
+
+	ld::trace::apply("measure strings", chunkCount, ^(size_t chunk) {
+		const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+		for (size_t i = chunk * kChunkSize; i < chunkEnd; ++i) {
+			lengths[i] = (uint32_t)strlen(strings[i]);
+			owners[i] = (uint32_t)i;
 		}
-		else {
-			int32_t offset = this->add(str);
-			_uniqueStrings[str] = offset;
-			return offset;
+	});
+	owners[kEmptyStringHandle] = kBurnedHandle;
+
+	// de-duplicate addUnique() strings: a shard sees all copies of a string, in the order they were
+	// added, so every copy uses the first one just as when the strings were uniqued one at a time
+	if ( std::find(_unique.begin(), _unique.end(), true) != _unique.end() ) {
+		std::vector<std::vector<uint32_t>> shards(kShardCount);
+		std::vector<uint8_t> shardForString(count);
+		uint8_t* shardIndexes = shardForString.data();
+		ld::trace::apply("shard strings", chunkCount, ^(size_t chunk) {
+			const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+			for (size_t i = chunk * kChunkSize; i < chunkEnd; ++i) {
+				if ( unique[i] )
+					shardIndexes[i] = std::hash<std::string_view>()(std::string_view(strings[i], lengths[i])) % kShardCount;
+			}
+		});
+		for (uint32_t i = 0; i < count; ++i) {
+			if ( unique[i] )
+				shards[shardForString[i]].push_back(i);
 		}
+		std::vector<uint32_t>* shardList = shards.data();
+		ld::trace::apply("dedup strings", kShardCount, ^(size_t shard) {
+			std::unordered_map<std::string_view, uint32_t> firstCopy;
+			firstCopy.reserve(shardList[shard].size());
+			for (uint32_t i : shardList[shard]) {
+				auto pos = firstCopy.emplace(std::string_view(strings[i], lengths[i]), i);
+				if ( !pos.second )
+					owners[i] = pos.first->second;
+			}
+		});
 	}
-}
 
+	if ( _tailMerge )
+		this->tailMerge(tailMergeEnd);
 
-const char* StringPoolAtom::stringForIndex(int32_t index) const
+	// strings with their own bytes are laid out in the order they were added
+	std::vector<uint32_t> chunkStarts(chunkCount + 1, 0);
+	uint32_t* chunkSizes = &chunkStarts[1];
+	ld::trace::apply("size strings", chunkCount, ^(size_t chunk) {
+		const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+		uint32_t chunkSize = 0;
+		for (size_t i = chunk * kChunkSize; i < chunkEnd; ++i) {
+			if ( owners[i] == i )
+				chunkSize += lengths[i] + 1;
+		}
+		chunkSizes[chunk] = chunkSize;
+	});
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+		chunkStarts[chunk + 1] += chunkStarts[chunk];
+	const uint32_t* starts = chunkStarts.data();
+	ld::trace::apply("place strings", chunkCount, ^(size_t chunk) {
+		const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+		uint32_t offset = starts[chunk];
+		for (size_t i = chunk * kChunkSize; i < chunkEnd; ++i) {
+			runningOffsets[i] = offset;
+			if ( owners[i] == i )
+				offset += lengths[i] + 1;
+		}
+	});
+	_size = chunkStarts[chunkCount];
+	runningOffsets[count] = _size;
+	ld::trace::apply("offset strings", chunkCount, ^(size_t chunk) {
+		const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+		for (size_t i = chunk * kChunkSize; i < chunkEnd; ++i) {
+			const uint32_t owner = owners[i];
+			offsets[i] = runningOffsets[owner] + lengths[owner] - lengths[i];
+		}
+	});
+}
+
+//
+// A string that ends another string can point into that string's bytes.  Strings can only be
+// suffixes of each other if they end in the same character, so each last character is handled
+// in parallel.  Sorting a bucket by reversed string puts each string right before the strings
+// it is a suffix of, so walking the sorted bucket backwards finds every merge.
+//
+void StringPoolAtom::tailMerge(uint32_t tailMergeEnd)
 {
-	int32_t currentBufferStartIndex = kBufferSize * _fullBuffers.size();
-	int32_t maxIndex = currentBufferStartIndex + _currentBufferUsed;
-	// check for out of bounds
-	if ( index > maxIndex )
-		return "";
-	// check for index in _currentBuffer
-	if ( index > currentBufferStartIndex )
-		return &_currentBuffer[index-currentBufferStartIndex];
-	// otherwise index is in a full buffer
-	uint32_t fullBufferIndex = index/kBufferSize;
-	return &_fullBuffers[fullBufferIndex][index-(kBufferSize*fullBufferIndex)];
+	std::vector<std::vector<uint32_t>> buckets(256);
+	// the burned string must keep offset 0 to itself
+	for (uint32_t i = kEmptyStringHandle + 1; i < tailMergeEnd; ++i) {
+		if ( (_owners[i] == i) && (_lengths[i] != 0) )
+			buckets[(uint8_t)_strings[i][_lengths[i] - 1]].push_back(i);
+	}
+	const char* const* strings = _strings.data();
+	const uint32_t* lengths = _lengths.data();
+	uint32_t* owners = _owners.data();
+	std::vector<uint32_t>* bucketList = buckets.data();
+	ld::trace::apply("tail merge strings", buckets.size(), ^(size_t bucketIndex) {
+		std::vector<uint32_t>& bucket = bucketList[bucketIndex];
+		if ( bucket.size() < 2 )
+			return;
+		std::sort(bucket.begin(), bucket.end(), [&](uint32_t a, uint32_t b) {
+			const uint8_t* aChar = (uint8_t*)strings[a] + lengths[a];
+			const uint8_t* bChar = (uint8_t*)strings[b] + lengths[b];
+			const uint32_t common = std::min(lengths[a], lengths[b]);
+			for (uint32_t i = 0; i < common; ++i) {
+				--aChar;
+				--bChar;
+				if ( *aChar != *bChar )
+					return *aChar < *bChar;
+			}
+			if ( lengths[a] != lengths[b] )
+				return lengths[a] < lengths[b];
+			// equal strings: the first one added keeps its bytes
+			return a > b;
+		});
+		uint32_t owner = bucket.back();
+		for (size_t i = bucket.size() - 1; i-- > 0; ) {
+			const uint32_t candidate = bucket[i];
+			const uint32_t length = lengths[candidate];
+			if ( (length <= lengths[owner]) && (memcmp(strings[candidate], strings[owner] + lengths[owner] - length, length) == 0) )
+				owners[candidate] = owner;
+			else
+				owner = candidate;
+		}
+	});
+	// copies made by de-duplication follow their string
+	for (uint32_t i = kEmptyStringHandle + 1; i < _owners.size(); ++i) {
+		const uint32_t owner = _owners[i];
+		if ( (owner != i) && (_owners[owner] != owner) )
+			_owners[i] = _owners[owner];
+	}
 }
 
 
@@ -236,10 +365,14 @@ private:
 	uint32_t						stringOffsetForStab(const ld::relocatable::File::Stab& stab, StringPoolAtom* pool);
 	uint64_t						valueForStab(const ld::relocatable::File::Stab& stab);
 	uint8_t							sectionIndexForStab(const ld::relocatable::File::Stab& stab);
+	static void						resolveStringHandles(std::vector<macho_nlist<P> >& entries, const std::vector<uint32_t>& valueIndexes,
+																const StringPoolAtom* pool);
 
 	mutable std::vector<macho_nlist<P> >	_globals;
 	mutable std::vector<macho_nlist<P> >	_locals;
 	mutable std::vector<macho_nlist<P> >	_imports;
+	std::vector<uint32_t>					_globalsWithStringValue;
+	std::vector<uint32_t>					_importsWithStringValue;
 	
 	uint32_t								_stabsStringsOffsetStart;
 	uint32_t								_stabsStringsOffsetEnd;
@@ -388,11 +521,11 @@ void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringPoolAtom* pool)
 
 	// set n_strx
 	const char* symbolName = atom->name();
-	char anonName[32];
 	if ( this->_options.outputKind() == Options::kObjectFile ) {
 		if ( atom->symbolTableInclusion() == ld::Atom::symbolTableInWithRandomAutoStripLabel ) {
 			// make auto-strip anonymous name for symbol 
-			sprintf(anonName, "l%03u", _s_anonNameIndex++);
+			char* anonName;
+			asprintf(&anonName, "l%03u", _s_anonNameIndex++);
 			symbolName = anonName;
 		}
 	}
@@ -469,6 +602,7 @@ void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringPoolAtom* pool)
 		}
 		else
 			entry.set_n_value(entry.n_strx());
+		_globalsWithStringValue.push_back((uint32_t)_globals.size());
 	}
 	else
 		entry.set_n_value(atom->finalAddress());
@@ -579,6 +713,7 @@ void SymbolTableAtom<A>::addImport(const ld::Atom* atom, StringPoolAtom* pool)
 					assert(0 && "internal error: unexpected alias binding");
 			}
 		}
+		_importsWithStringValue.push_back((uint32_t)_imports.size());
 	}
 	
 	// add to array
@@ -729,7 +864,7 @@ void SymbolTableAtom<A>::encode()
 	for (const ld::Atom* atom : localAtoms) {
 		this->addLocal(atom, this->_writer._stringPoolAtom);
 	}
-	_stabsStringsOffsetStart = this->_writer._stringPoolAtom->currentOffset();
+	const uint32_t stabsStringsStart = this->_writer._stringPoolAtom->position();
 	for (const ld::relocatable::File::Stab& stab : _state.stabs) {
 		macho_nlist<P> entry;
 		entry.set_n_type(stab.type);
@@ -741,8 +876,34 @@ void SymbolTableAtom<A>::encode()
 	}
 	_stabsIndexStart = this->_writer._localSymbolsStartIndex + this->_writer._localSymbolsCount;
 	_stabsIndexEnd = _stabsIndexStart + _state.stabs.size();
-	_stabsStringsOffsetEnd = this->_writer._stringPoolAtom->currentOffset();
+	const uint32_t stabsStringsEnd = this->_writer._stringPoolAtom->position();
 	this->_writer._localSymbolsCount += _state.stabs.size();
+
+	// n_strx (and n_value of indirect symbols) hold string pool handles until the pool is laid out,
+	// stabs strings are kept out of tail merging so they stay at the end of the pool
+	StringPoolAtom* pool = this->_writer._stringPoolAtom;
+	pool->layout(stabsStringsStart);
+	_stabsStringsOffsetStart = pool->offsetAtPosition(stabsStringsStart);
+	_stabsStringsOffsetEnd = pool->offsetAtPosition(stabsStringsEnd);
+	resolveStringHandles(_globals, _globalsWithStringValue, pool);
+	resolveStringHandles(_imports, _importsWithStringValue, pool);
+	resolveStringHandles(_locals, std::vector<uint32_t>(), pool);
+}
+
+template <typename A>
+void SymbolTableAtom<A>::resolveStringHandles(std::vector<macho_nlist<P> >& entries, const std::vector<uint32_t>& valueIndexes,
+																const StringPoolAtom* pool)
+{
+	enum { kChunkSize = 0x4000 };
+	macho_nlist<P>* entryArray = entries.data();
+	const size_t count = entries.size();
+	ld::trace::apply("resolve string handles", (count + kChunkSize - 1) / kChunkSize, ^(size_t chunk) {
+		const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+		for (size_t i = chunk * kChunkSize; i < chunkEnd; ++i)
+			entryArray[i].set_n_strx(pool->offset(entryArray[i].n_strx()));
+	});
+	for (uint32_t index : valueIndexes)
+		entryArray[index].set_n_value(pool->offset((uint32_t)entryArray[index].n_value()));
 }
 
 template <typename A>
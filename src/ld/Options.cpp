@@ -31,6 +31,8 @@
 #include <mach-o/dyld.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
 #include <string.h>
 #include <spawn.h>
 #include <Availability.h>
@@ -84,9 +86,26 @@ static bool			sFatalWarnings = false;
 static const char*	sWarningsSideFilePath = NULL;
 static FILE*		sWarningsSideFile = NULL;
 static int			sWarningsCount = 0;
+static thread_local int	sThreadWarningsCount = 0;
+static thread_local std::vector<std::string>* sThreadWarningsCapture = NULL;
+static bool			sVerifyWildCardMatches = false;
 
 void warning(const char* format, ...)
 {
+	++sThreadWarningsCount;
+	if ( sThreadWarningsCapture != NULL ) {
+		// speculative work on this thread, caller replays the warnings if the result is used
+		char* message = NULL;
+		va_list	list;
+		va_start(list, format);
+		vasprintf(&message, format, list);
+		va_end(list);
+		if ( message != NULL ) {
+			sThreadWarningsCapture->push_back(message);
+			free(message);
+		}
+		return;
+	}
 	++sWarningsCount;
 	if ( sEmitWarnings ) {
 		va_list	list;
@@ -108,6 +127,18 @@ void warning(const char* format, ...)
 	}
 }
 
+// number of warnings issued on the calling thread, used to tell whether parsing one file warned
+int threadWarningsCount()
+{
+	return sThreadWarningsCount;
+}
+
+// while set, warnings on the calling thread are appended to the vector instead of being emitted or counted
+void captureThreadWarnings(std::vector<std::string>* warnings)
+{
+	sThreadWarningsCapture = warnings;
+}
+
 __attribute__((noreturn))
 void throwf(const char* format, ...)
 {
@@ -131,6 +162,10 @@ bool Options::FileInfo::checkFileExists(const Options& options, const char *p)
 	struct stat statBuffer;
 	if (p == NULL) 
 	  p = path;
+	if ( !options.fileMayExist(p) ) {
+		options.addDependency(Options::depNotFound, p);
+		return false;
+	}
 	if ( stat(p, &statBuffer) == 0 ) {
 		if (p != path) path = strdup(p);
 		modTime = statBuffer.st_mtime;
@@ -142,6 +177,87 @@ bool Options::FileInfo::checkFileExists(const Options& options, const char *p)
 }
 
 
+static std::string foldCase(const char* name)
+{
+	std::string result(name);
+	for (char& c : result)
+		c = tolower(c);
+	return result;
+}
+
+//
+// Library and framework searches probe many candidate paths (every -L/-F directory times every
+// suffix and extension), and almost all of them do not exist.  Rather than stat() each one, the
+// first probe into a directory reads the whole directory once and later probes are answered from
+// that listing.  Only negative answers come from the cache; a listed file is still stat()ed so
+// that symlinks and modification times behave as before.  A listing is never re-read, so a file
+// created in a search directory after its first probe is not found.  That is why the cache is
+// only used with -directory_cache, for builds that do not write into search directories while
+// linking.
+//
+bool Options::fileMayExist(const char* path) const
+{
+	if ( !fDirectoryCache )
+		return true;
+	const char* lastSlash = strrchr(path, '/');
+	std::string dir;
+	const char* leaf;
+	if ( lastSlash == NULL ) {
+		dir = ".";
+		leaf = path;
+	}
+	else {
+		dir = (lastSlash == path) ? std::string("/") : std::string(path, lastSlash - path);
+		leaf = lastSlash + 1;
+	}
+	if ( (leaf[0] == '\0') || (strcmp(leaf, ".") == 0) || (strcmp(leaf, "..") == 0) )
+		return true;
+	// file systems may normalize non-ASCII names, so let stat() decide those
+	for (const char* c = leaf; *c != '\0'; ++c) {
+		if ( (unsigned char)*c >= 0x80 )
+			return true;
+	}
+
+	pthread_mutex_lock(&fDirectoryCacheLock);
+	auto pos = fDirectoryListings.find(dir);
+	if ( pos == fDirectoryListings.end() ) {
+		DirectoryListing listing;
+		bool usable = true;
+		if ( DIR* d = opendir(dir.c_str()) ) {
+			listing.exists = true;
+			listing.caseSensitive = (pathconf(dir.c_str(), _PC_CASE_SENSITIVE) != 0);
+			while ( struct dirent* entry = readdir(d) )
+				listing.entries.insert(listing.caseSensitive ? std::string(entry->d_name) : foldCase(entry->d_name));
+			closedir(d);
+		}
+		else if ( (errno != ENOENT) && (errno != ENOTDIR) ) {
+			// e.g. search permission without read permission: fall back to stat()
+			usable = false;
+		}
+		++fDirectoryCacheReads;
+		if ( !usable ) {
+			pthread_mutex_unlock(&fDirectoryCacheLock);
+			return true;
+		}
+		pos = fDirectoryListings.emplace(dir, std::move(listing)).first;
+	}
+	const DirectoryListing& listing = pos->second;
+	bool result = listing.exists && (listing.entries.count(listing.caseSensitive ? std::string(leaf) : foldCase(leaf)) != 0);
+	if ( !result )
+		++fDirectoryCacheCallsAvoided;
+	pthread_mutex_unlock(&fDirectoryCacheLock);
+	return result;
+}
+
+void Options::directoryCacheStatistics(uint32_t& directoriesRead, uint64_t& callsAvoided) const
+{
+	pthread_mutex_lock(&fDirectoryCacheLock);
+	directoriesRead = fDirectoryCacheReads;
+	callsAvoided = fDirectoryCacheCallsAvoided;
+	pthread_mutex_unlock(&fDirectoryCacheLock);
+}
+
+
 Options::Options(int argc, const char* argv[])
 	: fOutputFile("a.out"), fArchitecture(0), fSubArchitecture(0),
 	  fFallbackArchitecture(0), fFallbackSubArchitecture(0), fArchitectureName("unknown"), fOutputKind(kDynamicExecutable),
@@ -963,7 +1079,7 @@ Options::FileInfo Options::findFramework(const char* rootName, const char* suffi
 		if ( suffix != nullptr ) {
 			char realPath[PATH_MAX];
 			// no symlink in framework to suffix variants, so follow main symlink if any
-			if ( realpath(possiblePath.c_str(), realPath) != nullptr )
+			if ( fileMayExist(possiblePath.c_str()) && (realpath(possiblePath.c_str(), realPath) != nullptr) )
 				possiblePath = std::string(realPath).append(suffix);
 			else
 				possiblePath.append(suffix);
@@ -1362,8 +1478,10 @@ bool Options::SetWithWildcards::hasWildCards(const char* symbol)
 
 void Options::SetWithWildcards::insert(const char* symbol, SymbolMatchingMode match_mode)
 {
-	if ( match_mode == kAllowWildcards && hasWildCards(symbol) )
+	if ( match_mode == kAllowWildcards && hasWildCards(symbol) ) {
 		fWildCard.push_back(symbol);
+		compileWildCard(symbol);
+	}
 	else
 		fRegular.insert(symbol);
 }
@@ -1375,15 +1493,22 @@ bool Options::SetWithWildcards::contains(const char* symbol, bool* matchBecauseO
 	// first look at hash table on non-wildcard symbols
 	if ( fRegular.find(symbol) != fRegular.end() )
 		return true;
-	// next walk list of wild card symbols looking for a match
-	for(std::vector<const char*>::const_iterator it = fWildCard.begin(); it != fWildCard.end(); ++it) {
-		if ( wildCardMatch(*it, symbol) ) {
-			if ( matchBecauseOfWildcard != NULL )
-				*matchBecauseOfWildcard = true;
-			return true;
+	// next look for a wild card pattern that matches
+	bool result = !fCompiled.empty() && compiledContains(symbol);
+	if ( sVerifyWildCardMatches ) {
+		bool expected = false;
+		for (const char* pattern : fWildCard) {
+			if ( wildCardMatch(pattern, symbol) ) {
+				expected = true;
+				break;
+			}
 		}
+		if ( expected != result )
+			throwf("internal error: wildcard matcher %s '%s' but expected %s", (result ? "matched" : "did not match"), symbol, (expected ? "a match" : "no match"));
 	}
-	return false;
+	if ( result && (matchBecauseOfWildcard != NULL) )
+		*matchBecauseOfWildcard = true;
+	return result;
 }
 
 // Support "foo.o:_bar" to mean symbol _bar in file foo.o
@@ -1470,6 +1595,156 @@ bool Options::SetWithWildcards::wildCardMatch(const char* pattern, const char* s
 	return (*s == '\0');
 }
 
+//
+// Compile a pattern into tokens that match exactly what wildCardMatch() matches.  Two quirks
+// of wildCardMatch() are preserved: a '*' that is not last in the pattern never lets the rest
+// of the pattern start at the end of the symbol (so a trailing "**" needs at least one
+// character), and bracket sets are whatever inCharRange() accepts for each byte.
+//
+void Options::SetWithWildcards::compileWildCard(const char* pattern)
+{
+	CompiledWildCard compiled;
+	compiled.minLength = 0;
+	compiled.hasStar = false;
+	for (const char* p = pattern; *p != '\0'; ++p) {
+		switch ( *p ) {
+			case '*': {
+				const char* lastStar = p;
+				while ( lastStar[1] == '*' )
+					++lastStar;
+				if ( (lastStar != p) && (lastStar[1] == '\0') ) {
+					compiled.tokens.push_back({ WildCardToken::kAnyChar, 0, 0 });
+					++compiled.minLength;
+				}
+				compiled.tokens.push_back({ WildCardToken::kStar, 0, 0 });
+				compiled.hasStar = true;
+				p = lastStar;
+				break;
+			}
+			case '?':
+				compiled.tokens.push_back({ WildCardToken::kAnyChar, 0, 0 });
+				++compiled.minLength;
+				break;
+			case '[': {
+				CharClass charClass = { 0, 0, 0, 0 };
+				const char* end = p;
+				inCharRange(end, 'a');
+				// an unterminated '[' never matches, so neither does the pattern
+				if ( *end == '\0' )
+					return;
+				// the end of the symbol is never in a set
+				for (unsigned c = 1; c < 256; ++c) {
+					const char* range = p;
+					if ( inCharRange(range, c) )
+						charClass[c / 64] |= (1ULL << (c % 64));
+				}
+				compiled.tokens.push_back({ WildCardToken::kCharClass, 0, (uint32_t)fCharClasses.size() });
+				fCharClasses.push_back(charClass);
+				++compiled.minLength;
+				p = end;
+				break;
+			}
+			default:
+				compiled.tokens.push_back({ WildCardToken::kLiteral, (uint8_t)*p, 0 });
+				++compiled.minLength;
+				break;
+		}
+	}
+	for (const WildCardToken& token : compiled.tokens) {
+		if ( token.kind != WildCardToken::kLiteral )
+			break;
+		compiled.prefix.push_back(token.literal);
+	}
+	for (auto it = compiled.tokens.rbegin(); it != compiled.tokens.rend(); ++it) {
+		if ( it->kind != WildCardToken::kLiteral )
+			break;
+		compiled.suffix.insert(compiled.suffix.begin(), it->literal);
+	}
+
+	uint32_t index = (uint32_t)fCompiled.size();
+	if ( compiled.prefix.empty() )
+		fNoPrefix.push_back(index);
+	else
+		fByPrefix[compiled.prefix.substr(0, kPrefixIndexLength)].push_back(index);
+	fCompiled.push_back(std::move(compiled));
+}
+
+bool Options::SetWithWildcards::compiledMatch(const CompiledWildCard& pattern, const char* symbol, size_t length) const
+{
+	if ( (length < pattern.minLength) || (!pattern.hasStar && (length != pattern.minLength)) )
+		return false;
+	if ( memcmp(symbol, pattern.prefix.data(), pattern.prefix.size()) != 0 )
+		return false;
+	if ( memcmp(&symbol[length - pattern.suffix.size()], pattern.suffix.data(), pattern.suffix.size()) != 0 )
+		return false;
+
+	// Match left to right and on a mismatch retry from the most recent '*', consuming one more
+	// character with it.  The text between stars has a fixed length, so the leftmost match of
+	// each part is always good enough and earlier stars never need to be revisited.
+	const std::vector<WildCardToken>& tokens = pattern.tokens;
+	const size_t tokenCount = tokens.size();
+	size_t t = 0;
+	size_t s = 0;
+	size_t starToken = SIZE_MAX;
+	size_t starSymbol = 0;
+	while ( s < length ) {
+		if ( t < tokenCount ) {
+			const WildCardToken& token = tokens[t];
+			const uint8_t c = (uint8_t)symbol[s];
+			bool matches;
+			switch ( token.kind ) {
+				case WildCardToken::kStar:
+					starToken = t++;
+					starSymbol = s;
+					continue;
+				case WildCardToken::kAnyChar:
+					matches = true;
+					break;
+				case WildCardToken::kCharClass:
+					matches = ((fCharClasses[token.charClass][c / 64] >> (c % 64)) & 1);
+					break;
+				case WildCardToken::kLiteral:
+				default:
+					matches = (token.literal == c);
+					break;
+			}
+			if ( matches ) {
+				++t;
+				++s;
+				continue;
+			}
+		}
+		if ( starToken == SIZE_MAX )
+			return false;
+		t = starToken + 1;
+		s = ++starSymbol;
+	}
+	while ( (t < tokenCount) && (tokens[t].kind == WildCardToken::kStar) )
+		++t;
+	return (t == tokenCount);
+}
+
+bool Options::SetWithWildcards::compiledContains(const char* symbol) const
+{
+	const size_t length = strlen(symbol);
+	for (uint32_t index : fNoPrefix) {
+		if ( compiledMatch(fCompiled[index], symbol, length) )
+			return true;
+	}
+	// patterns are indexed by up to kPrefixIndexLength bytes of their literal prefix
+	const size_t maxPrefix = std::min<size_t>(length, kPrefixIndexLength);
+	for (size_t n = 1; (n <= maxPrefix) && !fByPrefix.empty(); ++n) {
+		auto pos = fByPrefix.find(std::string(symbol, n));
+		if ( pos == fByPrefix.end() )
+			continue;
+		for (uint32_t index : pos->second) {
+			if ( compiledMatch(fCompiled[index], symbol, length) )
+				return true;
+		}
+	}
+	return false;
+}
+
 
 void Options::loadExportFile(const char* fileOfExports, const char* option, SetWithWildcards& set, SymbolMatchingMode match_mode)
 {
@@ -2034,6 +2309,64 @@ void Options::parseOrderFile(const char* path, bool cstring)
 	// Note: we do not free() the malloc buffer, because the strings are used by the fOrderedSymbols
 }
 
+//
+// Each line of a call graph file is a caller symbol name, a callee symbol name, and optionally how
+// many times the call was seen.  Lines without a count are single samples, so raw sampled edges can
+// be used as is.  Repeated edges are added up by the order pass.
+//
+void Options::parseCallGraphFile(const char* path)
+{
+	// read in whole file
+	int fd = ::open(path, O_RDONLY, 0);
+	if ( fd == -1 )
+		throwf("can't open call graph file: %s", path);
+	struct stat stat_buf;
+	::fstat(fd, &stat_buf);
+	char* p = (char*)malloc(stat_buf.st_size+1);
+	if ( p == NULL )
+		throwf("can't process call graph file: %s", path);
+	if ( read(fd, p, stat_buf.st_size) != stat_buf.st_size )
+		throwf("can't read call graph file: %s", path);
+	::close(fd);
+	p[stat_buf.st_size] = '\0';
+	this->addDependency(Options::depMisc, path);
+
+	uint32_t lineNumber = 0;
+	for (char* line = p; line != NULL; ) {
+		char* nextLine = strchr(line, '\n');
+		if ( nextLine != NULL )
+			*nextLine++ = '\0';
+		++lineNumber;
+		char* comment = strchr(line, '#');
+		if ( comment != NULL )
+			*comment = '\0';
+		char* fields[4];
+		int fieldCount = 0;
+		for (char* s = strtok(line, " \t\r"); s != NULL; s = strtok(NULL, " \t\r")) {
+			if ( fieldCount == 4 )
+				break;
+			fields[fieldCount++] = s;
+		}
+		line = nextLine;
+		if ( fieldCount == 0 )
+			continue;
+		if ( (fieldCount < 2) || (fieldCount > 3) )
+			throwf("malformed line %u in call graph file %s, expected caller, callee and optional count", lineNumber, path);
+		CallGraphEdge edge;
+		edge.caller = fields[0];
+		edge.callee = fields[1];
+		edge.count = 1;
+		if ( fieldCount == 3 ) {
+			char* end;
+			edge.count = strtoull(fields[2], &end, 10);
+			if ( *end != '\0' )
+				throwf("malformed count '%s' on line %u in call graph file %s", fields[2], lineNumber, path);
+		}
+		fCallGraphEdges.push_back(edge);
+	}
+	// Note: we do not free() the malloc buffer, because the strings are used by the fCallGraphEdges
+}
+
 void Options::parseSectionOrderFile(const char* segment, const char* section, const char* path)
 {
 	if ( (strcmp(section, "__cstring") == 0) && (strcmp(segment, "__TEXT") == 0) ) {
@@ -2694,6 +3027,45 @@ void Options::parse(int argc, const char* argv[])
 				if (fLtoMaxCacheSize > 100)
 					throw "Expect a value between 0 and 100 for -max_relative_cache_size_lto";
 			}
+			else if ( strcmp(arg, "-cache_path_objects") == 0 ) {
+				fObjectCachePath = argv[++i];
+				if ( fObjectCachePath == NULL )
+					throw "missing argument to -cache_path_objects";
+			}
+			else if ( strcmp(arg, "-cache_path_tbd") == 0 ) {
+				fTBDCachePath = argv[++i];
+				if ( fTBDCachePath == NULL )
+					throw "missing argument to -cache_path_tbd";
+			}
+			else if ( strcmp(arg, "-prune_interval_objects") == 0 ) {
+				const char* value = argv[++i];
+				if ( value == NULL )
+					throw "missing argument to -prune_interval_objects";
+				char* endptr;
+				fObjectCachePruneInterval = (int)strtol(value, &endptr, 10);
+				if ( *endptr != '\0')
+					throw "invalid argument for -prune_interval_objects";
+			}
+			else if ( strcmp(arg, "-prune_after_objects") == 0 ) {
+				const char* value = argv[++i];
+				if ( value == NULL )
+					throw "missing argument to -prune_after_objects";
+				char* endptr;
+				fObjectCachePruneAfter = (int)strtoul(value, &endptr, 10);
+				if ( *endptr != '\0')
+					throw "invalid argument for -prune_after_objects";
+			}
+			else if ( strcmp(arg, "-max_relative_cache_size_objects") == 0 ) {
+				const char* value = argv[++i];
+				if ( value == NULL )
+					throw "missing argument to -max_relative_cache_size_objects";
+				char* endptr;
+				fObjectCacheMaxSize = (unsigned)strtoul(value, &endptr, 10);
+				if ( *endptr != '\0')
+					throw "invalid argument for -max_relative_cache_size_objects";
+				if (fObjectCacheMaxSize > 100)
+					throw "Expect a value between 0 and 100 for -max_relative_cache_size_objects";
+			}
 			else if ( (arg[1] == 'l') && (strncmp(arg,"-lazy_",6) != 0)  && (strcmp(arg,"-load_hidden") != 0) ) {
                 snapshotArgCount = 0;
                 try {
@@ -2830,6 +3202,13 @@ void Options::parse(int argc, const char* argv[])
                 snapshotFileArgIndex = 1;
 				parseOrderFile(argv[++i], false);
 			}
+			else if ( strcmp(arg, "-call_graph_order_file") == 0 ) {
+                snapshotFileArgIndex = 1;
+				if ( argv[i+1] == NULL )
+					throw "-call_graph_order_file missing <path>";
+				parseCallGraphFile(argv[++i]);
+				cannotBeUsedWithBitcode(arg);
+			}
 			else if ( strcmp(arg, "-order_file_statistics") == 0 ) {
 				fPrintOrderFileStatistics = true;
 				cannotBeUsedWithBitcode(arg);
@@ -3540,6 +3919,29 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-print_statistics") == 0 ) {
 				fStatistics = true;
 			}
+			else if ( strcmp(arg, "-resolve_while_parsing") == 0 ) {
+				fResolveWhileParsing = true;
+			}
+			else if ( strcmp(arg, "-no_library_symbol_index") == 0 ) {
+				fLibrarySymbolIndex = false;
+			}
+			else if ( strcmp(arg, "-no_lazy_dylib_exports") == 0 ) {
+				fLazyDylibExports = false;
+			}
+			else if ( strcmp(arg, "-no_speculative_archive_parsing") == 0 ) {
+				fSpeculativeArchiveParsing = false;
+			}
+			else if ( strcmp(arg, "-tail_merge_strings") == 0 ) {
+				fTailMergeStrings = true;
+			}
+			else if ( strcmp(arg, "-optimize_dyld_info_opcodes") == 0 ) {
+				fOptimizeDyldInfoOpcodes = true;
+			}
+			else if ( strcmp(arg, "-trace_json") == 0 ) {
+				fTraceJSONPath = argv[++i];
+				if ( fTraceJSONPath == NULL )
+					throw "-trace_json missing <path>";
+			}
 			else if ( strcmp(arg, "-d") == 0 ) {
 				fMakeTentativeDefinitionsReal = true;
 			}
@@ -3549,6 +3951,12 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-Z") == 0 ) {
 				// previously handled by buildSearchPaths()
 			}
+			else if ( strcmp(arg, "-directory_cache") == 0 ) {
+				// previously handled by buildSearchPaths()
+			}
+			else if ( strcmp(arg, "-no_directory_cache") == 0 ) {
+				// previously handled by buildSearchPaths()
+			}
 			else if ( strcmp(arg, "-syslibroot") == 0 ) {
                 snapshotArgCount = 0;
 				++i;
@@ -4176,6 +4584,12 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-verbose_deduplicate") == 0 ) {
 				fVerboseDeDupe = true;
 			}
+			else if ( strcmp(arg, "-deduplicate_read_only_data") == 0 ) {
+				fDeDupeReadOnlyData = true;
+			}
+			else if ( strcmp(arg, "-deduplicate_address_not_taken") == 0 ) {
+				fDeDupeAddressNotTaken = true;
+			}
 			else if ( strcmp(arg, "-max_default_common_align") == 0 ) {
 				const char* alignStr = argv[++i];
 				if ( alignStr == NULL )
@@ -4404,6 +4818,10 @@ void Options::buildSearchPaths(int argc, const char* argv[])
 		}
 		else if ( strcmp(argv[i], "-Z") == 0 )
 			addStandardLibraryDirectories = false;
+		else if ( strcmp(argv[i], "-directory_cache") == 0 )
+			fDirectoryCache = true;
+		else if ( strcmp(argv[i], "-no_directory_cache") == 0 )
+			fDirectoryCache = false;
 		else if ( strcmp(argv[i], "-v") == 0 ) {
 			fVerbose = true;
 			extern const char ld_classicVersionString[];
@@ -4657,6 +5075,9 @@ void Options::buildSearchPaths(int argc, const char* argv[])
 // this is run before the command line is parsed
 void Options::parsePreCommandLineEnvironmentSettings()
 {
+	if (getenv("LD_VERIFY_WILDCARD_MATCHES") != NULL)
+		sVerifyWildCardMatches = true;
+
 	if (getenv("LD_FORCE_LEGACY_VERSION_LOAD_CMDS") != NULL) {
 		fForceLegacyVersionLoadCommands = true;
 	}
@@ -28,8 +28,11 @@
 
 #include <stdint.h>
 #include <mach/machine.h>
+#include <pthread.h>
 #include <tapi/tapi.h>
 
+#include <array>
+#include <string>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
@@ -42,6 +45,8 @@
 
 extern void throwf (const char* format, ...) __attribute__ ((noreturn,format(printf, 1, 2)));
 extern void warning(const char* format, ...) __attribute__((format(printf, 1, 2)));
+extern int  threadWarningsCount();
+extern void captureThreadWarnings(std::vector<std::string>* warnings);
 
 class Snapshot;
 
@@ -255,6 +260,12 @@ public:
 	};
 	typedef const OrderedSymbol*	OrderedSymbolsIterator;
 
+	struct CallGraphEdge {
+		const char*				caller;
+		const char*				callee;
+		uint64_t				count;
+	};
+
 	struct SegmentStart {
 		const char*				name;
 		uint64_t				address;
@@ -299,6 +310,7 @@ public:
 		  depOutputFile = 0x40 };
 	
 	void						addDependency(uint8_t, const char* path) const;
+	void						directoryCacheStatistics(uint32_t& directoriesRead, uint64_t& callsAvoided) const;
 	
 	typedef const char* const*	UndefinesIterator;
 
@@ -403,6 +415,7 @@ public:
 	unsigned long				orderedSymbolsCount() const { return fOrderedSymbols.size(); }
 	OrderedSymbolsIterator		orderedSymbolsBegin() const { return fOrderedSymbols.data(); }
 	OrderedSymbolsIterator		orderedSymbolsEnd() const { return fOrderedSymbols.data() + fOrderedSymbols.size(); }
+	const std::vector<CallGraphEdge>& callGraphEdges() const { return fCallGraphEdges; }
 	uint64_t					baseWritableAddress() { return fBaseWritableAddress; }
 	uint64_t					segmentAlignment() const { return fSegmentAlignment; }
 	uint64_t					segPageSize(const char* segName) const;
@@ -495,6 +508,8 @@ public:
 	bool						renameReverseSymbolMap() const { return fReverseMapUUIDRename; }
 	bool						deduplicateFunctions() const { return fDeDupe; }
 	bool						verboseDeduplicate() const { return fVerboseDeDupe; }
+	bool						deduplicateReadOnlyData() const { return fDeDupeReadOnlyData; }
+	bool						deduplicateAddressNotTaken() const { return fDeDupeAddressNotTaken; }
 	bool						makeInitializersIntoOffsets() const { return fMakeInitializersIntoOffsets; }
 	bool						useLinkedListBinding() const { return fUseLinkedListBinding; }
 	bool						makeChainedFixups() const { return fMakeChainedFixups; }
@@ -538,6 +553,19 @@ public:
 	uint64_t					sourceVersion() const { return fSourceVersion; }
 	const char*					demangleSymbol(const char* sym) const;
     bool						pipelineEnabled() const { return fPipelineFifo != NULL; }
+	bool						resolveWhileParsing() const { return fResolveWhileParsing; }
+	bool						librarySymbolIndex() const { return fLibrarySymbolIndex; }
+	bool						lazyDylibExports() const { return fLazyDylibExports; }
+	bool						directoryCache() const { return fDirectoryCache; }
+	bool						speculativeArchiveParsing() const { return fSpeculativeArchiveParsing; }
+	bool						tailMergeStrings() const { return fTailMergeStrings; }
+	bool						optimizeDyldInfoOpcodes() const { return fOptimizeDyldInfoOpcodes; }
+	const char*					traceJSONPath() const { return fTraceJSONPath; }
+	const char*					objectCachePath() const { return fObjectCachePath; }
+	int							objectCachePruneInterval() const { return fObjectCachePruneInterval; }
+	int							objectCachePruneAfter() const { return fObjectCachePruneAfter; }
+	unsigned					objectCacheMaxSize() const { return fObjectCacheMaxSize; }
+	const char*					tbdCachePath() const { return fTBDCachePath; }
     const char*					pipelineFifo() const { return fPipelineFifo; }
 	bool						dumpDependencyInfo() const { return (fDependencyInfoPath != NULL); }
 	const char*					dependencyInfoPath() const { return fDependencyInfoPath; }
@@ -600,12 +628,37 @@ private:
 		const NameSet&                          regular() const { return fRegular; }
 		void					remove(const NameSet&); 
 	private:
+		// Each wildcard pattern is compiled when inserted into a token list, and indexed by the
+		// first bytes of its literal prefix so contains() only runs the patterns that can match.
+		enum { kPrefixIndexLength = 4 };
+		struct WildCardToken {
+			enum Kind : uint8_t { kLiteral, kAnyChar, kCharClass, kStar };
+			Kind				kind;
+			uint8_t				literal;
+			uint32_t			charClass;		// index into fCharClasses
+		};
+		struct CompiledWildCard {
+			std::vector<WildCardToken>	tokens;
+			std::string					prefix;			// literal bytes every match starts with
+			std::string					suffix;			// literal bytes every match ends with
+			size_t						minLength;
+			bool						hasStar;
+		};
+		typedef std::array<uint64_t, 4>	CharClass;		// 256 bit set
+
 		static bool				hasWildCards(const char*);
 		bool					wildCardMatch(const char* pattern, const char* candidate) const;
 		bool					inCharRange(const char*& range, unsigned char c) const;
+		void					compileWildCard(const char* pattern);
+		bool					compiledMatch(const CompiledWildCard& pattern, const char* symbol, size_t length) const;
+		bool					compiledContains(const char* symbol) const;
 
 		NameSet							fRegular;
 		std::vector<const char*>		fWildCard;
+		std::vector<CompiledWildCard>	fCompiled;
+		std::vector<CharClass>			fCharClasses;
+		std::unordered_map<std::string, std::vector<uint32_t>>	fByPrefix;	// first kPrefixIndexLength (or fewer) prefix bytes
+		std::vector<uint32_t>			fNoPrefix;
 	};
 
 	struct SymbolsMove {
@@ -618,6 +671,13 @@ private:
 		std::string			path;
 	};
 
+	// one readdir() of a search directory, used to answer "does this file exist" without a stat()
+	struct DirectoryListing {
+		bool								exists = false;
+		bool								caseSensitive = true;
+		std::unordered_set<std::string>		entries;
+	};
+
 	const char*					checkForNullArgument(const char* argument_name, const char* arg, bool allowDashArg=false) const;
 	const char*					checkForNullVersionArgument(const char* argument_name, const char* arg) const;
 	void						parse(int argc, const char* argv[]);
@@ -630,12 +690,14 @@ private:
 											 FileInfo& result) const;
 	bool						checkForFileWithSuffix(const char* possiblePath, FileInfo& result) const;
 	bool						findFileWithSuffix(const std::string &path, const std::vector<std::string> &tbdExtensions, FileInfo& result) const;
+	bool						fileMayExist(const char* path) const;
 	uint64_t					parseVersionNumber64(const char*);
 	std::string					getVersionString32(uint32_t ver) const;
 	std::string					getVersionString64(uint64_t ver) const;
 	bool						parsePackedVersion32(const std::string& versionStr, uint32_t &result);
 	void						parseSectionOrderFile(const char* segment, const char* section, const char* path);
 	void						parseOrderFile(const char* path, bool cstring);
+	void						parseCallGraphFile(const char* path);
 	void						addSection(const char* segment, const char* section, const char* path);
 	void						addSubLibrary(const char* name);
 	void						loadFileList(const char* fileOfPaths, ld::File::Ordinal baseOrdinal);
@@ -868,6 +930,8 @@ private:
 	bool								fReverseMapUUIDRename;
 	bool								fDeDupe;
 	bool								fVerboseDeDupe;
+	bool								fDeDupeReadOnlyData = false;
+	bool								fDeDupeAddressNotTaken = false;
 	bool								fMakeInitializersIntoOffsets;
 	bool								fUseLinkedListBinding;
 	bool								fMakeChainedFixupsForceOn;
@@ -924,6 +988,7 @@ private:
 	std::vector<ExtraSection>			fExtraSections;
 	std::vector<SectionAlignment>		fSectionAlignments;
 	std::vector<OrderedSymbol>			fOrderedSymbols;
+	std::vector<CallGraphEdge>			fCallGraphEdges;
 	std::vector<SegmentStart>			fCustomSegmentAddresses;
 	std::vector<SegmentSize>			fCustomSegmentSizes;
 	std::vector<SegmentProtect>			fCustomSegmentProtections;
@@ -947,6 +1012,23 @@ private:
     mutable Snapshot					fLinkSnapshot;
     bool								fSnapshotRequested;
     const char*							fPipelineFifo;
+	bool								fResolveWhileParsing = false;
+	bool								fLibrarySymbolIndex = true;
+	bool								fLazyDylibExports = true;
+	bool								fSpeculativeArchiveParsing = true;
+	bool								fTailMergeStrings = false;
+	bool								fOptimizeDyldInfoOpcodes = false;
+	const char*							fTraceJSONPath = NULL;
+	const char*							fObjectCachePath = NULL;
+	int									fObjectCachePruneInterval = 1200;
+	int									fObjectCachePruneAfter = 604800;
+	unsigned							fObjectCacheMaxSize = 75;
+	const char*							fTBDCachePath = NULL;
+	bool								fDirectoryCache = false;
+	mutable pthread_mutex_t				fDirectoryCacheLock = PTHREAD_MUTEX_INITIALIZER;
+	mutable std::unordered_map<std::string, DirectoryListing> fDirectoryListings;
+	mutable uint32_t					fDirectoryCacheReads = 0;
+	mutable uint64_t					fDirectoryCacheCallsAvoided = 0;
 	const char*							fDependencyInfoPath;
 	const char*							fBuildContextName;
 	mutable int							fTraceFileDescriptor;
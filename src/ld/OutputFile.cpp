@@ -50,8 +50,11 @@ extern "C" {
 #include <string>
 #include <string>
 #include <list>
+#include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <utility>
+#include <exception>
 #include <iostream>
 #include <fstream>
 
@@ -70,6 +73,7 @@ extern "C" {
 #include "LinkEditClassic.hpp"
 #include "generic_dylib_file.hpp"
 #include "Containers.h"
+#include "Trace.h"
 
 namespace ld {
 namespace tool {
@@ -157,18 +161,78 @@ void OutputFile::dumpAtomsBySection(ld::Internal& state, bool printAtoms)
 
 void OutputFile::write(ld::Internal& state)
 {
-	this->buildDylibOrdinalMapping(state);
-	this->addLoadCommands(state);
-	this->addLinkEdit(state);
-	state.setSectionSizesAndAlignments();
-	this->setLoadCommandsPadding(state);
-	_fileSize = state.assignFileOffsets();
-	this->assignAtomAddresses(state);
-	this->buildLINKEDITContent(state);
-	this->updateLINKEDITAddresses(state);
-	//this->dumpAtomsBySection(state, false);
-	this->writeOutputFile(state);
-	this->writeMapFile(state);
+	{
+		ld::trace::Scope traceScope("output", "assign addresses");
+		this->buildDylibOrdinalMapping(state);
+		this->addLoadCommands(state);
+		this->addLinkEdit(state);
+		state.setSectionSizesAndAlignments();
+		this->setLoadCommandsPadding(state);
+		_fileSize = state.assignFileOffsets();
+		this->assignAtomAddresses(state);
+	}
+	{
+		ld::trace::Scope traceScope("output", "build LINKEDIT");
+		this->buildLINKEDITContent(state);
+		this->updateLINKEDITAddresses(state);
+	}
+	// atoms are final once the symbol table is partitioned, so the map file is written alongside the output file.
+	// It goes to a temporary path that replaces the map file only once the output file is written.
+	FILE* mapFile = NULL;
+	char tmpMapPath[PATH_MAX];
+	if ( _options.generatedMapPath() != NULL ) {
+		if ( snprintf(tmpMapPath, PATH_MAX, "%s.ld_XXXXXX", _options.generatedMapPath()) < PATH_MAX ) {
+			int fd = ::mkstemp(tmpMapPath);
+			if ( fd != -1 )
+				mapFile = ::fdopen(fd, "w");
+		}
+		if ( mapFile == NULL )
+			warning("could not write map file: %s\n", _options.generatedMapPath());
+	}
+	__block std::exception_ptr mapFileException;
+	dispatch_group_t mapFileGroup = dispatch_group_create();
+	if ( mapFile != NULL ) {
+		dispatch_group_async(mapFileGroup, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+			ld::trace::Scope traceScope("output", "write map file");
+			try {
+				this->writeMapFile(state, mapFile);
+			}
+			catch (...) {
+				mapFileException = std::current_exception();
+			}
+		});
+	}
+	try {
+		//this->dumpAtomsBySection(state, false);
+		this->writeOutputFile(state);
+	}
+	catch (...) {
+		// map file writer still references state, and no map file is left for a failed link
+		dispatch_group_wait(mapFileGroup, DISPATCH_TIME_FOREVER);
+		dispatch_release(mapFileGroup);
+		if ( mapFile != NULL ) {
+			fclose(mapFile);
+			::unlink(tmpMapPath);
+		}
+		throw;
+	}
+	dispatch_group_wait(mapFileGroup, DISPATCH_TIME_FOREVER);
+	dispatch_release(mapFileGroup);
+	if ( mapFile != NULL ) {
+		const bool closed = (fclose(mapFile) == 0);
+		if ( mapFileException ) {
+			::unlink(tmpMapPath);
+			std::rethrow_exception(mapFileException);
+		}
+		// mkstemp() creates the file private, give it the permissions fopen() would
+		mode_t umask = ::umask(0);
+		::umask(umask);
+		if ( !closed || (::chmod(tmpMapPath, 0666 & ~umask) != 0) || (::rename(tmpMapPath, _options.generatedMapPath()) != 0) ) {
+			::unlink(tmpMapPath);
+			warning("could not write map file: %s\n", _options.generatedMapPath());
+		}
+	}
+	// JSON entry needs the UUID computed while writing the output
 	this->writeJSONEntry(state);
 }
 
@@ -3278,17 +3342,125 @@ void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
 		if ( (sect->type() == ld::Section::typeMachHeader) && (_options.outputKind() != Options::kPreload) )
 			baseAddress = sect->address;
 	}
-	__block const char* exception = nullptr;
-	dispatch_apply(state.sections.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
-		ld::Internal::FinalSection* sect = state.sections[index];
+	// split sections into ranges of atoms, so that a huge __text is written by all cores
+	struct AtomRange {
+		ld::Internal::FinalSection*	sect;
+		size_t						start;
+		size_t						end;
+		uint64_t					fileStart;		// includes nop padding before the first atom
+		uint64_t					fileEnd;
+		bool						prevAtomUsesNoOps;
+		bool						prevAtomWasThumb;
+		const char*					exception;
+	};
+	const size_t kAtomsPerRange = 1024;
+	std::vector<AtomRange> ranges;
+	for (ld::Internal::FinalSection* sect : state.sections) {
 		if ( takesNoDiskSpace(sect) )
-			return;
+			continue;
 		const bool sectionUsesNops = (sect->type() == ld::Section::typeCode);
-		//fprintf(stderr, "file offset=0x%08llX, section %s, atomCount=%lu\n", sect->fileOffset, sect->sectionName(), sect->atoms.size());
 		bool 		lastAtomWasThumb 		  = false;
 		bool 		lastAtomUsesNoOps 		  = false;
 		uint64_t 	fileOffsetOfEndOfLastAtom = sect->fileOffset;
-		for (const ld::Atom* atom : sect->atoms) {
+		for (size_t start=0; start < sect->atoms.size(); start += kAtomsPerRange) {
+			AtomRange range = { sect, start, std::min(start+kAtomsPerRange, sect->atoms.size()), fileOffsetOfEndOfLastAtom,
+								fileOffsetOfEndOfLastAtom, lastAtomUsesNoOps, lastAtomWasThumb, nullptr };
+			// padding before the first atom of the next range is filled as if this range's last atom had just been written
+			for (size_t i=range.end; i > range.start; --i) {
+				const ld::Atom* atom = sect->atoms[i-1];
+				if ( atom->definition() == ld::Atom::definitionProxy )
+					continue;
+				fileOffsetOfEndOfLastAtom = atom->finalAddress() - sect->address + sect->fileOffset + atom->size();
+				lastAtomUsesNoOps = sectionUsesNops;
+				lastAtomWasThumb = atom->isThumb();
+				range.fileEnd = fileOffsetOfEndOfLastAtom;
+				break;
+			}
+			ranges.push_back(range);
+		}
+	}
+
+	// Pages that are final as soon as their atoms are written are hashed for the code signature and
+	// content UUID right away, while still in cache, instead of in two more passes over the whole file.
+	// The header (gets the UUID), LINKEDIT and any segment rewritten when building chains wait until the end.
+	const uint64_t pageSize = CodeSignatureAtom::kPageSize;
+	const bool hashEarly = (_hasCodeSignature || !_contentUUIDChunks.empty()) && !_options.useLinkedListBinding();
+	const uint64_t pageCount = hashEarly ? (_fileSize + pageSize - 1)/pageSize : 0;
+	std::vector<uint32_t> pageWriters(pageCount, 0);
+	std::vector<uint8_t>  pageIsFinal(pageCount, 0);
+	if ( hashEarly ) {
+		auto markPages = [&](uint64_t fileStart, uint64_t fileEnd, uint8_t value) {
+			for (uint64_t page=fileStart/pageSize; page < (fileEnd+pageSize-1)/pageSize; ++page)
+				pageIsFinal[page] = value;
+		};
+		auto rewrittenLater = [](const ld::Internal::FinalSection* sect) -> bool {
+			switch ( sect->type() ) {
+				case ld::Section::typeMachHeader:
+				case ld::Section::typeLinkEdit:
+				case ld::Section::typeThreadStarts:
+				case ld::Section::typeChainStarts:
+					return true;
+				default:
+					return (strcmp(sect->segmentName(), "__LINKEDIT") == 0);
+			}
+		};
+		for (ld::Internal::FinalSection* sect : state.sections) {
+			if ( !takesNoDiskSpace(sect) && !rewrittenLater(sect) )
+				markPages(sect->fileOffset, sect->fileOffset+sect->size, 1);
+		}
+		// a page shared with a section that is rewritten later must wait too
+		for (ld::Internal::FinalSection* sect : state.sections) {
+			if ( !takesNoDiskSpace(sect) && rewrittenLater(sect) )
+				markPages(sect->fileOffset, sect->fileOffset+sect->size, 0);
+		}
+		if ( _hasChainedFixups ) {
+			for (const ChainedFixupSegInfo& segInfo : _chainedFixupSegments) {
+				for (const ChainedFixupPageInfo& pageInfo : segInfo.pages) {
+					if ( !pageInfo.fixupOffsets.empty() ) {
+						markPages(segInfo.fileOffset, segInfo.fileOffset+(segInfo.endAddr-segInfo.startAddr), 0);
+						break;
+					}
+				}
+			}
+		}
+		for (const AtomRange& range : ranges) {
+			if ( range.fileEnd <= range.fileStart )
+				continue;
+			for (uint64_t page=range.fileStart/pageSize; page < (range.fileEnd+pageSize-1)/pageSize; ++page)
+				++pageWriters[page];
+		}
+		for (ContentUUIDChunk& chunk : _contentUUIDChunks) {
+			chunk.pendingPages = 0;
+			chunk.hashEarly    = true;
+			for (uint64_t page=chunk.fileOffset/pageSize; page < (chunk.fileOffset+chunk.size+pageSize-1)/pageSize; ++page) {
+				if ( !pageIsFinal[page] )
+					chunk.hashEarly = false;
+				else if ( pageWriters[page] != 0 )
+					++chunk.pendingPages;
+			}
+			// chunks with no atom content are just hashed at the end
+			if ( chunk.pendingPages == 0 )
+				chunk.hashEarly = false;
+		}
+		if ( _hasCodeSignature )
+			_codeSignatureAtom->prepareEarlyHashes();
+	}
+
+	AtomRange*			rangesArray	   = ranges.data();
+	uint32_t*			pageWriterCounts = pageWriters.data();
+	const uint8_t*		finalPages	   = pageIsFinal.data();
+	ContentUUIDChunk*	uuidChunks	   = _contentUUIDChunks.data();
+	const size_t		uuidChunkCount = _contentUUIDChunks.size();
+	ld::trace::apply("write atoms", ranges.size(), ^(size_t index) {
+		AtomRange& range = rangesArray[index];
+		ld::Internal::FinalSection* sect = range.sect;
+		const bool sectionUsesNops = (sect->type() == ld::Section::typeCode);
+		//fprintf(stderr, "file offset=0x%08llX, section %s, atomCount=%lu\n", sect->fileOffset, sect->sectionName(), sect->atoms.size());
+		bool 		lastAtomWasThumb 		  = range.prevAtomWasThumb;
+		bool 		lastAtomUsesNoOps 		  = range.prevAtomUsesNoOps;
+		uint64_t 	fileOffsetOfEndOfLastAtom = range.fileStart;
+		for (size_t i=range.start; i < range.end; ++i) {
+			const ld::Atom* atom = sect->atoms[i];
 			if ( atom->definition() == ld::Atom::definitionProxy )
 				continue;
 			try {
@@ -3307,16 +3479,41 @@ void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
 				lastAtomWasThumb = atom->isThumb();
 			}
 			catch (const char* msg) {
-				// applyFixUps() are now done in parallel, if there is an error, just save the last error
+				// only the first error in each range is kept, the first range with an error is reported below
 				if ( atom->file() != NULL )
-					asprintf((char**)&exception, "%s in '%s' from %s", msg, atom->name(), atom->safeFilePath());
+					asprintf((char**)&range.exception, "%s in '%s' from %s", msg, atom->name(), atom->safeFilePath());
 				else
-					asprintf((char**)&exception, "%s in '%s'", msg, atom->name());
+					asprintf((char**)&range.exception, "%s in '%s'", msg, atom->name());
+				break;
+			}
+		}
+		if ( !hashEarly || (range.exception != nullptr) || (range.fileEnd <= range.fileStart) )
+			return;
+		// whoever writes the last bytes of a page hashes it
+		for (uint64_t page=range.fileStart/pageSize; page < (range.fileEnd+pageSize-1)/pageSize; ++page) {
+			if ( __atomic_sub_fetch(&pageWriterCounts[page], 1, __ATOMIC_ACQ_REL) != 0 )
+				continue;
+			if ( !finalPages[page] )
+				continue;
+			if ( _hasCodeSignature )
+				_codeSignatureAtom->hashPage(wholeBuffer, page);
+			ContentUUIDChunk* firstChunk = std::upper_bound(uuidChunks, uuidChunks+uuidChunkCount, page*pageSize,
+					[](uint64_t offset, const ContentUUIDChunk& chunk) { return offset < chunk.fileOffset+chunk.size; });
+			for (ContentUUIDChunk* chunk=firstChunk; chunk != uuidChunks+uuidChunkCount; ++chunk) {
+				if ( chunk->fileOffset >= (page+1)*pageSize )
+					break;
+				if ( chunk->hashEarly && (__atomic_sub_fetch(&chunk->pendingPages, 1, __ATOMIC_ACQ_REL) == 0) ) {
+					CCDigest(kCCDigestSHA256, &wholeBuffer[chunk->fileOffset], chunk->size, chunk->digest);
+					chunk->hashed = true;
+				}
 			}
 		}
 	});
-	if ( exception != nullptr )
-		throw exception;
+	// ranges are in section and atom order, so this reports the same error no matter how the work was scheduled
+	for (const AtomRange& range : ranges) {
+		if ( range.exception != nullptr )
+			throw range.exception;
+	}
 
 	if ( _options.verboseOptimizationHints() ) {
 		//fprintf(stderr, "ADRP optimized away:   %d\n", sAdrpNA);
@@ -3841,11 +4038,10 @@ void OutputFile::chain32bitPointers(dyld_chained_ptr_32_rebase* prevLoc, dyld_ch
 }
 
 
-void OutputFile::computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer)
+void OutputFile::buildContentUUIDChunks(ld::Internal& state)
 {
 	const bool log = false;
 	if ( (_options.outputKind() != Options::kObjectFile) || state.someObjectFileHasDwarf ) {
-		uint8_t digest[CCSHA256_OUTPUT_SIZE];
 		std::vector<std::pair<uint64_t, uint64_t>> excludeRegions;
 		uint64_t bitcodeCmdOffset;
 		uint64_t bitcodeCmdEnd;
@@ -3913,6 +4109,54 @@ void OutputFile::computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer)
 			excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(symbolTableCmdOffset, symbolTableCmdOffset+symbolTableCmdSize));
 			if ( log ) fprintf(stderr, "linkedit SegCmdOffset=0x%08llX, size=0x%08llX\n", symbolTableCmdOffset, symbolTableCmdSize);
 		}
+		// Work out which ranges of the file to measure, ignoring the exluded regions
+		std::sort(excludeRegions.begin(), excludeRegions.end());
+		std::vector<std::pair<uint64_t, uint64_t>> regionsToMeasure;
+		uint64_t checksumStart = 0;
+		for ( auto& region : excludeRegions ) {
+			uint64_t regionStart = region.first;
+			uint64_t regionEnd = region.second;
+			assert(checksumStart <= regionStart && regionStart <= regionEnd && "Region overlapped");
+			if ( log ) fprintf(stderr, "checksum 0x%08llX -> 0x%08llX\n", checksumStart, regionStart);
+			regionsToMeasure.emplace_back(checksumStart, regionStart - checksumStart);
+			checksumStart = regionEnd;
+		}
+		if ( checksumStart < _fileSize ) {
+			if ( log ) fprintf(stderr, "checksum 0x%08llX -> 0x%08llX\n", checksumStart, _fileSize);
+			regionsToMeasure.emplace_back(checksumStart, _fileSize-checksumStart);
+		}
+
+		// Split the ranges at fixed file offsets, so that writeAtoms() can hash each chunk as soon as it is written
+		const uint64_t chunkSize = 1024*1024;
+		for ( auto& region : regionsToMeasure ) {
+			uint64_t start = region.first;
+			uint64_t end   = region.first + region.second;
+			do {
+				uint64_t chunkEnd = std::min((start/chunkSize + 1)*chunkSize, end);
+				ContentUUIDChunk chunk = { start, chunkEnd - start, 0, false, false, {} };
+				_contentUUIDChunks.push_back(chunk);
+				start = chunkEnd;
+			} while ( start < end );
+		}
+	}
+}
+
+void OutputFile::computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer)
+{
+	const bool log = false;
+	if ( (_options.outputKind() != Options::kObjectFile) || state.someObjectFileHasDwarf ) {
+		uint8_t digest[CCSHA256_OUTPUT_SIZE];
+		if ( _contentUUIDChunks.empty() )
+			buildContentUUIDChunks(state);
+
+		// Measure the chunks not already hashed by writeAtoms() in parallel
+		ContentUUIDChunk* chunks = _contentUUIDChunks.data();
+		ld::trace::apply("hash UUID chunk", _contentUUIDChunks.size(), ^(size_t index) {
+			ContentUUIDChunk& chunk = chunks[index];
+			if ( !chunk.hashed )
+				CCDigest(kCCDigestSHA256, &wholeBuffer[chunk.fileOffset], chunk.size, chunk.digest);
+		});
+
 		const ccdigest_info* di = ccsha256_di();
 		ccdigest_di_decl(di, ctx);
 		ccdigest_init(di, ctx);
@@ -3927,41 +4171,9 @@ void OutputFile::computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer)
 			ccdigest_update(di, ctx, strlen(buildName), buildName);
 		}
 
-		if ( !excludeRegions.empty() ) {
-			// Work out which ranges of the file to measure, ignoring the exluded regions
-			std::sort(excludeRegions.begin(), excludeRegions.end());
-			std::vector<std::pair<uint64_t, uint64_t>> regionsToMeasure;
-			uint64_t checksumStart = 0;
-			for ( auto& region : excludeRegions ) {
-				uint64_t regionStart = region.first;
-				uint64_t regionEnd = region.second;
-				assert(checksumStart <= regionStart && regionStart <= regionEnd && "Region overlapped");
-				if ( log ) fprintf(stderr, "checksum 0x%08llX -> 0x%08llX\n", checksumStart, regionStart);
-				regionsToMeasure.emplace_back(checksumStart, regionStart - checksumStart);
-				checksumStart = regionEnd;
-			}
-			if ( checksumStart < _fileSize ) {
-				if ( log ) fprintf(stderr, "checksum 0x%08llX -> 0x%08llX\n", checksumStart, _fileSize);
-				regionsToMeasure.emplace_back(checksumStart, _fileSize-checksumStart);
-			}
-
-			// Measure the ranges we want in parallel
-			struct Digest
-			{
-				uint8_t digest[CCSHA256_OUTPUT_SIZE];
-			};
-			__block std::vector<Digest> digests(regionsToMeasure.size());
-			dispatch_apply(regionsToMeasure.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
-				uint64_t startOffset = regionsToMeasure[index].first;
-				uint64_t size = regionsToMeasure[index].second;
-				CCDigest(kCCDigestSHA256, &wholeBuffer[startOffset], size, digests[index].digest);
-			});
-
-			// Merge the resuls in serial
-			ccdigest_update(di, ctx, digests.size() * sizeof(Digest), digests.data());
-		} else {
-			ccdigest_update(di, ctx, _fileSize, wholeBuffer);
-		}
+		// Merge the resuls in serial
+		for (const ContentUUIDChunk& chunk : _contentUUIDChunks)
+			ccdigest_update(di, ctx, sizeof(chunk.digest), chunk.digest);
 
 		ccdigest_final(di, ctx, digest);
 		if ( log ) fprintf(stderr, "uuid=%02X, %02X, %02X, %02X, %02X, %02X, %02X, %02X\n", digest[0], digest[1], digest[2],
@@ -4122,15 +4334,27 @@ void OutputFile::writeOutputFile(ld::Internal& state)
 		_headersAndLoadCommandAtom->setUUID(bits);
 	}
 
-	writeAtoms(state, wholeBuffer);
+	// pages that are final once written are hashed by writeAtoms() for the UUID and code signature
+	if ( _options.UUIDMode() == Options::kUUIDContent )
+		buildContentUUIDChunks(state);
+
+	{
+		ld::trace::Scope traceScope("output", "write atoms");
+		traceScope.counter("bytes", _fileSize);
+		writeAtoms(state, wholeBuffer);
+	}
 	
 	// compute UUID 
-	if ( _options.UUIDMode() == Options::kUUIDContent )
+	if ( _options.UUIDMode() == Options::kUUIDContent ) {
+		ld::trace::Scope traceScope("output", "content UUID");
 		computeContentUUID(state, wholeBuffer);
+	}
 
-	// now that file output buffer is complete, if codesigned, compute each page's hash
-	if ( _hasCodeSignature )
+	// now that file output buffer is complete, if codesigned, compute the remaining page hashes
+	if ( _hasCodeSignature ) {
+		ld::trace::Scope traceScope("output", "code signature hash");
 		_codeSignatureAtom->hash(wholeBuffer);
+	}
 
 	if ( outputIsRegularFile && outputIsMappableFile ) {
 		::close(fd);
@@ -5696,7 +5920,38 @@ void OutputFile::buildChainedFixupInfo(ld::Internal& state)
 			_importedSymbolsCount = sect->atoms.size();
 	}
 
-	// build table of segments, fixup locations, and symbol targets
+	// build table of segments, and split their sections into ranges of atoms, so that the fixups of a huge __DATA are collected by all cores
+	struct FixupLocation {
+		uint32_t				pageIndex;
+		uint16_t				pageOffset;
+	};
+	struct FixupBind {
+		const ld::Atom*			target;
+		bool					isAuthPtr;
+		uint64_t				addend;
+	};
+	enum DiagnosticKind { kOverridesWeakDef, kUnalignedPointer, kPointerOnPageBoundary };
+	struct Diagnostic {
+		DiagnosticKind			kind;
+		const ld::Atom*			atom;
+		uint64_t				fixUpAddr;
+		uint32_t				offsetInAtom;
+	};
+	struct AtomRange {
+		const ld::Internal::FinalSection*	sect;
+		size_t								segIndex;
+		size_t								start;
+		size_t								end;
+		uint32_t							pageCount;		// pages the segment needs for this range's fixups
+		uint32_t							firstPage;		// page span of locations
+		uint32_t							lastPage;
+		std::vector<FixupLocation>			locations;
+		std::vector<FixupBind>				binds;
+		std::vector<Diagnostic>				diagnostics;	// warnings are issued in address order after collection
+		const char*							exception;
+	};
+	const size_t kAtomsPerRange = 1024;
+	std::vector<AtomRange> ranges;
 	uint32_t							pageSize     = _options.segmentAlignment();
 	// The kernel and kexts need to support unaligned fixups, so just always force 4k alignment on them
 	// x86_64 binaries are 16KB segments to make rosetta easier, but still use 4KB pages when run natively
@@ -5722,198 +5977,266 @@ void OutputFile::buildChainedFixupInfo(ld::Internal& state)
 			seg.pointerFormat = chainedPointerFormat();
 			_chainedFixupSegments.push_back(seg);
 		}
-		for (const ld::Atom* atom : sect->atoms) {
-			// Record regular atoms that override a dylib's weak definitions
-			if ( (atom->scope() == ld::Atom::scopeGlobal) && atom->overridesDylibsWeakDef() ) {
-				this->overridesWeakExternalSymbols = true;
-				if ( _options.warnWeakExports()	)
-					warning("overrides weak external symbol: %s", atom->name());
-			}
+		for (size_t start=0; start < sect->atoms.size(); start += kAtomsPerRange) {
+			AtomRange range = { sect, _chainedFixupSegments.size()-1, start, std::min(start+kAtomsPerRange, sect->atoms.size()),
+								0, UINT32_MAX, 0, {}, {}, {}, nullptr };
+			ranges.push_back(range);
+		}
+		lastSect = sect;
+	}
 
-			const ld::Atom* target;
-			const ld::Atom* fromTarget;
-			bool hadSubtract;
-			uint64_t accumulator;
-			bool isBind = false;
-			bool isAuthPtr = false;
-			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-				if ( fit->firstInCluster() ) {
-					accumulator = 0;
-					target = NULL;
-					hadSubtract = false;
-					isBind = false;
-					isAuthPtr = false;
-				}
-				if ( this->setsTarget(*fit) ) {
-					switch ( fit->binding ) {
-						case ld::Fixup::bindingNone:
-						case ld::Fixup::bindingByNameUnbound:
+	// phase 1: collect fixup locations, binds and diagnostics of each range concurrently
+	// segments are not modified until all ranges are collected
+	AtomRange*						rangesArray = ranges.data();
+	const ChainedFixupSegInfo*		segments	= _chainedFixupSegments.data();
+	const bool						slidable	= _options.outputSlidable();
+	ld::trace::apply("collect chained fixups", ranges.size(), ^(size_t index) {
+		AtomRange& range = rangesArray[index];
+		const ChainedFixupSegInfo& segInfo = segments[range.segIndex];
+		try {
+			for (size_t i=range.start; i < range.end; ++i) {
+				const ld::Atom* atom = range.sect->atoms[i];
+				// Record regular atoms that override a dylib's weak definitions
+				if ( (atom->scope() == ld::Atom::scopeGlobal) && atom->overridesDylibsWeakDef() )
+					range.diagnostics.push_back({ kOverridesWeakDef, atom, 0, 0 });
+
+				const ld::Atom* target;
+				const ld::Atom* fromTarget;
+				bool hadSubtract;
+				uint64_t accumulator;
+				bool isBind = false;
+				bool isAuthPtr = false;
+				for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+					if ( fit->firstInCluster() ) {
+						accumulator = 0;
+						target = NULL;
+						hadSubtract = false;
+						isBind = false;
+						isAuthPtr = false;
+					}
+					if ( this->setsTarget(*fit) ) {
+						switch ( fit->binding ) {
+							case ld::Fixup::bindingNone:
+							case ld::Fixup::bindingByNameUnbound:
+								break;
+							case ld::Fixup::bindingByContentBound:
+								target = fit->u.target;
+								break;
+							case ld::Fixup::bindingDirectlyBound:
+								target = fit->u.target;
+								break;
+							case ld::Fixup::bindingsIndirectlyBound:
+								target = state.indirectBindingTable[fit->u.bindingIndex];
+								break;
+						}
+						assert(target != NULL);
+					}
+					switch ( fit->kind ) {
+						case ld::Fixup::kindSetTargetAddress:
+							accumulator = addressOf(state, fit, &target);
+							if ( targetIsThumb(state, fit) )
+								accumulator |= 1;
+							if ( fit->contentAddendOnly || fit->contentDetlaToAddendOnly )
+								accumulator = 0;
 							break;
-						case ld::Fixup::bindingByContentBound:
-							target = fit->u.target;
+						case ld::Fixup::kindSubtractTargetAddress:
+							accumulator -= addressOf(state, fit, &fromTarget);
+							hadSubtract = true;
 							break;
-						case ld::Fixup::bindingDirectlyBound:
-							target = fit->u.target;
+						case ld::Fixup::kindAddAddend:
+							accumulator += fit->u.addend;
 							break;
-						case ld::Fixup::bindingsIndirectlyBound:
-							target = state.indirectBindingTable[fit->u.bindingIndex];
+						case ld::Fixup::kindSubtractAddend:
+							accumulator -= fit->u.addend;
+							break;
+						case ld::Fixup::kindSetTargetImageOffset:
+							hadSubtract = true;
+							break;
+						case ld::Fixup::kindStoreLittleEndian32:
+						case ld::Fixup::kindStoreLittleEndian64:
+							isBind = true;
+							break;
+						case ld::Fixup::kindStoreTargetAddressLittleEndian32:
+							accumulator = addressOf(state, fit, &target);
+							if ( targetIsThumb(state, fit) )
+								accumulator |= 1;
+							if ( fit->contentAddendOnly )
+								accumulator = 0;
+							isBind = true;
+							break;
+						case ld::Fixup::kindStoreTargetAddressLittleEndian64:
+							accumulator = addressOf(state, fit, &target);
+							if ( fit->contentAddendOnly )
+								accumulator = 0;
+							isBind = true;
 							break;
-					}
-					assert(target != NULL);
-				}
-				switch ( fit->kind ) {
-					case ld::Fixup::kindSetTargetAddress:
-						accumulator = addressOf(state, fit, &target);
-						if ( targetIsThumb(state, fit) )
-							accumulator |= 1;
-						if ( fit->contentAddendOnly || fit->contentDetlaToAddendOnly )
-							accumulator = 0;
-						break;
-					case ld::Fixup::kindSubtractTargetAddress:
-                        accumulator -= addressOf(state, fit, &fromTarget);
-						hadSubtract = true;
-						break;
-                    case ld::Fixup::kindAddAddend:
-						accumulator += fit->u.addend;
-						break;
-                    case ld::Fixup::kindSubtractAddend:
-						accumulator -= fit->u.addend;
-						break;
-                    case ld::Fixup::kindSetTargetImageOffset:
-                        hadSubtract = true;
-                        break;
-					case ld::Fixup::kindStoreLittleEndian32:
-					case ld::Fixup::kindStoreLittleEndian64:
-						isBind = true;
-						break;
-					case ld::Fixup::kindStoreTargetAddressLittleEndian32:
-						accumulator = addressOf(state, fit, &target);
-						if ( targetIsThumb(state, fit) )
-							accumulator |= 1;
-						if ( fit->contentAddendOnly )
-							accumulator = 0;
-						isBind = true;
-						break;
-					case ld::Fixup::kindStoreTargetAddressLittleEndian64:
-						accumulator = addressOf(state, fit, &target);
-						if ( fit->contentAddendOnly )
-							accumulator = 0;
-						isBind = true;
-						break;
 #if SUPPORT_ARCH_arm64e
-					case ld::Fixup::kindStoreLittleEndianAuth64:
-						if ( fit->contentAddendOnly ) {
-							// ld -r mode.  We want to write out the original relocation again
+						case ld::Fixup::kindStoreLittleEndianAuth64:
+							if ( fit->contentAddendOnly ) {
+								// ld -r mode.  We want to write out the original relocation again
+								break;
+							}
+							isBind = true;
+							break;
+						case ld::Fixup::kindStoreTargetAddressLittleEndianAuth64:
+							accumulator = addressOf(state, fit, &target);
+							if ( fit->contentAddendOnly )
+								accumulator = 0;
+							isBind = true;
+							break;
+						case ld::Fixup::kindSetAuthData:
+							isAuthPtr = true;
 							break;
-						}
-						isBind = true;
-						break;
-					case ld::Fixup::kindStoreTargetAddressLittleEndianAuth64:
-						accumulator = addressOf(state, fit, &target);
-						if ( fit->contentAddendOnly )
-							accumulator = 0;
-						isBind = true;
-						break;
-					case ld::Fixup::kindSetAuthData:
-						isAuthPtr = true;
-						break;
 #endif
-					default:
-						break;
-				}
-				if ( fit->lastInCluster() && isBind ) {
-					// this is an absolute pointer which means it needs to be in fixup chain
-					if ( (target != NULL) && !hadSubtract ) {
-						uint64_t fixUpAddr = atom->finalAddress() + fit->offsetInAtom;
-						//fprintf(stderr, "fixUpAddr=0x%0llX\n",fixUpAddr);
-
-						// Diagnose unaligned pointers
-						switch (_chainedFixupSegments.back().pointerFormat) {
-							case DYLD_CHAINED_PTR_ARM64E:
-							case DYLD_CHAINED_PTR_ARM64E_USERLAND:
-							case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
-								if ( fixUpAddr % 8 ) {
-									warning("pointer not aligned at address 0x%llX ('%s' + %u from %s)",
-											fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-									_hasUnalignedFixup = true;
-								}
-								break;
-							case DYLD_CHAINED_PTR_ARM64E_KERNEL:
-							case DYLD_CHAINED_PTR_64:
-							case DYLD_CHAINED_PTR_64_OFFSET:
-							case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
-							case DYLD_CHAINED_PTR_32:
-							case DYLD_CHAINED_PTR_32_FIRMWARE:
-								if ( fixUpAddr % 4 ) {
-									warning("pointer not aligned at address 0x%llX ('%s' + %u from %s)",
-										   fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-									_hasUnalignedFixup = true;
-								}
-								break;
-							default:
-								assert(0 && "unknown pointer format");
-						}
-
-						// rdar://94340387 pointers at page boundaries can't be properly
-						// fixed up by the kernel when using pagein linking
-						if ( diagnosePointersOnPageBoundary ) {
-							uint64_t pageEnd = (fixUpAddr & ~((uint64_t)pageSize - 1)) + pageSize;
-							switch (_chainedFixupSegments.back().pointerFormat) {
+						default:
+							break;
+					}
+					if ( fit->lastInCluster() && isBind ) {
+						// this is an absolute pointer which means it needs to be in fixup chain
+						if ( (target != NULL) && !hadSubtract ) {
+							uint64_t fixUpAddr = atom->finalAddress() + fit->offsetInAtom;
+							//fprintf(stderr, "fixUpAddr=0x%0llX\n",fixUpAddr);
+
+							// Diagnose unaligned pointers
+							switch (segInfo.pointerFormat) {
 								case DYLD_CHAINED_PTR_ARM64E:
 								case DYLD_CHAINED_PTR_ARM64E_USERLAND:
 								case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+									if ( fixUpAddr % 8 )
+										range.diagnostics.push_back({ kUnalignedPointer, atom, fixUpAddr, fit->offsetInAtom });
+									break;
 								case DYLD_CHAINED_PTR_ARM64E_KERNEL:
 								case DYLD_CHAINED_PTR_64:
 								case DYLD_CHAINED_PTR_64_OFFSET:
 								case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
-									if ( (fixUpAddr + 8) > pageEnd ) {
-										warning("pointer not aligned at page boundary address 0x%llX ('%s' + %u from %s)",
-												fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-										_hasUnalignedFixup = true;
-									}
-									break;
 								case DYLD_CHAINED_PTR_32:
 								case DYLD_CHAINED_PTR_32_FIRMWARE:
-									if ( (fixUpAddr + 4) > pageEnd ) {
-										warning("pointer not aligned at page boundary address 0x%llX ('%s' + %u from %s)",
-											   fixUpAddr, _options.demangleSymbol(atom->name()), fit->offsetInAtom, atom->safeFilePath());
-										_hasUnalignedFixup = true;
-									}
+									if ( fixUpAddr % 4 )
+										range.diagnostics.push_back({ kUnalignedPointer, atom, fixUpAddr, fit->offsetInAtom });
 									break;
 								default:
 									assert(0 && "unknown pointer format");
 							}
-						}
 
-						if ( targetNeedsNoFixup(target) )
-							continue;
+							// rdar://94340387 pointers at page boundaries can't be properly
+							// fixed up by the kernel when using pagein linking
+							if ( diagnosePointersOnPageBoundary ) {
+								uint64_t pageEnd = (fixUpAddr & ~((uint64_t)pageSize - 1)) + pageSize;
+								switch (segInfo.pointerFormat) {
+									case DYLD_CHAINED_PTR_ARM64E:
+									case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+									case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+									case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+									case DYLD_CHAINED_PTR_64:
+									case DYLD_CHAINED_PTR_64_OFFSET:
+									case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
+										if ( (fixUpAddr + 8) > pageEnd )
+											range.diagnostics.push_back({ kPointerOnPageBoundary, atom, fixUpAddr, fit->offsetInAtom });
+										break;
+									case DYLD_CHAINED_PTR_32:
+									case DYLD_CHAINED_PTR_32_FIRMWARE:
+										if ( (fixUpAddr + 4) > pageEnd )
+											range.diagnostics.push_back({ kPointerOnPageBoundary, atom, fixUpAddr, fit->offsetInAtom });
+										break;
+									default:
+										assert(0 && "unknown pointer format");
+								}
+							}
+
+							if ( targetNeedsNoFixup(target) )
+								continue;
 
-						unsigned pageIndex = (fixUpAddr - _chainedFixupSegments.back().startAddr)/pageSize;
-						while ( pageIndex >= _chainedFixupSegments.back().pages.size() ) {
-							ChainedFixupPageInfo emptyPage;
-							_chainedFixupSegments.back().pages.push_back(emptyPage);
+							uint32_t pageIndex = (uint32_t)((fixUpAddr - segInfo.startAddr)/pageSize);
+							range.pageCount = std::max(range.pageCount, pageIndex+1);
+							uint16_t pageOffset = fixUpAddr - (segInfo.startAddr + pageIndex*pageSize);
+							bool isRebase = !needsBind(target, isAuthPtr, &accumulator);
+							if ( !isRebase || slidable ) {
+								range.locations.push_back({ pageIndex, pageOffset });
+								range.firstPage = std::min(range.firstPage, pageIndex);
+								range.lastPage  = std::max(range.lastPage, pageIndex);
+							}
+							if ( !isRebase )
+								range.binds.push_back({ target, isAuthPtr, accumulator });
 						}
-						uint16_t pageOffset = fixUpAddr - (_chainedFixupSegments.back().startAddr + pageIndex*pageSize);
-						bool isRebase = !needsBind(target, isAuthPtr, &accumulator);
-						if ( !isRebase || _options.outputSlidable() )
-							_chainedFixupSegments.back().pages[pageIndex].fixupOffsets.push_back(pageOffset);
-						if ( !isRebase )
-							_chainedFixupBinds.ensureTarget(target, isAuthPtr, accumulator);
 					}
 				}
 			}
 		}
-		lastSect = sect;
+		catch (const char* msg) {
+			range.exception = msg;
+		}
+	});
+
+	// phase 2: in address order, issue warnings, assign bind ordinals, and size the page tables
+	for (AtomRange& range : ranges) {
+		for (const Diagnostic& diag : range.diagnostics) {
+			switch ( diag.kind ) {
+				case kOverridesWeakDef:
+					this->overridesWeakExternalSymbols = true;
+					if ( _options.warnWeakExports()	)
+						warning("overrides weak external symbol: %s", diag.atom->name());
+					break;
+				case kUnalignedPointer:
+					warning("pointer not aligned at address 0x%llX ('%s' + %u from %s)",
+							diag.fixUpAddr, _options.demangleSymbol(diag.atom->name()), diag.offsetInAtom, diag.atom->safeFilePath());
+					_hasUnalignedFixup = true;
+					break;
+				case kPointerOnPageBoundary:
+					warning("pointer not aligned at page boundary address 0x%llX ('%s' + %u from %s)",
+							diag.fixUpAddr, _options.demangleSymbol(diag.atom->name()), diag.offsetInAtom, diag.atom->safeFilePath());
+					_hasUnalignedFixup = true;
+					break;
+			}
+		}
+		if ( range.exception != nullptr )
+			throw range.exception;
+		for (const FixupBind& bind : range.binds)
+			_chainedFixupBinds.ensureTarget(bind.target, bind.isAuthPtr, bind.addend);
+		ChainedFixupSegInfo& segInfo = _chainedFixupSegments[range.segIndex];
+		if ( segInfo.pages.size() < range.pageCount )
+			segInfo.pages.resize(range.pageCount);
 	}
 	if ( _hasUnalignedFixup )
 		throw "unaligned pointer(s)";
 
-	// sort all fixups on each page, so chain can be built
-	for (ChainedFixupSegInfo& segInfo : _chainedFixupSegments) {
-		for (ChainedFixupPageInfo& pageInfo : segInfo.pages) {
-			std::sort(pageInfo.fixupOffsets.begin(), pageInfo.fixupOffsets.end());
+	// phase 3: fill and sort the pages of each segment in shards of pages, so chain can be built
+	// each shard owns its pages and only reads the ranges whose locations overlap them
+	struct PageShard {
+		size_t		segIndex;
+		uint32_t	firstPage;
+		uint32_t	endPage;
+		size_t		firstRange;
+		size_t		endRange;
+	};
+	const uint32_t kPagesPerShard = 64;
+	std::vector<PageShard> shards;
+	size_t segFirstRange = 0;
+	for (size_t segIndex=0; segIndex < _chainedFixupSegments.size(); ++segIndex) {
+		size_t segEndRange = segFirstRange;
+		while ( (segEndRange < ranges.size()) && (ranges[segEndRange].segIndex == segIndex) )
+			++segEndRange;
+		const uint32_t pageCount = (uint32_t)_chainedFixupSegments[segIndex].pages.size();
+		for (uint32_t firstPage=0; firstPage < pageCount; firstPage += kPagesPerShard)
+			shards.push_back({ segIndex, firstPage, std::min(firstPage+kPagesPerShard, pageCount), segFirstRange, segEndRange });
+		segFirstRange = segEndRange;
+	}
+	const PageShard*		shardsArray	 = shards.data();
+	ChainedFixupSegInfo*	segmentsArray = _chainedFixupSegments.data();
+	ld::trace::apply("sort chained fixup pages", shards.size(), ^(size_t index) {
+		const PageShard& shard = shardsArray[index];
+		ChainedFixupPageInfo* pages = segmentsArray[shard.segIndex].pages.data();
+		for (size_t r=shard.firstRange; r < shard.endRange; ++r) {
+			const AtomRange& range = rangesArray[r];
+			if ( range.locations.empty() || (range.firstPage >= shard.endPage) || (range.lastPage < shard.firstPage) )
+				continue;
+			for (const FixupLocation& location : range.locations) {
+				if ( (location.pageIndex >= shard.firstPage) && (location.pageIndex < shard.endPage) )
+					pages[location.pageIndex].fixupOffsets.push_back(location.pageOffset);
+			}
 		}
-	}
+		for (uint32_t p=shard.firstPage; p < shard.endPage; ++p)
+			std::sort(pages[p].fixupOffsets.begin(), pages[p].fixupOffsets.end());
+	});
 
     if ( _hasChainedFixups && (_chainedInfoAtom != nullptr) )
         _chainedInfoAtom->encode();
@@ -7174,223 +7497,245 @@ void OutputFile::makeSplitSegInfoV2(ld::Internal& state)
 }
 
 
-void OutputFile::writeMapFile(ld::Internal& state)
+// map file name for an atom, literal strings and pointers are described by their content
+static const char* mapFileSymbolName(const ld::Internal& state, const ld::Atom* atom, bool deadStripped, char buffer[4096])
 {
-	if ( _options.generatedMapPath() != NULL ) {
-		FILE* mapFile = fopen(_options.generatedMapPath(), "w");
-		if ( mapFile != NULL ) {
-			// write output path
-			fprintf(mapFile, "# Path: %s\n", _options.outputFilePath());
-			// write output architecure
-			fprintf(mapFile, "# Arch: %s\n", _options.architectureName());
-			// write UUID
-			//if ( fUUIDAtom != NULL ) {
-			//	const uint8_t* uuid = fUUIDAtom->getUUID();
-			//	fprintf(mapFile, "# UUID: %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X \n",
-			//		uuid[0], uuid[1], uuid[2],  uuid[3],  uuid[4],  uuid[5],  uuid[6],  uuid[7],
-			//		uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
-			//}
-			// write table of object files
-			std::map<const ld::File*, ld::File::Ordinal> readerToOrdinal;
-			std::map<ld::File::Ordinal, const ld::File*> ordinalToReader;
-			std::map<const ld::File*, uint32_t> readerToFileOrdinal;
-			for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
-				ld::Internal::FinalSection* sect = *sit;
-				if ( sect->isSectionHidden() ) 
-					continue;
-				for (std::vector<const ld::Atom*>::iterator ait = sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
-					const ld::Atom* atom = *ait;
-					const ld::File* reader = atom->originalFile();
-					if ( reader == NULL )
-						continue;
-					ld::File::Ordinal readerOrdinal = reader->ordinal();
-					std::map<const ld::File*, ld::File::Ordinal>::iterator pos = readerToOrdinal.find(reader);
-					if ( pos == readerToOrdinal.end() ) {
-						readerToOrdinal[reader] = readerOrdinal;
-						ordinalToReader[readerOrdinal] = reader;
-					}
-				}
+	const char* name = atom->name();
+	if ( atom->contentType() == ld::Atom::typeCString ) {
+		strcpy(buffer, "literal string: ");
+		const char* s = (char*)atom->rawContentPointer();
+		char* e = &buffer[4094];
+		for (char* b = &buffer[strlen(buffer)]; b < e;) {
+			char c = *s++;
+			if ( c == '\n' ) {
+				*b++ = '\\';
+				*b++ = 'n';
+			}
+			else if ( (c == '\r') && !deadStripped ) {
+				*b++ = '\\';
+				*b++ = 'r';
+			}
+			else if ( (c == '\t') && !deadStripped ) {
+				*b++ = '\\';
+				*b++ = 't';
+			}
+			else if ( (c == '\"') && !deadStripped ) {
+				*b++ = '\\';
+				*b++ = '\"';
 			}
-			// for LTO build map of symbols back to original .o file
-			__block std::map<std::string, const ld::File*> ltoSymbolsMap;
-			for (const ld::relocatable::File* ltoFile : state.filesForLTO) {
-				ltoFile->forEachLtoSymbol(^(const char* symName) {
-					auto pos = ltoSymbolsMap.find(symName);
-					if ( pos == ltoSymbolsMap.end() ) {
-						ltoSymbolsMap[symName] = ltoFile;
-					}
-					else {
-						// same symbol in multiple files, map will show lto.o
-						pos->second = nullptr;
-					}
-				});
-				// add to object file table even if nothing used from it
-				if ( readerToOrdinal.count(ltoFile) == 0 ) {
-					ld::File::Ordinal readerOrdinal = ltoFile->ordinal();
-					readerToOrdinal[ltoFile] = readerOrdinal;
-					ordinalToReader[readerOrdinal] = ltoFile;
+			else {
+				*b++ = c;
+			}
+			if ( c == '\0' )
+				break;
+		}
+		buffer[4095] = '\0';
+		name = buffer;
+	}
+	else if ( deadStripped ) {
+		return name;
+	}
+	else if ( (atom->contentType() == ld::Atom::typeCFI) && (strcmp(name, "FDE") == 0) ) {
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
+			if ( (fit->kind == ld::Fixup::kindSetTargetAddress) && (fit->clusterSize == ld::Fixup::k1of4) ) {
+				if ( (fit->binding == ld::Fixup::bindingDirectlyBound)
+				 &&  (fit->u.target->section().type() == ld::Section::typeCode) ) {
+					strcpy(buffer, "FDE for: ");
+					strlcat(buffer, fit->u.target->name(), 4096);
+					name = buffer;
 				}
 			}
-
-			for (const ld::Atom* atom : state.deadAtoms) {
-				const ld::File* reader = atom->originalFile();
-				if ( reader == NULL )
-					continue;
-				ld::File::Ordinal readerOrdinal = reader->ordinal();
-				std::map<const ld::File*, ld::File::Ordinal>::iterator pos = readerToOrdinal.find(reader);
-				if ( pos == readerToOrdinal.end() ) {
-					readerToOrdinal[reader] = readerOrdinal;
-					ordinalToReader[readerOrdinal] = reader;
-				}
-			}
-			fprintf(mapFile, "# Object files:\n");
-			fprintf(mapFile, "[%3u] %s\n", 0, "linker synthesized");
-			uint32_t fileIndex = 1;
-			for(std::map<ld::File::Ordinal, const ld::File*>::iterator it = ordinalToReader.begin(); it != ordinalToReader.end(); ++it) {
-				fprintf(mapFile, "[%3u] %s\n", fileIndex, it->second->path());
-				readerToFileOrdinal[it->second] = fileIndex++;
-			}
-			// write table of sections
-			fprintf(mapFile, "# Sections:\n");
-			fprintf(mapFile, "# Address\tSize    \tSegment\tSection\n"); 
-			for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
-				ld::Internal::FinalSection* sect = *sit;
-				if ( sect->isSectionHidden() ) 
-					continue;
-				fprintf(mapFile, "0x%08llX\t0x%08llX\t%s\t%s\n", sect->address, sect->size, 
-							sect->segmentName(), sect->sectionName());
+		}
+	}
+	else if ( atom->contentType() == ld::Atom::typeNonLazyPointer ) {
+		strcpy(buffer, "non-lazy-pointer");
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
+			if ( fit->binding == ld::Fixup::bindingsIndirectlyBound ) {
+				strcpy(buffer, "non-lazy-pointer-to: ");
+				strlcat(buffer, state.indirectBindingTable[fit->u.bindingIndex]->name(), 4096);
+				break;
 			}
-			// write table of symbols
-			fprintf(mapFile, "# Symbols:\n");
-			fprintf(mapFile, "# Address\tSize    \tFile  Name\n"); 
-			for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
-				ld::Internal::FinalSection* sect = *sit;
-				if ( sect->isSectionHidden() ) 
+			else if ( fit->binding == ld::Fixup::bindingDirectlyBound ) {
+				strcpy(buffer, "non-lazy-pointer-to-local: ");
+				strlcat(buffer, fit->u.target->name(), 4096);
+				break;
+			}
+		}
+		name = buffer;
+	}
+	return name;
+}
+
+// a slice of one section's atoms (or of the dead atoms) whose map file lines are formatted together
+struct MapFileRange {
+	const ld::Atom* const*			begin;
+	const ld::Atom* const*			end;
+	bool							deadStripped;
+	std::vector<const ld::File*>	files;
+	std::string						text;
+};
+
+typedef std::unordered_map<const ld::File*, uint32_t>			MapFileOrdinals;
+typedef std::unordered_map<std::string, const ld::File*>		MapFileLtoSymbols;
+
+static void addMapFileRanges(const std::vector<const ld::Atom*>& atoms, bool deadStripped, std::vector<MapFileRange>& ranges)
+{
+	const size_t kAtomsPerRange = 1024;
+	for (size_t i=0; i < atoms.size(); i += kAtomsPerRange)
+		ranges.push_back({ &atoms[i], &atoms[std::min(i+kAtomsPerRange, atoms.size())], deadStripped, {}, {} });
+}
+
+// formats ranges in parallel a wave at a time, and writes each wave in order so memory stays bounded
+static void writeMapFileSymbols(FILE* mapFile, const ld::Internal& state, MapFileRange* ranges, size_t rangeCount,
+								const MapFileOrdinals& readerToFileOrdinal, const MapFileLtoSymbols& ltoSymbolsMap)
+{
+	const size_t kRangesPerWave = 256;
+	const ld::Internal* statePtr = &state;
+	const MapFileOrdinals* ordinals = &readerToFileOrdinal;
+	const MapFileLtoSymbols* ltoSymbols = &ltoSymbolsMap;
+	for (size_t wave=0; wave < rangeCount; wave += kRangesPerWave) {
+		const size_t waveCount = std::min(kRangesPerWave, rangeCount - wave);
+		ld::trace::apply("format map file", waveCount, ^(size_t index) {
+			MapFileRange& range = ranges[wave + index];
+			range.text.reserve((range.end - range.begin) * 64);
+			for (const ld::Atom* const* it = range.begin; it != range.end; ++it) {
+				const ld::Atom* atom = *it;
+				// don't add auto-stripped aliases to .map file
+				if ( (atom->size() == 0) && (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages) )
 					continue;
-				//bool isCstring = (sect->type() == ld::Section::typeCString);
-				for (std::vector<const ld::Atom*>::iterator ait = sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
-					char buffer[4096];
-					const ld::Atom* atom = *ait;
-					const char* name = atom->name();
-					// don't add auto-stripped aliases to .map file
-					if ( (atom->size() == 0) && (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages) )
-						continue;
-					if ( atom->contentType() == ld::Atom::typeCString ) {
-						strcpy(buffer, "literal string: ");
-						const char* s = (char*)atom->rawContentPointer();
-						char* e = &buffer[4094];
-						for (char* b = &buffer[strlen(buffer)]; b < e;) {
-							char c = *s++;
-							if ( c == '\n' ) {
-								*b++ = '\\';
-								*b++ = 'n';
-							}
-							else if ( c == '\r' ) {
-								*b++ = '\\';
-								*b++ = 'r';
-							}
-							else if ( c == '\t' ) {
-								*b++ = '\\';
-								*b++ = 't';
-							}
-							else if ( c == '\"' ) {
-								*b++ = '\\';
-								*b++ = '\"';
-							}
-							else {
-								*b++ = c;
-							}
-							if ( c == '\0' )
-								break;
-						}
-						buffer[4095] = '\0';
-						name = buffer;
-					}
-					else if ( (atom->contentType() == ld::Atom::typeCFI) && (strcmp(name, "FDE") == 0) ) {
-						for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
-							if ( (fit->kind == ld::Fixup::kindSetTargetAddress) && (fit->clusterSize == ld::Fixup::k1of4) ) {
-								if ( (fit->binding == ld::Fixup::bindingDirectlyBound)
-								 &&  (fit->u.target->section().type() == ld::Section::typeCode) ) {
-									strcpy(buffer, "FDE for: ");
-									strlcat(buffer, fit->u.target->name(), 4096);
-									name = buffer;
-								}
-							}
-						}
-					}
-					else if ( atom->contentType() == ld::Atom::typeNonLazyPointer ) {
-						strcpy(buffer, "non-lazy-pointer");
-						for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
-							if ( fit->binding == ld::Fixup::bindingsIndirectlyBound ) {
-								strcpy(buffer, "non-lazy-pointer-to: ");
-								strlcat(buffer, state.indirectBindingTable[fit->u.bindingIndex]->name(), 4096);
-								break;
-							}
-							else if ( fit->binding == ld::Fixup::bindingDirectlyBound ) {
-								strcpy(buffer, "non-lazy-pointer-to-local: ");
-								strlcat(buffer, fit->u.target->name(), 4096);
-								break;
-							}
-						}
-						name = buffer;
-					}
+				char buffer[4096];
+				const char* name = mapFileSymbolName(*statePtr, atom, range.deadStripped, buffer);
+				const auto& pos = ordinals->find(atom->originalFile());
+				unsigned fromFileOrdinal = (pos != ordinals->end()) ? pos->second : 0;
+				char prefix[64];
+				int prefixLength;
+				if ( range.deadStripped ) {
+					prefixLength = snprintf(prefix, sizeof(prefix), "<<dead>> \t0x%08llX\t[%3u] ", atom->size(), fromFileOrdinal);
+				}
+				else {
 					// <rdar://problem/50031245> LTO: preserve the original file reference for symbols in link map
-					unsigned fromFileOrdinal = readerToFileOrdinal[atom->originalFile()];
 					const ld::relocatable::File* objFile = dynamic_cast<const ld::relocatable::File*>(atom->originalFile());
 					if ( (objFile != nullptr) && (objFile->sourceKind() == ld::relocatable::File::kSourceLTO) ) {
-						const auto& pos = ltoSymbolsMap.find(atom->name());
-						if ( pos != ltoSymbolsMap.end() ) {
-							const ld::File* betterFile = pos->second;
+						const auto& ltoPos = ltoSymbols->find(atom->name());
+						if ( ltoPos != ltoSymbols->end() ) {
+							const ld::File* betterFile = ltoPos->second;
 							if ( betterFile != nullptr ) {
-								const auto& pos2 = readerToFileOrdinal.find(betterFile);
-								if ( pos2 != readerToFileOrdinal.end() )
+								const auto& pos2 = ordinals->find(betterFile);
+								if ( pos2 != ordinals->end() )
 									fromFileOrdinal = pos2->second;
 							}
 						}
 					}
-					fprintf(mapFile, "0x%08llX\t0x%08llX\t[%3u] %s\n", atom->finalAddress(), atom->size(), fromFileOrdinal, name);
-				}
-			}
-			bool emitDeadStrippedSymbols = _options.deadCodeStrip();
-			if ( emitDeadStrippedSymbols  ) {
-				fprintf(mapFile, "\n");
-				fprintf(mapFile, "# Dead Stripped Symbols:\n");
-				fprintf(mapFile, "#        \tSize    \tFile  Name\n");
-				for (const ld::Atom* atom : state.deadAtoms) {
-					char buffer[4096];
-					const char* name = atom->name();
-					// don't add auto-stripped aliases to .map file
-					if ( (atom->size() == 0) && (atom->symbolTableInclusion() == ld::Atom::symbolTableNotInFinalLinkedImages) )
-						continue;
-					if ( atom->contentType() == ld::Atom::typeCString ) {
-						strcpy(buffer, "literal string: ");
-						const char* s = (char*)atom->rawContentPointer();
-						char* e = &buffer[4094];
-						for (char* b = &buffer[strlen(buffer)]; b < e;) {
-							char c = *s++;
-							if ( c == '\n' ) {
-								*b++ = '\\';
-								*b++ = 'n';
-							}
-							else {
-								*b++ = c;
-							}
-							if ( c == '\0' )
-								break;
-						}
-						buffer[4095] = '\0';
-						name = buffer;
-					}
-					fprintf(mapFile, "<<dead>> \t0x%08llX\t[%3u] %s\n",  atom->size(),
-							readerToFileOrdinal[atom->originalFile()], name);
+					prefixLength = snprintf(prefix, sizeof(prefix), "0x%08llX\t0x%08llX\t[%3u] ", atom->finalAddress(), atom->size(), fromFileOrdinal);
 				}
+				range.text.append(prefix, prefixLength);
+				range.text.append(name);
+				range.text.push_back('\n');
 			}
-			fclose(mapFile);
+		});
+		for (size_t i=wave; i < wave + waveCount; ++i) {
+			fwrite(ranges[i].text.data(), ranges[i].text.size(), 1, mapFile);
+			std::string().swap(ranges[i].text);
 		}
-		else {
-			warning("could not write map file: %s\n", _options.generatedMapPath());
+	}
+}
+
+void OutputFile::writeMapFile(ld::Internal& state, FILE* mapFile)
+{
+	// formatted ranges are large, so buffer generously and let big writes pass straight through
+	setvbuf(mapFile, NULL, _IOFBF, 1024*1024);
+	// write output path
+	fprintf(mapFile, "# Path: %s\n", _options.outputFilePath());
+	// write output architecure
+	fprintf(mapFile, "# Arch: %s\n", _options.architectureName());
+	// write UUID
+	//if ( fUUIDAtom != NULL ) {
+	//	const uint8_t* uuid = fUUIDAtom->getUUID();
+	//	fprintf(mapFile, "# UUID: %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X %2X \n",
+	//		uuid[0], uuid[1], uuid[2],  uuid[3],  uuid[4],  uuid[5],  uuid[6],  uuid[7],
+	//		uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+	//}
+	// split visible sections, then dead atoms, into ranges
+	std::vector<MapFileRange> ranges;
+	for (const ld::Internal::FinalSection* sect : state.sections) {
+		if ( sect->isSectionHidden() ) 
+			continue;
+		addMapFileRanges(sect->atoms, false, ranges);
+	}
+	const size_t liveRangeCount = ranges.size();
+	const bool emitDeadStrippedSymbols = _options.deadCodeStrip();
+	addMapFileRanges(state.deadAtoms, true, ranges);
+
+	// find the files each range uses in parallel
+	MapFileRange* rangesArray = ranges.data();
+	ld::trace::apply("map file readers", ranges.size(), ^(size_t index) {
+		MapFileRange& range = rangesArray[index];
+		std::unordered_set<const ld::File*> seen;
+		for (const ld::Atom* const* it = range.begin; it != range.end; ++it) {
+			const ld::File* reader = (*it)->originalFile();
+			if ( (reader != NULL) && seen.insert(reader).second )
+				range.files.push_back(reader);
+		}
+	});
+
+	// build table of object files, ordered by file ordinal
+	std::unordered_set<const ld::File*> readerSet;
+	std::vector<const ld::File*> readers;
+	for (const MapFileRange& range : ranges) {
+		for (const ld::File* reader : range.files) {
+			if ( readerSet.insert(reader).second )
+				readers.push_back(reader);
 		}
 	}
+	// for LTO build map of symbols back to original .o file
+	__block MapFileLtoSymbols ltoSymbolsMap;
+	for (const ld::relocatable::File* ltoFile : state.filesForLTO) {
+		ltoFile->forEachLtoSymbol(^(const char* symName) {
+			auto pos = ltoSymbolsMap.find(symName);
+			if ( pos == ltoSymbolsMap.end() ) {
+				ltoSymbolsMap[symName] = ltoFile;
+			}
+			else {
+				// same symbol in multiple files, map will show lto.o
+				pos->second = nullptr;
+			}
+		});
+		// add to object file table even if nothing used from it
+		if ( readerSet.insert(ltoFile).second )
+			readers.push_back(ltoFile);
+	}
+	std::sort(readers.begin(), readers.end(), [](const ld::File* lhs, const ld::File* rhs) {
+		return lhs->ordinal() < rhs->ordinal();
+	});
+
+	fprintf(mapFile, "# Object files:\n");
+	fprintf(mapFile, "[%3u] %s\n", 0, "linker synthesized");
+	MapFileOrdinals readerToFileOrdinal;
+	uint32_t fileIndex = 1;
+	for (const ld::File* reader : readers) {
+		fprintf(mapFile, "[%3u] %s\n", fileIndex, reader->path());
+		readerToFileOrdinal[reader] = fileIndex++;
+	}
+	// write table of sections
+	fprintf(mapFile, "# Sections:\n");
+	fprintf(mapFile, "# Address\tSize    \tSegment\tSection\n"); 
+	for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
+		ld::Internal::FinalSection* sect = *sit;
+		if ( sect->isSectionHidden() ) 
+			continue;
+		fprintf(mapFile, "0x%08llX\t0x%08llX\t%s\t%s\n", sect->address, sect->size, 
+					sect->segmentName(), sect->sectionName());
+	}
+	// write table of symbols
+	fprintf(mapFile, "# Symbols:\n");
+	fprintf(mapFile, "# Address\tSize    \tFile  Name\n"); 
+	writeMapFileSymbols(mapFile, state, rangesArray, liveRangeCount, readerToFileOrdinal, ltoSymbolsMap);
+	if ( emitDeadStrippedSymbols  ) {
+		fprintf(mapFile, "\n");
+		fprintf(mapFile, "# Dead Stripped Symbols:\n");
+		fprintf(mapFile, "#        \tSize    \tFile  Name\n");
+		writeMapFileSymbols(mapFile, state, &rangesArray[liveRangeCount], ranges.size() - liveRangeCount, readerToFileOrdinal, ltoSymbolsMap);
+	}
 }
 
 static std::string realPathString(const char* path)
@@ -7952,6 +8297,7 @@ void OutputFile::buildLINKEDITContent(ld::Internal& state)
 	// phase 1: build state.stabs and _importedAtoms, _exportedAtoms, _localAtoms in parallel
 	__block const char* exceptionMsg = nullptr;
 	dispatch_group_async(group, queue, ^{
+		ld::trace::Scope traceScope("linkedit", "debug notes");
 		try {
 			this->synthesizeDebugNotes(state);	// needs state.section.atoms, updates: state.stabs
 		}
@@ -7960,6 +8306,7 @@ void OutputFile::buildLINKEDITContent(ld::Internal& state)
 		}
 	});
 	dispatch_group_async(group, queue, ^{
+		ld::trace::Scope traceScope("linkedit", "partition symbol table");
 		try {
 			this->partitionSymbolTable(state);	// needs state.section.atoms, updates: _importedAtoms, _exportedAtoms, _localAtoms, `Atom::_outputSymbolIndex`
 		}
@@ -7977,6 +8324,7 @@ void OutputFile::buildLINKEDITContent(ld::Internal& state)
 	// phase 3: build linkedit parts in parallel that depend on results of phase 1
 	if ( _hasDyldInfo || _hasSectionRelocations || _hasLocalRelocations || _hasExternalRelocations || _hasThreadedPageStarts ) {
 		dispatch_group_async(group, queue, ^{
+			ld::trace::Scope traceScope("linkedit", "dyld info and relocations");
 			try {
 				this->buildLinkEditOpcodes(state);	// needs state.section.atoms, `Atom::_outputSymbolIndex`, updates: _rebasingInfoAtom, _bindingInfoAtom, _weakBindingInfoAtom, _weakBindingInfoAtom, _sectionsRelocationsAtom
 			}
@@ -7987,6 +8335,7 @@ void OutputFile::buildLINKEDITContent(ld::Internal& state)
 	}
 	else if ( _hasChainedFixups ) {
 		dispatch_group_async(group, queue, ^{
+			ld::trace::Scope traceScope("linkedit", "chained fixups");
 			try {
 				this->buildChainedFixupInfo(state);  // needs state.section.atoms, updates: _chainedFixupSegments, _importedSymbolsCount, _chainedInfoAtom
 			}
@@ -7997,23 +8346,29 @@ void OutputFile::buildLINKEDITContent(ld::Internal& state)
 	}
 	if ( _options.sharedRegionEligible() || _options.emitSharedRegionMarker() ) {
 		dispatch_group_async(group, queue, ^{
+			ld::trace::Scope traceScope("linkedit", "split seg info");
 			this->makeSplitSegInfo(state);	 // needs state.section.atoms, updates: _splitSegInfoAtom
 			_splitSegInfoAtom->encode();
+			traceScope.counter("bytes", _splitSegInfoAtom->size());
 		});
 	}
 	if ( _exportInfoAtom != nullptr ) {
 		dispatch_group_async(group, queue, ^{
+				ld::trace::Scope traceScope("linkedit", "export info");
 				try {
 					_exportInfoAtom->encode(); 		// needs _exportedAtoms, updates: _exportInfoAtom
+					traceScope.counter("bytes", _exportInfoAtom->size());
 				} catch ( const char* msg ) {
 					exceptionMsg = msg;
 				}
 		});
 	}
 	dispatch_group_async(group, queue, ^{
+		ld::trace::Scope traceScope("linkedit", "symbol table");
 		try {
 			_symbolTableAtom->encode();			// needs _importedAtoms, _exportedAtoms, _localAtoms, state.stabs, updates: _symbolTableAtom
 			_indirectSymbolTableAtom->encode(); // needs state.section.atoms, `Atom::_outputSymbolIndex`, updates:  _indirectSymbolTableAtom
+			traceScope.counter("bytes", _symbolTableAtom->size() + _indirectSymbolTableAtom->size());
 		}
 		catch (const char* msg) {
 			exceptionMsg = msg;
@@ -8021,17 +8376,23 @@ void OutputFile::buildLINKEDITContent(ld::Internal& state)
 	});
 	if ( _functionStartsAtom != nullptr ) {
 		dispatch_group_async(group, queue, ^{
+			ld::trace::Scope traceScope("linkedit", "function starts");
 			_functionStartsAtom->encode();	// needs state.section.atoms
+			traceScope.counter("bytes", _functionStartsAtom->size());
 		});
 	}
 	if ( _dataInCodeAtom != nullptr ) {
 		dispatch_group_async(group, queue, ^{
+			ld::trace::Scope traceScope("linkedit", "data in code");
 			_dataInCodeAtom->encode();		// needs state.section.atoms
+			traceScope.counter("bytes", _dataInCodeAtom->size());
 		});
 	}
 	if ( _optimizationHintsAtom != nullptr ) {
 		dispatch_group_async(group, queue, ^{
+			ld::trace::Scope traceScope("linkedit", "optimization hints");
 			_optimizationHintsAtom->encode(); // needs state.section.atoms
+			traceScope.counter("bytes", _optimizationHintsAtom->size());
 		});
 	}
 	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
@@ -8044,22 +8405,22 @@ void OutputFile::buildLINKEDITContent(ld::Internal& state)
 
 
 
+size_t OutputFile::ChainedFixupBinds::AtomAndAddendHash::operator()(const AtomAndAddend& target) const
+{
+	return std::hash<const ld::Atom*>()(target.atom) ^ std::hash<uint64_t>()(target.addend * 0x9E3779B97F4A7C15ULL);
+}
+
+bool OutputFile::ChainedFixupBinds::AtomAndAddendEquals::operator()(const AtomAndAddend& left, const AtomAndAddend& right) const
+{
+	return (left.atom == right.atom) && (left.addend == right.addend);
+}
+
 void OutputFile::ChainedFixupBinds::ensureTarget(const ld::Atom* atom, bool authPtr, uint64_t addend)
 {
-	if ( addend == 0 ) {
-		// special case normal case of addend==0 to use map to be fast
-		if ( _bindOrdinalsWithNoAddend.count(atom) )
-			return;
-		_bindOrdinalsWithNoAddend[atom] = _bindsTargets.size();
-		_bindsTargets.push_back({atom, 0});
+	// auth only affects the import format, a pointer with and without auth shares the same import
+	auto pos = _bindOrdinals.insert({{atom, addend}, (uint32_t)_bindsTargets.size()});
+	if ( !pos.second )
 		return;
-	}
-	unsigned index = 0;
-	for (const AtomAndAddend& entry : _bindsTargets) {
-		if ( entry.atom == atom && entry.addend == addend )
-			return;
-		++index;
-	}
 	_bindsTargets.push_back({atom, addend});
 	if ( authPtr )  {
 		// arm64e auth-pointer binds have no bit for addend, so any addend means wide import table
@@ -8115,18 +8476,9 @@ void OutputFile::ChainedFixupBinds::forEachBind(void (^callback)(unsigned bindOr
 
 uint32_t OutputFile::ChainedFixupBinds::ordinal(const ld::Atom* atom, uint64_t addend) const
 {
-	if ( addend == 0 ) {
-		auto it = _bindOrdinalsWithNoAddend.find(atom);
-		assert(it != _bindOrdinalsWithNoAddend.end());
-		return it->second;
-	}
-	unsigned index = 0;
-	for (const AtomAndAddend& entry : _bindsTargets) {
-		if ( entry.atom == atom  && entry.addend == addend )
-			return index;
-		++index;
-	}
-	assert(0 && "bind ordinal missing");
+	auto it = _bindOrdinals.find({atom, addend});
+	assert(it != _bindOrdinals.end() && "bind ordinal missing");
+	return it->second;
 }
 
 
@@ -178,8 +178,20 @@ public:
 		std::vector<ChainedFixupPageInfo> pages;
 	};
 
+	// part of the file measured for the content UUID, hashed as soon as all of its pages are written
+	struct ContentUUIDChunk
+	{
+		uint64_t	fileOffset;
+		uint64_t	size;
+		uint32_t	pendingPages;
+		bool		hashEarly;
+		bool		hashed;
+		uint8_t		digest[32];
+	};
+
 private:
 	void						writeAtoms(ld::Internal& state, uint8_t* wholeBuffer);
+	void						buildContentUUIDChunks(ld::Internal& state);
 	void						computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer);
 	void						buildDylibOrdinalMapping(ld::Internal&);
 	bool						hasOrdinalForInstallPath(const char* path, int* ordinal);
@@ -252,7 +264,7 @@ private:
 	void						buildChainedFixupInfo(ld::Internal& state);
 	void						makeSplitSegInfo(ld::Internal& state);
 	void						makeSplitSegInfoV2(ld::Internal& state);
-	void						writeMapFile(ld::Internal& state);
+	void						writeMapFile(ld::Internal& state, FILE* mapFile);
 	void						writeJSONEntry(ld::Internal& state);
 	uint64_t					lookBackAddend(ld::Fixup::iterator fit);
 	bool						takesNoDiskSpace(const ld::Section* sect);
@@ -340,7 +352,15 @@ private:
 			const ld::Atom*		atom;
 			uint64_t			addend;
 		};
-		std::unordered_map<const ld::Atom*, uint32_t> 	_bindOrdinalsWithNoAddend;
+		struct AtomAndAddendHash {
+			size_t operator()(const AtomAndAddend&) const;
+		};
+		struct AtomAndAddendEquals {
+			bool operator()(const AtomAndAddend& left, const AtomAndAddend& right) const;
+		};
+		typedef std::unordered_map<AtomAndAddend, uint32_t, AtomAndAddendHash, AtomAndAddendEquals> BindOrdinals;
+
+		BindOrdinals									_bindOrdinals;
 		std::vector<AtomAndAddend>						_bindsTargets;
 		uint64_t										_maxRebase = 0;
 		bool											_hasLargeAddends = false;
@@ -411,6 +431,7 @@ public:
 	std::unordered_map<const ld::Atom*, uint32_t> _chainedFixupNoAddendBindOrdinals;
 	ChainedFixupBinds						_chainedFixupBinds;
 	std::vector<ChainedFixupSegInfo>    	_chainedFixupSegments;
+	std::vector<ContentUUIDChunk>			_contentUUIDChunks;
 	size_t 									_importedSymbolsCount;
 #if SUPPORT_ARCH_arm64e
 	std::map<uintptr_t, std::pair<Fixup::AuthData, uint64_t>> _authenticatedFixupData;
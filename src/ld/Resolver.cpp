@@ -58,6 +58,7 @@
 #include "InputFiles.h"
 #include "Mangling.h"
 #include "SymbolTable.h"
+#include "Trace.h"
 #include "Resolver.h"
 #include "parsers/lto_file.h"
 
@@ -916,9 +917,30 @@ void Resolver::addInitialUndefines()
 }
 
 void Resolver::resolveCurrentUndefines() {
+	// An undefine that libraries did not define last time can only be found now if libraries
+	// were added since, so normally only the undefines created since the last call are searched.
+	const size_t libraryGeneration = _inputFiles.librarySearchGeneration();
+	const SymbolTable::IndirectBindingSlot endSlot = _symbolTable.updateCount();
+	bool searchingAll = (libraryGeneration != _undefinesSearchedGeneration);
 	std::vector<std::string_view> undefineNames;
-	_symbolTable.undefines(undefineNames);
-	for (const std::string_view& undefsv : undefineNames) {
+	_symbolTable.undefines(undefineNames, searchingAll ? 0 : _undefinesSearchedSlots, endSlot);
+	_undefinesSearchedSlots = endSlot;
+	_undefinesSearchedGeneration = libraryGeneration;
+	_inputFiles.speculativelyParseArchiveMembers(undefineNames);
+	for (size_t i = 0; i < undefineNames.size(); ++i) {
+		// <rdar://problem/23053404> loading a member with linker options can add libraries, which
+		// must also be searched for the earlier undefines still to come in this sorted walk
+		if ( !searchingAll && (_inputFiles.librarySearchGeneration() != libraryGeneration) ) {
+			std::vector<std::string_view> allNames;
+			_symbolTable.undefines(allNames, 0, endSlot);
+			auto rest = std::upper_bound(allNames.begin(), allNames.end(), undefineNames[i-1]);
+			undefineNames.assign(rest, allNames.end());
+			i = 0;
+			searchingAll = true;
+			if ( undefineNames.empty() )
+				break;
+		}
+		const std::string_view& undefsv = undefineNames[i];
 		// <rdar://95875374> Don't search libraries for objc_msgSend stubs, they're synthesized.
 		if ( undefsv.starts_with("_objc_msgSend$") ) {
 			// Synthesize the stubs already if needed, so that they don't appear
@@ -1095,6 +1117,49 @@ void Resolver::resolveAllUndefines()
 }
 
 
+// Returns true if a fixup of this kind keeps its target alive when dead stripping
+static bool fixupKeepsTargetLive(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindNone:
+		case ld::Fixup::kindNoneFollowOn:
+		case ld::Fixup::kindNoneGroupSubordinate:
+		case ld::Fixup::kindNoneGroupSubordinateFDE:
+		case ld::Fixup::kindNoneGroupSubordinateLSDA:
+		case ld::Fixup::kindNoneGroupSubordinatePersonality:
+		case ld::Fixup::kindSetTargetAddress:
+		case ld::Fixup::kindSubtractTargetAddress:
+		case ld::Fixup::kindStoreTargetAddressLittleEndian32:
+		case ld::Fixup::kindStoreTargetAddressLittleEndian64:
+#if SUPPORT_ARCH_arm64e
+		case ld::Fixup::kindStoreTargetAddressLittleEndianAuth64:
+#endif
+		case ld::Fixup::kindStoreTargetAddressBigEndian32:
+		case ld::Fixup::kindStoreTargetAddressBigEndian64:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32:
+		case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoadNowLEA:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoadNowLEA:
+		case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
+		case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoadNowLEA:
+		case ld::Fixup::kindStoreTargetAddressARMBranch24:
+		case ld::Fixup::kindStoreTargetAddressThumbBranch22:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64Branch26:
+		case ld::Fixup::kindStoreTargetAddressARM64Page21:
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLeaPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadNowLeaPage21:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
 void Resolver::markLive(const ld::Atom& atom, WhyLiveBackChain* previous)
 {
 	//fprintf(stderr, "markLive(%p) %s\n", &atom, atom.name());
@@ -1124,88 +1189,113 @@ void Resolver::markLive(const ld::Atom& atom, WhyLiveBackChain* previous)
 	thisChain.previous = previous;
 	thisChain.referer = &atom;
 	for (ld::Fixup::iterator fit = atom.fixupsBegin(), end=atom.fixupsEnd(); fit != end; ++fit) {
+		if ( !fixupKeepsTargetLive(fit->kind) )
+			continue;
 		const ld::Atom* target;
-		switch ( fit->kind ) {
-			case ld::Fixup::kindNone:
-			case ld::Fixup::kindNoneFollowOn:
-			case ld::Fixup::kindNoneGroupSubordinate:
-			case ld::Fixup::kindNoneGroupSubordinateFDE:
-			case ld::Fixup::kindNoneGroupSubordinateLSDA:
-			case ld::Fixup::kindNoneGroupSubordinatePersonality:
-			case ld::Fixup::kindSetTargetAddress:
-			case ld::Fixup::kindSubtractTargetAddress:
-			case ld::Fixup::kindStoreTargetAddressLittleEndian32:
-			case ld::Fixup::kindStoreTargetAddressLittleEndian64:
-#if SUPPORT_ARCH_arm64e
-			case ld::Fixup::kindStoreTargetAddressLittleEndianAuth64:
-#endif
-			case ld::Fixup::kindStoreTargetAddressBigEndian32:
-			case ld::Fixup::kindStoreTargetAddressBigEndian64:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32:
-			case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoadNowLEA:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoadNowLEA:
-			case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
-			case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoadNowLEA:
-			case ld::Fixup::kindStoreTargetAddressARMBranch24:
-			case ld::Fixup::kindStoreTargetAddressThumbBranch22:
-#if SUPPORT_ARCH_arm64
-			case ld::Fixup::kindStoreTargetAddressARM64Branch26:
-			case ld::Fixup::kindStoreTargetAddressARM64Page21:
-			case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
-			case ld::Fixup::kindStoreTargetAddressARM64GOTLeaPage21:
-			case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
-			case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadNowLeaPage21:
-#endif
-				if ( fit->binding == ld::Fixup::bindingByContentBound ) {
-					// normally this was done in convertReferencesToIndirect()
-					// but a archive loaded .o file may have a forward reference
-					SymbolTable::IndirectBindingSlot slot;
-					const ld::Atom* dummy;
-					switch ( fit->u.target->combine() ) {
-						case ld::Atom::combineNever:
-						case ld::Atom::combineByName:
-							assert(0 && "wrong combine type for bind by content");
-							break;
-						case ld::Atom::combineByNameAndContent:
-							slot = _symbolTable.findSlotForContent(fit->u.target, &dummy);
-							fit->binding = ld::Fixup::bindingsIndirectlyBound;
-							fit->u.bindingIndex = slot;
+		if ( fit->binding == ld::Fixup::bindingByContentBound ) {
+			// normally this was done in convertReferencesToIndirect()
+			// but a archive loaded .o file may have a forward reference
+			SymbolTable::IndirectBindingSlot slot;
+			const ld::Atom* dummy;
+			switch ( fit->u.target->combine() ) {
+				case ld::Atom::combineNever:
+				case ld::Atom::combineByName:
+					assert(0 && "wrong combine type for bind by content");
+					break;
+				case ld::Atom::combineByNameAndContent:
+					slot = _symbolTable.findSlotForContent(fit->u.target, &dummy);
+					fit->binding = ld::Fixup::bindingsIndirectlyBound;
+					fit->u.bindingIndex = slot;
+					break;
+				case ld::Atom::combineByNameAndReferences:
+					slot = _symbolTable.findSlotForReferences(fit->u.target, &dummy);
+					fit->binding = ld::Fixup::bindingsIndirectlyBound;
+					fit->u.bindingIndex = slot;
+					break;
+			}
+		}
+		switch ( fit->binding ) {
+			case ld::Fixup::bindingDirectlyBound:
+				markLive(*(fit->u.target), &thisChain);
+				break;
+			case ld::Fixup::bindingByNameUnbound:
+				// doAtom() did not convert to indirect in dead-strip mode, so that now
+				fit->u.bindingIndex = _symbolTable.findSlotForName(fit->u.name);
+				fit->binding = ld::Fixup::bindingsIndirectlyBound;
+				// fall into next case
+				[[clang::fallthrough]];
+			case ld::Fixup::bindingsIndirectlyBound:
+				target = _internal.indirectBindingTable[fit->u.bindingIndex];
+				if ( target != NULL ) {
+					this->markLive(*target, &thisChain);
+				}
+				break;
+			default:
+				assert(0 && "bad binding during dead stripping");
+		}
+	}
+
+}
+
+// Marks everything reachable from roots live, a level at a time with each level spread across all
+// cores.  The live set does not depend on the order atoms are reached in, so it is the same as
+// markLive() computes, as long as no fixup still has to be bound through the symbol table.  If one
+// does, this returns false and markLive() has to be used instead.  Every atom made live is added
+// to marked.
+bool Resolver::markLiveConcurrently(const std::vector<const ld::Atom*>& roots, std::vector<const ld::Atom*>& marked)
+{
+	const size_t kAtomsPerChunk = 1024;
+	std::vector<const ld::Atom*> level;
+	for (const ld::Atom* atom : roots) {
+		if ( (const_cast<ld::Atom*>(atom))->setLiveConcurrently() )
+			level.push_back(atom);
+	}
+	__block bool needsSymbolTable = false;
+	const std::vector<const ld::Atom*>* table = &_internal.indirectBindingTable;
+	while ( !level.empty() ) {
+		marked.insert(marked.end(), level.begin(), level.end());
+		const size_t chunkCount = (level.size() + kAtomsPerChunk - 1) / kAtomsPerChunk;
+		std::vector<std::vector<const ld::Atom*>> nextLevels(chunkCount);
+		std::vector<const ld::Atom*>* nextLevelsBase = nextLevels.data();
+		const ld::Atom* const* levelBase = level.data();
+		const size_t levelSize = level.size();
+		ld::trace::apply("mark live atoms", chunkCount, ^(size_t chunk) {
+			std::vector<const ld::Atom*>& next = nextLevelsBase[chunk];
+			const size_t end = std::min(levelSize, (chunk+1) * kAtomsPerChunk);
+			for (size_t i = chunk * kAtomsPerChunk; i < end; ++i) {
+				const ld::Atom* atom = levelBase[i];
+				for (ld::Fixup::iterator fit = atom->fixupsBegin(), fend=atom->fixupsEnd(); fit != fend; ++fit) {
+					if ( !fixupKeepsTargetLive(fit->kind) )
+						continue;
+					const ld::Atom* target = NULL;
+					switch ( fit->binding ) {
+						case ld::Fixup::bindingDirectlyBound:
+							target = fit->u.target;
 							break;
-						case ld::Atom::combineByNameAndReferences:
-							slot = _symbolTable.findSlotForReferences(fit->u.target, &dummy);
-							fit->binding = ld::Fixup::bindingsIndirectlyBound;
-							fit->u.bindingIndex = slot;
+						case ld::Fixup::bindingsIndirectlyBound:
+							target = (*table)[fit->u.bindingIndex];
 							break;
+						case ld::Fixup::bindingByNameUnbound:
+						case ld::Fixup::bindingByContentBound:
+							__atomic_store_n(&needsSymbolTable, true, __ATOMIC_RELAXED);
+							return;
+						default:
+							assert(0 && "bad binding during dead stripping");
 					}
+					if ( (target != NULL) && (const_cast<ld::Atom*>(target))->setLiveConcurrently() )
+						next.push_back(target);
 				}
-				switch ( fit->binding ) {
-					case ld::Fixup::bindingDirectlyBound:
-						markLive(*(fit->u.target), &thisChain);
-						break;
-					case ld::Fixup::bindingByNameUnbound:
-						// doAtom() did not convert to indirect in dead-strip mode, so that now
-						fit->u.bindingIndex = _symbolTable.findSlotForName(fit->u.name);
-						fit->binding = ld::Fixup::bindingsIndirectlyBound;
-						// fall into next case
-						[[clang::fallthrough]];
-					case ld::Fixup::bindingsIndirectlyBound:
-						target = _internal.indirectBindingTable[fit->u.bindingIndex];
-						if ( target != NULL ) {
-							this->markLive(*target, &thisChain);
-						}
-						break;
-					default:
-						assert(0 && "bad binding during dead stripping");
-				}
-				break;
-            default:
-                break;    
+			}
+		});
+		level.clear();
+		for (const std::vector<const ld::Atom*>& next : nextLevels)
+			level.insert(level.end(), next.begin(), next.end());
+		if ( needsSymbolTable ) {
+			marked.insert(marked.end(), level.begin(), level.end());
+			return false;
 		}
 	}
-
+	return true;
 }
 
 class LiveLTO {
@@ -1359,24 +1449,52 @@ void Resolver::deadStripOptimize(bool force)
 	}
 
 	// mark all roots as live, and all atoms they reference
-	forEachDeadStripRoot(dontDeadStripIfReferencesLive, force, [this](const ld::Atom * atom) {
-		WhyLiveBackChain rootChain;
-		rootChain.previous = NULL;
-		rootChain.referer = atom;
-		this->markLive(*atom, &rootChain);
+	std::vector<const ld::Atom*> roots;
+	forEachDeadStripRoot(dontDeadStripIfReferencesLive, force, [&roots](const ld::Atom * atom) {
+		roots.push_back(atom);
 	});
-	
-	// special case atoms that need to be live if they reference something live
-	for (const Atom* liveIfRefLiveAtom : dontDeadStripIfReferencesLive) {
-		//fprintf(stderr, "live-if-live atom: %s\n", liveIfRefLiveAtom->name());
-		if ( liveIfRefLiveAtom->live() )
-			continue;
 
-		if ( atomHasLiveRef(_internal, liveIfRefLiveAtom) ) {
+	// -why_live needs the chain of references that reached each atom, which only the serial walk has
+	bool markedConcurrently = false;
+	if ( !_printWhyLive ) {
+		std::vector<const ld::Atom*> marked;
+		markedConcurrently = markLiveConcurrently(roots, marked);
+		// special case atoms that need to be live if they reference something live
+		for (const Atom* liveIfRefLiveAtom : dontDeadStripIfReferencesLive) {
+			if ( !markedConcurrently )
+				break;
+			if ( liveIfRefLiveAtom->live() )
+				continue;
+			if ( atomHasLiveRef(_internal, liveIfRefLiveAtom) )
+				markedConcurrently = markLiveConcurrently({ liveIfRefLiveAtom }, marked);
+		}
+		if ( !markedConcurrently ) {
+			// start over with the serial walk, which can bind fixups as it goes
+			for (const ld::Atom* atom : marked)
+				(const_cast<ld::Atom*>(atom))->setLive(false);
+		}
+	}
+
+	if ( !markedConcurrently ) {
+		for (const ld::Atom* atom : roots) {
 			WhyLiveBackChain rootChain;
 			rootChain.previous = NULL;
-			rootChain.referer = liveIfRefLiveAtom;
-			this->markLive(*liveIfRefLiveAtom, &rootChain);
+			rootChain.referer = atom;
+			this->markLive(*atom, &rootChain);
+		}
+
+		// special case atoms that need to be live if they reference something live
+		for (const Atom* liveIfRefLiveAtom : dontDeadStripIfReferencesLive) {
+			//fprintf(stderr, "live-if-live atom: %s\n", liveIfRefLiveAtom->name());
+			if ( liveIfRefLiveAtom->live() )
+				continue;
+
+			if ( atomHasLiveRef(_internal, liveIfRefLiveAtom) ) {
+				WhyLiveBackChain rootChain;
+				rootChain.previous = NULL;
+				rootChain.referer = liveIfRefLiveAtom;
+				this->markLive(*liveIfRefLiveAtom, &rootChain);
+			}
 		}
 	}
 
@@ -1790,7 +1908,7 @@ void Resolver::checkDylibSymbolCollisions()
 		}
 	}
 
-	dispatch_apply(weakDefDylibs.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+	ld::trace::apply("weak def dylib scan", weakDefDylibs.size(), ^(size_t index) {
 			ld::dylib::File* dylib = weakDefDylibs[index];
 
 			dylib->forEachExportedSymbol(^(const char *symbolName, bool weakDef) {
@@ -2358,24 +2476,32 @@ void Resolver::writeDotOutput()
 }
 void Resolver::resolve()
 {
-	this->initializeState();
-	this->buildAtomList();
-	this->addInitialUndefines();
-	this->fillInHelpersInInternalState();
-	this->resolveAllUndefines();
-	this->deadStripOptimize();
-	this->checkUndefines();
-	this->checkDylibSymbolCollisions();
-	this->syncAliases();
-	this->removeCoalescedAwayAtoms();
-	this->fillInEntryPoint();
-	this->linkTimeOptimize();
-	this->fillInInternalState();
-	this->tweakWeakness();
-    _symbolTable.checkDuplicateSymbols();
-	this->buildArchivesList();
-	this->checkChainedFixupsBounds();
-	this->writeDotOutput();
+	try {
+		this->initializeState();
+		this->buildAtomList();
+		this->addInitialUndefines();
+		this->fillInHelpersInInternalState();
+		this->resolveAllUndefines();
+		this->deadStripOptimize();
+		this->checkUndefines();
+		this->checkDylibSymbolCollisions();
+		this->syncAliases();
+		this->removeCoalescedAwayAtoms();
+		this->fillInEntryPoint();
+		this->linkTimeOptimize();
+		this->fillInInternalState();
+		this->tweakWeakness();
+		_symbolTable.checkDuplicateSymbols();
+		this->buildArchivesList();
+		this->checkChainedFixupsBounds();
+		this->writeDotOutput();
+	}
+	catch (...) {
+		_inputFiles.finishSpeculativeArchiveParses();
+		throw;
+	}
+	// no more archive members will be loaded, so any parse still outstanding is wasted
+	_inputFiles.finishSpeculativeArchiveParses();
 }
 
 
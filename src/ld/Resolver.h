@@ -110,6 +110,7 @@ private:
 	const ld::Atom*			entryPoint(bool searchArchives);
 	bool					diagnoseAtomsWithUnalignedPointers() const;
 	void					markLive(const ld::Atom& atom, WhyLiveBackChain* previous);
+	bool					markLiveConcurrently(const std::vector<const ld::Atom*>& roots, std::vector<const ld::Atom*>& marked);
 	bool					isDtraceProbe(ld::Fixup::Kind kind);
 	void					liveUndefines(std::vector<std::string_view>&);
 	void					remainingUndefines(std::vector<std::string_view>&);
@@ -143,6 +144,8 @@ private:
 	bool							_printWhyLive;
 	bool							_synthesizeObjcMsgSendStubs;
 	bool							_needsObjcMsgSendProxy;
+	SymbolTable::IndirectBindingSlot	_undefinesSearchedSlots = 0;		// slots below this were searched for by resolveCurrentUndefines()
+	size_t							_undefinesSearchedGeneration = SIZE_MAX;	// library search generation at that time
 };
 
 
@@ -456,6 +456,7 @@ bool SymbolTable::addByName(const ld::Atom& newAtom, Options::Treatment duplicat
 		}
 		if ( newAtom.definition() == ld::Atom::definitionTentative ) {
 			_hasTentativeDefinitions = true;
+			_tentativeSlots.push_back(slot);
 		}
 	}
 	else {
@@ -562,11 +563,18 @@ void SymbolTable::markCoalescedAway(const ld::Atom* atom)
 }
 
 
-void SymbolTable::undefines(std::vector<std::string_view>& undefs)
+void SymbolTable::undefines(std::vector<std::string_view>& undefs, IndirectBindingSlot fromSlot, IndirectBindingSlot toSlot)
 {
-	for (size_t slot = 0; slot < _indirectBindingTable.size(); ++slot) {
-		if (_indirectBindingTable[slot] == NULL) {
-			if (const auto& nameIt = _byNameReverseTable.find(slot); nameIt != _byNameReverseTable.end())
+	// slots are only ever defined or removed after being created, so drop those from the worklist
+	// when looking at all of it
+	if ( fromSlot == 0 ) {
+		_undefinedSlots.erase(std::remove_if(_undefinedSlots.begin(), _undefinedSlots.end(), [&](IndirectBindingSlot slot) {
+			return (_indirectBindingTable[slot] != NULL) || (_byNameReverseTable.find(slot) == _byNameReverseTable.end());
+		}), _undefinedSlots.end());
+	}
+	for (auto it = std::lower_bound(_undefinedSlots.begin(), _undefinedSlots.end(), fromSlot); (it != _undefinedSlots.end()) && (*it < toSlot); ++it) {
+		if (_indirectBindingTable[*it] == NULL) {
+			if (const auto& nameIt = _byNameReverseTable.find(*it); nameIt != _byNameReverseTable.end())
 				undefs.push_back(nameIt->second);
 		}
 	}
@@ -577,12 +585,16 @@ void SymbolTable::undefines(std::vector<std::string_view>& undefs)
 
 void SymbolTable::tentativeDefs(std::vector<std::string_view>& tents)
 {
-	// return all names in _byNameTable that have no associated atom
-	for (size_t slot = 0; slot < _indirectBindingTable.size(); ++slot) {
-		if (const ld::Atom* atom = _indirectBindingTable[slot];
-				atom != nullptr && (atom->definition() == ld::Atom::definitionTentative))
-			if (const auto& nameIt = _byNameReverseTable.find(slot); nameIt != _byNameReverseTable.end())
-				tents.push_back(nameIt->second);
+	// return all names whose atom is still a tentative definition
+	_tentativeSlots.erase(std::remove_if(_tentativeSlots.begin(), _tentativeSlots.end(), [&](IndirectBindingSlot slot) {
+		const ld::Atom* atom = _indirectBindingTable[slot];
+		return (atom == nullptr) || (atom->definition() != ld::Atom::definitionTentative);
+	}), _tentativeSlots.end());
+	std::sort(_tentativeSlots.begin(), _tentativeSlots.end());
+	_tentativeSlots.erase(std::unique(_tentativeSlots.begin(), _tentativeSlots.end()), _tentativeSlots.end());
+	for (IndirectBindingSlot slot : _tentativeSlots) {
+		if (const auto& nameIt = _byNameReverseTable.find(slot); nameIt != _byNameReverseTable.end())
+			tents.push_back(nameIt->second);
 	}
 	std::sort(tents.begin(), tents.end());
 }
@@ -620,6 +632,7 @@ SymbolTable::IndirectBindingSlot SymbolTable::findSlotForName(const std::string_
 	pos->second = slot;
 	_indirectBindingTable.push_back(NULL);
 	_byNameReverseTable[slot] = name;
+	_undefinedSlots.push_back(slot);
 	return slot;
 }
 
@@ -124,7 +124,10 @@ public:
 	const ld::Atom*		atomForSlot(IndirectBindingSlot s)	{ return _indirectBindingTable[s]; }
 	const ld::Atom*		atomForName(const std::string_view& name) const;
 	unsigned int		updateCount()						{ return _indirectBindingTable.size(); }
-	void				undefines(std::vector<std::string_view>& undefines);
+	// names without a definition, sorted.  Only slots in [fromSlot, toSlot) are considered,
+	// which lets the resolver ask for just the undefines created since it last looked.
+	void				undefines(std::vector<std::string_view>& undefines, IndirectBindingSlot fromSlot=0,
+								  IndirectBindingSlot toSlot=UINT32_MAX);
 	void				tentativeDefs(std::vector<std::string_view>& undefines);
 	void				mustPreserveForBitcode(std::unordered_set<const char*>& syms);
 	void				removeDeadAtoms();
@@ -173,6 +176,8 @@ private:
 	ReferencesToSlot				_pointerToCStringTable;
 	std::vector<const ld::Atom*>&	_indirectBindingTable;
 	bool							_hasTentativeDefinitions;
+	std::vector<IndirectBindingSlot>	_undefinedSlots;	// name slots created without an atom, in slot order
+	std::vector<IndirectBindingSlot>	_tentativeSlots;	// name slots that were given a tentative definition
 	
     DuplicateSymbols                _duplicateSymbolErrors;
     DuplicateSymbols                _duplicateSymbolWarnings;
@@ -0,0 +1,197 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <mach/mach_time.h>
+#include <dispatch/dispatch.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+namespace ld {
+namespace trace {
+
+struct Event
+{
+	const char*				category;
+	std::string				name;
+	uint64_t				start;
+	uint64_t				end;
+	std::vector<Counter>	counters;
+};
+
+struct ThreadBuffer
+{
+	uint64_t				tid;
+	std::vector<Event>		events;
+};
+
+bool									sEnabled = false;
+static pthread_mutex_t					sBuffersLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<ThreadBuffer*>		sBuffers;
+// buffers are owned by sBuffers and live until the process exits, so worker threads never race a destructor
+static thread_local ThreadBuffer*		sThreadBuffer = nullptr;
+static std::atomic<int32_t>				sOpenScopes(0);
+
+
+void enable()
+{
+	sEnabled = true;
+}
+
+uint64_t now()
+{
+	return mach_absolute_time();
+}
+
+static ThreadBuffer& threadBuffer()
+{
+	if ( sThreadBuffer == nullptr ) {
+		ThreadBuffer* buffer = new ThreadBuffer();
+		pthread_threadid_np(NULL, &buffer->tid);
+		pthread_mutex_lock(&sBuffersLock);
+		sBuffers.push_back(buffer);
+		pthread_mutex_unlock(&sBuffersLock);
+		sThreadBuffer = buffer;
+	}
+	return *sThreadBuffer;
+}
+
+void record(const char* category, const char* name, uint64_t start, std::initializer_list<Counter> counters)
+{
+	if ( !sEnabled )
+		return;
+	uint64_t end = now();
+	threadBuffer().events.push_back({ category, name, start, end, std::vector<Counter>(counters) });
+}
+
+void record(const char* category, const char* name, uint64_t start, const std::vector<Counter>& counters)
+{
+	if ( !sEnabled )
+		return;
+	uint64_t end = now();
+	threadBuffer().events.push_back({ category, name, start, end, counters });
+}
+
+void apply(const char* name, size_t iterations, void (^work)(size_t index))
+{
+	if ( !sEnabled ) {
+		dispatch_apply(iterations, DISPATCH_APPLY_AUTO, work);
+		return;
+	}
+	dispatch_apply(iterations, DISPATCH_APPLY_AUTO, ^(size_t index) {
+		uint64_t start = now();
+		work(index);
+		record("work", name, start, { { "index", index } });
+	});
+}
+
+static void writeString(FILE* out, const char* str)
+{
+	fputc('"', out);
+	for (const char* s = str; *s != '\0'; ++s) {
+		unsigned char c = *s;
+		if ( (c == '"') || (c == '\\') )
+			fprintf(out, "\\%c", c);
+		else if ( c < 0x20 )
+			fprintf(out, "\\u%04x", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+void scopeOpened()
+{
+	++sOpenScopes;
+}
+
+void scopeClosed()
+{
+	--sOpenScopes;
+}
+
+bool write(const char* path)
+{
+	// a span still being recorded means some thread may also be appending to its buffer
+	if ( sOpenScopes != 0 ) {
+		errno = EBUSY;
+		return false;
+	}
+	FILE* out = fopen(path, "w");
+	if ( out == NULL )
+		return false;
+
+	// trace-event timestamps are in microseconds
+	mach_timebase_info_data_t timeBase;
+	mach_timebase_info(&timeBase);
+	auto micros = ^(uint64_t ticks) {
+		return (double)ticks * timeBase.numer / timeBase.denom / 1000.0;
+	};
+
+	// spans may have been started before tracing was enabled (e.g. option parsing), so the timeline begins at the earliest span
+	uint64_t base = UINT64_MAX;
+	pthread_mutex_lock(&sBuffersLock);
+	for (const ThreadBuffer* buffer : sBuffers) {
+		for (const Event& event : buffer->events)
+			base = std::min(base, event.start);
+	}
+
+	int pid = getpid();
+	fprintf(out, "{\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"ld\"}}", pid);
+	for (const ThreadBuffer* buffer : sBuffers) {
+		for (const Event& event : buffer->events) {
+			fprintf(out, ",\n{\"name\":");
+			writeString(out, event.name.c_str());
+			fprintf(out, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%llu",
+					event.category, micros(event.start - base), micros(event.end - event.start), pid, buffer->tid);
+			if ( !event.counters.empty() ) {
+				fprintf(out, ",\"args\":{");
+				bool first = true;
+				for (const Counter& counter : event.counters) {
+					fprintf(out, "%s\"%s\":%llu", (first ? "" : ","), counter.name, counter.value);
+					first = false;
+				}
+				fputc('}', out);
+			}
+			fputc('}', out);
+		}
+	}
+	pthread_mutex_unlock(&sBuffersLock);
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	return (fclose(out) == 0);
+}
+
+} // namespace trace
+} // namespace ld
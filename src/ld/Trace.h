@@ -0,0 +1,97 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __LD_TRACE_H__
+#define __LD_TRACE_H__
+
+#include <stdint.h>
+#include <initializer_list>
+#include <vector>
+
+//
+// Timeline tracing for -trace_json.  Each complete span is recorded into a
+// per-thread buffer and the whole timeline is written out once at the end of
+// the link in the Chrome trace-event format, which chrome://tracing and
+// Perfetto both load.  When tracing is not enabled every entry point is a
+// single predictable branch.
+//
+
+namespace ld {
+namespace trace {
+
+struct Counter
+{
+	const char*		name;
+	uint64_t		value;
+};
+
+extern bool			sEnabled;
+
+inline bool			enabled() { return sEnabled; }
+extern void			enable();
+extern uint64_t		now();
+
+// record a span that began at 'start' and ends now, name is copied
+extern void			record(const char* category, const char* name, uint64_t start, std::initializer_list<Counter> counters={});
+extern void			record(const char* category, const char* name, uint64_t start, const std::vector<Counter>& counters);
+
+// Writes all recorded spans to 'path', returns false and sets errno if the file could not be written.
+// Threads append to their buffers without locking, so every background task that records spans must
+// have been joined before this is called.  If a Scope is still open it fails with EBUSY.
+extern bool			write(const char* path);
+
+// count of Scopes alive, so write() can tell it is racing a background task
+extern void			scopeOpened();
+extern void			scopeClosed();
+
+// dispatch_apply() that records one span per work item when tracing is enabled
+extern void			apply(const char* name, size_t iterations, void (^work)(size_t index));
+
+
+//
+// Records a span from construction to destruction.  The name must outlive the scope.
+//
+class Scope
+{
+public:
+					Scope(const char* category, const char* name)
+						: _category(category), _name(name), _start(enabled() ? now() : 0) { if ( _start != 0 ) scopeOpened(); }
+					~Scope() { if ( _start != 0 ) { record(_category, _name, _start, _counters); scopeClosed(); } }
+
+	void			counter(const char* name, uint64_t value) { if ( _start != 0 ) _counters.push_back({ name, value }); }
+
+private:
+					Scope(const Scope&) = delete;
+	Scope&			operator=(const Scope&) = delete;
+
+	const char*				_category;
+	const char*				_name;
+	uint64_t				_start;
+	std::vector<Counter>	_counters;
+};
+
+} // namespace trace
+} // namespace ld
+
+#endif // __LD_TRACE_H__
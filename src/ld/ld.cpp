@@ -69,6 +69,7 @@ extern "C" double log2 ( double );
 #include "Resolver.h"
 #include "OutputFile.h"
 #include "Snapshot.h"
+#include "Trace.h"
 
 #include "passes/stubs/make_stubs.h"
 #include "passes/dtrace_dof.h"
@@ -87,12 +88,14 @@ extern "C" double log2 ( double );
 #include "passes/bitcode_bundle.h"
 #include "passes/code_dedup.h"
 #include "passes/objc_stubs.h"
+#include "passes/fixup_index.h"
 
 #include "parsers/archive_file.h"
 #include "parsers/macho_relocatable_file.h"
 #include "parsers/macho_dylib_file.h"
 #include "parsers/lto_file.h"
 #include "parsers/opaque_section_file.h"
+#include "parsers/textstub_dylib_file.hpp"
 
 
 const ld::VersionSet ld::File::_platforms;
@@ -107,6 +110,7 @@ struct PerformanceStatistics {
 	uint64_t						startDone;
 	vm_statistics_data_t			vmStart;
 	vm_statistics_data_t			vmEnd;
+	std::vector<std::pair<const char*, uint64_t>>	passTimes;
 };
 
 
@@ -1472,6 +1476,20 @@ static void printTime(const char* msg, uint64_t partTime, uint64_t totalTime)
 }
 
 
+// counters attached to -trace_json phase and pass spans
+static std::vector<ld::trace::Counter> traceAtomCounters(const ld::Internal& state)
+{
+	uint64_t atomCount = 0;
+	uint64_t fixupCount = 0;
+	for (const ld::Internal::FinalSection* sect : state.sections) {
+		atomCount += sect->atoms.size();
+		for (const ld::Atom* atom : sect->atoms)
+			fixupCount += (atom->fixupsEnd() - atom->fixupsBegin());
+	}
+	return { { "sections", state.sections.size() }, { "atoms", atomCount }, { "fixups", fixupCount } };
+}
+
+
 static void getVMInfo(vm_statistics_data_t& info)
 {
 	mach_msg_type_number_t count = sizeof(vm_statistics_data_t) / sizeof(natural_t);
@@ -1500,6 +1518,10 @@ int main(int argc, const char* argv[])
 		// create object to track command line arguments
 		Options& options = *(new Options(argc, argv));
 		InternalState& state = *(new InternalState(options));
+		if ( options.traceJSONPath() != NULL ) {
+			ld::trace::enable();
+			ld::trace::record("phase", "option parsing", statistics.startTool);
+		}
 		
 		// allow libLTO to be overridden by command line -lto_library
 		if (const char *dylib = options.overridePathlibLTO())
@@ -1516,11 +1538,14 @@ int main(int argc, const char* argv[])
 		// open and parse input files
 		statistics.startInputFileProcessing = mach_absolute_time();
 		ld::tool::InputFiles& inputFiles = *(new ld::tool::InputFiles(options));
+		ld::trace::record("phase", "object file processing", statistics.startInputFileProcessing);
 		
 		// load and resolve all references
 		statistics.startResolver = mach_absolute_time();
 		ld::tool::Resolver& resolver = *(new ld::tool::Resolver(options, inputFiles, state));
 		resolver.resolve();
+		if ( ld::trace::enabled() )
+			ld::trace::record("phase", "resolve symbols", statistics.startResolver, traceAtomCounters(state));
         
 		// add dylibs used
 		statistics.startDylibs = mach_absolute_time();
@@ -1528,33 +1553,44 @@ int main(int argc, const char* argv[])
 	
 		// do initial section sorting so passes have rough idea of the layout
 		state.sortSections();
+		ld::trace::record("phase", "build atom list", statistics.startDylibs);
 
 		// run passes
 		statistics.startPasses = mach_absolute_time();
-		ld::passes::objc_stubs::doPass(options, state);
-		ld::passes::objc::doPass(options, state);
-		ld::passes::stubs::doPass(options, state);
-		ld::passes::inits::doPass(options, state);
-		ld::passes::huge::doPass(options, state);
-		ld::passes::got::doPass(options, state);
+		auto runPass = [&](const char* name, auto pass) {
+			uint64_t start = mach_absolute_time();
+			pass(options, state);
+			if ( options.printStatistics() )
+				statistics.passTimes.push_back({ name, mach_absolute_time() - start });
+			if ( ld::trace::enabled() )
+				ld::trace::record("pass", name, start, traceAtomCounters(state));
+		};
+		runPass("fixup index", ld::passes::fixup_index::doPass);	// must be before passes that use ld::Atom::mayHaveFixups()
+		runPass("objc stubs", ld::passes::objc_stubs::doPass);
+		runPass("objc", ld::passes::objc::doPass);
+		runPass("stubs", ld::passes::stubs::doPass);
+		runPass("inits", ld::passes::inits::doPass);
+		runPass("huge", ld::passes::huge::doPass);
+		runPass("got", ld::passes::got::doPass);
 		//ld::passes::objc_constants::doPass(options, state);
-		ld::passes::tlvp::doPass(options, state);
-		ld::passes::dylibs::doPass(options, state);	// must be after stubs and GOT passes
-		ld::passes::dedup::doPass(options, state);
-		ld::passes::order::doPass(options, state); // must run after code dedup, so that deduplicated aliases are sorted
+		runPass("tlvp", ld::passes::tlvp::doPass);
+		runPass("dylibs", ld::passes::dylibs::doPass);	// must be after stubs and GOT passes
+		runPass("dedup", ld::passes::dedup::doPass);
+		runPass("order", ld::passes::order::doPass); // must run after code dedup, so that deduplicated aliases are sorted
 		state.markAtomsOrdered();
-		ld::passes::branch_shim::doPass(options, state);	// must be after stubs
-		ld::passes::branch_island::doPass(options, state);	// must be after stubs and order pass
-		ld::passes::dtrace::doPass(options, state);
-		ld::passes::compact_unwind::doPass(options, state);  // must be after order pass
-		ld::passes::bitcode_bundle::doPass(options, state);  // must be after dylib
+		runPass("branch shim", ld::passes::branch_shim::doPass);	// must be after stubs
+		runPass("branch island", ld::passes::branch_island::doPass);	// must be after stubs and order pass
+		runPass("dtrace", ld::passes::dtrace::doPass);
+		runPass("compact unwind", ld::passes::compact_unwind::doPass);  // must be after order pass
+		runPass("bitcode bundle", ld::passes::bitcode_bundle::doPass);  // must be after dylib
 
 		// Sort again so that we get the segments in order.
 		state.sortSections();
-		ld::passes::thread_starts::doPass(options, state);  // must be after dylib
+		runPass("thread starts", ld::passes::thread_starts::doPass);  // must be after dylib
 		
 		// sort final sections
 		state.sortSections();
+		ld::trace::record("phase", "passes", statistics.startPasses);
 
 		options.writeDependencyInfo();
 
@@ -1563,6 +1599,14 @@ int main(int argc, const char* argv[])
 		ld::tool::OutputFile& out = *(new ld::tool::OutputFile(options, state));
 		out.write(state);
 		statistics.startDone = mach_absolute_time();
+		ld::trace::record("phase", "write output", statistics.startOutput, { { "bytes", out.fileSize() } });
+
+		if ( options.objectCachePath() != NULL )
+			mach_o::relocatable::pruneObjectCache(options.objectCachePath(), options.objectCachePruneInterval(),
+												  options.objectCachePruneAfter(), options.objectCacheMaxSize());
+		if ( options.tbdCachePath() != NULL )
+			textstub::dylib::pruneInterfaceCache(options.tbdCachePath(), options.objectCachePruneInterval(),
+												 options.objectCachePruneAfter(), options.objectCacheMaxSize());
 
 		// print statistics
 		//mach_o::relocatable::printCounts();
@@ -1573,8 +1617,12 @@ int main(int argc, const char* argv[])
 			printTime(" option parsing time", statistics.startInputFileProcessing  -	statistics.startTool,				totalTime);
 			printTime(" object file processing", statistics.startResolver			 -	statistics.startInputFileProcessing,totalTime);
 			printTime(" resolve symbols", statistics.startDylibs				 -	statistics.startResolver,			totalTime);
+			if ( options.resolveWhileParsing() )
+				printTime("  waiting for input", inputFiles._resolverStallTime,							totalTime);
 			printTime(" build atom list", statistics.startPasses				 -	statistics.startDylibs,				totalTime);
 			printTime(" passess", statistics.startOutput				 -	statistics.startPasses,				totalTime);
+			for (const auto& passTime : statistics.passTimes)
+				printTime((std::string("  ") + passTime.first).c_str(), passTime.second, totalTime);
 			printTime(" write output", statistics.startDone				 -	statistics.startOutput,				totalTime);
 			fprintf(stderr, "pageins=%u, pageouts=%u, faults=%u\n", 
 								statistics.vmEnd.pageins-statistics.vmStart.pageins,
@@ -1585,8 +1633,44 @@ int main(int argc, const char* argv[])
 			fprintf(stderr, "processed %3u object files,  totaling %15s bytes\n", inputFiles._totalObjectLoaded, commatize(inputFiles._totalObjectSize, temp));
 			fprintf(stderr, "processed %3u archive files, totaling %15s bytes\n", inputFiles._totalArchivesLoaded, commatize(inputFiles._totalArchiveSize, temp));
 			fprintf(stderr, "processed %3u dylib files\n", inputFiles._totalDylibsLoaded);
+			const ld::passes::fixup_index::Statistics& fixupStats = ld::passes::fixup_index::statistics();
+			fprintf(stderr, "fixup index: %llu atoms, %llu fixups; atoms walked by stubs: %llu, got: %llu, tlvp: %llu, dylibs: %llu, dedup: %llu\n",
+							fixupStats.atoms, fixupStats.fixups, fixupStats.stubable, fixupStats.got, fixupStats.tlv,
+							fixupStats.toProxy, fixupStats.toAutoHideCode);
+			{
+				uint64_t hits, misses;
+				mach_o::relocatable::compactUnwindMemoStatistics(hits, misses);
+				fprintf(stderr, "dwarf to compact unwind: %llu memo hits, %llu misses\n", hits, misses);
+			}
+			if ( options.objectCachePath() != NULL ) {
+				uint32_t hits, misses;
+				mach_o::relocatable::objectCacheStatistics(hits, misses);
+				fprintf(stderr, "object file cache: %u hits, %u misses\n", hits, misses);
+			}
+			if ( options.tbdCachePath() != NULL ) {
+				uint32_t hits, misses;
+				uint64_t timeSaved;
+				textstub::dylib::interfaceCacheStatistics(hits, misses, timeSaved);
+				fprintf(stderr, "text-stub cache: %u hits, %u misses\n", hits, misses);
+				printTime("text-stub time saved", timeSaved, totalTime);
+			}
+			if ( options.speculativeArchiveParsing() ) {
+				uint32_t used, wasted;
+				archive::speculativeParseStatistics(used, wasted);
+				fprintf(stderr, "speculative archive member parses: %u used, %u wasted\n", used, wasted);
+			}
+			if ( options.directoryCache() ) {
+				uint32_t directoriesRead;
+				uint64_t callsAvoided;
+				options.directoryCacheStatistics(directoriesRead, callsAvoided);
+				fprintf(stderr, "directory cache: %u directories read, %llu file system calls avoided\n", directoriesRead, callsAvoided);
+			}
 			fprintf(stderr, "wrote output file            totaling %15s bytes\n", commatize(out.fileSize(), temp));
 		}
+		if ( options.traceJSONPath() != NULL ) {
+			if ( !ld::trace::write(options.traceJSONPath()) )
+				warning("could not write -trace_json file %s, errno=%d", options.traceJSONPath(), errno);
+		}
 		// <rdar://problem/6780050> Would like linker warning to be build error.
 		if ( options.errorBecauseOfWarnings() ) {
 			fprintf(stderr, "ld: fatal warning(s) induced error (-fatal_warnings)\n");
@@ -611,6 +611,8 @@ namespace dylib {
 		virtual bool						installPathVersionSpecific() const { return false; }
 		virtual bool						appExtensionSafe() const = 0;
 		virtual void						forEachExportedSymbol(void (^handler)(const char* symbolName, bool weakDef)) const = 0;
+		virtual void						forEachReExportedDylib(void (^handler)(const ld::dylib::File* reExportedDylib)) const { }
+		virtual bool						exportsLookedUpInPlace() const { return false; }
 		virtual bool						hasReExportedDependentsThatProvidedExportAtom() const { return false; }
 		virtual bool						isUnzipperedTwin() const { return false; }
 
@@ -645,6 +647,11 @@ namespace archive {
 												: ld::File(pth, modTime, ord, Archive) { }
 		virtual								~File() {}
 		virtual bool						justInTimeDataOnlyforEachAtom(const char* name, AtomHandler&) const = 0;
+		virtual void						forEachTableOfContentsSymbol(void (^handler)(const char* symbolName)) const = 0;
+		// start parsing in the background the members that would be loaded for these names
+		virtual void						speculativelyParseMembers(const std::vector<const char*>& names) const { }
+		// wait for, or cancel, background parses that were never used
+		virtual void						finishSpeculativeParses() const { }
 	};
 } // namespace archive 
 
@@ -1192,6 +1199,9 @@ public:
 								symbolTableInAndNeverStrip, symbolTableInAsAbsolute, 
 								symbolTableInWithRandomAutoStripLabel };
 	enum WeakImportState { weakImportUnset, weakImportTrue, weakImportFalse };
+	// which passes need to look at this atom's fixups, see ld::passes::fixup_index
+	enum FixupSummary { fixupsStubable=0x01, fixupsGOT=0x02, fixupsTLV=0x04, fixupsToProxy=0x08,
+						fixupsToAutoHideCode=0x10, fixupsUnindexed=0xFF };
 	
 	struct Alignment { 
 					Alignment(int p2, int m=0) : powerOf2(p2), modulus(m) {}
@@ -1221,8 +1231,9 @@ public:
 													_contentType(ct), _symbolTableInclusion(i),
 													_scope(s), _mode(modeSectionOffset), 
 													_overridesADylibsWeakDef(false), _coalescedAway(false),
-													_live(false), _dontDeadStripIfRefLive(false), _cold(cold),
-													_machoSection(0), _weakImportState(weakImportUnset)
+													_dontDeadStripIfRefLive(false), _cold(cold),
+													_machoSection(0), _weakImportState(weakImportUnset), _live(false),
+													_fixupSummary(fixupsUnindexed)
 													 {
 													#ifndef NDEBUG
 														switch ( _combine ) {
@@ -1273,6 +1284,10 @@ public:
 	void									setDontDeadStripIfReferencesLive() { _dontDeadStripIfRefLive = true; }
 	void									setLive()					{ _live = true; }
 	void									setLive(bool value)			{ _live = value; }
+	// for marking from several threads at once, returns true if this call made the atom live
+	bool									setLiveConcurrently()		{ return !__atomic_exchange_n(&_live, true, __ATOMIC_RELAXED); }
+	bool									mayHaveFixups(uint8_t summaryBits) const { return ((_fixupSummary & summaryBits) != 0); }
+	void									setFixupSummary(uint8_t summaryBits) { _fixupSummary = summaryBits; }
 	void									setMachoSection(unsigned x) { assert(x != 0); assert(x < 256); _machoSection = x; }
 	void									setSectionOffset(uint64_t o){ assert(_mode == modeSectionOffset); _address = o; _mode = modeSectionOffset; }
 	void									setSectionStartAddress(uint64_t a) { assert(_mode == modeSectionOffset); _address += a; _mode = modeFinalAddress; }
@@ -1366,11 +1381,12 @@ protected:
 	AddressMode							_mode: 2;
 	bool								_overridesADylibsWeakDef : 1;
 	bool								_coalescedAway : 1;
-	bool								_live : 1;
 	bool								_dontDeadStripIfRefLive : 1;
 	bool								_cold : 1;
 	unsigned							_machoSection : 8;
 	WeakImportState						_weakImportState : 2;
+	bool								_live;		// not a bitfield, so it can be set atomically
+	uint8_t								_fixupSummary;
 };
 
 
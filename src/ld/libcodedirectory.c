@@ -172,6 +172,10 @@ struct _libcd {
     bool linkage_set;
     uint8_t linkage_hash_type;
     uint8_t linkage_hash[CS_CDHASH_LEN];
+
+    // pages hashed before serialization, see libcd_hash_page()
+    uint8_t *page_hashes;
+    bool *page_hashed;
 };
 
 #if LIBCD_LOG_OS_LOG
@@ -418,6 +422,8 @@ libcd_free (libcd *s)
         }
         free(s->hash_types);
         free(s->cdhashes);
+        free(s->page_hashes);
+        free(s->page_hashed);
 
         libcd_reset_write_method(s);
         libcd_reset_read_method(s);
@@ -492,6 +498,11 @@ libcd_set_hash_types (libcd *s, int const hash_types[], unsigned int count)
 {
     free(s->hash_types);
     s->hash_types = NULL;
+    // page hashes are laid out per hash type
+    free(s->page_hashes);
+    s->page_hashes = NULL;
+    free(s->page_hashed);
+    s->page_hashed = NULL;
 
     for (unsigned int i = 0; i < count; i++) {
         if (_libcd_get_hash_info(hash_types[i]) == NULL) {
@@ -771,6 +782,60 @@ libcd_cd_size (libcd *s, uint32_t hash_type)
     return si;
 }
 
+static size_t
+_libcd_page_count (libcd *s)
+{
+    return (s->image_size + _cs_page_bytes-1) >> _cs_page_shift;
+}
+
+static uint8_t *
+_libcd_page_hash_slot (libcd *s, unsigned int hash_type_idx, size_t page_idx)
+{
+    return s->page_hashes + ((size_t)hash_type_idx * _libcd_page_count(s) + page_idx) * _max_known_hash_len;
+}
+
+void
+libcd_prepare_page_hashes (libcd *s)
+{
+    const size_t page_count = _libcd_page_count(s);
+
+    free(s->page_hashes);
+    free(s->page_hashed);
+    s->page_hashes = calloc(page_count * s->hash_types_count, _max_known_hash_len);
+    s->page_hashed = calloc(page_count, sizeof(bool));
+}
+
+enum libcd_serialize_ret
+libcd_hash_page (libcd *s, size_t page_idx, uint8_t const *page_data)
+{
+    const size_t page_count = _libcd_page_count(s);
+
+    if (s->page_hashed == NULL || s->page_hashes == NULL) {
+        _libcd_err("page hashes not prepared");
+        return LIBCD_SERIALIZE_NO_MEM;
+    }
+    if (page_idx >= page_count) {
+        _libcd_err("page %zu out of range (pages: %zu)", page_idx, page_count);
+        return LIBCD_SERIALIZE_READ_PAGE_ERROR;
+    }
+
+    const size_t pos = page_idx * _cs_page_bytes;
+    const size_t len = pos + _cs_page_bytes > s->image_size ? s->image_size-pos : _cs_page_bytes;
+
+    for (unsigned int i = 0; i < s->hash_types_count; i++) {
+        struct _hash_info const *hi = _libcd_get_hash_info(s->hash_types[i]);
+        struct ccdigest_info const *di = hi->di();
+        ccdigest_di_decl(di, ctx);
+
+        ccdigest_init(di, ctx);
+        ccdigest_update(di, ctx, len, page_data);
+        ccdigest_final(di, ctx, _libcd_page_hash_slot(s, i, page_idx));
+    }
+    s->page_hashed[page_idx] = true;
+
+    return LIBCD_SERIALIZE_SUCCESS;
+}
+
 static enum libcd_serialize_ret
 _libcd_hash_page(libcd *s,
                  size_t page_idx,
@@ -781,6 +846,15 @@ _libcd_hash_page(libcd *s,
     uint8_t page_hash[_max_known_hash_len] = {0};
     const unsigned int page_no = (unsigned int)page_idx;
 
+    if (s->page_hashed != NULL && s->page_hashed[page_idx]) {
+        for (unsigned int i = 0; i < s->hash_types_count; i++) {
+            if (_libcd_get_hash_info(s->hash_types[i]) == hi) {
+                memcpy(hash_destination, _libcd_page_hash_slot(s, i, page_idx), hi->hash_len);
+                return LIBCD_SERIALIZE_SUCCESS;
+            }
+        }
+    }
+
     struct ccdigest_info const *di = hi->di();
     ccdigest_di_decl(di, ctx);
 
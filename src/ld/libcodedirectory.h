@@ -100,6 +100,12 @@ enum libcd_serialize_ret {
 enum libcd_serialize_ret libcd_serialize_as_type (libcd *s, uint32_t type);
 enum libcd_serialize_ret libcd_serialize (libcd *s);
 
+// Pages can be hashed as soon as their content is final, instead of being read back
+// during serialization. Call libcd_prepare_page_hashes() after the hash types are set.
+// Different pages may be hashed concurrently, a hashed page must not change afterwards.
+void libcd_prepare_page_hashes (libcd *s);
+enum libcd_serialize_ret libcd_hash_page (libcd *s, size_t page_idx, uint8_t const *page_data);
+
 enum libcd_cdhash_ret {
     LIBCD_CDHASH_SUCCESS,
     LIBCD_CDHASH_INVALID_BUFFER,
@@ -30,6 +30,11 @@
 #include <ar.h>
 
 #include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dispatch/dispatch.h>
 
 #include "MachOFileAbstraction.hpp"
 #include "Architectures.hpp"
@@ -38,9 +43,13 @@
 #include "lto_file.h"
 #include "archive_file.h"
 #include "Containers.h"
+#include "Trace.h"
 
 namespace archive {
 
+static std::atomic<uint32_t> sSpeculativeParsesStarted(0);
+static std::atomic<uint32_t> sSpeculativeParsesUsed(0);
+
 
 // forward reference
 template <typename A> class File;
@@ -73,7 +82,7 @@ public:
 													File(const uint8_t* fileContent, uint64_t fileLength,
 															const char* pth, time_t modTime, 
 															ld::File::Ordinal ord, const ParserOptions& opts);
-	virtual											~File() {}
+	virtual											~File();
 
 	// overrides of ld::File
 	virtual bool										forEachAtom(ld::File::AtomHandler&) const;
@@ -82,6 +91,9 @@ public:
 	
 	// overrides of ld::archive::File
 	virtual bool										justInTimeDataOnlyforEachAtom(const char* name, ld::File::AtomHandler& handler) const;
+	virtual void										forEachTableOfContentsSymbol(void (^handler)(const char* symbolName)) const;
+	virtual void										speculativelyParseMembers(const std::vector<const char*>& names) const;
+	virtual void										finishSpeculativeParses() const;
 
 private:
 	friend bool isArchiveFile(const uint8_t* fileContent, uint64_t fileLength, ld::Platform* platform, const char** archiveArchName);
@@ -107,6 +119,15 @@ private:
 	};
 
 	struct MemberState { ld::relocatable::File* file; const Entry *entry; bool logged; bool loaded; uint32_t index;};
+	struct SpeculativeParse {
+		SpeculativeParse() : done(dispatch_semaphore_create(0)), cancelled(false), file(NULL), error(NULL) { }
+		dispatch_semaphore_t										done;
+		std::atomic<bool>											cancelled;
+		ld::relocatable::File*										file;
+		const char*													error;
+		std::vector<std::string>									warnings;		// emitted only if the parse is used
+		std::vector<mach_o::relocatable::DeferredObjectCacheEntry>	cacheEntries;	// written only if the parse is used
+	};
 	bool											loadMember(MemberState& state, ld::File::AtomHandler& handler, const char *format, ...) const;
 
 	using NameToOffsetMap = ld::StringViewMap<uint64_t>;
@@ -115,8 +136,13 @@ private:
 	typedef typename A::P::E						E;
 
 	typedef std::map<const class Entry*, MemberState> MemberToStateMap;
+	typedef std::unordered_map<const class Entry*, SpeculativeParse*> MemberToSpeculativeParseMap;
 
+	MemberState&									stateForMember(const Entry* member) const;
 	MemberState&									makeObjectFileForMember(const Entry* member) const;
+	void											makeObjectFilesForMembers(const std::vector<const Entry*>& members) const;
+	ld::relocatable::File*							parseMember(const Entry* member, uint32_t memberIndex,
+																SpeculativeParse* speculative=NULL) const;
 	bool											memberHasObjCCategories(const Entry* member) const;
 	void											dumpTableOfContents();
 	void											buildHashTable();
@@ -132,6 +158,7 @@ private:
 	uint32_t										_tableOfContentCount;
 	const char*										_tableOfContentStrings;
 	mutable MemberToStateMap						_instantiatedEntries;
+	mutable MemberToSpeculativeParseMap				_speculativeParses;		// only accessed on the resolver thread
 	NameToOffsetMap									_hashTable;
 	const LibraryOptions::ArchiveLoadMode			_loadMode;
 	const bool										_objc2ABI;
@@ -327,6 +354,7 @@ File<A>::File(const uint8_t fileContent[], uint64_t fileLength, const char* pth,
 	if ( _loadMode != LibraryOptions::ArchiveLoadMode::lazy ) {
 		// parse all .o files in archive
 		// do this now while ld is multithreaded
+		std::vector<const Entry*> members;
 		const Entry* const start = (Entry*)&_archiveFileContent[8];
 		const Entry* const end = (Entry*)&_archiveFileContent[_archiveFilelength];
 		for (const Entry* p=start; p < end; p = p->next()) {
@@ -340,12 +368,20 @@ File<A>::File(const uint8_t fileContent[], uint64_t fileLength, const char* pth,
 #endif
 			// don't instantiate bitcode files with -ObjC because instantiation has side effect of merging into LTO
 			if ( _loadMode == LibraryOptions::ArchiveLoadMode::forceLoad || !validLTOFile(p->content(), p->contentSize(), _objOpts) )
-				this->makeObjectFileForMember(p);
+				members.push_back(p);
 		}
+		this->makeObjectFilesForMembers(members);
 	}
 
 }
 
+template <typename A>
+File<A>::~File()
+{
+	// background parses reference this file
+	this->finishSpeculativeParses();
+}
+
 template <>
 bool File<x86>::memberHasObjCCategories(const Entry* member) const
 {
@@ -371,36 +407,168 @@ bool File<A>::memberHasObjCCategories(const Entry* member) const
 
 
 template <typename A>
-typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* member) const
+typename File<A>::MemberState& File<A>::stateForMember(const Entry* member) const
 {
-	uint32_t memberIndex = 0;
 	// in case member was instantiated earlier but not needed yet
 	typename MemberToStateMap::iterator pos = _instantiatedEntries.find(member);
-	if ( pos == _instantiatedEntries.end() ) {
-		// Have to find the index of this member
-		const Entry* start;
-		uint32_t index;
-		if (_instantiatedEntries.size() == 0) {
-			start = (Entry*)&_archiveFileContent[8];
-			index = 1;
-		} else {
-			MemberState &lastKnown = _instantiatedEntries.rbegin()->second;
-			start = lastKnown.entry->next();
-			index = lastKnown.index+1;
+	if ( pos != _instantiatedEntries.end() )
+		return pos->second;
+
+	// Have to find the index of this member
+	const Entry* start;
+	uint32_t index;
+	if (_instantiatedEntries.size() == 0) {
+		start = (Entry*)&_archiveFileContent[8];
+		index = 1;
+	} else {
+		MemberState &lastKnown = _instantiatedEntries.rbegin()->second;
+		start = lastKnown.entry->next();
+		index = lastKnown.index+1;
+	}
+	for (const Entry* p=start; p <= member; p = p->next(), index++) {
+		MemberState state = {NULL, p, false, false, index};
+		_instantiatedEntries[p] = state;
+	}
+	return _instantiatedEntries[member];
+}
+
+template <typename A>
+typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* member) const
+{
+	MemberState& state = this->stateForMember(member);
+	if ( state.file == NULL ) {
+		auto pos = _speculativeParses.find(member);
+		if ( pos != _speculativeParses.end() ) {
+			// member was already parsed, or is being parsed, in the background
+			SpeculativeParse* parse = pos->second;
+			_speculativeParses.erase(pos);
+			dispatch_semaphore_wait(parse->done, DISPATCH_TIME_FOREVER);
+			dispatch_release(parse->done);
+			++sSpeculativeParsesUsed;
+			// the parse is used now, so do what it held back
+			if ( _logAllFiles && (parse->file != NULL) )
+				printf("%s\n", parse->file->path());
+			for (const std::string& msg : parse->warnings)
+				warning("%s", msg.c_str());
+			if ( parse->error == NULL )
+				mach_o::relocatable::storeDeferredObjectCacheEntries(parse->cacheEntries);
+			ld::relocatable::File* file = parse->file;
+			const char* error = parse->error;
+			delete parse;
+			if ( error != NULL )
+				throw error;
+			state.file = file;
 		}
-		for (const Entry* p=start; p <= member; p = p->next(), index++) {
-			MemberState state = {NULL, p, false, false, index};
-			_instantiatedEntries[p] = state;
-			if (member == p) {
-				memberIndex = index;
+		else {
+			state.file = this->parseMember(member, state.index);
+		}
+	}
+	return state;
+}
+
+//
+// The resolver calls this with names that are still undefined, before searching libraries for
+// them.  Members that would be loaded for those names are parsed on worker threads, so that by
+// the time justInTimeforEachAtom() needs one its parse is done or under way.  Nothing is
+// loaded here, and a parse has no visible effect (-t output, warnings, object cache entries)
+// until makeObjectFileForMember() uses it.  A member whose parse is never asked for is dropped
+// by finishSpeculativeParses().
+//
+template <typename A>
+void File<A>::speculativelyParseMembers(const std::vector<const char*>& names) const
+{
+	if ( (_loadMode != LibraryOptions::ArchiveLoadMode::lazy) || _alreadyLoadedAll )
+		return;
+	for (const char* name : names) {
+		const auto& pos = _hashTable.find(name);
+		if ( pos == _hashTable.end() )
+			continue;
+		const Entry* member = (Entry*)&_archiveFileContent[pos->second];
+		if ( _speculativeParses.count(member) != 0 )
+			continue;
+		// a corrupt member is diagnosed when it is actually needed
+		if ( (member > (Entry*)(_archiveFileContent+_archiveFilelength))
+			|| ((member->content() + member->contentSize()) > (_archiveFileContent+_archiveFilelength)) )
+			continue;
+		// bitcode members are not parsed early, because instantiating them adds them to the LTO module
+		if ( !validMachOFile(member->content(), member->contentSize(), _objOpts) )
+			continue;
+		MemberState& state = this->stateForMember(member);
+		if ( state.file != NULL )
+			continue;
+		SpeculativeParse* parse = new SpeculativeParse();
+		_speculativeParses[member] = parse;
+		++sSpeculativeParsesStarted;
+		const uint32_t memberIndex = state.index;
+		dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+			if ( !parse->cancelled ) {
+				captureThreadWarnings(&parse->warnings);
+				try {
+					parse->file = this->parseMember(member, memberIndex, parse);
+				}
+				catch (const char* msg) {
+					parse->error = msg;
+				}
+				captureThreadWarnings(NULL);
 			}
+			dispatch_semaphore_signal(parse->done);
+		});
+	}
+}
+
+template <typename A>
+void File<A>::finishSpeculativeParses() const
+{
+	// parses not yet started are skipped, the rest are waited for
+	for (auto& entry : _speculativeParses)
+		entry.second->cancelled = true;
+	for (auto& entry : _speculativeParses) {
+		dispatch_semaphore_wait(entry.second->done, DISPATCH_TIME_FOREVER);
+		dispatch_release(entry.second->done);
+		delete entry.second;
+	}
+	_speculativeParses.clear();
+}
+
+template <typename A>
+void File<A>::makeObjectFilesForMembers(const std::vector<const Entry*>& members) const
+{
+	// assign every member its state up front, so _instantiatedEntries is not modified while parsing
+	std::vector<MemberState*> toParse;
+	for (const Entry* member : members) {
+		MemberState& state = this->stateForMember(member);
+		if ( state.file == NULL )
+			toParse.push_back(&state);
+	}
+	if ( toParse.empty() )
+		return;
+	std::sort(toParse.begin(), toParse.end(), [](const MemberState* a, const MemberState* b) { return a->index < b->index; });
+	toParse.erase(std::unique(toParse.begin(), toParse.end()), toParse.end());
+
+	// members are independent, so parse them concurrently and keep the first error in member order
+	std::vector<ld::relocatable::File*> files(toParse.size(), NULL);
+	std::vector<const char*> errors(toParse.size(), NULL);
+	MemberState* const* states = toParse.data();
+	ld::relocatable::File** parsed = files.data();
+	const char** parseErrors = errors.data();
+	ld::trace::apply("parse archive member", toParse.size(), ^(size_t index) {
+		try {
+			parsed[index] = this->parseMember(states[index]->entry, states[index]->index);
 		}
-	} else {
-		MemberState& state = pos->second;
-		if (state.file)
-			return state;
-		memberIndex = state.index;
+		catch (const char* msg) {
+			parseErrors[index] = msg;
+		}
+	});
+	for (size_t i=0; i < toParse.size(); ++i) {
+		if ( errors[i] != NULL )
+			throw errors[i];
+		toParse[i]->file = files[i];
 	}
+}
+
+template <typename A>
+ld::relocatable::File* File<A>::parseMember(const Entry* member, uint32_t memberIndex, SpeculativeParse* speculative) const
+{
 	assert(memberIndex != 0);
 	char memberName[256];
 	member->getName(memberName, sizeof(memberName));
@@ -409,6 +577,8 @@ typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* mem
 	strcat(memberPath, "(");
 	strcat(memberPath, memberName);
 	strcat(memberPath, ")");
+	ld::trace::Scope traceScope("archive member", memberPath);
+	traceScope.counter("bytes", member->contentSize());
 	//fprintf(stderr, "using %s from %s\n", memberName, this->path());
 	try {
 		// range check
@@ -419,23 +589,23 @@ typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* mem
 		const char* mPath = strdup(memberPath);
 		// see if member is mach-o file
 		ld::File::Ordinal ordinal = this->ordinal().archiveOrdinalWithMemberIndex(memberIndex);
+		mach_o::relocatable::ParserOptions objOpts = _objOpts;
+		objOpts.fileIdentity.memberOffset = (uint8_t*)member - _archiveFileContent;
+		if ( speculative != NULL ) {
+			objOpts.logAllFiles = false;
+			objOpts.deferredCacheEntries = &speculative->cacheEntries;
+		}
 		ld::relocatable::File* result = mach_o::relocatable::parse(member->content(), member->contentSize(), 
 																	mPath, member->modificationTime(), 
-																	ordinal, _objOpts);
-		if ( result != NULL ) {
-			MemberState state = {result, member, false, false, memberIndex};
-			_instantiatedEntries[member] = state;
-			return _instantiatedEntries[member];
-		}
+																	ordinal, objOpts);
+		if ( result != NULL )
+			return result;
 		// see if member is llvm bitcode file
 		result = lto::parse(member->content(), member->contentSize(), 
 								mPath, member->modificationTime(), ordinal, 
 								_objOpts.architecture, _objOpts.subType, _logAllFiles, _objOpts.verboseOptimizationHints);
-		if ( result != NULL ) {
-			MemberState state = {result, member, false, false, memberIndex};
-			_instantiatedEntries[member] = state;
-			return _instantiatedEntries[member];
-		}
+		if ( result != NULL )
+			return result;
 			
 		throwf("archive member '%s' with length %d is not mach-o or llvm bitcode", memberName, member->contentSize());
 	}
@@ -470,6 +640,7 @@ bool File<A>::forEachAtom(ld::File::AtomHandler& handler) const
 	bool didSome = false;
 	if ( _loadMode == LibraryOptions::ArchiveLoadMode::forceLoad ) {
 		// call handler on all .o files in this archive
+		std::vector<const Entry*> members;
 		const Entry* const start = (Entry*)&_archiveFileContent[8];
 		const Entry* const end = (Entry*)&_archiveFileContent[_archiveFilelength];
 		for (const Entry* p=start; p < end; p = p->next()) {
@@ -481,29 +652,32 @@ bool File<A>::forEachAtom(ld::File::AtomHandler& handler) const
 			if ( (p==start) && ((strcmp(memberName, SYMDEF_64_SORTED) == 0) || (strcmp(memberName, SYMDEF_64) == 0)) )
 				continue;
 #endif
-			typename MemberToStateMap::iterator pos = _instantiatedEntries.find(p);
-			if ( pos == _instantiatedEntries.end() )
-				this->makeObjectFileForMember(p);
+			members.push_back(p);
+		}
+		// parse whatever the constructor did not concurrently, but load members in archive order
+		this->makeObjectFilesForMembers(members);
+		for (const Entry* p : members) {
+			char memberName[256];
+			p->getName(memberName, sizeof(memberName));
 			didSome |= loadMember(_instantiatedEntries[p], handler, "forced load of %s(%s)\n", this->path(), memberName);
 		}
 		_alreadyLoadedAll = true;
 	}
 	else if ( _loadMode == LibraryOptions::ArchiveLoadMode::objc ) {
 		// call handler on all .o files in this archive containing objc classes
+		std::vector<const Entry*> classMembers;
 		for (const auto& entry : _hashTable) {
-			if ( entry.first.starts_with(".objc_c") || entry.first.starts_with("_OBJC_CLASS_$_") ) {
-				const Entry* member = (Entry*)&_archiveFileContent[entry.second];
-				typename MemberToStateMap::iterator pos = _instantiatedEntries.find(member);
-				if ( pos == _instantiatedEntries.end() )
-					this->makeObjectFileForMember(member);
-				else if ( pos->second.file == nullptr )
-					this->makeObjectFileForMember(member);
-				char memberName[256];
-				member->getName(memberName, sizeof(memberName));
-				didSome |= loadMember(_instantiatedEntries[member], handler, "-ObjC forced load of %s(%s)\n", this->path(), memberName);
-			}
+			if ( entry.first.starts_with(".objc_c") || entry.first.starts_with("_OBJC_CLASS_$_") )
+				classMembers.push_back((Entry*)&_archiveFileContent[entry.second]);
+		}
+		this->makeObjectFilesForMembers(classMembers);
+		for (const Entry* member : classMembers) {
+			char memberName[256];
+			member->getName(memberName, sizeof(memberName));
+			didSome |= loadMember(_instantiatedEntries[member], handler, "-ObjC forced load of %s(%s)\n", this->path(), memberName);
 		}
 		// ObjC2 has no symbols in .o files with categories but not classes, look deeper for those
+		std::vector<const Entry*> members;
 		const Entry* const start = (Entry*)&_archiveFileContent[8];
 		const Entry* const end = (Entry*)&_archiveFileContent[_archiveFilelength];
 		for (const Entry* member=start; member < end; member = member->next()) {
@@ -516,17 +690,34 @@ bool File<A>::forEachAtom(ld::File::AtomHandler& handler) const
 			if ( (member==start) && ((strcmp(mname, SYMDEF_64_SORTED) == 0) || (strcmp(mname, SYMDEF_64) == 0)) )
 				continue;
 #endif
-			if ( validMachOFile(member->content(), member->contentSize(), _objOpts) ) {
+			members.push_back(member);
+		}
+		// scan the mach-o members for categories concurrently
+		enum { kNotMachO, kMachO, kMachOWithCategories };
+		std::vector<uint8_t> memberKinds(members.size(), kNotMachO);
+		const Entry* const* memberList = members.data();
+		uint8_t* kinds = memberKinds.data();
+		ld::trace::apply("scan archive member", members.size(), ^(size_t index) {
+			const Entry* member = memberList[index];
+			if ( validMachOFile(member->content(), member->contentSize(), _objOpts) )
+				kinds[index] = this->memberHasObjCCategories(member) ? kMachOWithCategories : kMachO;
+		});
+		std::vector<const Entry*> machoMembers;
+		for (size_t i=0; i < members.size(); ++i) {
+			if ( memberKinds[i] != kNotMachO )
+				machoMembers.push_back(members[i]);
+		}
+		this->makeObjectFilesForMembers(machoMembers);
+		for (size_t i=0; i < members.size(); ++i) {
+			const Entry* member = members[i];
+			if ( memberKinds[i] != kNotMachO ) {
 				MemberState& state = this->makeObjectFileForMember(member);
 				// only look at files not already loaded
 				if ( ! state.loaded ) {
-					if ( this->memberHasObjCCategories(member) ) {
-						typename MemberToStateMap::iterator pos = _instantiatedEntries.find(member);
-						if ( pos == _instantiatedEntries.end() )
-							this->makeObjectFileForMember(member);
+					if ( memberKinds[i] == kMachOWithCategories ) {
 						char memberName[256];
 						member->getName(memberName, sizeof(memberName));
-						didSome |= loadMember(_instantiatedEntries[member], handler, "-ObjC forced load of %s(%s)\n", this->path(), memberName);
+						didSome |= loadMember(state, handler, "-ObjC forced load of %s(%s)\n", this->path(), memberName);
 					}
 				}
 			}
@@ -646,6 +837,14 @@ bool File<A>::justInTimeDataOnlyforEachAtom(const char* name, ld::File::AtomHand
 	return false;
 }
 
+template <typename A>
+void File<A>::forEachTableOfContentsSymbol(void (^handler)(const char* symbolName)) const
+{
+	// table of content strings are zero terminated, so the keys can be used as C strings
+	for (const auto& entry : _hashTable)
+		handler(entry.first.data());
+}
+
 template <typename A>
 void File<A>::buildHashTable()
 {
@@ -697,6 +896,12 @@ void File<A>::dumpTableOfContents()
 }
 
 
+void speculativeParseStatistics(uint32_t& used, uint32_t& wasted)
+{
+	used = sSpeculativeParsesUsed;
+	wasted = sSpeculativeParsesStarted - sSpeculativeParsesUsed;
+}
+
 //
 // main function used by linker to instantiate archive files
 //
@@ -43,6 +43,8 @@ extern ld::archive::File* parse(const uint8_t* fileContent, uint64_t fileLength,
 
 extern bool isArchiveFile(const uint8_t* fileContent, uint64_t fileLength, ld::Platform* platform, const char** archiveArchName);
 
+extern void speculativeParseStatistics(uint32_t& used, uint32_t& wasted);
+
 
 } // namespace archive
 
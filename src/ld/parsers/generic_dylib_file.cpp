@@ -121,11 +121,27 @@ File::File(const char* path, time_t mTime, ld::File::Ordinal ord, const ld::Vers
     }
 }
 
-std::pair<bool, bool> File::hasWeakDefinitionImpl(const char* name) const
+bool File::findExport(const char* name, AtomAndWeak& atom) const
 {
     const auto pos = _atoms.find(name);
-    if ( pos != this->_atoms.end() )
-        return std::make_pair(true, pos->second.weakDef);
+    if ( pos != _atoms.end() ) {
+        atom = pos->second;
+        return true;
+    }
+    if ( findExportInPlace(name, atom) ) {
+        if ( _s_logHashtable )
+            fprintf(stderr, "  adding %s to hash table for %s\n", name, this->path());
+        _atoms[strdup(name)] = atom;
+        return true;
+    }
+    return false;
+}
+
+std::pair<bool, bool> File::hasWeakDefinitionImpl(const char* name) const
+{
+    AtomAndWeak atom;
+    if ( findExport(name, atom) )
+        return std::make_pair(true, atom.weakDef);
 
     // look in re-exported libraries.
     for (const auto &dep : _dependentDylibs) {
@@ -140,8 +156,8 @@ std::pair<bool, bool> File::hasWeakDefinitionImpl(const char* name) const
 
 bool File::hasDefinitionImpl(const char* name) const
 {
-    const auto pos = _atoms.find(name);
-    if ( pos != this->_atoms.end() )
+    AtomAndWeak atom;
+    if ( findExport(name, atom) )
         return true;
 
     // look in re-exported libraries.
@@ -178,11 +194,8 @@ bool File::containsOrReExports(const char* name, AtomAndWeak& atom) const
         return false;
 
     // check myself
-    const auto pos = _atoms.find(name);
-    if ( pos != _atoms.end() ) {
-        atom = pos->second;
+    if ( findExport(name, atom) )
         return true;
-    }
 
     // check dylibs I re-export
     for (const auto& dep : _dependentDylibs) {
@@ -232,11 +245,20 @@ bool File::justInTimeforEachAtom(const char* name, ld::File::AtomHandler& handle
 
 void File::forEachExportedSymbol(void (^handler)(const char* symbolName, bool weakDef)) const
 {
+    const_cast<File*>(this)->addAllExports();
     for (const auto& entry : _atoms) {
         handler(entry.first, entry.second.weakDef);
     }
 }
 
+void File::forEachReExportedDylib(void (^handler)(const ld::dylib::File* reExportedDylib)) const
+{
+    for (const auto& dep : _dependentDylibs) {
+        if ( dep.reExport && (dep.dylib != nullptr) )
+            handler(dep.dylib);
+    }
+}
+
 File* File::createSyntheticDylib(const char* installName, uint32_t version) const {
     auto result = new File(this->path(), this->modificationTime(), this->ordinal(), _platforms, false, false, false, false, true);
     result->_dylibInstallPath                = installName;
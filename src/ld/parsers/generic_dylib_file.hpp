@@ -129,6 +129,7 @@ public:
 	virtual bool							installPathVersionSpecific() const override final { return _installPathOverride; }
 	virtual bool							appExtensionSafe() const override final	{ return _appExtensionSafe; };
     virtual void                            forEachExportedSymbol(void (^handler)(const char* symbolName, bool weakDef)) const override;
+    virtual void                            forEachReExportedDylib(void (^handler)(const ld::dylib::File* reExportedDylib)) const override;
     virtual bool						    isUnzipperedTwin() const override { return _isUnzipperedTwin; }
     File*                                   createSyntheticDylib(const char* insstallName, uint32_t version) const;
     void                                    addExportedSymbol(const ExportAtom*);
@@ -151,6 +152,11 @@ protected:
     };
 	struct ReExportChain { ReExportChain* prev; const File* file; };
 
+	// Subclasses that can look up a single export in place, without first adding every export
+	// to _atoms, override these.  Anything found is cached in _atoms.
+	virtual bool				findExportInPlace(const char* name, AtomAndWeak& atom) const { return false; }
+	virtual void				addAllExports() { }
+
 private:
 	using NameToAtomMap = ld::CStringMap<AtomAndWeak>;
 	using NameSet = ld::CStringSet;
@@ -158,6 +164,7 @@ private:
 	std::pair<bool, bool>		hasWeakDefinitionImpl(const char* name) const;
     bool                        hasDefinitionImpl(const char* name) const;
 	bool						containsOrReExports(const char* name, AtomAndWeak& atom) const;
+	bool						findExport(const char* name, AtomAndWeak& atom) const;
 	void						assertNoReExportCycles(ReExportChain*) const;
 
 protected:
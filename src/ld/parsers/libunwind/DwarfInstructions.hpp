@@ -36,6 +36,7 @@
 #include <algorithm>
 #include <vector>
 #include <unordered_set>
+#include <string>
 
 #include <libunwind.h>
 #include <mach-o/compact_unwind_encoding.h>
@@ -87,6 +88,18 @@ struct CFI_Atom_Info {
 
 typedef void (*WarnFunc)(void* ref, uint64_t funcAddr, const char* msg);  
 
+///
+/// Optional memo of compact unwind encodings converted from dwarf, shared by parseCFIs() callers.
+/// The key holds the CIE fields and the CIE and FDE instructions the conversion depends on.
+///
+class CompactUnwindMemo
+{
+public:
+	virtual			~CompactUnwindMemo() { }
+	virtual bool	lookup(const std::string& key, compact_unwind_encoding_t& encoding, char warningBuffer[1024]) = 0;
+	virtual void	add(const std::string& key, compact_unwind_encoding_t encoding, const char* warning) = 0;
+};
+
 ///
 /// DwarfInstructions maps abtract dwarf unwind instructions to a particular architecture
 ///  
@@ -100,7 +113,8 @@ public:
 	static const char* parseCFIs(A& addressSpace, pint_t ehSectionStart, uint32_t sectionLength, 
                             const ld::Set<pint_t>& cuStarts,
                             bool keepDwarfWhichHasCU, bool forceDwarfConversion, bool neverConvertToCU, bool canEncodeToDwarf,
-                            CFI_Atom_Info<A>* infos, uint32_t& infosCount, void* ref, WarnFunc warn);
+                            CFI_Atom_Info<A>* infos, uint32_t& infosCount, void* ref, WarnFunc warn,
+                            CompactUnwindMemo* memo=NULL);
 
 
 	static compact_unwind_encoding_t createCompactEncodingFromFDE(A& addressSpace, pint_t fdeStart, 
@@ -122,6 +136,7 @@ private:
 	static pint_t evaluateExpression(pint_t expression, A& addressSpace, const R& registers, pint_t initialStackValue);
 	static pint_t getSavedRegister(A& addressSpace, const R& registers, pint_t cfa, 
 										const typename CFI_Parser<A>::RegisterLocation& savedReg);
+	static void appendMemoKey(A& addressSpace, pint_t start, pint_t end, std::string& key);
 	static double getSavedFloatRegister(A& addressSpace, const R& registers, pint_t cfa, 
 										const typename CFI_Parser<A>::RegisterLocation& savedReg);
 	static v128 getSavedVectorRegister(A& addressSpace, const R& registers, pint_t cfa, 
@@ -134,6 +149,7 @@ private:
 
 	static uint32_t getEBPEncodedRegister(uint32_t reg, int32_t regOffsetFromBaseOffset, bool& failure);
 	static compact_unwind_encoding_t encodeToUseDwarf(const Registers_x86&);
+	static bool   encodingReadsFunction(const typename CFI_Parser<A>::PrologInfo& prolog, const Registers_x86&);
 	static compact_unwind_encoding_t createCompactEncodingFromProlog(A& addressSpace, pint_t funcAddr,
 												const Registers_x86&, const typename CFI_Parser<A>::PrologInfo& prolog,
 												char warningBuffer[1024]);
@@ -145,6 +161,7 @@ private:
 
 	static uint32_t getRBPEncodedRegister(uint32_t reg, int32_t regOffsetFromBaseOffset, bool& failure);
 	static compact_unwind_encoding_t encodeToUseDwarf(const Registers_x86_64&);
+	static bool   encodingReadsFunction(const typename CFI_Parser<A>::PrologInfo& prolog, const Registers_x86_64&);
 	static compact_unwind_encoding_t createCompactEncodingFromProlog(A& addressSpace, pint_t funcAddr,
 												const Registers_x86_64&, const typename CFI_Parser<A>::PrologInfo& prolog,
 												char warningBuffer[1024]);
@@ -154,6 +171,7 @@ private:
 	static bool   isReturnAddressRegister(int regNum, const Registers_ppc&);
 	static pint_t getCFA(A& addressSpace, const typename CFI_Parser<A>::PrologInfo& prolog, const Registers_ppc&);
 	static compact_unwind_encoding_t encodeToUseDwarf(const Registers_ppc&);
+	static bool   encodingReadsFunction(const typename CFI_Parser<A>::PrologInfo&, const Registers_ppc&) { return false; }
 	static compact_unwind_encoding_t createCompactEncodingFromProlog(A& addressSpace, pint_t funcAddr,
 												const Registers_ppc&, const typename CFI_Parser<A>::PrologInfo& prolog,
 												char warningBuffer[1024]);
@@ -165,6 +183,7 @@ private:
 	static bool checkRegisterPair(uint32_t reg, const typename CFI_Parser<A>::PrologInfo& prolog,
 												int& offset, char warningBuffer[1024]);
 	static compact_unwind_encoding_t encodeToUseDwarf(const Registers_arm64&);
+	static bool   encodingReadsFunction(const typename CFI_Parser<A>::PrologInfo&, const Registers_arm64&) { return false; }
 	static compact_unwind_encoding_t createCompactEncodingFromProlog(A& addressSpace, pint_t funcAddr,
 												const Registers_arm64&, const typename CFI_Parser<A>::PrologInfo& prolog,
 												char warningBuffer[1024]);
@@ -173,6 +192,7 @@ private:
 	static bool   isReturnAddressRegister(int regNum, const Registers_arm&);
 	static pint_t getCFA(A& addressSpace, const typename CFI_Parser<A>::PrologInfo& prolog, const Registers_arm&);
 	static compact_unwind_encoding_t encodeToUseDwarf(const Registers_arm&);
+	static bool   encodingReadsFunction(const typename CFI_Parser<A>::PrologInfo&, const Registers_arm&) { return false; }
 	static compact_unwind_encoding_t createCompactEncodingFromProlog(A& addressSpace, pint_t funcAddr,
 												const Registers_arm&, const typename CFI_Parser<A>::PrologInfo& prolog,
 												char warningBuffer[1024]);
@@ -186,10 +206,14 @@ template <typename A, typename R>
 const char* DwarfInstructions<A,R>::parseCFIs(A& addressSpace, pint_t ehSectionStart, uint32_t sectionLength, 
                                       const ld::Set<pint_t>& cuStarts,
                                       bool keepDwarfWhichHasCU,  bool forceDwarfConversion, bool neverConvertToCU, bool canEncodeToDwarf,
-                                      CFI_Atom_Info<A>* infos, uint32_t& infosCount, void* ref, WarnFunc warn)
+                                      CFI_Atom_Info<A>* infos, uint32_t& infosCount, void* ref, WarnFunc warn,
+                                      CompactUnwindMemo* memo)
 {
 	const bool encodeToDwarf = neverConvertToCU || (canEncodeToDwarf && !forceDwarfConversion);
 	typename CFI_Parser<A>::CIE_Info cieInfo;
+	std::string memoKey;
+	std::string cieMemoKey;
+	pint_t cieMemoKeyStart = CFI_INVALID_ADDRESS;
 	CFI_Atom_Info<A>* entry = infos;
 	CFI_Atom_Info<A>* end = &infos[infosCount];
 	const pint_t ehSectionEnd = ehSectionStart + sectionLength;
@@ -299,9 +323,33 @@ const char* DwarfInstructions<A,R>::parseCFIs(A& addressSpace, pint_t ehSectionS
 					fdeInfo.lsda = entry->u.fdeInfo.lsda.targetAddress;
 					typename CFI_Parser<A>::PrologInfo prolog;
 					R dummy; // for proper selection of architecture specific functions
-					if ( CFI_Parser<A>::parseFDEInstructions(addressSpace, fdeInfo, cieInfo, CFI_INVALID_ADDRESS, &prolog) ) {
-						char warningBuffer[1024];
-						entry->u.fdeInfo.compactUnwindInfo = createCompactEncodingFromProlog(addressSpace, fdeInfo.pcStart, dummy, prolog, warningBuffer);
+					char warningBuffer[1024];
+					compact_unwind_encoding_t encoding;
+					bool memoized = false;
+					if ( memo != NULL ) {
+						// the conversion only depends on the CIE and FDE instructions, which many functions share
+						if ( cieInfo.cieStart != cieMemoKeyStart ) {
+							cieMemoKey.clear();
+							cieMemoKey.append((char*)&cieInfo.codeAlignFactor, sizeof(cieInfo.codeAlignFactor));
+							cieMemoKey.append((char*)&cieInfo.dataAlignFactor, sizeof(cieInfo.dataAlignFactor));
+							cieMemoKey.push_back(cieInfo.pointerEncoding);
+							cieMemoKey.push_back(cieInfo.isSignalFrame);
+							uint32_t cieInstructionsLength = cieInfo.cieStart + cieInfo.cieLength - cieInfo.cieInstructions;
+							cieMemoKey.append((char*)&cieInstructionsLength, sizeof(cieInstructionsLength));
+							appendMemoKey(addressSpace, cieInfo.cieInstructions, cieInfo.cieStart + cieInfo.cieLength, cieMemoKey);
+							cieMemoKeyStart = cieInfo.cieStart;
+						}
+						memoKey = cieMemoKey;
+						appendMemoKey(addressSpace, p, nextCFI, memoKey);
+						memoized = memo->lookup(memoKey, encoding, warningBuffer);
+					}
+					if ( memoized || CFI_Parser<A>::parseFDEInstructions(addressSpace, fdeInfo, cieInfo, CFI_INVALID_ADDRESS, &prolog) ) {
+						if ( !memoized ) {
+							encoding = createCompactEncodingFromProlog(addressSpace, fdeInfo.pcStart, dummy, prolog, warningBuffer);
+							if ( (memo != NULL) && !encodingReadsFunction(prolog, dummy) )
+								memo->add(memoKey, encoding, warningBuffer);
+						}
+						entry->u.fdeInfo.compactUnwindInfo = encoding;
 						if ( fdeInfo.lsda != CFI_INVALID_ADDRESS ) 
 							entry->u.fdeInfo.compactUnwindInfo |= UNWIND_HAS_LSDA;
 						if ( warningBuffer[0] != '\0' )
@@ -328,6 +376,14 @@ const char* DwarfInstructions<A,R>::parseCFIs(A& addressSpace, pint_t ehSectionS
 
 
 
+template <typename A, typename R>
+void DwarfInstructions<A,R>::appendMemoKey(A& addressSpace, pint_t start, pint_t end, std::string& key)
+{
+	for (pint_t p=start; p < end; ++p)
+		key.push_back(addressSpace.get8(p));
+}
+
+
 template <typename A, typename R>
 compact_unwind_encoding_t DwarfInstructions<A,R>::createCompactEncodingFromFDE(A& addressSpace, pint_t fdeStart, 
 																		pint_t* lsda, pint_t* personality,
@@ -1004,6 +1060,21 @@ compact_unwind_encoding_t DwarfInstructions<A,R>::encodeToUseDwarf(const Registe
 	return UNWIND_X86_MODE_DWARF;
 }
 
+// stack sizes too large for the immediate field are checked against the function's sub instruction
+template <typename A, typename R>
+bool DwarfInstructions<A,R>::encodingReadsFunction(const typename CFI_Parser<A>::PrologInfo& prolog, const Registers_x86_64&) 
+{
+	uint64_t stackValue = prolog.cfaRegisterOffset / 8;
+	return ( stackValue > EXTRACT_BITS(0xFFFFFFFF,UNWIND_X86_64_FRAMELESS_STACK_SIZE) );
+}
+
+template <typename A, typename R>
+bool DwarfInstructions<A,R>::encodingReadsFunction(const typename CFI_Parser<A>::PrologInfo& prolog, const Registers_x86&) 
+{
+	uint64_t stackValue = prolog.cfaRegisterOffset / 4;
+	return ( stackValue > EXTRACT_BITS(0xFFFFFFFF,UNWIND_X86_FRAMELESS_STACK_SIZE) );
+}
+
 
 
 template <typename A, typename R>
@@ -50,6 +50,7 @@
 #include "lto_file.h"
 #include "SymbolTable.h"
 #include "Containers.h"
+#include "Trace.h"
 
 #include "llvm-c/lto.h"
 
@@ -845,6 +846,7 @@ std::tuple<uint8_t *, size_t> Parser::codegen(const OptimizeOptions& options,
 											  ld::Internal&			 state,
 											  lto_code_gen_t		 generator,
 											  std::string&           object_path) {
+	ld::trace::Scope traceScope("lto", "LTO codegen");
 	uint8_t *machOFile;
 	size_t machOFileLen;
 
@@ -930,6 +932,7 @@ std::tuple<uint8_t *, size_t> Parser::codegen(const OptimizeOptions& options,
 			::lto_codegen_write_merged_modules(generator, tempOptBitcodePath);
 		}
 	}
+	traceScope.counter("bytes", machOFileLen);
 
 	// if requested, save off temp mach-o file
 	if ( options.saveTemps ) {
@@ -1362,6 +1365,7 @@ bool Parser::optimizeThinLTO(const std::vector<File*>&              files,
 #endif
 
 	// run code generator
+	ld::trace::Scope traceScope("lto", "ThinLTO codegen");
 	thinlto_codegen_process(thingenerator);
 
 	unsigned numObjects;
@@ -1371,6 +1375,7 @@ bool Parser::optimizeThinLTO(const std::vector<File*>&              files,
 	else
 #endif
 		numObjects = thinlto_module_get_num_objects(thingenerator);
+	traceScope.counter("objects", numObjects);
 	if ( numObjects == 0 )
 		throwf("could not do ThinLTO codegen (thinlto_codegen_process didn't produce any object): '%s', using libLTO version '%s'", ::lto_get_error_message(), ::lto_get_version());
 
@@ -1494,6 +1499,8 @@ bool Parser::optimize(  const std::vector<const ld::Atom*>&	allAtoms,
 	// exit quickly if nothing to do
 	if ( _s_files.size() == 0 )
 		return false;
+	ld::trace::Scope traceScope("lto", "LTO optimize");
+	traceScope.counter("modules", _s_files.size());
 
 	// print out LTO version string if -v was used
 	if ( options.verbose )
@@ -66,9 +66,17 @@ public:
 													bool allowSimToMacOSX, bool addVers,  bool buildingForSimulator,
 													bool logAllFiles, const char* installPath,
 													bool indirectDylib, bool usingBitcode, bool internalSDK,
-													bool fromSDK, bool platformMismatchesAreWarning);
+													bool fromSDK, bool platformMismatchesAreWarning, bool lazyExports);
 	virtual									~File() noexcept {}
 
+	// overrides of ld::dylib::File
+	virtual bool							exportsLookedUpInPlace() const override { return (_exportsStart != nullptr); }
+
+protected:
+	// overrides of generic::dylib::File
+	virtual bool							findExportInPlace(const char* name, AtomAndWeak& atom) const override;
+	virtual void							addAllExports() override;
+
 private:
 	using P = typename A::P;
 	using E = typename A::P::E;
@@ -77,6 +85,8 @@ private:
 	void				addDyldFastStub();
 	void				buildExportHashTableFromExportInfo(uint32_t exportsOffset, uint32_t exportsSize,
 															const uint8_t* fileContent);
+	void				keepExportInfoMapped(uint32_t exportsOffset, uint32_t exportsSize,
+											 const uint8_t* fileContent);
 	void				buildExportHashTableFromSymbolTable(const macho_dysymtab_command<P>* dynamicInfo,
 														const macho_nlist<P>* symbolTable, const char* strings,
 														const uint8_t* fileContent);
@@ -85,8 +95,12 @@ private:
 	static const char*	objCInfoSectionName();
 
 
-	uint64_t  _fileLength;
-	uint32_t  _linkeditStartOffset;
+	uint64_t		_fileLength;
+	uint32_t		_linkeditStartOffset;
+	const uint8_t*	_exportsStart;
+	const uint8_t*	_exportsEnd;
+	uint8_t*		_exportsMapping;
+	size_t			_exportsMappingSize;
 
 };
 
@@ -104,9 +118,10 @@ File<A>::File(const uint8_t* fileContent, uint64_t fileLength, const char* path,
 			  bool hoistImplicitPublicDylibs, const ld::VersionSet& cmdLinePlatforms, bool allowWeakImports,
 			  bool allowSimToMacOSX, bool addVers, bool buildingForSimulator, bool logAllFiles,
 			  const char* targetInstallPath, bool indirectDylib, bool usingBitcode, bool internalSDK,
-			  bool fromSDK, bool platformMismatchesAreWarning)
+			  bool fromSDK, bool platformMismatchesAreWarning, bool lazyExports)
 	: Base(strdup(path), mTime, ord, cmdLinePlatforms, allowWeakImports, linkingFlatNamespace,
-		   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers), _fileLength(fileLength), _linkeditStartOffset(0)
+		   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers), _fileLength(fileLength), _linkeditStartOffset(0),
+		   _exportsStart(nullptr), _exportsEnd(nullptr), _exportsMapping(nullptr), _exportsMappingSize(0)
 {
 	const macho_header<P>* header = (const macho_header<P>*)fileContent;
 	const uint32_t cmd_count = header->ncmds();
@@ -402,8 +417,16 @@ File<A>::File(const uint8_t* fileContent, uint64_t fileLength, const char* path,
 		this->_importAtom = new generic::dylib::ImportAtom(*this, importNames);
 	}
 
-	// build hash table
-	if ( dyldInfo != nullptr )
+	// build hash table, or keep the export trie to look names up in place
+	if ( lazyExports && (dyldInfo != nullptr) ) {
+		keepExportInfoMapped(dyldInfo->export_off(), dyldInfo->export_size(), fileContent);
+		return;
+	}
+	else if ( lazyExports && (exportsTrie != nullptr) ) {
+		keepExportInfoMapped(exportsTrie->dataoff(), exportsTrie->datasize(), fileContent);
+		return;
+	}
+	else if ( dyldInfo != nullptr )
 		buildExportHashTableFromExportInfo(dyldInfo->export_off(), dyldInfo->export_size(), fileContent);
 	else if ( exportsTrie != nullptr )
 		buildExportHashTableFromExportInfo(exportsTrie->dataoff(), exportsTrie->datasize(), fileContent);
@@ -469,6 +492,95 @@ void File<A>::buildExportHashTableFromExportInfo(uint32_t exportsOffset, uint32_
 	}
 }
 
+//
+// Large dylibs export far more symbols than any one link uses, so instead of adding every export
+// to the hash table, the pages holding the export trie stay mapped and names are looked up in the
+// trie when first asked for.  The $ld$ meta-data symbols change how other exports are seen, so those
+// are processed now.  The rest of the file is unmapped.
+//
+template <typename A>
+void File<A>::keepExportInfoMapped(uint32_t exportsOffset, uint32_t exportsSize, const uint8_t* fileContent)
+{
+	if ( ((uint64_t)exportsOffset + (uint64_t)exportsSize) > _fileLength )
+		throwf("malformed mach-o dylib, exports trie extends beyond end of file");
+	if ( exportsSize == 0 ) {
+		munmap((caddr_t)fileContent, _fileLength);
+		return;
+	}
+	_exportsStart = fileContent + exportsOffset;
+	_exportsEnd   = &_exportsStart[exportsSize];
+
+	// slices that are not page aligned in a fat file cannot be partially unmapped
+	const uintptr_t pageMask = ::getpagesize() - 1;
+	if ( ((uintptr_t)fileContent & pageMask) == 0 ) {
+		uint8_t* mapEnd = (uint8_t*)(((uintptr_t)fileContent + _fileLength + pageMask) & ~pageMask);
+		_exportsMapping = (uint8_t*)((uintptr_t)_exportsStart & ~pageMask);
+		uint8_t* exportsMappingEnd = (uint8_t*)(((uintptr_t)_exportsEnd + pageMask) & ~pageMask);
+		_exportsMappingSize = exportsMappingEnd - _exportsMapping;
+		if ( _exportsMapping > fileContent )
+			munmap((caddr_t)fileContent, _exportsMapping - fileContent);
+		if ( mapEnd > exportsMappingEnd )
+			munmap((caddr_t)exportsMappingEnd, mapEnd - exportsMappingEnd);
+	}
+	else {
+		_exportsMapping = (uint8_t*)fileContent;
+		_exportsMappingSize = _fileLength;
+	}
+
+	if ( this->_s_logHashtable )
+		fprintf(stderr, "ld: keeping export trie of %u bytes mapped for %s\n", exportsSize, this->path());
+	std::vector<mach_o::trie::Entry> list;
+	parseTrieWithPrefix(_exportsStart, _exportsEnd, "$ld$", list);
+	for (const auto &entry : list)
+		this->addSymbol(entry.name,
+						entry.flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION,
+						(entry.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL,
+						entry.address);
+}
+
+template <typename A>
+bool File<A>::findExportInPlace(const char* name, AtomAndWeak& atom) const
+{
+	if ( _exportsStart == nullptr )
+		return false;
+	// all $ld$ symbols were processed when the dylib was loaded
+	if ( strncmp(name, "$ld$", 4) == 0 )
+		return false;
+	if ( this->_ignoreExports.count(name) != 0 )
+		return false;
+	mach_o::trie::Entry entry;
+	if ( !findTrieEntry(_exportsStart, _exportsEnd, name, entry) )
+		return false;
+	atom = { nullptr, (entry.flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION) != 0,
+			 (entry.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL,
+			 (pint_t)entry.address, nullptr, 0 };
+	return true;
+}
+
+template <typename A>
+void File<A>::addAllExports()
+{
+	if ( _exportsStart == nullptr )
+		return;
+	if ( this->_s_logHashtable )
+		fprintf(stderr, "ld: building hashtable from export trie in %s\n", this->path());
+	std::vector<mach_o::trie::Entry> list;
+	parseTrie(_exportsStart, _exportsEnd, list);
+	for (const auto &entry : list) {
+		if ( strncmp(entry.name, "$ld$", 4) == 0 )
+			continue;
+		this->addSymbol(entry.name,
+						entry.flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION,
+						(entry.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL,
+						entry.address);
+	}
+	munmap((caddr_t)_exportsMapping, _exportsMappingSize);
+	_exportsStart = nullptr;
+	_exportsEnd = nullptr;
+	_exportsMapping = nullptr;
+	_exportsMappingSize = 0;
+}
+
 template <typename A>
 void File<A>::addSymbol(const char* name, bool weakDef, bool tlv, pint_t address)
 {
@@ -584,7 +696,7 @@ public:
 						   opts.allowSimulatorToLinkWithMacOSX(), opts.addVersionLoadCommand(),
 						   opts.targetIOSSimulator(), opts.logAllFiles(), opts.installPath(),
 						   indirectDylib, opts.bundleBitcode(), opts.internalSDK(), fromSDK,
-						   opts.platformMismatchesAreWarning());
+						   opts.platformMismatchesAreWarning(), opts.lazyDylibExports());
 	}
 
 };
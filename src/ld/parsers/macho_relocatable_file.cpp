@@ -28,9 +28,15 @@
 #include <math.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/statvfs.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <CommonCrypto/CommonDigest.h>
 
 #include "MachOFileAbstraction.hpp"
 
@@ -41,8 +47,11 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <type_traits>
+#include <atomic>
+#include <string>
 
 #include "dwarf2.h"
 #include "debugline.h"
@@ -1007,6 +1016,261 @@ private:
 ld::Section AliasAtom::_s_section("__LD", "__aliases", ld::Section::typeTempAlias, true);
 
 
+//
+// Support for -cache_path_objects.  Turning relocations into fixups and running libunwind
+// over __eh_frame are the expensive parts of parsing a .o file.  Both are a pure function
+// of the file content and the parser options, so the results are saved in a cache entry
+// named by a SHA256 of those inputs.  Atoms are still built from the symbol table on every
+// link, so an entry only stores fixups (with atom targets as indexes into the file's atom
+// array and by-name targets as offsets into the file content) and the CFI parse results.
+//
+// Hashing the content of every .o on every link is itself a cost, so a second, tiny entry
+// keyed by the file's path, size, modification time and inode holds the name of its content
+// entry.  The content is only hashed when that identity entry is missing or stale.
+//
+struct ObjectCacheHeader {
+	enum { kMagic = 0x6f6c646c, kVersion = 1 };
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	atomCount;
+	uint32_t	fixupCount;
+	uint32_t	cfiParsedCount;	// CFI count before parsing __eh_frame
+	uint32_t	cfiCount;		// CFI count after parsing __eh_frame
+	uint32_t	cfiSize;
+	uint32_t	reserved;
+	// followed by fixup count of each atom, then the fixups, then the CFI infos
+};
+
+static std::atomic<uint32_t> sObjectCacheHits(0);
+static std::atomic<uint32_t> sObjectCacheMisses(0);
+
+class ObjectCacheEntry
+{
+public:
+								ObjectCacheEntry() : _content(NULL), _size(0) { }
+								~ObjectCacheEntry() { unload(); }
+
+	bool						load(const char* path, uint32_t cfiSize);
+	void						unload();
+	bool						loaded() const		{ return (_content != NULL); }
+	const ObjectCacheHeader*	header() const		{ return (ObjectCacheHeader*)_content; }
+	const uint32_t*				fixupCounts() const	{ return (uint32_t*)&_content[sizeof(ObjectCacheHeader)]; }
+	const ld::Fixup*			fixups() const		{ return (ld::Fixup*)&fixupCounts()[header()->atomCount]; }
+	const uint8_t*				cfis() const		{ return (uint8_t*)&fixups()[header()->fixupCount]; }
+
+	static void					makePath(const ParserOptions& opts, const uint8_t* fileContent, uint64_t fileLength,
+											size_t atomSize, size_t cfiSize, char path[PATH_MAX]);
+	static bool					makeIdentityPath(const ParserOptions& opts, size_t atomSize, size_t cfiSize, char path[PATH_MAX]);
+	static bool					readIdentity(const char* cachePath, const char* identityPath, char path[PATH_MAX]);
+	static void					storeIdentity(const char* identityPath, const char* path,
+												std::vector<DeferredObjectCacheEntry>* deferred);
+	static void					store(const char* path, const ObjectCacheHeader& header, const uint32_t* fixupCounts,
+										const ld::Fixup* fixups, const void* cfis,
+										std::vector<DeferredObjectCacheEntry>* deferred);
+	static void					write(const char* path, const std::vector<uint8_t>& buffer);
+private:
+	static uint64_t				entrySize(const ObjectCacheHeader& header) {
+									return sizeof(ObjectCacheHeader) + header.atomCount*sizeof(uint32_t)
+										+ header.fixupCount*sizeof(ld::Fixup) + (uint64_t)header.cfiCount*header.cfiSize;
+								}
+
+	const uint8_t*				_content;
+	size_t						_size;
+};
+
+static const char kObjectCacheEntryPrefix[] = "ld64-obj-";
+
+static const char kObjectCacheIdentityPrefix[] = "ld64-obj-id-";	// pruned along with content entries
+
+static void addToHash(CC_SHA256_CTX& ctx, const void* p, size_t len)
+{
+	const uint8_t* bytes = (uint8_t*)p;
+	while ( len != 0 ) {
+		CC_LONG chunk = (CC_LONG)std::min(len, (size_t)0x40000000);
+		CC_SHA256_Update(&ctx, bytes, chunk);
+		bytes += chunk;
+		len -= chunk;
+	}
+}
+
+static void addParserOptionsToHash(CC_SHA256_CTX& ctx, const ParserOptions& opts, size_t atomSize, size_t cfiSize)
+{
+	extern const char ld_classicVersionString[];
+	auto add = [&](const void* p, size_t len) {
+		addToHash(ctx, p, len);
+	};
+	// anything that changes what the parser produces must be part of the key
+	add(ld_classicVersionString, strlen(ld_classicVersionString));
+	const uint32_t layout[] = { ObjectCacheHeader::kVersion, (uint32_t)atomSize, (uint32_t)cfiSize, (uint32_t)sizeof(ld::Fixup),
+								opts.architecture, opts.subType, (uint32_t)opts.srcKind, opts.maxDefaultCommonAlignment };
+	add(layout, sizeof(layout));
+	const bool flags[] = { opts.objSubtypeMustMatch, opts.warnUnwindConversionProblems, opts.keepDwarfUnwind,
+							opts.forceDwarfConversion, opts.neverConvertDwarf, opts.armUsesZeroCostExceptions,
+#if SUPPORT_ARCH_arm64e
+							opts.supportsAuthenticatedPointers,
+#endif
+							opts.treateBitcodeAsData, opts.usingBitcode, opts.internalSDK, opts.forceHidden,
+							opts.platformMismatchesAreWarning, opts.avoidMisalignedPointers };
+	add(flags, sizeof(flags));
+	CC_SHA256_CTX* ctxPtr = &ctx;
+	opts.platforms.forEach(^(ld::Platform platform, uint32_t minVersion, uint32_t sdkVersion, bool& stop) {
+		const uint32_t version[] = { (uint32_t)platform, minVersion, sdkVersion };
+		CC_SHA256_Update(ctxPtr, version, sizeof(version));
+	});
+}
+
+static void makeCacheEntryPath(const char* cachePath, const char* prefix, CC_SHA256_CTX& ctx, char path[PATH_MAX])
+{
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256_Final(digest, &ctx);
+	char* end = path + snprintf(path, PATH_MAX, "%s/%s", cachePath, prefix);
+	for (unsigned i=0; i < CC_SHA256_DIGEST_LENGTH; ++i) {
+		if ( end+3 > &path[PATH_MAX] )
+			break;
+		end += snprintf(end, 3, "%02x", digest[i]);
+	}
+}
+
+void ObjectCacheEntry::makePath(const ParserOptions& opts, const uint8_t* fileContent, uint64_t fileLength,
+								size_t atomSize, size_t cfiSize, char path[PATH_MAX])
+{
+	CC_SHA256_CTX ctx;
+	CC_SHA256_Init(&ctx);
+	addParserOptionsToHash(ctx, opts, atomSize, cfiSize);
+	addToHash(ctx, &fileLength, sizeof(fileLength));
+	addToHash(ctx, fileContent, fileLength);
+	makeCacheEntryPath(opts.cachePath, kObjectCacheEntryPrefix, ctx, path);
+}
+
+bool ObjectCacheEntry::makeIdentityPath(const ParserOptions& opts, size_t atomSize, size_t cfiSize, char path[PATH_MAX])
+{
+	const ObjectFileIdentity& identity = opts.fileIdentity;
+	if ( identity.path == NULL )
+		return false;
+	CC_SHA256_CTX ctx;
+	CC_SHA256_Init(&ctx);
+	addParserOptionsToHash(ctx, opts, atomSize, cfiSize);
+	addToHash(ctx, identity.path, strlen(identity.path));
+	const uint64_t fields[] = { identity.device, identity.inode, identity.size, (uint64_t)identity.modTimeSec,
+								(uint64_t)identity.modTimeNSec, identity.memberOffset };
+	addToHash(ctx, fields, sizeof(fields));
+	makeCacheEntryPath(opts.cachePath, kObjectCacheIdentityPrefix, ctx, path);
+	return true;
+}
+
+// an identity entry holds the file name of a content entry in the same directory
+bool ObjectCacheEntry::readIdentity(const char* cachePath, const char* identityPath, char path[PATH_MAX])
+{
+	int fd = ::open(identityPath, O_RDONLY, 0);
+	if ( fd == -1 )
+		return false;
+	char name[NAME_MAX+1];
+	ssize_t len = ::read(fd, name, NAME_MAX);
+	::close(fd);
+	const size_t prefixLen = strlen(kObjectCacheEntryPrefix);
+	if ( (len <= (ssize_t)prefixLen) || (strncmp(name, kObjectCacheEntryPrefix, prefixLen) != 0) || (memchr(name, '/', len) != NULL) )
+		return false;
+	name[len] = '\0';
+	if ( snprintf(path, PATH_MAX, "%s/%s", cachePath, name) >= PATH_MAX )
+		return false;
+	// mark entry as recently used for pruning
+	::utimes(identityPath, NULL);
+	return true;
+}
+
+void ObjectCacheEntry::storeIdentity(const char* identityPath, const char* path, std::vector<DeferredObjectCacheEntry>* deferred)
+{
+	const char* name = strrchr(path, '/') + 1;
+	std::vector<uint8_t> buffer(name, name + strlen(name));
+	if ( deferred != NULL )
+		deferred->push_back({ identityPath, std::move(buffer) });
+	else
+		write(identityPath, buffer);
+}
+
+bool ObjectCacheEntry::load(const char* path, uint32_t cfiSize)
+{
+	int fd = ::open(path, O_RDONLY, 0);
+	if ( fd == -1 )
+		return false;
+	struct stat statBuffer;
+	if ( (::fstat(fd, &statBuffer) != 0) || (statBuffer.st_size < (off_t)sizeof(ObjectCacheHeader)) ) {
+		::close(fd);
+		return false;
+	}
+	void* p = ::mmap(NULL, statBuffer.st_size, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if ( p == (void*)(-1) )
+		return false;
+	_content = (uint8_t*)p;
+	_size = statBuffer.st_size;
+	const ObjectCacheHeader* hdr = header();
+	if ( (hdr->magic != ObjectCacheHeader::kMagic) || (hdr->version != ObjectCacheHeader::kVersion) || (hdr->cfiSize != cfiSize)
+	  || (hdr->cfiCount > hdr->cfiParsedCount) || (entrySize(*hdr) != _size) ) {
+		unload();
+		return false;
+	}
+	// mark entry as recently used for pruning
+	::utimes(path, NULL);
+	return true;
+}
+
+void ObjectCacheEntry::unload()
+{
+	if ( _content != NULL )
+		::munmap((void*)_content, _size);
+	_content = NULL;
+	_size = 0;
+}
+
+void ObjectCacheEntry::store(const char* path, const ObjectCacheHeader& header, const uint32_t* fixupCounts,
+							const ld::Fixup* fixups, const void* cfis, std::vector<DeferredObjectCacheEntry>* deferred)
+{
+	std::vector<uint8_t> buffer;
+	buffer.reserve(entrySize(header));
+	buffer.insert(buffer.end(), (uint8_t*)&header, (uint8_t*)&header + sizeof(ObjectCacheHeader));
+	buffer.insert(buffer.end(), (uint8_t*)fixupCounts, (uint8_t*)&fixupCounts[header.atomCount]);
+	buffer.insert(buffer.end(), (uint8_t*)fixups, (uint8_t*)&fixups[header.fixupCount]);
+	buffer.insert(buffer.end(), (uint8_t*)cfis, (uint8_t*)cfis + (uint64_t)header.cfiCount*header.cfiSize);
+	if ( deferred != NULL ) {
+		// parse result may never be used, so leave writing to whoever uses it
+		deferred->push_back({ path, std::move(buffer) });
+		return;
+	}
+	write(path, buffer);
+}
+
+void ObjectCacheEntry::write(const char* path, const std::vector<uint8_t>& buffer)
+{
+	// the cache is best effort, so any failure just leaves the entry out
+	char tempPath[PATH_MAX];
+	if ( snprintf(tempPath, PATH_MAX, "%s.XXXXXX", path) >= PATH_MAX )
+		return;
+	int fd = ::mkstemp(tempPath);
+	if ( (fd == -1) && (errno == ENOENT) ) {
+		// create cache directory on first use
+		std::string dir = path;
+		dir.erase(dir.rfind('/'));
+		::mkdir(dir.c_str(), 0777);
+		fd = ::mkstemp(tempPath);
+	}
+	if ( fd == -1 )
+		return;
+	bool written = (::write(fd, buffer.data(), buffer.size()) == (ssize_t)buffer.size());
+	::fchmod(fd, 0644);
+	::close(fd);
+	// rename is atomic so concurrent links never see a partial entry
+	if ( !written || (::rename(tempPath, path) != 0) )
+		::unlink(tempPath);
+}
+
+void storeDeferredObjectCacheEntries(const std::vector<DeferredObjectCacheEntry>& entries)
+{
+	for (const DeferredObjectCacheEntry& entry : entries)
+		ObjectCacheEntry::write(entry.path.c_str(), entry.content);
+}
+
+
 template <typename A>
 class Parser 
 {
@@ -1243,6 +1507,10 @@ private:
 															bool forceDwarfConversion, bool neverConvertDwarf,
 															bool verboseOptimizationHints);
 	ld::relocatable::File*							parse(const ParserOptions& opts);
+	bool											useCachedFixups(const ObjectCacheEntry& entry, const CFI_CU_InfoArrays& cus);
+	void											storeInObjectCache(const char* entryPath, uint32_t cfiParsedCount,
+																		const typename CFISection<A>::CFI_Atom_Info cfiArray[], uint32_t cfiCount,
+																		std::vector<DeferredObjectCacheEntry>* deferred);
 	static uint8_t									loadCommandSizeMask();
 	bool											parseLoadCommands(const ld::VersionSet& platforms, bool internalSDK);
 	void											makeSections();
@@ -1940,6 +2208,7 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 	// respond to -t option
 	if ( opts.logAllFiles )
 		printf("%s\n", _path);
+	const int warningsAtStart = threadWarningsCount();
 		
 	_armUsesZeroCostExceptions = opts.armUsesZeroCostExceptions;
 	_maxDefaultCommonAlignment = opts.maxDefaultCommonAlignment;
@@ -1988,15 +2257,42 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 	if ( _EHFrameSection != NULL )
 		countOfCFIs = _EHFrameSection->cfiCount(*this);
 	STACK_ALLOC_IF_SMALL(typename CFISection<A>::CFI_Atom_Info, cfiArray, countOfCFIs, 1024);
-	
+	const uint32_t cfiParsedCount = countOfCFIs;
+
+	// with -cache_path_objects, look for the __eh_frame parse and fixups of a previous link of the same content
+	// (but not with -verbose_optimization_hints, which logs while making fixups)
+	const bool useObjectCache = (opts.cachePath != NULL) && !_verboseOptimizationHints;
+	char cacheEntryPath[PATH_MAX];
+	ObjectCacheEntry cacheEntry;
+	if ( useObjectCache ) {
+		const size_t cfiSize = sizeof(typename CFISection<A>::CFI_Atom_Info);
+		// only hash the content if the file changed since a previous link, or was never seen
+		char identityPath[PATH_MAX];
+		const bool hasIdentity = ObjectCacheEntry::makeIdentityPath(opts, sizeof(Atom<A>), cfiSize, identityPath);
+		if ( !hasIdentity || !ObjectCacheEntry::readIdentity(opts.cachePath, identityPath, cacheEntryPath) || !cacheEntry.load(cacheEntryPath, cfiSize) ) {
+			ObjectCacheEntry::makePath(opts, _fileContent, _fileLength, sizeof(Atom<A>), cfiSize, cacheEntryPath);
+			cacheEntry.load(cacheEntryPath, cfiSize);
+			if ( hasIdentity )
+				ObjectCacheEntry::storeIdentity(identityPath, cacheEntryPath, opts.deferredCacheEntries);
+		}
+		if ( cacheEntry.loaded() && (cacheEntry.header()->cfiParsedCount != countOfCFIs) )
+			cacheEntry.unload();
+	}
+
 	// stack allocate (if not too large) a copy of __eh_frame to apply relocations to
 	uint32_t sectSize = 4;
-	if ( (countOfCFIs != 0) && _EHFrameSection->needsRelocating() ) 
+	if ( (countOfCFIs != 0) && _EHFrameSection->needsRelocating() && !cacheEntry.loaded() ) 
 		sectSize = _EHFrameSection->machoSection()->size()+4;
 	STACK_ALLOC_IF_SMALL(uint8_t, ehBuffer, sectSize, 50*1024);
 	uint32_t cfiStartsCount = 0;
 	if ( countOfCFIs != 0 ) {
-		_EHFrameSection->cfiParse(*this, ehBuffer, cfiArray, countOfCFIs, cuStarts, canEncodeToDwarf);
+		if ( cacheEntry.loaded() ) {
+			countOfCFIs = cacheEntry.header()->cfiCount;
+			memcpy(cfiArray, cacheEntry.cfis(), countOfCFIs*sizeof(typename CFISection<A>::CFI_Atom_Info));
+		}
+		else {
+			_EHFrameSection->cfiParse(*this, ehBuffer, cfiArray, countOfCFIs, cuStarts, canEncodeToDwarf);
+		}
 		// count functions and lsdas
 		for(uint32_t i=0; i < countOfCFIs; ++i) {
 			if ( cfiArray[i].isCIE )
@@ -2085,33 +2381,45 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 	assert( _file->_atomsArrayCount == computedAtomCount && "more atoms allocated than expected");
 
 	
-	// have each section add all fix-ups for its atoms
-	_allFixups.reserve(computedAtomCount*5);
-	for (uint32_t i=0; i < sectionsCount; ++i )
-		sections[i]->makeFixups(*this, cfis);
-	
-	// assign fixups start offset for each atom
-	uint8_t* p = _file->_atomsArray;
-	uint32_t fixupOffset = 0;
-	for(int i=_file->_atomsArrayCount; i > 0; --i) {
-		Atom<A>* atom = (Atom<A>*)p;
-		atom->_fixupsStartIndex = fixupOffset;
-		fixupOffset += atom->_fixupsCount;
-		atom->_fixupsCount = 0;
-		p += sizeof(Atom<A>);
+	if ( cacheEntry.loaded() && this->useCachedFixups(cacheEntry, cfis) ) {
+		++sObjectCacheHits;
 	}
-	assert(fixupOffset == _allFixups.size());
-	_file->_fixups.resize(fixupOffset);
-	
-	// copy each fixup for each atom 
-	for(typename std::vector<FixupInAtom>::iterator it=_allFixups.begin(); it != _allFixups.end(); ++it) {
-		uint32_t slot = it->atom->_fixupsStartIndex + it->atom->_fixupsCount;
-		_file->_fixups[slot] = it->fixup;
-		it->atom->_fixupsCount++;
+	else {
+		// have each section add all fix-ups for its atoms
+		_allFixups.reserve(computedAtomCount*5);
+		for (uint32_t i=0; i < sectionsCount; ++i )
+			sections[i]->makeFixups(*this, cfis);
+
+		// assign fixups start offset for each atom
+		uint8_t* p = _file->_atomsArray;
+		uint32_t fixupOffset = 0;
+		for(int i=_file->_atomsArrayCount; i > 0; --i) {
+			Atom<A>* atom = (Atom<A>*)p;
+			atom->_fixupsStartIndex = fixupOffset;
+			fixupOffset += atom->_fixupsCount;
+			atom->_fixupsCount = 0;
+			p += sizeof(Atom<A>);
+		}
+		assert(fixupOffset == _allFixups.size());
+		_file->_fixups.resize(fixupOffset);
+
+		// copy each fixup for each atom 
+		for(typename std::vector<FixupInAtom>::iterator it=_allFixups.begin(); it != _allFixups.end(); ++it) {
+			uint32_t slot = it->atom->_fixupsStartIndex + it->atom->_fixupsCount;
+			_file->_fixups[slot] = it->fixup;
+			it->atom->_fixupsCount++;
+		}
+
+		// done with temp vector
+		_allFixups.clear();
+
+		if ( useObjectCache ) {
+			++sObjectCacheMisses;
+			// a hit would not reissue warnings, so only cache files that parse cleanly
+			if ( threadWarningsCount() == warningsAtStart )
+				this->storeInObjectCache(cacheEntryPath, cfiParsedCount, cfiArray, countOfCFIs, opts.deferredCacheEntries);
+		}
 	}
-	
-	// done with temp vector
-	_allFixups.clear();
 
 	// add unwind info
 	_file->_unwindInfos.reserve(countOfFDEs+countOfCUs);
@@ -2175,6 +2483,118 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 	return _file;
 }
 
+template <typename A>
+bool Parser<A>::useCachedFixups(const ObjectCacheEntry& entry, const CFI_CU_InfoArrays& cus)
+{
+	const ObjectCacheHeader* header = entry.header();
+	if ( header->atomCount != _file->_atomsArrayCount )
+		return false;
+	const uint32_t* fixupCounts = entry.fixupCounts();
+	uint64_t totalFixups = 0;
+	for (uint32_t i=0; i < header->atomCount; ++i) {
+		if ( fixupCounts[i] >= (1 << Atom<A>::kFixupCountBits) )
+			return false;
+		totalFixups += fixupCounts[i];
+	}
+	if ( totalFixups != header->fixupCount )
+		return false;
+
+	// rebind cached fixups to this file's atoms and strings
+	_file->_fixups.resize(header->fixupCount);
+	const ld::Fixup* cachedFixups = entry.fixups();
+	for (uint32_t i=0; i < header->fixupCount; ++i) {
+		ld::Fixup& fixup = _file->_fixups[i];
+		fixup = cachedFixups[i];
+		switch ( fixup.binding ) {
+			case ld::Fixup::bindingByNameUnbound:
+				if ( fixup.u.addend >= _fileLength ) {
+					_file->_fixups.clear();
+					return false;
+				}
+				fixup.u.name = (char*)&_fileContent[fixup.u.addend];
+				break;
+			case ld::Fixup::bindingDirectlyBound:
+			case ld::Fixup::bindingByContentBound:
+				if ( fixup.u.addend >= header->atomCount ) {
+					_file->_fixups.clear();
+					return false;
+				}
+				fixup.u.target = (Atom<A>*)&_file->_atomsArray[fixup.u.addend*sizeof(Atom<A>)];
+				break;
+			default:
+				break;
+		}
+	}
+	uint8_t* p = _file->_atomsArray;
+	uint32_t fixupOffset = 0;
+	for (uint32_t i=0; i < header->atomCount; ++i) {
+		Atom<A>* atom = (Atom<A>*)p;
+		atom->_fixupsStartIndex = fixupOffset;
+		atom->_fixupsCount = fixupCounts[i];
+		fixupOffset += fixupCounts[i];
+		p += sizeof(Atom<A>);
+	}
+
+	// CUSection<A>::makeFixups() also binds each compact unwind entry to its function and lsda
+	for (uint32_t i=0; i < cus.cuCount; ++i) {
+		typename CUSection<A>::Info* info = &cus.cuArray[i];
+		info->function = findAtomByAddress(info->functionStartAddress);
+		if ( info->lsdaAddress != 0 )
+			info->lsda = findAtomByAddress(info->lsdaAddress);
+	}
+	return true;
+}
+
+template <typename A>
+void Parser<A>::storeInObjectCache(const char* entryPath, uint32_t cfiParsedCount,
+									const typename CFISection<A>::CFI_Atom_Info cfiArray[], uint32_t cfiCount,
+									std::vector<DeferredObjectCacheEntry>* deferred)
+{
+	ObjectCacheHeader header;
+	header.magic			= ObjectCacheHeader::kMagic;
+	header.version			= ObjectCacheHeader::kVersion;
+	header.atomCount		= _file->_atomsArrayCount;
+	header.fixupCount		= (uint32_t)_file->_fixups.size();
+	header.cfiParsedCount	= cfiParsedCount;
+	header.cfiCount			= cfiCount;
+	header.cfiSize			= sizeof(typename CFISection<A>::CFI_Atom_Info);
+	header.reserved			= 0;
+
+	std::vector<uint32_t> fixupCounts;
+	fixupCounts.reserve(header.atomCount);
+	const uint8_t* const atomsStart = _file->_atomsArray;
+	const uint8_t* const atomsEnd = &atomsStart[header.atomCount*sizeof(Atom<A>)];
+	for (const uint8_t* p = atomsStart; p < atomsEnd; p += sizeof(Atom<A>))
+		fixupCounts.push_back(((Atom<A>*)p)->_fixupsCount);
+
+	// replace pointers with offsets, giving up on any target that is not in this file
+	std::vector<ld::Fixup> fixups(_file->_fixups);
+	for (ld::Fixup& fixup : fixups) {
+		switch ( fixup.binding ) {
+			case ld::Fixup::bindingByNameUnbound: {
+				const uint8_t* name = (uint8_t*)fixup.u.name;
+				if ( (name < _fileContent) || (name >= &_fileContent[_fileLength]) )
+					return;
+				fixup.u.addend = name - _fileContent;
+				break;
+			}
+			case ld::Fixup::bindingDirectlyBound:
+			case ld::Fixup::bindingByContentBound: {
+				const uint8_t* target = (uint8_t*)fixup.u.target;
+				if ( (target < atomsStart) || (target >= atomsEnd) || (((target - atomsStart) % sizeof(Atom<A>)) != 0) )
+					return;
+				fixup.u.addend = (target - atomsStart) / sizeof(Atom<A>);
+				break;
+			}
+			case ld::Fixup::bindingsIndirectlyBound:
+				return;
+			default:
+				break;
+		}
+	}
+	ObjectCacheEntry::store(entryPath, header, fixupCounts.data(), fixups.data(), cfiArray, deferred);
+}
+
 template <> uint8_t Parser<x86>::loadCommandSizeMask()		{ return 0x03; }
 template <> uint8_t Parser<x86_64>::loadCommandSizeMask()	{ return 0x07; }
 template <> uint8_t Parser<arm>::loadCommandSizeMask()		{ return 0x03; }
@@ -4833,6 +5253,73 @@ uint32_t Section<A>::sectionNum(class Parser<A>& parser) const
 		return 1 + (this->_machOSection - parser.firstMachOSection());
 }
 
+//
+// C++ code has many functions whose CIE and FDE instructions are byte-identical, so converting
+// their dwarf unwind info to compact unwind is memoized across every object file parsed for an
+// architecture.  Parser threads share the memo, which is split into shards by key hash so they
+// rarely wait on each other.
+//
+static std::atomic<uint64_t> sCompactUnwindMemoHits(0);
+static std::atomic<uint64_t> sCompactUnwindMemoMisses(0);
+
+class CompactUnwindMemo : public libunwind::CompactUnwindMemo
+{
+public:
+								CompactUnwindMemo() {
+									for (unsigned i=0; i < kShardCount; ++i)
+										pthread_mutex_init(&_shards[i].lock, NULL);
+								}
+
+	virtual bool				lookup(const std::string& key, compact_unwind_encoding_t& encoding, char warningBuffer[1024]);
+	virtual void				add(const std::string& key, compact_unwind_encoding_t encoding, const char* warning);
+
+	template <typename A>
+	static CompactUnwindMemo*	forArch() { static CompactUnwindMemo memo; return &memo; }
+
+private:
+	struct Entry {
+		compact_unwind_encoding_t	encoding;
+		std::string					warning;
+	};
+	struct Shard {
+		pthread_mutex_t							lock;
+		std::unordered_map<std::string, Entry>	entries;
+	};
+	enum { kShardCount = 16 };
+
+	Shard&						shardFor(const std::string& key) { return _shards[std::hash<std::string>()(key) % kShardCount]; }
+
+	Shard						_shards[kShardCount];
+};
+
+bool CompactUnwindMemo::lookup(const std::string& key, compact_unwind_encoding_t& encoding, char warningBuffer[1024])
+{
+	Shard& shard = shardFor(key);
+	pthread_mutex_lock(&shard.lock);
+	std::unordered_map<std::string, Entry>::const_iterator pos = shard.entries.find(key);
+	bool found = (pos != shard.entries.end());
+	if ( found ) {
+		encoding = pos->second.encoding;
+		strlcpy(warningBuffer, pos->second.warning.c_str(), 1024);
+	}
+	pthread_mutex_unlock(&shard.lock);
+	if ( found )
+		++sCompactUnwindMemoHits;
+	else
+		++sCompactUnwindMemoMisses;
+	return found;
+}
+
+void CompactUnwindMemo::add(const std::string& key, compact_unwind_encoding_t encoding, const char* warning)
+{
+	Shard& shard = shardFor(key);
+	pthread_mutex_lock(&shard.lock);
+	Entry& entry = shard.entries[key];
+	entry.encoding = encoding;
+	entry.warning = warning;
+	pthread_mutex_unlock(&shard.lock);
+}
+
 // arm does not have zero cost exceptions
 template <> 
 uint32_t CFISection<arm>::cfiCount(Parser<arm>& parser) 
@@ -4959,7 +5446,7 @@ void CFISection<x86_64>::cfiParse(class Parser<x86_64>& parser, uint8_t* buffer,
 	msg = libunwind::DwarfInstructions<OAS, libunwind::Registers_x86_64>::parseCFIs(
 							oas, this->_machOSection->addr(), this->_machOSection->size(), 
 							cuStarts, parser.keepDwarfUnwind(), parser.forceDwarfConversion(), parser.neverConvertDwarf(), canEncodeToDwarf,
-							cfiArray, count, (void*)&parser, warnFunc);
+							cfiArray, count, (void*)&parser, warnFunc, CompactUnwindMemo::forArch<x86_64>());
 	if ( msg != NULL ) 
 		throwf("malformed __eh_frame section: %s", msg);
 }
@@ -4977,7 +5464,7 @@ void CFISection<x86>::cfiParse(class Parser<x86>& parser, uint8_t* buffer,
 	msg = libunwind::DwarfInstructions<OAS, libunwind::Registers_x86>::parseCFIs(
 							oas, this->_machOSection->addr(), this->_machOSection->size(), 
 							cuStarts, parser.keepDwarfUnwind(), parser.forceDwarfConversion(), parser.neverConvertDwarf(), canEncodeToDwarf,
-							cfiArray, count, (void*)&parser, warnFunc);
+							cfiArray, count, (void*)&parser, warnFunc, CompactUnwindMemo::forArch<x86>());
 	if ( msg != NULL ) 
 		throwf("malformed __eh_frame section: %s", msg);
 }
@@ -5003,7 +5490,7 @@ void CFISection<arm>::cfiParse(class Parser<arm>& parser, uint8_t* buffer,
 	msg = libunwind::DwarfInstructions<OAS, libunwind::Registers_arm>::parseCFIs(
 							oas, this->_machOSection->addr(), this->_machOSection->size(), 
 							cuStarts, parser.keepDwarfUnwind(), parser.forceDwarfConversion(), parser.neverConvertDwarf(), canEncodeToDwarf,
-							cfiArray, count, (void*)&parser, warnFunc);
+							cfiArray, count, (void*)&parser, warnFunc, CompactUnwindMemo::forArch<arm>());
 	if ( msg != NULL ) 
 		throwf("malformed __eh_frame section: %s", msg);
 }
@@ -5073,7 +5560,7 @@ void CFISection<arm64>::cfiParse(class Parser<arm64>& parser, uint8_t* buffer,
 	msg = libunwind::DwarfInstructions<OAS, libunwind::Registers_arm64>::parseCFIs(
 							oas, this->_machOSection->addr(), this->_machOSection->size(), 
 							cuStarts, parser.keepDwarfUnwind(), parser.forceDwarfConversion(), parser.neverConvertDwarf(), canEncodeToDwarf,
-							cfiArray, count, (void*)&parser, warnFunc);
+							cfiArray, count, (void*)&parser, warnFunc, CompactUnwindMemo::forArch<arm64>());
 	if ( msg != NULL ) 
 		throwf("malformed __eh_frame section: %s", msg);
 }
@@ -5140,7 +5627,7 @@ void CFISection<arm64_32>::cfiParse(class Parser<arm64_32>& parser, uint8_t* buf
 	msg = libunwind::DwarfInstructions<OAS, libunwind::Registers_arm64>::parseCFIs(
 							oas, this->_machOSection->addr(), this->_machOSection->size(), 
 							cuStarts, parser.keepDwarfUnwind(), parser.forceDwarfConversion(), parser.neverConvertDwarf(), canEncodeToDwarf,
-							cfiArray, count, (void*)&parser, warnFunc);
+							cfiArray, count, (void*)&parser, warnFunc, CompactUnwindMemo::forArch<arm64_32>());
 	if ( msg != NULL ) 
 		throwf("malformed __eh_frame section: %s", msg);
 }
@@ -9422,6 +9909,88 @@ bool getNonLocalSymbols(const uint8_t* fileContent, std::vector<const char*> &sy
 	return false;
 }
 
+//
+// Used by -print_statistics to report -cache_path_objects effectiveness
+//
+void objectCacheStatistics(uint32_t& hits, uint32_t& misses)
+{
+	hits = sObjectCacheHits;
+	misses = sObjectCacheMisses;
+}
+
+//
+// Used by -print_statistics to report how often dwarf to compact unwind conversions were shared
+//
+void compactUnwindMemoStatistics(uint64_t& hits, uint64_t& misses)
+{
+	hits = sCompactUnwindMemoHits;
+	misses = sCompactUnwindMemoMisses;
+}
+
+//
+// Removes -cache_path_objects entries not used recently, then trims the cache to a percentage of free space
+//
+void pruneObjectCache(const char* cachePath, int interval, int after, unsigned maxRelativeSize)
+{
+	pruneCache(cachePath, kObjectCacheEntryPrefix, interval, after, maxRelativeSize);
+}
+
+//
+// Prunes the entries whose names start with entryPrefix from a cache directory
+//
+void pruneCache(const char* cachePath, const char* entryPrefix, int interval, int after, unsigned maxRelativeSize)
+{
+	if ( interval < 0 )
+		return;
+
+	// only prune once per interval
+	const time_t now = ::time(NULL);
+	std::string timestampPath = std::string(cachePath) + "/" + entryPrefix + "timestamp";
+	struct stat statBuffer;
+	if ( (interval != 0) && (::stat(timestampPath.c_str(), &statBuffer) == 0) && ((now - statBuffer.st_mtime) < interval) )
+		return;
+	int fd = ::open(timestampPath.c_str(), O_WRONLY | O_CREAT, 0644);
+	if ( fd == -1 )
+		return;
+	::close(fd);
+	::utimes(timestampPath.c_str(), NULL);
+
+	struct Entry { std::string path; time_t lastUsed; uint64_t size; };
+	std::vector<Entry> entries;
+	uint64_t totalSize = 0;
+	DIR* dir = ::opendir(cachePath);
+	if ( dir == NULL )
+		return;
+	while ( struct dirent* entry = ::readdir(dir) ) {
+		if ( strncmp(entry->d_name, entryPrefix, strlen(entryPrefix)) != 0 )
+			continue;
+		std::string path = std::string(cachePath) + "/" + entry->d_name;
+		if ( (path == timestampPath) || (::stat(path.c_str(), &statBuffer) != 0) )
+			continue;
+		if ( (now - statBuffer.st_mtime) > after )
+			::unlink(path.c_str());
+		else {
+			entries.push_back({ path, statBuffer.st_mtime, (uint64_t)statBuffer.st_size });
+			totalSize += statBuffer.st_size;
+		}
+	}
+	::closedir(dir);
+
+	struct statvfs fsStats;
+	if ( ::statvfs(cachePath, &fsStats) != 0 )
+		return;
+	const uint64_t maxSize = (uint64_t)fsStats.f_bavail * fsStats.f_frsize * maxRelativeSize / 100;
+	if ( totalSize <= maxSize )
+		return;
+	// remove least recently used entries first
+	std::sort(entries.begin(), entries.end(), [](const Entry& l, const Entry& r) { return l.lastUsed < r.lastUsed; });
+	for (const Entry& entry : entries) {
+		if ( totalSize <= maxSize )
+			break;
+		if ( ::unlink(entry.path.c_str()) == 0 )
+			totalSize -= entry.size;
+	}
+}
 
 
 } // namespace relocatable
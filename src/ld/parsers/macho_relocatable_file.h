@@ -31,6 +31,24 @@
 namespace mach_o {
 namespace relocatable {
 
+// where a .o file came from on disk, lets the object cache find the entry of an unchanged file
+// without hashing its content
+struct ObjectFileIdentity {
+	const char*		path = NULL;		// NULL if unknown
+	uint64_t		device = 0;
+	uint64_t		inode = 0;
+	uint64_t		size = 0;
+	int64_t			modTimeSec = 0;
+	int64_t			modTimeNSec = 0;
+	uint64_t		memberOffset = 0;	// of an archive member within its archive
+};
+
+// object cache entry built by a parse whose result may go unused
+struct DeferredObjectCacheEntry {
+	std::string				path;
+	std::vector<uint8_t>	content;
+};
+
 struct ParserOptions {
 	uint32_t		architecture;
 	bool			objSubtypeMustMatch;
@@ -54,6 +72,9 @@ struct ParserOptions {
 	bool			forceHidden;
 	bool			platformMismatchesAreWarning;
 	bool			avoidMisalignedPointers;
+	const char*		cachePath = NULL;		// -cache_path_objects
+	std::vector<DeferredObjectCacheEntry>* deferredCacheEntries = NULL;	// collect cache entries instead of writing them
+	ObjectFileIdentity	fileIdentity;
 };
 
 extern ld::relocatable::File* parse(const uint8_t* fileContent, uint64_t fileLength, 
@@ -72,6 +93,16 @@ extern const char* archName(const uint8_t* fileContent);
 
 bool getNonLocalSymbols(const uint8_t* fileContent, std::vector<const char*> &syms);
 
+extern void objectCacheStatistics(uint32_t& hits, uint32_t& misses);
+
+extern void storeDeferredObjectCacheEntries(const std::vector<DeferredObjectCacheEntry>& entries);
+
+extern void compactUnwindMemoStatistics(uint64_t& hits, uint64_t& misses);
+
+extern void pruneObjectCache(const char* cachePath, int interval, int after, unsigned maxRelativeSize);
+
+extern void pruneCache(const char* cachePath, const char* entryPrefix, int interval, int after, unsigned maxRelativeSize);
+
 } // namespace relocatable
 } // namespace mach_o
 
@@ -25,7 +25,16 @@
 
 #include <sys/param.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <mach/mach_time.h>
 #include <tapi/tapi.h>
+#include <CommonCrypto/CommonDigest.h>
+#include <atomic>
+#include <string>
 #include <vector>
 
 #include "Architectures.hpp"
@@ -34,11 +43,312 @@
 #include "MachOTrie.hpp"
 #include "generic_dylib_file.hpp"
 #include "textstub_dylib_file.hpp"
+#include "macho_relocatable_file.h"
 
 
 namespace textstub {
 namespace dylib {
 
+//
+// Support for -cache_path_tbd.  Parsing the YAML of a .tbd file is by far the most expensive
+// part of loading it, and SDK .tbd files are loaded again by every link.  Everything the linker
+// uses from a parsed tapi::LinkerInterfaceFile is copied into an InterfaceImage, which has no
+// pointers, so it can be written to the cache directory and mmap'ed by later links.  Entries
+// are named by a SHA256 of the .tbd path, modification time and content, plus the options that
+// change what tapi returns.  The dylib is always built from an InterfaceImage, whether it came
+// from the cache or from tapi, so both paths produce the same dylib.
+//
+struct InterfaceCacheHeader {
+	enum { kMagic = 0x6c646274, kVersion = 1 };
+	enum { kHasReexportedLibraries = 0x01, kHasWeakDefinedExports = 0x02, kInstallNameVersionSpecific = 0x04,
+		   kApplicationExtensionSafe = 0x08, kHasAllowableClients = 0x10, kHasTwoLevelNamespace = 0x20 };
+	enum { kExportWeakDefined = 0x01, kExportThreadLocal = 0x02 };
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	flags;
+	uint32_t	currentVersion;
+	uint32_t	compatibilityVersion;
+	uint32_t	swiftVersion;
+	uint32_t	installName;			// string pool offset
+	uint32_t	parentFrameworkName;	// string pool offset
+	uint32_t	allowableClientCount;
+	uint32_t	rpathCount;
+	uint32_t	reexportCount;
+	uint32_t	ignoreExportCount;
+	uint32_t	undefinedCount;
+	uint32_t	platformCount;
+	uint32_t	exportCount;
+	uint32_t	stringPoolSize;
+	uint64_t	parseTime;				// mach_absolute_time() units tapi took to parse the .tbd file
+	// followed by string pool offsets of the allowable clients, rpaths, re-exports, ignored exports
+	// and undefineds, then (platform, minVersion, sdkVersion) of each platform, then (string pool
+	// offset, flags) of each export, then the string pool
+};
+
+static const char kInterfaceCacheEntryPrefix[] = "ld64-tbd-";
+
+static std::atomic<uint32_t> sInterfaceCacheHits(0);
+static std::atomic<uint32_t> sInterfaceCacheMisses(0);
+static std::atomic<uint64_t> sInterfaceCacheTimeSaved(0);
+
+class InterfaceImage
+{
+public:
+							InterfaceImage() : _content(nullptr), _size(0), _mapped(false) { }
+							~InterfaceImage() { unload(); }
+
+	bool					load(const char* path);
+	void					build(const tapi::LinkerInterfaceFile* file, uint64_t parseTime);
+	void					store(const char* path) const;
+	bool					loaded() const				{ return (_content != nullptr); }
+
+	const InterfaceCacheHeader& header() const			{ return *(InterfaceCacheHeader*)_content; }
+	const char*				string(uint32_t offset) const { return (char*)&stringPool()[offset]; }
+	const uint32_t*			allowableClients() const	{ return (uint32_t*)&_content[sizeof(InterfaceCacheHeader)]; }
+	const uint32_t*			rpaths() const				{ return &allowableClients()[header().allowableClientCount]; }
+	const uint32_t*			reexports() const			{ return &rpaths()[header().rpathCount]; }
+	const uint32_t*			ignoreExports() const		{ return &reexports()[header().reexportCount]; }
+	const uint32_t*			undefineds() const			{ return &ignoreExports()[header().ignoreExportCount]; }
+	const uint32_t*			platforms() const			{ return &undefineds()[header().undefinedCount]; }
+	const uint32_t*			exports() const				{ return &platforms()[3*header().platformCount]; }
+
+	static void				makePath(const char* cachePath, const char* tbdPath, time_t mTime, const uint8_t* fileContent,
+									 uint64_t fileLength, cpu_type_t cpuType, cpu_subtype_t cpuSubType,
+									 tapi::ParsingFlags flags, uint32_t linkMinOSVersion, bool buildingForSimulator,
+									 char path[PATH_MAX]);
+private:
+	static uint64_t			wordCount(const InterfaceCacheHeader& header) {
+								return (uint64_t)header.allowableClientCount + header.rpathCount + header.reexportCount
+									 + header.ignoreExportCount + header.undefinedCount + 3*(uint64_t)header.platformCount
+									 + 2*(uint64_t)header.exportCount;
+							}
+	const uint8_t*			stringPool() const			{ return (uint8_t*)&exports()[2*header().exportCount]; }
+	bool					valid() const;
+	void					unload();
+
+	std::vector<uint8_t>	_buffer;
+	const uint8_t*			_content;
+	size_t					_size;
+	bool					_mapped;
+};
+
+void InterfaceImage::makePath(const char* cachePath, const char* tbdPath, time_t mTime, const uint8_t* fileContent,
+							  uint64_t fileLength, cpu_type_t cpuType, cpu_subtype_t cpuSubType,
+							  tapi::ParsingFlags flags, uint32_t linkMinOSVersion, bool buildingForSimulator,
+							  char path[PATH_MAX])
+{
+	extern const char ld_classicVersionString[];
+	CC_SHA256_CTX ctx;
+	CC_SHA256_Init(&ctx);
+	auto add = [&](const void* p, size_t len) {
+		const uint8_t* bytes = (uint8_t*)p;
+		while ( len != 0 ) {
+			CC_LONG chunk = (CC_LONG)std::min(len, (size_t)0x40000000);
+			CC_SHA256_Update(&ctx, bytes, chunk);
+			bytes += chunk;
+			len -= chunk;
+		}
+	};
+	// anything that changes what tapi returns, or how it is recorded, must be part of the key
+	add(ld_classicVersionString, strlen(ld_classicVersionString));
+	const uint32_t key[] = { InterfaceCacheHeader::kVersion, tapi::APIVersion::getMajor(), tapi::APIVersion::getMinor(),
+							 (uint32_t)cpuType, (uint32_t)cpuSubType, (uint32_t)flags, linkMinOSVersion, buildingForSimulator };
+	add(key, sizeof(key));
+	add(tbdPath, strlen(tbdPath)+1);
+	const int64_t modTime = mTime;
+	add(&modTime, sizeof(modTime));
+	add(&fileLength, sizeof(fileLength));
+	add(fileContent, fileLength);
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256_Final(digest, &ctx);
+
+	char* end = path + snprintf(path, PATH_MAX, "%s/%s", cachePath, kInterfaceCacheEntryPrefix);
+	for (unsigned i=0; i < CC_SHA256_DIGEST_LENGTH; ++i) {
+		if ( end+3 > &path[PATH_MAX] )
+			break;
+		end += snprintf(end, 3, "%02x", digest[i]);
+	}
+}
+
+bool InterfaceImage::load(const char* path)
+{
+	int fd = ::open(path, O_RDONLY, 0);
+	if ( fd == -1 )
+		return false;
+	struct stat statBuffer;
+	if ( (::fstat(fd, &statBuffer) != 0) || (statBuffer.st_size < (off_t)sizeof(InterfaceCacheHeader)) ) {
+		::close(fd);
+		return false;
+	}
+	void* p = ::mmap(NULL, statBuffer.st_size, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if ( p == (void*)(-1) )
+		return false;
+	_content = (uint8_t*)p;
+	_size = statBuffer.st_size;
+	_mapped = true;
+	if ( !valid() ) {
+		unload();
+		return false;
+	}
+	// mark entry as recently used for pruning
+	::utimes(path, NULL);
+	return true;
+}
+
+// a corrupt entry must never make the linker read outside the image
+bool InterfaceImage::valid() const
+{
+	const InterfaceCacheHeader& hdr = header();
+	if ( (hdr.magic != InterfaceCacheHeader::kMagic) || (hdr.version != InterfaceCacheHeader::kVersion) )
+		return false;
+	if ( sizeof(InterfaceCacheHeader) + 4*wordCount(hdr) + hdr.stringPoolSize != _size )
+		return false;
+	if ( (hdr.stringPoolSize == 0) || (stringPool()[hdr.stringPoolSize-1] != '\0') )
+		return false;
+	if ( (hdr.installName >= hdr.stringPoolSize) || (hdr.parentFrameworkName >= hdr.stringPoolSize) )
+		return false;
+	const uint64_t stringCount = (uint64_t)hdr.allowableClientCount + hdr.rpathCount + hdr.reexportCount
+							   + hdr.ignoreExportCount + hdr.undefinedCount;
+	for (uint64_t i=0; i < stringCount; ++i) {
+		if ( allowableClients()[i] >= hdr.stringPoolSize )
+			return false;
+	}
+	for (uint32_t i=0; i < hdr.exportCount; ++i) {
+		if ( exports()[2*i] >= hdr.stringPoolSize )
+			return false;
+	}
+	return true;
+}
+
+void InterfaceImage::unload()
+{
+	if ( _mapped )
+		::munmap((void*)_content, _size);
+	_buffer.clear();
+	_content = nullptr;
+	_size = 0;
+	_mapped = false;
+}
+
+void InterfaceImage::build(const tapi::LinkerInterfaceFile* file, uint64_t parseTime)
+{
+	InterfaceCacheHeader hdr;
+	bzero(&hdr, sizeof(hdr));
+	std::vector<uint32_t> words;
+	std::vector<uint8_t> strings;
+	auto addString = [&](const std::string& str) -> uint32_t {
+		uint32_t offset = (uint32_t)strings.size();
+		strings.insert(strings.end(), str.begin(), str.end());
+		strings.push_back('\0');
+		return offset;
+	};
+
+	hdr.magic					= InterfaceCacheHeader::kMagic;
+	hdr.version					= InterfaceCacheHeader::kVersion;
+	if ( file->hasReexportedLibraries() )
+		hdr.flags |= InterfaceCacheHeader::kHasReexportedLibraries;
+	if ( file->hasWeakDefinedExports() )
+		hdr.flags |= InterfaceCacheHeader::kHasWeakDefinedExports;
+	if ( file->isInstallNameVersionSpecific() )
+		hdr.flags |= InterfaceCacheHeader::kInstallNameVersionSpecific;
+	if ( file->isApplicationExtensionSafe() )
+		hdr.flags |= InterfaceCacheHeader::kApplicationExtensionSafe;
+	if ( file->hasAllowableClients() )
+		hdr.flags |= InterfaceCacheHeader::kHasAllowableClients;
+	if ( file->hasTwoLevelNamespace() )
+		hdr.flags |= InterfaceCacheHeader::kHasTwoLevelNamespace;
+	hdr.currentVersion			= file->getCurrentVersion();
+	hdr.compatibilityVersion	= file->getCompatibilityVersion();
+	hdr.swiftVersion			= file->getSwiftVersion();
+	hdr.installName				= addString(file->getInstallName());
+	hdr.parentFrameworkName		= addString(file->getParentFrameworkName());
+	hdr.parseTime				= parseTime;
+
+	for (const auto& client : file->allowableClients())
+		words.push_back(addString(client));
+	hdr.allowableClientCount = (uint32_t)words.size();
+#if (TAPI_API_VERSION_MAJOR == 2 && TAPI_API_VERSION_MINOR >= 2)
+	if (tapi::APIVersion::isAtLeast(2, 2)) {
+		for (const auto& rpath : file->rPaths()) {
+			words.push_back(addString(rpath));
+			++hdr.rpathCount;
+		}
+	}
+#endif
+	for (const auto& reexport : file->reexportedLibraries()) {
+		words.push_back(addString(reexport));
+		++hdr.reexportCount;
+	}
+	for (const auto& symbol : file->ignoreExports()) {
+		words.push_back(addString(symbol));
+		++hdr.ignoreExportCount;
+	}
+	for (const auto& sym : file->undefineds()) {
+		words.push_back(addString(sym.getName()));
+		++hdr.undefinedCount;
+	}
+	bool havePlatformVersions = false;
+#if (TAPI_API_VERSION_MAJOR == 2 && TAPI_API_VERSION_MINOR >= 2)
+	if (tapi::APIVersion::isAtLeast(2, 2)) {
+		havePlatformVersions = true;
+		for (const auto &[platform, minOS] : file->getPlatformsAndMinDeployment()) {
+			words.insert(words.end(), { (uint32_t)platform, (uint32_t)minOS, (uint32_t)minOS });
+			++hdr.platformCount;
+		}
+	}
+#endif
+	if ( !havePlatformVersions ) {
+		for (const auto& platform : file->getPlatformSet()) {
+			words.insert(words.end(), { (uint32_t)platform, 0, 0 });
+			++hdr.platformCount;
+		}
+	}
+	for (const auto& sym : file->exports()) {
+		uint32_t flags = 0;
+		if ( sym.isWeakDefined() )
+			flags |= InterfaceCacheHeader::kExportWeakDefined;
+		if ( sym.isThreadLocalValue() )
+			flags |= InterfaceCacheHeader::kExportThreadLocal;
+		words.insert(words.end(), { addString(sym.getName()), flags });
+		++hdr.exportCount;
+	}
+	hdr.stringPoolSize = (uint32_t)strings.size();
+
+	unload();
+	_buffer.reserve(sizeof(hdr) + 4*words.size() + strings.size());
+	_buffer.insert(_buffer.end(), (uint8_t*)&hdr, (uint8_t*)&hdr + sizeof(hdr));
+	_buffer.insert(_buffer.end(), (uint8_t*)words.data(), (uint8_t*)(words.data() + words.size()));
+	_buffer.insert(_buffer.end(), strings.begin(), strings.end());
+	_content = _buffer.data();
+	_size = _buffer.size();
+}
+
+void InterfaceImage::store(const char* path) const
+{
+	// the cache is best effort, so any failure just leaves the entry out
+	char tempPath[PATH_MAX];
+	if ( snprintf(tempPath, PATH_MAX, "%s.XXXXXX", path) >= PATH_MAX )
+		return;
+	int fd = ::mkstemp(tempPath);
+	if ( (fd == -1) && (errno == ENOENT) ) {
+		// create cache directory on first use
+		std::string dir = path;
+		dir.erase(dir.rfind('/'));
+		::mkdir(dir.c_str(), 0777);
+		fd = ::mkstemp(tempPath);
+	}
+	if ( fd == -1 )
+		return;
+	bool written = (::write(fd, _content, _size) == (ssize_t)_size);
+	::fchmod(fd, 0644);
+	::close(fd);
+	// rename is atomic so concurrent links never see a partial entry
+	if ( !written || (::rename(tempPath, path) != 0) )
+		::unlink(tempPath);
+}
+
+
 //
 // The reader for a dylib extracts all exported symbols names from the memory-mapped
 // dylib, builds a hash table, then unmaps the file.  This is an important memory
@@ -72,11 +382,11 @@ public:
 	virtual void	processIndirectLibraries(ld::dylib::File::DylibHandler*, bool addImplicitDylibs) override final;
 
 private:
-	void				init(tapi::LinkerInterfaceFile* file, const Options *opts, bool buildingForSimulator,
+	void				init(const InterfaceImage& image, const Options *opts, bool buildingForSimulator,
 									 bool indirectDylib, bool linkingFlatNamespace, bool linkingMainExecutable,
 									 const char *path, const ld::VersionSet& platforms, const char *targetInstallPath,
 									 bool usingBitcode, bool internalSDK, bool fromSDK, bool platformMismatchesAreWarning);
-	void				buildExportHashTable(const tapi::LinkerInterfaceFile* file);
+	void				buildExportHashTable(const InterfaceImage& image);
 	static bool useSimulatorVariant();
 	
 	const Options* _opts;
@@ -96,7 +406,7 @@ File<A>::File(const char* path, const uint8_t* fileContent, uint64_t fileLength,
 		  bool buildingForSimulator, bool logAllFiles, const char* targetInstallPath,
 		  bool indirectDylib, bool usingBitcode, bool internalSDK, bool fromSDK, bool platformMismatchesAreWarning)
 : Base(strdup(path), mTime, ord, platforms, allowWeakImports, linkingFlatNamespace,
-	   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers)
+	   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers), _interface(nullptr)
 {
 #if (TAPI_API_VERSION_MAJOR >= 1)
 	if(!tapi::APIVersion::isAtLeast(1,6))
@@ -124,12 +434,42 @@ File<A>::File(const char* path, const uint8_t* fileContent, uint64_t fileLength,
 	if (!allowWeakImports)
 		flags |= tapi::ParsingFlags::DisallowWeakImports;
 
-	_interface = tapi::LinkerInterfaceFile::create(
-		path, cpuType, cpuSubType, flags,
-		tapi::PackedVersion32(linkMinOSVersion), errorMessage);
+	// with -cache_path_tbd, use the interface saved by a previous link of the same .tbd file
+	const uint64_t parseStart = mach_absolute_time();
+	InterfaceImage image;
+	char cacheEntryPath[PATH_MAX];
+	const char* cachePath = opts->tbdCachePath();
+	if ( cachePath != nullptr ) {
+		InterfaceImage::makePath(cachePath, path, mTime, fileContent, fileLength, cpuType, cpuSubType, flags,
+								 linkMinOSVersion, buildingForSimulator, cacheEntryPath);
+		if ( image.load(cacheEntryPath) ) {
+			++sInterfaceCacheHits;
+			const uint64_t loadTime = mach_absolute_time() - parseStart;
+			if ( image.header().parseTime > loadTime )
+				sInterfaceCacheTimeSaved += image.header().parseTime - loadTime;
+		}
+	}
 
-	if (!_interface)
-		throw strdup(errorMessage.c_str());
+	if ( !image.loaded() ) {
+		_interface = tapi::LinkerInterfaceFile::create(
+			path, cpuType, cpuSubType, flags,
+			tapi::PackedVersion32(linkMinOSVersion), errorMessage);
+
+		if (!_interface)
+			throw strdup(errorMessage.c_str());
+
+		image.build(_interface, mach_absolute_time() - parseStart);
+		if ( cachePath != nullptr ) {
+			++sInterfaceCacheMisses;
+			// inlined frameworks are parsed from the live interface, so those .tbd files are not cached
+			bool hasInlinedFrameworks = false;
+#if ((TAPI_API_VERSION_MAJOR == 1 &&  TAPI_API_VERSION_MINOR >= 6) || (TAPI_API_VERSION_MAJOR > 1))
+			hasInlinedFrameworks = !_interface->inlinedFrameworkNames().empty();
+#endif
+			if ( !hasInlinedFrameworks )
+				image.store(cacheEntryPath);
+		}
+	}
 
 	// unmap file - it is no longer needed.
 	munmap((caddr_t)fileContent, fileLength);
@@ -138,7 +478,7 @@ File<A>::File(const char* path, const uint8_t* fileContent, uint64_t fileLength,
 	if ( logAllFiles )
 		printf("%s\n", path);
 
-	init(_interface, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
+	init(image, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
 		 linkingMainExecutable, path, platforms, targetInstallPath, usingBitcode, internalSDK, fromSDK, platformMismatchesAreWarning);
 }
 
@@ -154,26 +494,30 @@ File<A>::File(const char* path, const uint8_t* fileContent, uint64_t fileLength,
 	: Base(strdup(path), mTime, ordinal, platforms, allowWeakImports, linkingFlatNamespace,
 		   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers), _interface(file)
 {
-	init(_interface, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
+	InterfaceImage image;
+	image.build(_interface, 0);
+	init(image, opts, buildingForSimulator, indirectDylib, linkingFlatNamespace,
 		 linkingMainExecutable, path, platforms, installPath, usingBitcode, internalSDK, fromSDK, platformMismatchesAreWarning);
 }
 	
 template<typename A>
-void File<A>::init(tapi::LinkerInterfaceFile* file, const Options *opts, bool buildingForSimulator,
+void File<A>::init(const InterfaceImage& image, const Options *opts, bool buildingForSimulator,
 				   bool indirectDylib, bool linkingFlatNamespace, bool linkingMainExecutable,
 				   const char *path, const ld::VersionSet& cmdLinePlatforms, const char *targetInstallPath,
 				   bool usingBitcode, bool internalSDK, bool fromSDK, bool platformMismatchesAreWarning) {
+	const InterfaceCacheHeader& header = image.header();
 	_opts = opts;
 	this->_bitcode = std::unique_ptr<ld::Bitcode>(new ld::Bitcode(nullptr, 0));
-	this->_noRexports = !file->hasReexportedLibraries();
-	this->_hasWeakExports = file->hasWeakDefinedExports();
-	this->_dylibInstallPath = strdup(file->getInstallName().c_str());
-	this->_installPathOverride = file->isInstallNameVersionSpecific();
-	this->_dylibCurrentVersion = file->getCurrentVersion();
-	this->_dylibCompatibilityVersion = file->getCompatibilityVersion();
-	this->_swiftVersion = file->getSwiftVersion();
-	this->_parentUmbrella = file->getParentFrameworkName().empty() ? nullptr : strdup(file->getParentFrameworkName().c_str());
-	this->_appExtensionSafe = file->isApplicationExtensionSafe();
+	this->_noRexports = !(header.flags & InterfaceCacheHeader::kHasReexportedLibraries);
+	this->_hasWeakExports = (header.flags & InterfaceCacheHeader::kHasWeakDefinedExports);
+	this->_dylibInstallPath = strdup(image.string(header.installName));
+	this->_installPathOverride = (header.flags & InterfaceCacheHeader::kInstallNameVersionSpecific);
+	this->_dylibCurrentVersion = header.currentVersion;
+	this->_dylibCompatibilityVersion = header.compatibilityVersion;
+	this->_swiftVersion = header.swiftVersion;
+	const char* parentFrameworkName = image.string(header.parentFrameworkName);
+	this->_parentUmbrella = (parentFrameworkName[0] == '\0') ? nullptr : strdup(parentFrameworkName);
+	this->_appExtensionSafe = (header.flags & InterfaceCacheHeader::kApplicationExtensionSafe);
 
 	// if framework, capture framework name
 	const char* lastSlash = strrchr(this->_dylibInstallPath, '/');
@@ -187,69 +531,62 @@ void File<A>::init(tapi::LinkerInterfaceFile* file, const Options *opts, bool bu
 			this->_frameworkName = leafName;
 	}
 	
-	for (auto &client : file->allowableClients())
-		this->_allowableClients.push_back(strdup(client.c_str()));
+	for (uint32_t i=0; i < header.allowableClientCount; ++i)
+		this->_allowableClients.push_back(strdup(image.string(image.allowableClients()[i])));
 	
 	// <rdar://problem/20659505> [TAPI] Don't hoist "public" (in /usr/lib/) dylibs that should not be directly linked
-	this->_hasPublicInstallName = file->hasAllowableClients() ? false : this->isPublicLocation(file->getInstallName().c_str());
+	this->_hasPublicInstallName = (header.flags & InterfaceCacheHeader::kHasAllowableClients) ? false : this->isPublicLocation(this->_dylibInstallPath);
 	
-	for (const auto &client : file->allowableClients())
-		this->_allowableClients.emplace_back(strdup(client.c_str()));
+	for (uint32_t i=0; i < header.allowableClientCount; ++i)
+		this->_allowableClients.emplace_back(strdup(image.string(image.allowableClients()[i])));
+
+	for (uint32_t i=0; i < header.rpathCount; ++i)
+		this->_rpaths.emplace_back(strdup(image.string(image.rpaths()[i])));
 
 	ld::VersionSet lcPlatforms;
-#if (TAPI_API_VERSION_MAJOR == 2 && TAPI_API_VERSION_MINOR >= 2)
-	if (tapi::APIVersion::isAtLeast(2, 2)) {
-		for (const auto &rpath : file->rPaths())
-			this->_rpaths.emplace_back(rpath.c_str());
-		
-		for (const auto &[platform, minOS] : file->getPlatformsAndMinDeployment()) {
-			ld::PlatformVersion pv((ld::Platform)platform, minOS);
-			lcPlatforms.insert(pv);
-		}
-	} else
-#endif
-	{
-		for (const auto &platform : file->getPlatformSet())
-			lcPlatforms.insert((ld::Platform)platform);
+	for (uint32_t i=0; i < header.platformCount; ++i) {
+		const uint32_t* platform = &image.platforms()[3*i];
+		lcPlatforms.insert(ld::PlatformVersion((ld::Platform)platform[0], platform[1], platform[2]));
 	}
 
 	// check cross-linking
 	cmdLinePlatforms.checkDylibCrosslink(lcPlatforms, path, ".tbd", internalSDK, indirectDylib, usingBitcode, _isUnzipperedTwin, _dylibInstallPath, fromSDK, platformMismatchesAreWarning);
 
-	for (const auto& reexport : file->reexportedLibraries()) {
-		const char *path = strdup(reexport.c_str());
+	for (uint32_t i=0; i < header.reexportCount; ++i) {
+		const char *path = strdup(image.string(image.reexports()[i]));
 		if ( (targetInstallPath == nullptr) || (strcmp(targetInstallPath, path) != 0) )
 			this->_dependentDylibs.emplace_back(path, true);
 	}
 	
-	for (const auto& symbol : file->ignoreExports())
-		this->_ignoreExports.insert(strdup(symbol.c_str()));
+	for (uint32_t i=0; i < header.ignoreExportCount; ++i)
+		this->_ignoreExports.insert(strdup(image.string(image.ignoreExports()[i])));
 	
 	// if linking flat and this is a flat dylib, create one atom that references all imported symbols.
-	if ( linkingFlatNamespace && linkingMainExecutable && (file->hasTwoLevelNamespace() == false) ) {
+	if ( linkingFlatNamespace && linkingMainExecutable && !(header.flags & InterfaceCacheHeader::kHasTwoLevelNamespace) ) {
 		std::vector<const char*> importNames;
-		importNames.reserve(file->undefineds().size());
+		importNames.reserve(header.undefinedCount);
 		// We do not need to strdup the name, because that will be done by the
 		// ImportAtom constructor.
-		for (const auto &sym : file->undefineds())
-			importNames.emplace_back(sym.getName().c_str());
+		for (uint32_t i=0; i < header.undefinedCount; ++i)
+			importNames.emplace_back(image.string(image.undefineds()[i]));
 		this->_importAtom = new generic::dylib::ImportAtom(*this, importNames);
 	}
 	
 	// build hash table
-	buildExportHashTable(file);
+	buildExportHashTable(image);
 }
 
 template <typename A>
-void File<A>::buildExportHashTable(const tapi::LinkerInterfaceFile* file) {
+void File<A>::buildExportHashTable(const InterfaceImage& image) {
 	if (this->_s_logHashtable )
 		fprintf(stderr, "ld: building hashtable from text-stub info in %s\n", this->path());
 
-	for (const auto &sym : file->exports()) {
-		const char* name = sym.getName().c_str();
-		bool weakDef = sym.isWeakDefined();
-		bool tlv = sym.isThreadLocalValue();
-		addExportedSymbol(name, weakDef, tlv, 0);
+	const InterfaceCacheHeader& header = image.header();
+	for (uint32_t i=0; i < header.exportCount; ++i) {
+		const uint32_t* entry = &image.exports()[2*i];
+		bool weakDef = (entry[1] & InterfaceCacheHeader::kExportWeakDefined);
+		bool tlv = (entry[1] & InterfaceCacheHeader::kExportThreadLocal);
+		addExportedSymbol(image.string(entry[0]), weakDef, tlv, 0);
 	}
 }
 
@@ -424,6 +761,21 @@ bool isTextStubFile(const uint8_t* fileContent, uint64_t fileLength, const char*
 	return tapi::LinkerInterfaceFile::isSupported(path, fileContent, fileLength);
 }
 
+//
+// Used by -print_statistics to report -cache_path_tbd effectiveness
+//
+void interfaceCacheStatistics(uint32_t& hits, uint32_t& misses, uint64_t& timeSaved)
+{
+	hits = sInterfaceCacheHits;
+	misses = sInterfaceCacheMisses;
+	timeSaved = sInterfaceCacheTimeSaved;
+}
+
+void pruneInterfaceCache(const char* cachePath, int interval, int after, unsigned maxRelativeSize)
+{
+	mach_o::relocatable::pruneCache(cachePath, kInterfaceCacheEntryPrefix, interval, after, maxRelativeSize);
+}
+
 
 
 } // namespace dylib
@@ -41,6 +41,10 @@ extern ld::dylib::File *parse(const char *path, tapi::LinkerInterfaceFile* file,
 
 extern bool isTextStubFile(const uint8_t* fileContent, uint64_t fileLength, const char* path);
 
+extern void interfaceCacheStatistics(uint32_t& hits, uint32_t& misses, uint64_t& timeSaved);
+
+extern void pruneInterfaceCache(const char* cachePath, int interval, int after, unsigned maxRelativeSize);
+
 } // namespace dylib
 } // namespace textstub
 
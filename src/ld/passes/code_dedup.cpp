@@ -34,9 +34,11 @@
 #include <map>
 #include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "ld.hpp"
 #include "code_dedup.h"
+#include "Trace.h"
 
 namespace ld {
 namespace passes {
@@ -49,7 +51,7 @@ class DeDupAliasAtom : public ld::Atom
 public:
 										DeDupAliasAtom(const ld::Atom* dupOf, const ld::Atom* replacement) :
 											ld::Atom(dupOf->section(), ld::Atom::definitionRegular, ld::Atom::combineNever,
-													dupOf->scope(), dupOf->contentType(), ld::Atom::symbolTableIn,
+													dupOf->scope(), dupOf->contentType(), dupOf->symbolTableInclusion(),
 													false, false, true, replacement->alignment()),
 											_dedupOf(dupOf),
 											_fixup(0, ld::Fixup::k1of1, ld::Fixup::kindNoneFollowOn, ld::Fixup::bindingDirectlyBound, replacement) {
@@ -74,180 +76,185 @@ private:
 
 
 namespace {
-    typedef std::unordered_map<const ld::Atom*, unsigned long> CachedHashes;
 
-    ld::Internal*   sState = nullptr;
-    CachedHashes    sSavedHashes;
-    unsigned long   sHashCount = 0;
-    unsigned long   sFixupCompareCount = 0;
-};
+// Identical code folding by partition refinement.  All candidate atoms start out in classes of atoms with
+// the same content, alignment and fixups, where references to other candidates are only required to point
+// at some candidate.  Each round then splits classes whose members reference candidates in different classes,
+// until no class splits any more.  What remains are sets of atoms that are equal, even if they call each
+// other recursively, and each set is folded into its first atom.
 
+const uint32_t kNotCandidate = UINT32_MAX;
 
-// A helper for std::unordered_map<> that hashes the instructions of a function
-struct atom_hashing {
+struct FixupTarget {
+    const ld::Atom*     atom;
+    uint32_t            candidate;  // index in candidates, or kNotCandidate
+};
 
-    static unsigned long hash(const ld::Atom* atom) {
-        auto pos = sSavedHashes.find(atom);
-        if ( pos != sSavedHashes.end() )
-            return pos->second;
+struct Candidate {
+    const ld::Atom*             atom;
+    uint32_t                    sectionIndex;
+    bool                        comparable;     // false if it has fixups that can't be compared
+    uint64_t                    staticHash;
+    std::vector<FixupTarget>    targets;        // one per fixup with a target, in fixup order
+};
 
-        const unsigned instructionBytes = atom->size();
-        const uint8_t*	instructions = atom->rawContentPointer();
-        unsigned long hash = instructionBytes;
-        for (unsigned i=0; i < instructionBytes; ++i) {
-            hash = (hash * 33) + instructions[i];
+inline uint64_t mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+// hashes a word at a time in four independent lanes, so the compiler can keep them in vector registers
+uint64_t hashBytes(const uint8_t* bytes, uint64_t size)
+{
+    const uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+    uint64_t lanes[4] = { size, size ^ kMul, size + kMul, ~size };
+    uint64_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        uint64_t words[4];
+        memcpy(words, &bytes[i], sizeof(words));
+        for (int lane=0; lane < 4; ++lane) {
+            lanes[lane] = (lanes[lane] ^ words[lane]) * kMul;
+            lanes[lane] ^= (lanes[lane] >> 29);
         }
-		for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-            const Atom* target = NULL;
-            switch ( fit->binding ) {
-                case ld::Fixup::bindingDirectlyBound:
-                    target = fit->u.target;
-                    break;
-                case ld::Fixup::bindingsIndirectlyBound:
-                    target = sState->indirectBindingTable[fit->u.bindingIndex];
-                    break;
-                default:
-                    break;
-            }
-            // don't include calls to auto-hide functions in hash because they might be de-dup'ed
-            switch ( fit->kind ) {
+    }
+    uint64_t hash = mix(mix(lanes[0], lanes[1]), mix(lanes[2], lanes[3]));
+    for (; i < size; ++i)
+        hash = (hash * 33) + bytes[i];
+    return hash;
+}
+
+bool isBranch(ld::Fixup::Kind kind)
+{
+    switch ( kind ) {
 #if SUPPORT_ARCH_arm64
-                case ld::Fixup::kindStoreTargetAddressARM64Branch26:
+        case ld::Fixup::kindStoreTargetAddressARM64Branch26:
 #endif
-                case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
-                    if ( target && target->autoHide() )
-                        continue; // don't include
-                    break;
-                default:
-                    break;
-            }
-            if ( target != NULL ) {
-                const char* name = target->name();
-                if ( target->contentType() == ld::Atom::typeCString )
-                    name = (const char*)target->rawContentPointer();
-                for (const char* s = name; *s != '\0'; ++s)
-                    hash = (hash * 33) + *s;
-            }
-        }
-        ++sHashCount;
-        sSavedHashes[atom] = hash;
-        return hash;
+        case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
+            return true;
+        default:
+            return false;
     }
+}
 
-    unsigned long operator()(const ld::Atom* atom) const {
-        return hash(atom);
+const ld::Atom* fixupTarget(const ld::Internal& state, const ld::Fixup* fit, bool& comparable)
+{
+    switch ( fit->binding ) {
+        case ld::Fixup::bindingDirectlyBound:
+            return fit->u.target;
+        case ld::Fixup::bindingsIndirectlyBound:
+            return state.indirectBindingTable[fit->u.bindingIndex];
+        case ld::Fixup::bindingNone:
+            return nullptr;
+        default:
+            comparable = false;
+            return nullptr;
     }
-};
-
-
-// A helper for std::unordered_map<> that compares functions
-struct atom_equal {
-
-    struct BackChain {
-        BackChain*      prev;
-        const Atom*     inCallChain1;
-        const Atom*     inCallChain2;
+}
 
-        bool inCallChain(const Atom* target) {
-            for (BackChain* p = this; p->prev != NULL; p = p->prev) {
-                if ( (p->inCallChain1 == target) || (p->inCallChain2 == target) )
-                     return true;
-            }
+// everything about two candidates except which classes the candidates they reference are in
+bool sameStatic(const Candidate& c1, const Candidate& c2)
+{
+    if ( !c1.comparable || !c2.comparable )
+        return false;
+    const ld::Atom* atom1 = c1.atom;
+    const ld::Atom* atom2 = c2.atom;
+    if ( c1.sectionIndex != c2.sectionIndex )
+        return false;
+    if ( atom1->size() != atom2->size() )
+        return false;
+    if ( (atom1->alignment().powerOf2 != atom2->alignment().powerOf2) || (atom1->alignment().modulus != atom2->alignment().modulus) )
+        return false;
+    if ( atom1->contentType() != atom2->contentType() )
+        return false;
+    if ( memcmp(atom1->rawContentPointer(), atom2->rawContentPointer(), atom1->size()) != 0 )
+        return false;
+    ld::Fixup::iterator f1   = atom1->fixupsBegin();
+    ld::Fixup::iterator end1 = atom1->fixupsEnd();
+    ld::Fixup::iterator f2   = atom2->fixupsBegin();
+    ld::Fixup::iterator end2 = atom2->fixupsEnd();
+    if ( (end1 - f1) != (end2 - f2) )
+        return false;
+    for (; f1 != end1; ++f1, ++f2) {
+        if ( f1->offsetInAtom != f2->offsetInAtom )
             return false;
-        }
-    };
-
-    static bool sameFixups(const ld::Atom* atom1, const ld::Atom* atom2, BackChain& backChain) {
-        ++sFixupCompareCount;
-        //fprintf(stderr, "sameFixups(%s,%s)\n", atom1->name(), atom2->name());
-        Fixup::iterator	f1   = atom1->fixupsBegin();
-        Fixup::iterator	end1 = atom1->fixupsEnd();
-        Fixup::iterator	f2   = atom2->fixupsBegin();
-        Fixup::iterator	end2 = atom2->fixupsEnd();
-        // two atoms must have same number of fixups
-        if ( (end1 - f1) != (end2 - f2) )
+        if ( f1->kind != f2->kind )
             return false;
-        // if no fixups, fixups are equal
-        if ( f1 == end1 )
-            return true;
-        // all fixups must be the same
-        do {
-            if ( f1->offsetInAtom != f2->offsetInAtom )
-                return false;
-            if ( f1->kind != f2->kind )
-                return false;
-            if ( (f1->kind == ld::Fixup::kindAddAddend) || (f1->kind == ld::Fixup::kindSubtractAddend) ) {
-                if ( f1->u.addend != f2->u.addend )
-                    return false;
-            }
-            if ( f1->clusterSize != f2->clusterSize )
+        if ( (f1->kind == ld::Fixup::kindAddAddend) || (f1->kind == ld::Fixup::kindSubtractAddend) ) {
+            if ( f1->u.addend != f2->u.addend )
                 return false;
-            if ( f1->binding != f2->binding )
-                return false;
-            const Atom* target1 = NULL;
-            const Atom* target2 = NULL;
-            switch ( f1->binding ) {
-                case ld::Fixup::bindingDirectlyBound:
-                    target1 = f1->u.target;
-                    target2 = f2->u.target;
-                    break;
-                case ld::Fixup::bindingsIndirectlyBound:
-                    target1 = sState->indirectBindingTable[f1->u.bindingIndex];
-                    target2 = sState->indirectBindingTable[f2->u.bindingIndex];
-                    break;
-                 case ld::Fixup::bindingNone:
-                    break;
-               default:
-                    return false;
-            }
-            if ( target1 != target2 ) {
-                // targets must match unless they are both calls to functions that will de-dup together
-    #if SUPPORT_ARCH_arm64
-                if ( (f1->kind != ld::Fixup::kindStoreTargetAddressARM64Branch26) && (f1->kind != ld::Fixup::kindStoreTargetAddressX86BranchPCRel32) )
-    #else
-                if ( f1->kind != ld::Fixup::kindStoreTargetAddressX86BranchPCRel32 )
-    #endif
-                    return false;
-                if ( target1->section().type() != target2->section().type() )
-                    return false;
-                if ( target1->section().type() != ld::Section::typeCode )
-                    return false;
-                // to support co-recursive functions, don't recurse into equals() for targets already in the back chain
-                if ( !backChain.inCallChain(target1) || !backChain.inCallChain(target2) ) {
-                    BackChain nextBackChain;
-                    nextBackChain.prev = &backChain;
-                    nextBackChain.inCallChain1 = target1;
-                    nextBackChain.inCallChain2 = target2;
-                    if ( !equal(target1, target2, nextBackChain) )
-                        return false;
-                }
-            }
-
-            ++f1;
-            ++f2;
-        } while (f1 != end1);
-
-        return true;
+        }
+        if ( f1->clusterSize != f2->clusterSize )
+            return false;
+        if ( f1->binding != f2->binding )
+            return false;
     }
-
-    static bool equal(const ld::Atom* atom1, const ld::Atom* atom2, BackChain& backChain) {
-        if ( atom1->size() != atom2->size() )
+    if ( c1.targets.size() != c2.targets.size() )
+        return false;
+    for (size_t i=0; i < c1.targets.size(); ++i) {
+        const FixupTarget& t1 = c1.targets[i];
+        const FixupTarget& t2 = c2.targets[i];
+        if ( (t1.candidate == kNotCandidate) != (t2.candidate == kNotCandidate) )
             return false;
-        if ( atom_hashing::hash(atom1) != atom_hashing::hash(atom2) )
+        if ( (t1.candidate == kNotCandidate) && (t1.atom != t2.atom) )
             return false;
-        if ( memcmp(atom1->rawContentPointer(), atom2->rawContentPointer(), atom1->size()) != 0 )
+    }
+    return true;
+}
+
+bool sameTargetClasses(const Candidate& c1, const Candidate& c2, const uint32_t classes[])
+{
+    for (size_t i=0; i < c1.targets.size(); ++i) {
+        uint32_t target1 = c1.targets[i].candidate;
+        uint32_t target2 = c2.targets[i].candidate;
+        if ( (target1 != kNotCandidate) && (classes[target1] != classes[target2]) )
             return false;
-        bool result = sameFixups(atom1, atom2, backChain);
-        //fprintf(stderr, "sameFixups(%s,%s) = %d\n", atom1->name(), atom2->name(), result);
-        return result;
     }
+    return true;
+}
 
-    bool operator()(const ld::Atom* atom1, const ld::Atom* atom2) const {
-        BackChain backChain = { NULL, atom1, atom2 };
-        return equal(atom1, atom2, backChain);
+// Sorts candidates by (class, key) and gives each run of equal members a new class, numbered in sorted order.
+// Returns the number of classes.
+template <typename SameFunc>
+uint32_t splitClasses(std::vector<uint32_t>& classes, const std::vector<uint64_t>& keys, SameFunc same)
+{
+    std::vector<uint32_t> order(classes.size());
+    for (uint32_t i=0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right) {
+        if ( classes[left] != classes[right] )
+            return classes[left] < classes[right];
+        if ( keys[left] != keys[right] )
+            return keys[left] < keys[right];
+        return left < right;
+    });
+    std::vector<uint32_t> newClasses(classes.size());
+    std::vector<std::pair<uint32_t, uint32_t>> representatives;   // (candidate, class) of the current run
+    uint32_t classCount = 0;
+    for (size_t i=0; i < order.size(); ++i) {
+        uint32_t index = order[i];
+        if ( (i == 0) || (classes[order[i-1]] != classes[index]) || (keys[order[i-1]] != keys[index]) )
+            representatives.clear();
+        bool found = false;
+        // usually there is only one representative, more only if keys collide
+        for (const auto& rep : representatives) {
+            if ( same(rep.first, index) ) {
+                newClasses[index] = rep.second;
+                found = true;
+                break;
+            }
+        }
+        if ( !found ) {
+            newClasses[index] = classCount;
+            representatives.push_back({index, classCount});
+            ++classCount;
+        }
     }
-};
+    classes.swap(newClasses);
+    return classCount;
+}
 
+} // anonymous namespace
 
 
 void doPass(const Options& opts, ld::Internal& state)
@@ -266,76 +273,196 @@ void doPass(const Options& opts, ld::Internal& state)
     if ( ! opts.deduplicateFunctions() )
         return;
 
-    const bool verbose = opts.verboseDeduplicate();
+    const bool verbose             = opts.verboseDeduplicate();
+    const bool foldReadOnlyData    = opts.deduplicateReadOnlyData();
+    const bool foldAddressNotTaken = opts.deduplicateAddressNotTaken();
+
+    // with -deduplicate_address_not_taken find functions whose address is used for something other than a call
+    std::unordered_set<const ld::Atom*> addressTaken;
+    if ( foldAddressNotTaken ) {
+        std::vector<std::vector<const ld::Atom*>> addressTakenBySection(state.sections.size());
+        std::vector<const ld::Atom*>* addressTakenBySectionArray = addressTakenBySection.data();
+        ld::trace::apply("dedup address taken", state.sections.size(), ^(size_t index) {
+            const ld::Internal::FinalSection* sect = state.sections[index];
+            // unwind info describes functions, it does not take their address
+            switch ( sect->type() ) {
+                case ld::Section::typeCFI:
+                case ld::Section::typeLSDA:
+                case ld::Section::typeUnwindInfo:
+                    return;
+                default:
+                    break;
+            }
+            for (const ld::Atom* atom : sect->atoms) {
+                for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+                    if ( isBranch(fit->kind) )
+                        continue;
+                    // follow-on and group fixups don't use the target's address
+                    if ( !fit->isStore() && (fit->kind != ld::Fixup::kindSetTargetAddress) )
+                        continue;
+                    bool comparable = true;
+                    if ( const ld::Atom* target = fixupTarget(state, fit, comparable) )
+                        addressTakenBySectionArray[index].push_back(target);
+                }
+            }
+        });
+        for (const std::vector<const ld::Atom*>& targets : addressTakenBySection)
+            addressTaken.insert(targets.begin(), targets.end());
+    }
 
-    // find __text section
-    ld::Internal::FinalSection* textSection = NULL;
-    for (ld::Internal::FinalSection* sect : state.sections) {
-        if ( (sect->type() == ld::Section::typeCode) && (strcmp(sect->sectionName(), "__text") == 0) ) {
-            textSection = sect;
-            break;
+    // collect candidates in section and atom order
+    std::vector<Candidate> candidates;
+    std::unordered_map<const ld::Atom*, uint32_t> candidateIndexes;
+    bool onlyAutoHideCode = true;
+    for (uint32_t sectIndex=0; sectIndex < state.sections.size(); ++sectIndex) {
+        const ld::Internal::FinalSection* sect = state.sections[sectIndex];
+        const bool isText         = (sect->type() == ld::Section::typeCode) && (strcmp(sect->sectionName(), "__text") == 0);
+        const bool isReadOnlyData = foldReadOnlyData && (sect->type() == ld::Section::typeUnclassified)
+                                    && (strcmp(sect->segmentName(), "__TEXT") == 0) && (strcmp(sect->sectionName(), "__const") == 0);
+        if ( !isText && !isReadOnlyData )
+            continue;
+        for (const ld::Atom* atom : sect->atoms) {
+            // ignore empty (alias) atoms
+            if ( atom->size() == 0 )
+                continue;
+            if ( atom->rawContentPointer() == nullptr )
+                continue;
+            bool candidate = atom->autoHide();
+            if ( !candidate && (atom->scope() != ld::Atom::scopeGlobal) ) {
+                if ( isReadOnlyData )
+                    candidate = true;
+                else if ( foldAddressNotTaken )
+                    candidate = (addressTaken.count(atom) == 0);
+            }
+            if ( !candidate )
+                continue;
+            if ( !isText )
+                onlyAutoHideCode = false;
+            else if ( !atom->autoHide() )
+                onlyAutoHideCode = false;
+            candidateIndexes[atom] = (uint32_t)candidates.size();
+            candidates.push_back({atom, sectIndex, true, 0, {}});
         }
     }
-    if ( textSection == NULL )
+    if ( candidates.empty() )
         return;
 
-    // build map of auto-hide functions and their duplicates
-    // the key for the map is always the first element in the value vector
-    // the key is always earlier in the atoms list then matching other atoms
-    sState = &state;
-    std::unordered_map<const ld::Atom*, std::vector<const ld::Atom*>, atom_hashing, atom_equal> map;
-    std::unordered_set<const ld::Atom*> masterAtoms;
-    for (const ld::Atom* atom : textSection->atoms) {
-        // ignore empty (alias) atoms
-        if ( atom->size() == 0 )
-            continue;
-        if ( atom->autoHide() )
-            map[atom].push_back(atom);
-	  }
+    // hash content and fixups and find referenced candidates, in parallel
+    Candidate* candidatesArray = candidates.data();
+    const std::unordered_map<const ld::Atom*, uint32_t>* candidateIndexesPtr = &candidateIndexes;
+    const size_t kCandidatesPerChunk = 1024;
+    const size_t chunkCount = (candidates.size() + kCandidatesPerChunk - 1) / kCandidatesPerChunk;
+    const size_t candidateCount = candidates.size();
+    ld::trace::apply("dedup hash candidates", chunkCount, ^(size_t chunk) {
+        for (size_t i=chunk*kCandidatesPerChunk; i < std::min((chunk+1)*kCandidatesPerChunk, candidateCount); ++i) {
+            Candidate& candidate = candidatesArray[i];
+            const ld::Atom* atom = candidate.atom;
+            uint64_t hash = mix(hashBytes(atom->rawContentPointer(), atom->size()), candidate.sectionIndex);
+            hash = mix(hash, ((uint64_t)atom->alignment().powerOf2 << 16) | atom->alignment().modulus);
+            for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+                hash = mix(hash, ((uint64_t)fit->offsetInAtom << 16) | ((uint64_t)fit->kind << 8) | fit->clusterSize);
+                if ( (fit->kind == ld::Fixup::kindAddAddend) || (fit->kind == ld::Fixup::kindSubtractAddend) )
+                    hash = mix(hash, fit->u.addend);
+                const ld::Atom* target = fixupTarget(state, fit, candidate.comparable);
+                if ( target == nullptr )
+                    continue;
+                auto pos = candidateIndexesPtr->find(target);
+                uint32_t targetIndex = (pos != candidateIndexesPtr->end()) ? pos->second : kNotCandidate;
+                candidate.targets.push_back({target, targetIndex});
+                // references to candidates only constrain which class they are in, that is up to the refinement rounds
+                hash = mix(hash, (targetIndex == kNotCandidate) ? (uint64_t)(uintptr_t)target : 1);
+            }
+            candidate.staticHash = hash;
+        }
+    });
+
+    // initial classes: same content and same references, except to candidates
+    std::vector<uint32_t> classes(candidates.size(), 0);
+    std::vector<uint64_t> keys(candidates.size());
+    for (size_t i=0; i < candidates.size(); ++i)
+        keys[i] = candidates[i].staticHash;
+    uint32_t classCount = splitClasses(classes, keys, [&](uint32_t left, uint32_t right) {
+        return sameStatic(candidates[left], candidates[right]);
+    });
+
+    // refine until members of each class reference candidates in the same classes
+    unsigned rounds = 0;
+    for (;;) {
+        ++rounds;
+        const uint32_t* classesArray = classes.data();
+        uint64_t* keysArray = keys.data();
+        ld::trace::apply("dedup refine classes", chunkCount, ^(size_t chunk) {
+            for (size_t i=chunk*kCandidatesPerChunk; i < std::min((chunk+1)*kCandidatesPerChunk, candidateCount); ++i) {
+                uint64_t hash = 0;
+                for (const FixupTarget& target : candidatesArray[i].targets) {
+                    if ( target.candidate != kNotCandidate )
+                        hash = mix(hash, classesArray[target.candidate]);
+                }
+                keysArray[i] = hash;
+            }
+        });
+        const std::vector<uint32_t> previousClasses = classes;
+        uint32_t newClassCount = splitClasses(classes, keys, [&](uint32_t left, uint32_t right) {
+            return sameTargetClasses(candidates[left], candidates[right], previousClasses.data());
+        });
+        if ( newClassCount == classCount )
+            break;
+        classCount = newClassCount;
+    }
+
+    // gather members of each class, in candidate order so the first one is the earliest in its section
+    std::vector<std::vector<uint32_t>> classMembers(classCount);
+    for (uint32_t i=0; i < candidates.size(); ++i)
+        classMembers[classes[i]].push_back(i);
+    std::sort(classMembers.begin(), classMembers.end(), [](const std::vector<uint32_t>& left, const std::vector<uint32_t>& right) {
+        return left.front() < right.front();
+    });
 
     if ( log ) {
-        for (auto& entry : map) {
-            if ( entry.second.size() > 1 ) {
-                printf("Found following matching functions:\n");
-                for (const ld::Atom* atom : entry.second) {
-                    printf("  %p %s\n", atom, atom->name());
+        for (const std::vector<uint32_t>& members : classMembers) {
+            if ( members.size() > 1 ) {
+                printf("Found following matching atoms:\n");
+                for (uint32_t member : members) {
+                    printf("  %p %s\n", candidates[member].atom, candidates[member].atom->name());
                 }
             }
         }
-        fprintf(stderr, "duplicate sets count:\n");
-        for (auto& entry : map)
-            fprintf(stderr, "  %p -> %lu\n", entry.first, entry.second.size());
     }
 
     // construct alias atoms to replace atoms found to be duplicates
-    unsigned atomsBeingComparedCount = 0;
     uint64_t dedupSavings = 0;
-    std::vector<const ld::Atom*>& textAtoms = textSection->atoms;
+    uint64_t foldedClassCount = 0;
+    uint64_t foldedAtomCount = 0;
+    std::unordered_set<ld::Internal::FinalSection*> changedSections;
     std::unordered_map<const ld::Atom*, const ld::Atom*> replacementMap;
-    for (auto& entry : map) {
-        const ld::Atom* masterAtom = entry.first;
-        std::vector<const ld::Atom*>& dups = entry.second;
-        atomsBeingComparedCount += dups.size();
-        if ( dups.size() == 1 )
+    for (const std::vector<uint32_t>& members : classMembers) {
+        if ( members.size() == 1 )
             continue;
-        if ( verbose )  {
-            dedupSavings += ((dups.size() - 1) * masterAtom->size());
-            fprintf(stderr, "deduplicate the following %lu functions (%llu bytes apiece):\n", dups.size(), masterAtom->size());
-        }
-
-        for (const ld::Atom* dupAtom : dups) {
+        const ld::Atom* masterAtom = candidates[members.front()].atom;
+        ld::Internal::FinalSection* sect = state.sections[candidates[members.front()].sectionIndex];
+        ++foldedClassCount;
+        foldedAtomCount += (members.size() - 1);
+        dedupSavings += ((members.size() - 1) * masterAtom->size());
+        if ( verbose )
+            fprintf(stderr, "deduplicate the following %lu %s (%llu bytes apiece):\n", members.size(),
+                    (sect->type() == ld::Section::typeCode) ? "functions" : "data atoms", masterAtom->size());
+        for (uint32_t member : members) {
+            const ld::Atom* dupAtom = candidates[member].atom;
             if ( verbose )
                 fprintf(stderr, "    %s\n", dupAtom->name());
             if ( dupAtom == masterAtom )
                 continue;
             const ld::Atom* aliasAtom = new DeDupAliasAtom(dupAtom, masterAtom);
-            textAtoms.push_back(aliasAtom);
+            sect->atoms.push_back(aliasAtom);
             replacementMap[dupAtom] = aliasAtom;
             (const_cast<ld::Atom*>(dupAtom))->setCoalescedAway();
         }
+        changedSections.insert(sect);
     }
     if ( verbose )  {
-        fprintf(stderr, "deduplication saved %llu bytes of __text\n", dedupSavings);
+        fprintf(stderr, "deduplication found %u classes among %lu atoms in %u rounds, folded %llu atoms into %llu\n",
+                classCount, candidates.size(), rounds, foldedAtomCount, foldedClassCount);
+        fprintf(stderr, "deduplication saved %llu bytes\n", dedupSavings);
     }
 
     if ( log ) {
@@ -346,8 +473,11 @@ void doPass(const Options& opts, ld::Internal& state)
 
     // walk all atoms and replace references to dups with references to alias
     // the replacement map is now read only so this can be done concurrently for all sections
-    dispatch_apply(state.sections.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+    // the fixup summary only tracks references to auto-hide code, so it can only be used if that is all that was folded
+    ld::trace::apply("dedup rewrite references", state.sections.size(), ^(size_t index) {
         for (const ld::Atom* atom : state.sections[index]->atoms) {
+            if ( onlyAutoHideCode && !atom->mayHaveFixups(ld::Atom::fixupsToAutoHideCode) )
+                continue;
             for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
                 std::unordered_map<const ld::Atom*, const ld::Atom*>::const_iterator pos;
                 switch ( fit->binding ) {
@@ -368,25 +498,24 @@ void doPass(const Options& opts, ld::Internal& state)
         }
     });
 
-    if ( log ) {
-        fprintf(stderr, "atoms before pruning:\n");
-        for (const ld::Atom* atom : textSection->atoms)
-            fprintf(stderr, "  %p (size=%llu) %s\n", atom, atom->size(), atom->name());
-    }
-    // remove replaced atoms from section
-    textSection->atoms.erase(std::remove_if(textSection->atoms.begin(), textSection->atoms.end(),
-                [&](const ld::Atom* atom) {
-                    return (replacementMap.count(atom) != 0);
-                }),
-                textSection->atoms.end());
-
-    if ( log ) {
-        fprintf(stderr, "atoms after pruning:\n");
-        for (const ld::Atom* atom : textSection->atoms)
-            fprintf(stderr, "  %p (size=%llu) %s\n", atom, atom->size(), atom->name());
+    // remove replaced atoms from sections
+    for (ld::Internal::FinalSection* sect : changedSections) {
+        if ( log ) {
+            fprintf(stderr, "atoms before pruning:\n");
+            for (const ld::Atom* atom : sect->atoms)
+                fprintf(stderr, "  %p (size=%llu) %s\n", atom, atom->size(), atom->name());
+        }
+        sect->atoms.erase(std::remove_if(sect->atoms.begin(), sect->atoms.end(),
+                    [&](const ld::Atom* atom) {
+                        return (replacementMap.count(atom) != 0);
+                    }),
+                    sect->atoms.end());
+        if ( log ) {
+            fprintf(stderr, "atoms after pruning:\n");
+            for (const ld::Atom* atom : sect->atoms)
+                fprintf(stderr, "  %p (size=%llu) %s\n", atom, atom->size(), atom->name());
+        }
     }
-
-   //fprintf(stderr, "hash-count=%lu, fixup-compares=%lu, atom-count=%u\n", sHashCount, sFixupCompareCount, atomsBeingComparedCount);
 }
 
 
@@ -32,9 +32,11 @@
 
 #include <vector>
 #include <map>
+#include <algorithm>
 
 #include "ld.hpp"
 #include "compact_unwind.h"
+#include "Trace.h"
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
 
@@ -86,6 +88,15 @@ private:
 
 	typedef macho_unwind_info_compressed_second_level_page_header<P> CSLP;
 
+	struct SecondLevelPage {
+		unsigned int										startIndex;
+		unsigned int										endIndex;
+		uint8_t*											pageStart;
+		bool												compressed;
+		std::map<compact_unwind_encoding_t, unsigned int>	pageSpecificEncodings;
+		std::vector<ld::Fixup>								fixups;
+	};
+
 	bool						encodingMeansUseDwarf(compact_unwind_encoding_t enc);
 	bool						encodingCannotBeMerged(compact_unwind_encoding_t enc);
 	void						compressDuplicates(const std::vector<UnwindEntry>& entries,
@@ -96,15 +107,17 @@ private:
 													std::map<compact_unwind_encoding_t, unsigned int>& commonEncodings);
 	void						makeLsdaIndex(const std::vector<UnwindEntry>& entries, std::vector<LSDAEntry>& lsdaIndex, 
 																std::map<const ld::Atom*, uint32_t>& lsdaIndexOffsetMap);
-	unsigned int				makeCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
-													const std::map<compact_unwind_encoding_t,unsigned int> commonEncodings,  
-													uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd);
-	unsigned int				makeRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, uint32_t pageSize,  
-															unsigned int endIndex, uint8_t*& pageEnd);
-	void						addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc);
-	void						addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde);
-	void						addRegularAddressFixup(uint32_t offset, const ld::Atom* func);
-	void						addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde);
+	unsigned int				layoutCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
+													const std::map<compact_unwind_encoding_t,unsigned int>& commonEncodings,  
+													uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd, SecondLevelPage& page);
+	unsigned int				layoutRegularSecondLevelPage(uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd, SecondLevelPage& page);
+	void						fillCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
+													const std::map<compact_unwind_encoding_t,unsigned int>& commonEncodings, SecondLevelPage& page);
+	void						fillRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, SecondLevelPage& page);
+	void						addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc);
+	void						addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde);
+	void						addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func);
+	void						addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde);
 	void						addImageOffsetFixup(uint32_t offset, const ld::Atom* targ);
 	void						addImageOffsetFixupPlusAddend(uint32_t offset, const ld::Atom* targ, uint32_t addend);
 
@@ -176,27 +189,36 @@ UnwindInfoAtom<A>::UnwindInfoAtom(const std::vector<UnwindEntry>& entries, uint6
 		maxLastPageSize = 4096;
 	}
 	
-	// fill in pages in reverse order
-	const ld::Atom* secondLevelFirstFuncs[pageCount*3];
-	uint8_t* secondLevelPagesStarts[pageCount*3];
+	// lay out pages in reverse order, each page boundary depends on how many entries fit in the page after it
+	std::vector<SecondLevelPage> secondLevelPages;
 	unsigned int endIndex = uniqueEntries.size();
-	unsigned int secondLevelPageCount = 0;
 	uint8_t* pageEnd = &_pageAlignedPages[pageCount*4096];
 	uint32_t pageSize = maxLastPageSize;
 	while ( endIndex > 0 ) {
-		endIndex = makeCompressedSecondLevelPage(uniqueEntries, commonEncodings, pageSize, endIndex, pageEnd);
-		secondLevelPagesStarts[secondLevelPageCount] = pageEnd;
-		secondLevelFirstFuncs[secondLevelPageCount] = uniqueEntries[endIndex].func;
-		++secondLevelPageCount;
+		secondLevelPages.emplace_back();
+		endIndex = layoutCompressedSecondLevelPage(uniqueEntries, commonEncodings, pageSize, endIndex, pageEnd, secondLevelPages.back());
 		// if this requires more than one page, align so that next starts on page boundary
 		if ( (pageSize != 4096) && (endIndex > 0) ) {
 			pageEnd = (uint8_t*)((uintptr_t)(pageEnd) & -4096);
 			pageSize = 4096;  // last page can be odd size, make rest up to 4096 bytes in size
 		}
 	}
+	const unsigned int secondLevelPageCount = secondLevelPages.size();
 	_pages = pageEnd;
 	_pagesSize = &_pageAlignedPages[pageCount*4096] - pageEnd;
 
+	// with boundaries known, pages are filled in independently
+	SecondLevelPage* pagesArray = secondLevelPages.data();
+	const std::vector<UnwindEntry>* uniqueEntriesPtr = &uniqueEntries;
+	const std::map<compact_unwind_encoding_t, unsigned int>* commonEncodingsPtr = &commonEncodings;
+	ld::trace::apply("fill unwind info pages", secondLevelPageCount, ^(size_t index) {
+		SecondLevelPage& page = pagesArray[index];
+		if ( page.compressed )
+			this->fillCompressedSecondLevelPage(*uniqueEntriesPtr, *commonEncodingsPtr, page);
+		else
+			this->fillRegularSecondLevelPage(*uniqueEntriesPtr, page);
+	});
+
 	// calculate section layout
 	const uint32_t commonEncodingsArraySectionOffset = sizeof(macho_unwind_info_section_header<P>);
 	const uint32_t commonEncodingsArrayCount = commonEncodings.size();
@@ -212,10 +234,13 @@ UnwindInfoAtom<A>::UnwindInfoAtom(const std::vector<UnwindEntry>& entries, uint6
 	const uint32_t lsdaIndexArraySize = lsdaIndexArrayCount * sizeof(macho_unwind_info_section_header_lsda_index_entry<P>);
 	const uint32_t headerEndSectionOffset = lsdaIndexArraySectionOffset + lsdaIndexArraySize;
 
-	// now that we know the size of the header, slide all existing fixups on the pages
+	// now that we know the size of the header, slide all fixups on the pages and gather them in page order
 	const int32_t fixupSlide = headerEndSectionOffset + (_pageAlignedPages - _pages);
-	for(std::vector<ld::Fixup>::iterator it = _fixups.begin(); it != _fixups.end(); ++it) {
-		it->offsetInAtom += fixupSlide;
+	for (SecondLevelPage& page : secondLevelPages) {
+		for (ld::Fixup& fixup : page.fixups) {
+			fixup.offsetInAtom += fixupSlide;
+			_fixups.push_back(fixup);
+		}
 	}
 
 	// allocate and fill in section header
@@ -249,10 +274,11 @@ UnwindInfoAtom<A>::UnwindInfoAtom(const std::vector<UnwindEntry>& entries, uint6
 	for (unsigned int i=0; i < secondLevelPageCount; ++i) {
 		unsigned int reverseIndex = secondLevelPageCount - 1 - i;
 		indexTable[i].set_functionOffset(0);
-		indexTable[i].set_secondLevelPagesSectionOffset(secondLevelPagesStarts[reverseIndex]-_pages+headerEndSectionOffset);
-		indexTable[i].set_lsdaIndexArraySectionOffset(lsdaIndexOffsetMap[secondLevelFirstFuncs[reverseIndex]]+lsdaIndexArraySectionOffset); 
+		const ld::Atom* firstFunc = uniqueEntries[secondLevelPages[reverseIndex].startIndex].func;
+		indexTable[i].set_secondLevelPagesSectionOffset(secondLevelPages[reverseIndex].pageStart-_pages+headerEndSectionOffset);
+		indexTable[i].set_lsdaIndexArraySectionOffset(lsdaIndexOffsetMap[firstFunc]+lsdaIndexArraySectionOffset); 
 		refOffset = (uint8_t*)&indexTable[i] - _header;
-		this->addImageOffsetFixup(refOffset, secondLevelFirstFuncs[reverseIndex]);
+		this->addImageOffsetFixup(refOffset, firstFunc);
 	}
 	indexTable[secondLevelPageCount].set_functionOffset(0);
 	indexTable[secondLevelPageCount].set_secondLevelPagesSectionOffset(0);
@@ -364,17 +390,44 @@ void UnwindInfoAtom<A>::compressDuplicates(const std::vector<UnwindEntry>& entri
 template <typename A>
 void UnwindInfoAtom<A>::makePersonalityIndexes(std::vector<UnwindEntry>& entries, std::map<const ld::Atom*, uint32_t>& personalityIndexMap)
 {
-	for(std::vector<UnwindEntry>::iterator it=entries.begin(); it != entries.end(); ++it) {
-		if ( it->personalityPointer != NULL ) {
-			std::map<const ld::Atom*, uint32_t>::iterator pos = personalityIndexMap.find(it->personalityPointer);
-			if ( pos == personalityIndexMap.end() ) {
+	// each range lists its personality routines in order of first use, so merging the lists
+	// in range order numbers them just as a serial walk of all entries would
+	const size_t kEntriesPerRange = 1024;
+	const size_t rangeCount = (entries.size() + kEntriesPerRange - 1) / kEntriesPerRange;
+	std::vector<std::vector<const ld::Atom*>> rangePersonalities(rangeCount);
+	std::vector<const ld::Atom*>* personalitiesArray = rangePersonalities.data();
+	UnwindEntry* entriesArray = entries.data();
+	const size_t entryCount = entries.size();
+	ld::trace::apply("find personalities", rangeCount, ^(size_t index) {
+		std::vector<const ld::Atom*>& personalities = personalitiesArray[index];
+		const size_t end = std::min(entryCount, (index + 1) * kEntriesPerRange);
+		for (size_t i=index * kEntriesPerRange; i < end; ++i) {
+			const ld::Atom* personality = entriesArray[i].personalityPointer;
+			if ( (personality != NULL) && (std::find(personalities.begin(), personalities.end(), personality) == personalities.end()) )
+				personalities.push_back(personality);
+		}
+	});
+	for (const std::vector<const ld::Atom*>& personalities : rangePersonalities) {
+		for (const ld::Atom* personality : personalities) {
+			if ( personalityIndexMap.find(personality) == personalityIndexMap.end() ) {
 				const uint32_t nextIndex = personalityIndexMap.size() + 1;
-				personalityIndexMap[it->personalityPointer] = nextIndex;
+				personalityIndexMap[personality] = nextIndex;
 			}
-			uint32_t personalityIndex = personalityIndexMap[it->personalityPointer];
-			it->encoding |= (personalityIndex << (__builtin_ctz(UNWIND_PERSONALITY_MASK)) );
 		}
 	}
+
+	// update encodings with personality index
+	const std::map<const ld::Atom*, uint32_t>* indexMap = &personalityIndexMap;
+	ld::trace::apply("set personality indexes", rangeCount, ^(size_t index) {
+		const size_t end = std::min(entryCount, (index + 1) * kEntriesPerRange);
+		for (size_t i=index * kEntriesPerRange; i < end; ++i) {
+			UnwindEntry& entry = entriesArray[i];
+			if ( entry.personalityPointer != NULL ) {
+				uint32_t personalityIndex = indexMap->find(entry.personalityPointer)->second;
+				entry.encoding |= (personalityIndex << (__builtin_ctz(UNWIND_PERSONALITY_MASK)) );
+			}
+		}
+	});
 	if (_s_log) fprintf(stderr, "makePersonalityIndexes() %lu personality routines used\n", personalityIndexMap.size()); 
 }
 
@@ -383,34 +436,42 @@ template <typename A>
 void UnwindInfoAtom<A>::findCommonEncoding(const std::vector<UnwindEntry>& entries, 
 											std::map<compact_unwind_encoding_t, unsigned int>& commonEncodings)
 {
-	// scan infos to get frequency counts for each encoding
-	std::map<compact_unwind_encoding_t, unsigned int> encodingsUsed;
-	unsigned int mostCommonEncodingUsageCount = 0;
-	for(std::vector<UnwindEntry>::const_iterator it=entries.begin(); it != entries.end(); ++it) {
-		// never put dwarf into common table
-		if ( encodingMeansUseDwarf(it->encoding) )
-			continue;
-		std::map<compact_unwind_encoding_t, unsigned int>::iterator pos = encodingsUsed.find(it->encoding);
-		if ( pos == encodingsUsed.end() ) {
-			encodingsUsed[it->encoding] = 1;
-		}
-		else {
-			encodingsUsed[it->encoding] += 1;
-			if ( mostCommonEncodingUsageCount < encodingsUsed[it->encoding] )
-				mostCommonEncodingUsageCount = encodingsUsed[it->encoding];
+	// scan infos in parallel ranges to get frequency counts for each encoding, then merge the counts
+	typedef std::map<compact_unwind_encoding_t, unsigned int> EncodingCounts;
+	const size_t kEntriesPerRange = 1024;
+	const size_t rangeCount = (entries.size() + kEntriesPerRange - 1) / kEntriesPerRange;
+	std::vector<EncodingCounts> rangeCounts(rangeCount);
+	EncodingCounts* countsArray = rangeCounts.data();
+	const UnwindEntry* entriesArray = entries.data();
+	const size_t entryCount = entries.size();
+	ld::trace::apply("count encodings", rangeCount, ^(size_t index) {
+		EncodingCounts& counts = countsArray[index];
+		const size_t end = std::min(entryCount, (index + 1) * kEntriesPerRange);
+		for (size_t i=index * kEntriesPerRange; i < end; ++i) {
+			// never put dwarf into common table
+			if ( encodingMeansUseDwarf(entriesArray[i].encoding) )
+				continue;
+			counts[entriesArray[i].encoding] += 1;
 		}
+	});
+	EncodingCounts encodingsUsed;
+	for (const EncodingCounts& counts : rangeCounts) {
+		for (const auto& count : counts)
+			encodingsUsed[count.first] += count.second;
 	}
+
 	// put the most common encodings into the common table, but at most 127 of them
-	for(unsigned int usages=mostCommonEncodingUsageCount; usages > 1; --usages) {
-		for (std::map<compact_unwind_encoding_t, unsigned int>::iterator euit=encodingsUsed.begin(); euit != encodingsUsed.end(); ++euit) {
-			if ( euit->second == usages ) {
-				unsigned int sz = commonEncodings.size();
-				if ( sz < 127 ) {
-					commonEncodings[euit->first] = sz;
-				}
-			}
-		}
+	// encodings used only once are never common, ties go to the lower encoding
+	std::vector<std::pair<compact_unwind_encoding_t, unsigned int>> byUsage;
+	for (const auto& used : encodingsUsed) {
+		if ( used.second > 1 )
+			byUsage.push_back(used);
 	}
+	std::stable_sort(byUsage.begin(), byUsage.end(), [](const std::pair<compact_unwind_encoding_t, unsigned int>& lhs, const std::pair<compact_unwind_encoding_t, unsigned int>& rhs) {
+		return lhs.second > rhs.second;
+	});
+	for (size_t i=0; (i < byUsage.size()) && (i < 127); ++i)
+		commonEncodings[byUsage[i].first] = i;
 	if (_s_log) fprintf(stderr, "findCommonEncoding() %lu common encodings found\n", commonEncodings.size()); 
 }
 
@@ -432,164 +493,164 @@ void UnwindInfoAtom<A>::makeLsdaIndex(const std::vector<UnwindEntry>& entries, s
 
 
 template <>
-void UnwindInfoAtom<x86>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<x86>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<x86_64>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<arm64>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 #if SUPPORT_ARCH_arm64_32
 template <>
-void UnwindInfoAtom<arm64_32>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<arm64_32>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 #endif
 
 template <>
-void UnwindInfoAtom<arm>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<arm>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
 	if ( fromFunc->isThumb() ) {
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of4, ld::Fixup::kindSetTargetAddress, func));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of4, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of4, ld::Fixup::kindSubtractAddend, 1));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k4of4, ld::Fixup::kindStoreLittleEndianLow24of32));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of4, ld::Fixup::kindSetTargetAddress, func));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of4, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of4, ld::Fixup::kindSubtractAddend, 1));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k4of4, ld::Fixup::kindStoreLittleEndianLow24of32));
 	}
 	else {
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 	}
 }
 
 template <>
-void UnwindInfoAtom<x86>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86_64>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm64>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 #if SUPPORT_ARCH_arm64_32
 template <>
-void UnwindInfoAtom<arm64_32>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm64_32>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 #endif
 
 template <>
-void UnwindInfoAtom<arm>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<x86>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<x86_64>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<arm64>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 #if SUPPORT_ARCH_arm64_32
 template <>
-void UnwindInfoAtom<arm64_32>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<arm64_32>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 #endif
 
 template <>
-void UnwindInfoAtom<arm>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<arm>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<x86>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86_64>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm64>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 #if SUPPORT_ARCH_arm64_32
 template <>
-void UnwindInfoAtom<arm64_32>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm64_32>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 #endif
 
 template <>
-void UnwindInfoAtom<arm>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
@@ -675,51 +736,62 @@ void UnwindInfoAtom<arm>::addImageOffsetFixupPlusAddend(uint32_t offset, const l
 
 
 template <typename A>
-unsigned int UnwindInfoAtom<A>::makeRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, uint32_t pageSize,  
-															unsigned int endIndex, uint8_t*& pageEnd)
+unsigned int UnwindInfoAtom<A>::layoutRegularSecondLevelPage(uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd, SecondLevelPage& page)
 {
 	const unsigned int maxEntriesPerPage = (pageSize - sizeof(unwind_info_regular_second_level_page_header))/sizeof(unwind_info_regular_second_level_entry);
 	const unsigned int entriesToAdd = ((endIndex > maxEntriesPerPage) ? maxEntriesPerPage : endIndex);
 	uint8_t* pageStart = pageEnd 
 						- entriesToAdd*sizeof(unwind_info_regular_second_level_entry) 
 						- sizeof(unwind_info_regular_second_level_page_header);
-	macho_unwind_info_regular_second_level_page_header<P>* page = (macho_unwind_info_regular_second_level_page_header<P>*)pageStart;
-	page->set_kind(UNWIND_SECOND_LEVEL_REGULAR);
-	page->set_entryPageOffset(sizeof(macho_unwind_info_regular_second_level_page_header<P>));
-	page->set_entryCount(entriesToAdd);
-	macho_unwind_info_regular_second_level_entry<P>* entryTable = (macho_unwind_info_regular_second_level_entry<P>*)(pageStart + page->entryPageOffset());
+	page.startIndex = endIndex - entriesToAdd;
+	page.endIndex = endIndex;
+	page.pageStart = pageStart;
+	page.compressed = false;
+	if (_s_log) fprintf(stderr, "regular page with %u entries\n", entriesToAdd);
+	pageEnd = pageStart;
+	return endIndex - entriesToAdd;
+}
+
+
+template <typename A>
+void UnwindInfoAtom<A>::fillRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, SecondLevelPage& page)
+{
+	const unsigned int entriesToAdd = page.endIndex - page.startIndex;
+	macho_unwind_info_regular_second_level_page_header<P>* header = (macho_unwind_info_regular_second_level_page_header<P>*)page.pageStart;
+	header->set_kind(UNWIND_SECOND_LEVEL_REGULAR);
+	header->set_entryPageOffset(sizeof(macho_unwind_info_regular_second_level_page_header<P>));
+	header->set_entryCount(entriesToAdd);
+	macho_unwind_info_regular_second_level_entry<P>* entryTable = (macho_unwind_info_regular_second_level_entry<P>*)(page.pageStart + header->entryPageOffset());
+	page.fixups.reserve(entriesToAdd*2);
 	for (unsigned int i=0; i < entriesToAdd; ++i) {
-		const UnwindEntry& info = uniqueInfos[endIndex-entriesToAdd+i];
+		const UnwindEntry& info = uniqueInfos[page.startIndex+i];
 		entryTable[i].set_functionOffset(0);
 		entryTable[i].set_encoding(info.encoding);
 		// add fixup for address part of entry
 		uint32_t offset = (uint8_t*)(&entryTable[i]) - _pageAlignedPages;
-		this->addRegularAddressFixup(offset, info.func);
+		this->addRegularAddressFixup(page.fixups, offset, info.func);
 		if ( encodingMeansUseDwarf(info.encoding) ) {
 			// add fixup for dwarf offset part of page specific encoding
 			uint32_t encOffset = (uint8_t*)(&entryTable[i]) - _pageAlignedPages;
-			this->addRegularFDEOffsetFixup(encOffset, info.fde);
+			this->addRegularFDEOffsetFixup(page.fixups, encOffset, info.fde);
 		}
 	}
-	if (_s_log) fprintf(stderr, "regular page with %u entries\n", entriesToAdd);
-	pageEnd = pageStart;
-	return endIndex - entriesToAdd;
 }
 
 
 template <typename A>
-unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
-													const std::map<compact_unwind_encoding_t,unsigned int> commonEncodings,  
-													uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd)
+unsigned int UnwindInfoAtom<A>::layoutCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
+													const std::map<compact_unwind_encoding_t,unsigned int>& commonEncodings,  
+													uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd, SecondLevelPage& page)
 {
-	if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(pageSize=%u, endIndex=%u)\n", pageSize, endIndex);
-	// first pass calculates how many compressed entries we could fit in this sized page
+	if (_s_log) fprintf(stderr, "layoutCompressedSecondLevelPage(pageSize=%u, endIndex=%u)\n", pageSize, endIndex);
+	// calculate how many compressed entries we could fit in this sized page
 	// keep adding entries to page until:
 	//  1) encoding table plus entry table plus header exceed page size
 	//  2) the file offset delta from the first to last function > 24 bits
 	//  3) custom encoding index reaches 255
 	//  4) run out of uniqueInfos to encode
-	std::map<compact_unwind_encoding_t, unsigned int> pageSpecificEncodings;
+	std::map<compact_unwind_encoding_t, unsigned int>& pageSpecificEncodings = page.pageSpecificEncodings;
 	uint32_t space4 =  (pageSize - sizeof(unwind_info_compressed_second_level_page_header))/sizeof(uint32_t);
 	int index = endIndex-1;
 	int entryCount = 0;
@@ -732,7 +804,7 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 		std::map<compact_unwind_encoding_t, unsigned int>::const_iterator pos = commonEncodings.find(info.encoding);
 		if ( pos != commonEncodings.end() ) {
 			encodingIndex = pos->second;
-			if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(): funcIndex=%d, re-use commonEncodings[%d]=0x%08X\n", index, encodingIndex, info.encoding);
+			if (_s_log) fprintf(stderr, "layoutCompressedSecondLevelPage(): funcIndex=%d, re-use commonEncodings[%d]=0x%08X\n", index, encodingIndex, info.encoding);
 		}
 		else {
 			// no commmon entry, so add one on this page
@@ -744,13 +816,13 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 			std::map<compact_unwind_encoding_t, unsigned int>::iterator ppos = pageSpecificEncodings.find(encoding);
 			if ( ppos != pageSpecificEncodings.end() ) {
 				encodingIndex = pos->second;
-				if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(): funcIndex=%d, re-use pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
+				if (_s_log) fprintf(stderr, "layoutCompressedSecondLevelPage(): funcIndex=%d, re-use pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
 			}
 			else {
 				encodingIndex = commonEncodings.size() + pageSpecificEncodings.size();
 				if ( encodingIndex <= 255 ) {
 					pageSpecificEncodings[encoding] = encodingIndex;
-					if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(): funcIndex=%d, pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
+					if (_s_log) fprintf(stderr, "layoutCompressedSecondLevelPage(): funcIndex=%d, pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
 				}
 				else {
 					canDo = false; // case 3)
@@ -785,7 +857,7 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 	if ( (compressPageUsed < (pageSize-4) && (index >= 0) ) ) {
 		const int regularEntriesPerPage = (pageSize - sizeof(unwind_info_regular_second_level_page_header))/sizeof(unwind_info_regular_second_level_entry);
 		if ( entryCount < regularEntriesPerPage ) {
-			return makeRegularSecondLevelPage(uniqueInfos, pageSize, endIndex, pageEnd);
+			return layoutRegularSecondLevelPage(pageSize, endIndex, pageEnd, page);
 		}
 	}
 	
@@ -794,17 +866,37 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 	if ( compressPageUsed == (pageSize-4) )
 		pad = 4;
 
-	// second pass fills in page 
 	uint8_t* pageStart = pageEnd - compressPageUsed - pad;
-	CSLP* page = (CSLP*)pageStart;
-	page->set_kind(UNWIND_SECOND_LEVEL_COMPRESSED);
-	page->set_entryPageOffset(sizeof(CSLP));
-	page->set_entryCount(entryCount);
-	page->set_encodingsPageOffset(page->entryPageOffset()+entryCount*sizeof(uint32_t));
-	page->set_encodingsCount(pageSpecificEncodings.size());
-	uint32_t* const encodingsArray = (uint32_t*)&pageStart[page->encodingsPageOffset()];
+	page.startIndex = endIndex - entryCount;
+	page.endIndex = endIndex;
+	page.pageStart = pageStart;
+	page.compressed = true;
+	if (_s_log) fprintf(stderr, "compressed page with %u entries, %lu custom encodings\n", entryCount, pageSpecificEncodings.size());
+	
+	// update pageEnd;
+	pageEnd = pageStart;
+	return endIndex-entryCount;  // endIndex for next page
+}
+
+
+template <typename A>
+void UnwindInfoAtom<A>::fillCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
+													const std::map<compact_unwind_encoding_t,unsigned int>& commonEncodings, SecondLevelPage& page)
+{
+	const unsigned int endIndex = page.endIndex;
+	const unsigned int entryCount = page.endIndex - page.startIndex;
+	std::map<compact_unwind_encoding_t, unsigned int>& pageSpecificEncodings = page.pageSpecificEncodings;
+	uint8_t* pageStart = page.pageStart;
+	CSLP* header = (CSLP*)pageStart;
+	header->set_kind(UNWIND_SECOND_LEVEL_COMPRESSED);
+	header->set_entryPageOffset(sizeof(CSLP));
+	header->set_entryCount(entryCount);
+	header->set_encodingsPageOffset(header->entryPageOffset()+entryCount*sizeof(uint32_t));
+	header->set_encodingsCount(pageSpecificEncodings.size());
+	uint32_t* const encodingsArray = (uint32_t*)&pageStart[header->encodingsPageOffset()];
 	// fill in entry table
-	uint32_t* const entiresArray = (uint32_t*)&pageStart[page->entryPageOffset()];
+	page.fixups.reserve(entryCount*3);
+	uint32_t* const entiresArray = (uint32_t*)&pageStart[header->entryPageOffset()];
 	const ld::Atom* firstFunc = uniqueInfos[endIndex-entryCount].func;
 	for(unsigned int i=endIndex-entryCount; i < endIndex; ++i) {
 		const UnwindEntry& info = uniqueInfos[i];
@@ -825,23 +917,17 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 		E::set32(entiresArray[entryIndex], encodingIndex << 24);
 		// add fixup for address part of entry
 		uint32_t offset = (uint8_t*)(&entiresArray[entryIndex]) - _pageAlignedPages;
-		this->addCompressedAddressOffsetFixup(offset, info.func, firstFunc);
+		this->addCompressedAddressOffsetFixup(page.fixups, offset, info.func, firstFunc);
 		if ( encodingMeansUseDwarf(info.encoding) ) {
 			// add fixup for dwarf offset part of page specific encoding
 			uint32_t encOffset = (uint8_t*)(&encodingsArray[encodingIndex-commonEncodings.size()]) - _pageAlignedPages;
-			this->addCompressedEncodingFixup(encOffset, info.fde);
+			this->addCompressedEncodingFixup(page.fixups, encOffset, info.fde);
 		}
 	}
 	// fill in encodings table
 	for(std::map<uint32_t, unsigned int>::const_iterator it = pageSpecificEncodings.begin(); it != pageSpecificEncodings.end(); ++it) {
 		E::set32(encodingsArray[it->second-commonEncodings.size()], it->first);
 	}
-	
-	if (_s_log) fprintf(stderr, "compressed page with %u entries, %lu custom encodings\n", entryCount, pageSpecificEncodings.size());
-	
-	// update pageEnd;
-	pageEnd = pageStart;
-	return endIndex-entryCount;  // endIndex for next page
 }
 
 
@@ -869,28 +955,50 @@ static uint64_t calculateEHFrameSize(ld::Internal& state)
 	return size;
 }
 
+static uint64_t alignAtomAddress(uint64_t address, const ld::Atom* atom)
+{
+	// adjust address for atom alignment
+	uint64_t alignment = 1 << atom->alignment().powerOf2;
+	uint64_t currentModulus = (address % alignment);
+	uint64_t requiredModulus = atom->alignment().modulus;
+	if ( currentModulus != requiredModulus ) {
+		if ( requiredModulus > currentModulus )
+			address += requiredModulus-currentModulus;
+		else
+			address += requiredModulus+alignment-currentModulus;
+	}
+	return address;
+}
+
 static void getAllUnwindInfos(const ld::Internal& state, std::vector<UnwindEntry>& entries)
 {
-	uint64_t address = 0;
-	for (std::vector<ld::Internal::FinalSection*>::const_iterator sit=state.sections.begin(); sit != state.sections.end(); ++sit) {
-		ld::Internal::FinalSection* sect = *sit;
-		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
-			const ld::Atom* atom = *ait;
-			// adjust address for atom alignment
-			uint64_t alignment = 1 << atom->alignment().powerOf2;
-			uint64_t currentModulus = (address % alignment);
-			uint64_t requiredModulus = atom->alignment().modulus;
-			if ( currentModulus != requiredModulus ) {
-				if ( requiredModulus > currentModulus )
-					address += requiredModulus-currentModulus;
-				else
-					address += requiredModulus+alignment-currentModulus;
-			}
+	// tentative addresses of each range of atoms are found serially, then ranges are scanned in parallel
+	struct AtomRange { const ld::Atom* const* begin; const ld::Atom* const* end; uint64_t address; std::vector<UnwindEntry> entries; };
+	const size_t kAtomsPerRange = 1024;
+	std::vector<AtomRange> ranges;
+	uint64_t nextAddress = 0;
+	for (const ld::Internal::FinalSection* sect : state.sections) {
+		const ld::Atom* const* atoms = sect->atoms.data();
+		for (size_t i=0; i < sect->atoms.size(); ++i) {
+			if ( (i % kAtomsPerRange) == 0 )
+				ranges.push_back({ &atoms[i], &atoms[std::min(i+kAtomsPerRange, sect->atoms.size())], nextAddress, std::vector<UnwindEntry>() });
+			nextAddress = alignAtomAddress(nextAddress, atoms[i]) + atoms[i]->size();
+		}
+	}
+
+	AtomRange* rangesArray = ranges.data();
+	const ld::Internal* statePtr = &state;
+	ld::trace::apply("collect unwind infos", ranges.size(), ^(size_t index) {
+		AtomRange& range = rangesArray[index];
+		uint64_t address = range.address;
+		for (const ld::Atom* const* it = range.begin; it != range.end; ++it) {
+			const ld::Atom* atom = *it;
+			address = alignAtomAddress(address, atom);
 
 			if ( atom->beginUnwind() == atom->endUnwind() ) {
 				// be sure to mark that we have no unwind info for stuff in the TEXT segment without unwind info
 				if ( (atom->section().type() == ld::Section::typeCode) && (atom->size() !=0) ) {
-					entries.push_back(UnwindEntry(atom, address, 0, NULL, NULL, NULL, 0));
+					range.entries.push_back(UnwindEntry(atom, address, 0, NULL, NULL, NULL, 0));
 				}
 			}
 			else {
@@ -936,7 +1044,7 @@ static void getAllUnwindInfos(const ld::Internal& state, std::vector<UnwindEntry
 							if ( fit->kind == ld::Fixup::kindSetTargetAddress ) {
 								switch ( fit->binding ) {
 									case ld::Fixup::bindingsIndirectlyBound:
-										personalityPointer = state.indirectBindingTable[fit->u.bindingIndex];
+										personalityPointer = statePtr->indirectBindingTable[fit->u.bindingIndex];
 										assert(personalityPointer->section().type() == ld::Section::typeNonLazyPointer);
 										break;
 									case ld::Fixup::bindingDirectlyBound:
@@ -951,12 +1059,20 @@ static void getAllUnwindInfos(const ld::Internal& state, std::vector<UnwindEntry
 					}
 				}
 				for ( ld::Atom::UnwindInfo::iterator uit = atom->beginUnwind(); uit != atom->endUnwind(); ++uit ) {
-					entries.push_back(UnwindEntry(atom, address, uit->startOffset, fde, lsda, personalityPointer, uit->unwindInfo));
+					range.entries.push_back(UnwindEntry(atom, address, uit->startOffset, fde, lsda, personalityPointer, uit->unwindInfo));
 				}
 			}
 			address += atom->size();
 		}
-	}
+	});
+
+	// concatenate in section and atom order
+	size_t count = 0;
+	for (const AtomRange& range : ranges)
+		count += range.entries.size();
+	entries.reserve(count);
+	for (const AtomRange& range : ranges)
+		entries.insert(entries.end(), range.entries.begin(), range.entries.end());
 }
 
 
@@ -334,6 +334,8 @@ void doPass(const Options& opts, ld::Internal& state)
 		ld::Internal::FinalSection* sect = *sit;
 		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin();  ait != sect->atoms.end(); ++ait) {
 			const ld::Atom* atom = *ait;
+			if ( !atom->mayHaveFixups(ld::Atom::fixupsToProxy) )
+				continue;
 			const ld::Atom* target = NULL;
 			bool targetIsWeakImport = false;
 			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
@@ -0,0 +1,194 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2024 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+
+#include <stdint.h>
+#include <string.h>
+#include <dispatch/dispatch.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "ld.hpp"
+#include "fixup_index.h"
+#include "Trace.h"
+
+namespace ld {
+namespace passes {
+namespace fixup_index {
+
+//
+// Several passes used to each walk every fixup of every atom looking for the few
+// references they care about.  Instead, this pass walks all fixups once, concurrently,
+// and records in each atom which passes need to look at it.  The summary is computed
+// from fixup kinds and from the targets at this point of the link, so it has to stay a
+// superset of what each pass later looks for:
+//  - passes only retarget existing fixups to atoms they create or to atoms already referenced
+//  - atoms created after this pass are fixupsUnindexed and always get walked
+//
+
+static Statistics sStatistics;
+
+static bool isBranch(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
+		case ld::Fixup::kindStoreTargetAddressARMBranch24:
+		case ld::Fixup::kindStoreTargetAddressThumbBranch22:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64Branch26:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
+// must match the kinds handled by gotFixup() in got.cpp
+static bool usesGOT(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
+		case ld::Fixup::kindStoreX86PCRel32GOT:
+		case ld::Fixup::kindNoneGroupSubordinatePersonality:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPageOff12:
+		case ld::Fixup::kindStoreARM64PCRelToGOT:
+#endif
+#if SUPPORT_ARCH_riscv32
+		case ld::Fixup::kindStoreRISCVhi20PCRelGOT:
+		case ld::Fixup::kindStoreRISCVlo12PCRelGOT:
+		case ld::Fixup::kindStoreRISCVhi20GOT:
+		case ld::Fixup::kindStoreRISCVlo12GOT:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
+// must match the kinds handled by tlvp::doPass()
+static bool usesTLV(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
+		case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
+		case ld::Fixup::kindStoreX86PCRel32TLVLoad:
+		case ld::Fixup::kindStoreX86Abs32TLVLoad:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPageOff12:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
+static uint8_t summarize(const ld::Atom* atom, const ld::Internal& state)
+{
+	uint8_t summary = 0;
+	for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+		const ld::Atom* target = NULL;
+		switch ( fit->binding ) {
+			case ld::Fixup::bindingsIndirectlyBound:
+				// any pointer to a resolver function needs a stub, so all indirect references are stubable
+				summary |= ld::Atom::fixupsStubable;
+				target = state.indirectBindingTable[fit->u.bindingIndex];
+				break;
+			case ld::Fixup::bindingDirectlyBound:
+				if ( isBranch(fit->kind) )
+					summary |= ld::Atom::fixupsStubable;
+				target = fit->u.target;
+				break;
+			default:
+				break;
+		}
+		if ( target != NULL ) {
+			if ( target->definition() == ld::Atom::definitionProxy )
+				summary |= ld::Atom::fixupsToProxy;
+			if ( target->autoHide() && (target->section().type() == ld::Section::typeCode) )
+				summary |= ld::Atom::fixupsToAutoHideCode;
+		}
+		if ( usesGOT(fit->kind) )
+			summary |= ld::Atom::fixupsGOT;
+		if ( usesTLV(fit->kind) )
+			summary |= ld::Atom::fixupsTLV;
+	}
+	return summary;
+}
+
+
+void doPass(const Options& opts, ld::Internal& state)
+{
+	// split sections into chunks so a huge __text does not serialize the walk
+	struct Chunk { const ld::Atom* const* begin; const ld::Atom* const* end; };
+	const size_t kChunkSize = 1024;
+	std::vector<Chunk> chunks;
+	for (const ld::Internal::FinalSection* sect : state.sections) {
+		const ld::Atom* const* atoms = sect->atoms.data();
+		for (size_t i=0; i < sect->atoms.size(); i += kChunkSize)
+			chunks.push_back({ &atoms[i], &atoms[std::min(i+kChunkSize, sect->atoms.size())] });
+	}
+
+	Chunk* chunksArray = chunks.data();
+	ld::Internal* statePtr = &state;
+	bzero(&sStatistics, sizeof(sStatistics));
+	Statistics* stats = &sStatistics;
+	ld::trace::apply("index fixups", chunks.size(), ^(size_t index) {
+		Statistics counts;
+		bzero(&counts, sizeof(counts));
+		for (const ld::Atom* const* it = chunksArray[index].begin; it != chunksArray[index].end; ++it) {
+			ld::Atom* atom = const_cast<ld::Atom*>(*it);
+			uint8_t summary = summarize(atom, *statePtr);
+			atom->setFixupSummary(summary);
+			++counts.atoms;
+			counts.fixups         += atom->fixupsEnd() - atom->fixupsBegin();
+			counts.stubable       += ((summary & ld::Atom::fixupsStubable) != 0);
+			counts.got            += ((summary & ld::Atom::fixupsGOT) != 0);
+			counts.tlv            += ((summary & ld::Atom::fixupsTLV) != 0);
+			counts.toProxy        += ((summary & ld::Atom::fixupsToProxy) != 0);
+			counts.toAutoHideCode += ((summary & ld::Atom::fixupsToAutoHideCode) != 0);
+		}
+		__atomic_fetch_add(&stats->atoms,          counts.atoms,          __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stats->fixups,         counts.fixups,         __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stats->stubable,       counts.stubable,       __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stats->got,            counts.got,            __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stats->tlv,            counts.tlv,            __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stats->toProxy,        counts.toProxy,        __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stats->toAutoHideCode, counts.toAutoHideCode, __ATOMIC_RELAXED);
+	});
+}
+
+const Statistics& statistics()
+{
+	return sStatistics;
+}
+
+
+} // namespace fixup_index
+} // namespace passes 
+} // namespace ld 
@@ -0,0 +1,60 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2024 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+
+#ifndef __FIXUP_INDEX_H__
+#define __FIXUP_INDEX_H__
+
+#include "Options.h"
+#include "ld.hpp"
+
+
+namespace ld {
+namespace passes {
+namespace fixup_index {
+
+struct Statistics {
+	uint64_t	atoms;
+	uint64_t	fixups;
+	uint64_t	stubable;
+	uint64_t	got;
+	uint64_t	tlv;
+	uint64_t	toProxy;
+	uint64_t	toAutoHideCode;
+};
+
+// called by linker before the stubs, got, tlvp, dylibs and dedup passes so they only
+// walk the fixups of atoms that can be interesting to them
+extern void doPass(const Options& opts, ld::Internal& internal);
+
+// counts from the last doPass() for -print_statistics
+extern const Statistics& statistics();
+
+
+} // namespace fixup_index
+} // namespace passes 
+} // namespace ld 
+
+#endif // __FIXUP_INDEX_H__
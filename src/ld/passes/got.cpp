@@ -307,6 +307,8 @@ void doPass(const Options& opts, ld::Internal& internal)
 		ld::Internal::FinalSection* sect = *sit;
 		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin();  ait != sect->atoms.end(); ++ait) {
 			const ld::Atom* atom = *ait;
+			if ( !atom->mayHaveFixups(ld::Atom::fixupsGOT) )
+				continue;
 			bool atomUsesGOT = false;
 			const ld::Atom* targetOfGOT = NULL;
 			bool targetIsWeakImport = false;
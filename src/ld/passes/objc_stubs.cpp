@@ -490,6 +490,8 @@ void Pass::process()
                         msgSendAtom = atom; // switch GOT entry to point to _objc_msgSend in libobjc, rather than a proxy
                     }
                 }
+                if ( !atom->mayHaveFixups(ld::Atom::fixupsStubable) )
+                    continue;
                 for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
                     if ( const ld::Atom* stubableTargetOfFixup = msgSendCallSite(fit) ) {
                         // reserve slot and add fixup reference
@@ -34,10 +34,12 @@
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <span>
 
 #include "ld.hpp"
 #include "order.h"
+#include "Trace.h"
 
 namespace ld {
 namespace passes {
@@ -70,6 +72,12 @@ namespace order {
 // order_file, if any entry is in a cluster (in "starts" map), then the entire cluster is
 // given ordinal overrides.
 //
+// A -call_graph_order_file adds override ordinals after the order_file ones for the functions
+// in __text that the profile shows calling each other.  They are grouped with the C3 heuristic
+// (from the hfsort paper): in order of decreasing density (call count per byte), a function's
+// cluster is appended to the cluster of its most frequent caller, as long as the merged cluster
+// fits in a page and its density does not drop too far.  Clusters are then laid out densest first.
+//
 
 static const Atom* targetOfAliasAtom(const Atom* atom, const Internal& state)
 {
@@ -151,6 +159,9 @@ private:
 	void				buildFollowOnTables();
 	void				buildOrdinalOverrideMap();
 	const ld::Atom*		follower(const ld::Atom* atom);
+	void				buildCallGraphOrder(uint32_t& index);
+	void				addCallGraphOrdinal(const ld::Atom* atom, uint32_t& index);
+	uint64_t			textPagesTouched(const ld::Internal::FinalSection* text, const std::unordered_set<const ld::Atom*>& atoms);
 	static bool			matchesObjectFile(const ld::Atom* atom, const char* objectFileLeafName);
 			bool		possibleToOrder(const ld::Internal::FinalSection*);
 	
@@ -170,7 +181,8 @@ private:
 bool Layout::_s_log = false;
 
 Layout::Layout(const Options& opts, ld::Internal& state)
-	: _options(opts), _state(state), _comparer(*this), _haveOrderFile(opts.orderedSymbolsCount() != 0)
+	: _options(opts), _state(state), _comparer(*this),
+	  _haveOrderFile((opts.orderedSymbolsCount() != 0) || !opts.callGraphEdges().empty())
 {
 }
 
@@ -602,6 +614,10 @@ void Layout::buildOrdinalOverrideMap()
 		warning("only %u out of %lu order_file symbols were applicable", matchCount, _options.orderedSymbolsCount() );
 	}
 
+	// functions from a call graph profile are laid out after the order_file symbols
+	if ( !_options.callGraphEdges().empty() )
+		this->buildCallGraphOrder(index);
+
 	// <rdar://problem/8612550> When order file used on data, turn ordered zero fill symbols into zeroed data
 	if ( ! moveToData.empty() ) {
 		// <rdar://problem/14919139> only move zero fill symbols to __data if there is a __data section
@@ -634,6 +650,202 @@ void Layout::buildOrdinalOverrideMap()
 
 }
 
+void Layout::addCallGraphOrdinal(const ld::Atom* atom, uint32_t& index)
+{
+	AtomToAtom::iterator start = _followOnStarts.find(atom);
+	if ( start != _followOnStarts.end() ) {
+		// atom is in a cluster that must lay out together
+		for (const ld::Atom* nextAtom = start->second; nextAtom != NULL; nextAtom = _followOnNexts[nextAtom]) {
+			if ( _ordinalOverrideMap.count(nextAtom) == 0 )
+				_ordinalOverrideMap[nextAtom] = index++;
+		}
+	}
+	else if ( _ordinalOverrideMap.count(atom) == 0 ) {
+		_ordinalOverrideMap[atom] = index++;
+	}
+}
+
+// pages of __text that the given atoms overlap, if the section was laid out in the current sort order
+uint64_t Layout::textPagesTouched(const ld::Internal::FinalSection* text, const std::unordered_set<const ld::Atom*>& atoms)
+{
+	std::vector<const ld::Atom*> sorted;
+	sorted.reserve(text->atoms.size());
+	for (const ld::Atom* atom : text->atoms) {
+		if ( !atom->isAlias() )
+			sorted.push_back(atom);
+	}
+	std::sort(sorted.begin(), sorted.end(), _comparer);
+
+	const uint64_t pageSize = _options.segPageSize("__TEXT");
+	uint64_t offset = 0;
+	uint64_t pages = 0;
+	uint64_t lastPage = UINT64_MAX;
+	for (const ld::Atom* atom : sorted) {
+		const uint64_t alignment = 1ULL << atom->alignment().powerOf2;
+		const uint64_t modulus = atom->alignment().modulus;
+		uint64_t misalignment = (offset + alignment - modulus) % alignment;
+		if ( misalignment != 0 )
+			offset += alignment - misalignment;
+		if ( atoms.count(atom) != 0 ) {
+			uint64_t firstPage = offset / pageSize;
+			uint64_t endPage = (offset + std::max(atom->size(), (uint64_t)1) - 1) / pageSize;
+			pages += endPage - firstPage + 1;
+			if ( firstPage == lastPage )
+				--pages;
+			lastPage = endPage;
+		}
+		offset += atom->size();
+	}
+	return pages;
+}
+
+void Layout::buildCallGraphOrder(uint32_t& index)
+{
+	// C3 heuristic tuning from the hfsort paper: an edge must carry over a tenth of a function's
+	// calls to pull it into its caller's cluster, and a merge must not cut the caller's density by 8x
+	const uint64_t kMaxClusterSize = _options.segPageSize("__TEXT");
+	const uint64_t kMaxDensityDegradation = 8;
+	const uint64_t kMinEdgeFraction = 10;
+
+	struct Function {
+		const ld::Atom*	atom;
+		uint64_t		size;
+		uint64_t		weight		= 0;	// calls into the function
+		uint64_t		bestCount	= 0;
+		uint32_t		bestCaller	= UINT32_MAX;
+	};
+	struct Cluster {
+		std::vector<uint32_t>	functions;
+		uint64_t				size;
+		uint64_t				weight;
+		double density() const { return (double)weight / (double)size; }
+	};
+
+	// functions in __text from the profile, numbered in the order they first appear
+	std::vector<Function> functions;
+	std::unordered_map<const ld::Atom*, uint32_t> functionIndexes;
+	uint32_t unmatchedNames = 0;
+	auto findFunction = [&](const char* name) -> const ld::Atom* {
+		Options::OrderedSymbol symbol = { name, NULL };
+		const ld::Atom* atom = this->findAtom(symbol);
+		if ( (atom == NULL) || (atom->section().type() != ld::Section::typeCode) || atom->isAlias() ) {
+			++unmatchedNames;
+			return NULL;
+		}
+		// cold functions stay at the end of the section
+		if ( atom->cold() )
+			return NULL;
+		return atom;
+	};
+	auto functionIndex = [&](const ld::Atom* atom) -> uint32_t {
+		auto pos = functionIndexes.find(atom);
+		if ( pos != functionIndexes.end() )
+			return pos->second;
+		functionIndexes[atom] = (uint32_t)functions.size();
+		functions.push_back({ atom, std::max(atom->size(), (uint64_t)1) });
+		return (uint32_t)functions.size() - 1;
+	};
+	std::map<std::pair<uint32_t, uint32_t>, uint64_t> edgeCounts;
+	for (const Options::CallGraphEdge& edge : _options.callGraphEdges()) {
+		const ld::Atom* callerAtom = findFunction(edge.caller);
+		const ld::Atom* calleeAtom = findFunction(edge.callee);
+		if ( (callerAtom == NULL) || (calleeAtom == NULL) )
+			continue;
+		uint32_t caller = functionIndex(callerAtom);
+		uint32_t callee = functionIndex(calleeAtom);
+		functions[callee].weight += edge.count;
+		if ( caller != callee )
+			edgeCounts[std::make_pair(caller, callee)] += edge.count;
+	}
+	if ( _options.printOrderFileStatistics() && (unmatchedNames != 0) )
+		warning("%u call graph file symbol names are not functions in this image", unmatchedNames);
+	for (const auto& edge : edgeCounts) {
+		Function& callee = functions[edge.first.second];
+		if ( edge.second > callee.bestCount ) {
+			callee.bestCount = edge.second;
+			callee.bestCaller = edge.first.first;
+		}
+	}
+
+	// every function starts in its own cluster, merge clusters in order of decreasing density
+	std::vector<Cluster> clusters(functions.size());
+	std::vector<uint32_t> leaders(functions.size());
+	std::vector<uint32_t> byDensity(functions.size());
+	for (uint32_t i = 0; i < functions.size(); ++i) {
+		clusters[i].functions.push_back(i);
+		clusters[i].size = functions[i].size;
+		clusters[i].weight = functions[i].weight;
+		leaders[i] = i;
+		byDensity[i] = i;
+	}
+	auto leaderOf = [&](uint32_t i) {
+		while ( leaders[i] != i ) {
+			leaders[i] = leaders[leaders[i]];
+			i = leaders[i];
+		}
+		return i;
+	};
+	std::stable_sort(byDensity.begin(), byDensity.end(), [&](uint32_t a, uint32_t b) {
+		return clusters[a].density() > clusters[b].density();
+	});
+	for (uint32_t i : byDensity) {
+		// a function's cluster has not been merged into another one yet when it is visited
+		const Function& function = functions[i];
+		if ( (function.bestCaller == UINT32_MAX) || (function.bestCount * kMinEdgeFraction <= function.weight) )
+			continue;
+		uint32_t callerLeader = leaderOf(function.bestCaller);
+		if ( callerLeader == i )
+			continue;
+		Cluster& from = clusters[i];
+		Cluster& to = clusters[callerLeader];
+		if ( from.size + to.size > kMaxClusterSize )
+			continue;
+		double mergedDensity = (double)(from.weight + to.weight) / (double)(from.size + to.size);
+		if ( mergedDensity < to.density() / kMaxDensityDegradation )
+			continue;
+		to.functions.insert(to.functions.end(), from.functions.begin(), from.functions.end());
+		to.size += from.size;
+		to.weight += from.weight;
+		from.functions.clear();
+		leaders[i] = callerLeader;
+	}
+
+	std::vector<uint32_t> clusterOrder;
+	for (uint32_t i = 0; i < clusters.size(); ++i) {
+		if ( leaders[i] == i )
+			clusterOrder.push_back(i);
+	}
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) {
+		return clusters[a].density() > clusters[b].density();
+	});
+
+	const ld::Internal::FinalSection* text = NULL;
+	for (const ld::Internal::FinalSection* sect : _state.sections) {
+		if ( (sect->type() == ld::Section::typeCode) && (strcmp(sect->sectionName(), "__text") == 0) && (strcmp(sect->segmentName(), "__TEXT") == 0) )
+			text = sect;
+	}
+	const bool report = (text != NULL) && (_options.printOrderFileStatistics() || _options.printStatistics());
+	std::unordered_set<const ld::Atom*> profiled;
+	if ( report ) {
+		for (const Function& function : functions)
+			profiled.insert(function.atom);
+	}
+	uint64_t pagesBefore = report ? this->textPagesTouched(text, profiled) : 0;
+
+	for (uint32_t clusterIndex : clusterOrder) {
+		for (uint32_t i : clusters[clusterIndex].functions) {
+			if ( _s_log ) fprintf(stderr, "call graph order %u for %s in cluster of %s\n", index, functions[i].atom->name(), functions[clusterIndex].atom->name());
+			this->addCallGraphOrdinal(functions[i].atom, index);
+		}
+	}
+
+	if ( report ) {
+		uint64_t pagesAfter = this->textPagesTouched(text, profiled);
+		fprintf(stderr, "call graph order: %lu profiled functions in %lu clusters touch %llu __text pages, %llu before reordering\n",
+				functions.size(), clusterOrder.size(), pagesAfter, pagesBefore);
+	}
+}
+
 void Layout::doPass()
 {
 	const bool log = false;
@@ -655,7 +867,7 @@ void Layout::doPass()
 	this->buildOrdinalOverrideMap();
 
 	// sort atoms in each section
-	dispatch_apply(_state.sections.size(), DISPATCH_APPLY_AUTO, ^(size_t index) {
+	ld::trace::apply("sort section", _state.sections.size(), ^(size_t index) {
 		ld::Internal::FinalSection* sect = _state.sections[index];
 
 		bool needsSort = true;
@@ -376,26 +376,28 @@ void Pass::process(ld::Internal& state)
 	for (const ld::Internal::FinalSection* sect : state.sections) {
 		for (const ld::Atom* atom: sect->atoms) {
 			codeSize += atom->size();
-			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-				const ld::Atom* stubableTargetOfFixup = stubableFixup(fit, state);
-				if ( stubableTargetOfFixup != NULL ) {
-					const auto& [pos, inserted] = infoForAtom.try_emplace(stubableTargetOfFixup);
-					pos->second.references.push_back(fit);
-
-					if ( inserted ) {
-						// new entry, set weak import
-						pos->second.weakImport = fit->weakImport;
-					} else if ( pos->second.weakImport != fit->weakImport ) {
-						// handle weak import mismatch
-						switch ( _options.weakReferenceMismatchTreatment() ) {
-							case Options::kWeakReferenceMismatchError:
-								throwf("mismatching weak references for symbol: %s", stubableTargetOfFixup->name());
-							case Options::kWeakReferenceMismatchWeak:
-								pos->second.weakImport = true;
-								break;
-							case Options::kWeakReferenceMismatchNonWeak:
-								pos->second.weakImport = false;
-								break;
+			if ( atom->mayHaveFixups(ld::Atom::fixupsStubable) ) {
+				for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+					const ld::Atom* stubableTargetOfFixup = stubableFixup(fit, state);
+					if ( stubableTargetOfFixup != NULL ) {
+						const auto& [pos, inserted] = infoForAtom.try_emplace(stubableTargetOfFixup);
+						pos->second.references.push_back(fit);
+
+						if ( inserted ) {
+							// new entry, set weak import
+							pos->second.weakImport = fit->weakImport;
+						} else if ( pos->second.weakImport != fit->weakImport ) {
+							// handle weak import mismatch
+							switch ( _options.weakReferenceMismatchTreatment() ) {
+								case Options::kWeakReferenceMismatchError:
+									throwf("mismatching weak references for symbol: %s", stubableTargetOfFixup->name());
+								case Options::kWeakReferenceMismatchWeak:
+									pos->second.weakImport = true;
+									break;
+								case Options::kWeakReferenceMismatchNonWeak:
+									pos->second.weakImport = false;
+									break;
+							}
 						}
 					}
 				}
@@ -123,6 +123,8 @@ void doPass(const Options& opts, ld::Internal& internal)
 		ld::Internal::FinalSection* sect = *sit;
 		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
 			const ld::Atom* atom = *ait;
+			if ( !atom->mayHaveFixups(ld::Atom::fixupsTLV) )
+				continue;
 			TlVReferenceCluster ref;
 			for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
 				if ( fit->firstInCluster() ) {
@@ -27,11 +27,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <mach-o/loader.h>
+#include <dispatch/dispatch.h>
+
+#include <algorithm>
+#include <atomic>
 
 #include "ExportsTrie.h"
 
 namespace mach_o {
 
+// when set, every trie built from sorted entries is compared to one built by adding one entry at a time
+static const bool sVerifyTrieBuilds = (getenv("LD_VERIFY_EXPORTS_TRIE") != nullptr);
+
 static uint32_t uleb128_size(uint64_t value)
 {
 	uint32_t result = 0;
@@ -42,6 +49,20 @@ static uint32_t uleb128_size(uint64_t value)
 	return result;
 }
 
+static uint8_t* write_uleb128(uint64_t value, uint8_t* p)
+{
+    uint8_t byte;
+    do {
+        byte = value & 0x7F;
+        value &= ~0x7F;
+        if ( value != 0 )
+            byte |= 0x80;
+        *p++ = byte;
+        value = value >> 7;
+    } while ( byte >= 0x80 );
+    return p;
+}
+
 //
 // MARK: --- GenericTrie methods ---
 //
@@ -60,12 +81,43 @@ GenericTrie::GenericTrie(size_t count, const std::vector<uint8_t>& terminalBuffe
 }
 
 void GenericTrie::buildTrieBytes(size_t entriesCount, const std::vector<uint8_t>& terminalBuffer, Getter get)
+{
+    std::vector<WriterEntry> entries;
+    entries.reserve(entriesCount);
+    bool hasEmptyName = false;
+    for ( size_t i = 0; i < entriesCount; ++i ) {
+        entries.push_back(get(i));
+        if ( entries.back().name.empty() )
+            hasEmptyName = true;
+    }
+
+    // only adding one entry at a time handles an entry for the root node itself
+    if ( hasEmptyName || entries.empty() || (entriesCount > (UINT32_MAX / 2)) ) {
+        buildTrieBytesByInsertion(entries, terminalBuffer);
+    }
+    else {
+        buildTrieBytesFromSorted(entries, terminalBuffer);
+        if ( sVerifyTrieBuilds && _buildError.noError() ) {
+            std::vector<uint8_t> sortedBytes;
+            std::swap(sortedBytes, _trieBytes);
+            buildTrieBytesByInsertion(entries, terminalBuffer);
+            if ( _buildError.noError() && (sortedBytes != _trieBytes) )
+                _buildError = Error("trie built from sorted entries differs from trie built by adding one entry at a time");
+        }
+    }
+
+    // set up trie buffer
+    _trieStart = _trieBytes.data();
+    _trieEnd   = _trieBytes.data() + _trieBytes.size();
+}
+
+void GenericTrie::buildTrieBytesByInsertion(const std::vector<WriterEntry>& entries, const std::vector<uint8_t>& terminalBuffer)
 {
     // build exports trie by splicing in each new symbol
     std::vector<Node*>  allNodes;
     Node* start = new Node("", allNodes);
-    for ( size_t i = 0; i < entriesCount; ++i ) {
-        Error err = start->addEntry(get(i), terminalBuffer, allNodes);
+    for ( const WriterEntry& entry : entries ) {
+        Error err = start->addEntry(entry, terminalBuffer, allNodes);
         if ( err.hasError() ) {
             _buildError = Error("%s", err.message());
             return;
@@ -96,10 +148,234 @@ void GenericTrie::buildTrieBytes(size_t entriesCount, const std::vector<uint8_t>
     for ( Node* node : allNodes ) {
         delete node;
     }
+}
 
-    // set up trie buffer
-  _trieStart = _trieBytes.data();
-  _trieEnd   = _trieBytes.data() + _trieBytes.size();
+//
+// Builds the same trie as buildTrieBytesByInsertion() from the entries sorted by name.  Entries are
+// sorted in parallel, and the subtrees below a node are built in parallel when the node has many
+// entries under it.  Partitioning by first character alone would not help, as almost every
+// mach-o symbol starts with an underscore.  Nodes are then put in the order adding one entry at a
+// time would have created them (see addSortedEntries()), and node offsets are found by the same
+// fixed point iteration, but each pass computes node sizes and offsets in parallel.
+//
+void GenericTrie::buildTrieBytesFromSorted(const std::vector<WriterEntry>& entries, const std::vector<uint8_t>& terminalBuffer)
+{
+    enum { kChunkSize = 0x2000 };
+    const size_t        count      = entries.size();
+    const WriterEntry*  entryArray = entries.data();
+    auto nameLessThan = [entryArray](uint32_t a, uint32_t b) {
+        int cmp = entryArray[a].name.compare(entryArray[b].name);
+        if ( cmp != 0 )
+            return (cmp < 0);
+        return (a < b);
+    };
+
+    // sort chunks in parallel, then merge pairs of sorted runs in parallel until one run is left
+    std::vector<uint32_t> sorted(count);
+    std::vector<uint32_t> merged(count);
+    uint32_t* sortedArray = sorted.data();
+    const size_t sortChunkCount = (count + kChunkSize - 1) / kChunkSize;
+    dispatch_apply(sortChunkCount, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+        const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+        for ( size_t i = chunk * kChunkSize; i < chunkEnd; ++i )
+            sortedArray[i] = (uint32_t)i;
+        std::sort(&sortedArray[chunk * kChunkSize], &sortedArray[chunkEnd], nameLessThan);
+    });
+    for ( size_t runSize = kChunkSize; runSize < count; runSize *= 2 ) {
+        const uint32_t* from = sorted.data();
+        uint32_t*       to   = merged.data();
+        dispatch_apply((count + 2 * runSize - 1) / (2 * runSize), DISPATCH_APPLY_AUTO, ^(size_t pair) {
+            const size_t start  = pair * 2 * runSize;
+            const size_t middle = std::min(count, start + runSize);
+            const size_t end    = std::min(count, start + 2 * runSize);
+            std::merge(&from[start], &from[middle], &from[middle], &from[end], &to[start], nameLessThan);
+        });
+        std::swap(sorted, merged);
+    }
+    sortedArray = sorted.data();
+
+    // adding entries one at a time fails at the first entry whose name was already added
+    std::atomic<uint32_t>  firstDuplicate(UINT32_MAX);
+    std::atomic<uint32_t>* firstDuplicatePtr = &firstDuplicate;
+    dispatch_apply(sortChunkCount, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+        const size_t chunkEnd = std::min<size_t>(count, (chunk + 1) * kChunkSize);
+        for ( size_t i = std::max<size_t>(1, chunk * kChunkSize); i < chunkEnd; ++i ) {
+            if ( entryArray[sortedArray[i]].name != entryArray[sortedArray[i-1]].name )
+                continue;
+            uint32_t duplicate = sortedArray[i];
+            uint32_t current   = firstDuplicatePtr->load();
+            while ( (duplicate < current) && !firstDuplicatePtr->compare_exchange_weak(current, duplicate) )
+                ;
+        }
+    });
+    if ( firstDuplicate != UINT32_MAX ) {
+        std::string_view name = entries[firstDuplicate].name;
+        char cstr[name.size()+2];
+        memcpy(cstr, name.data(), name.size());
+        cstr[name.size()] = '\0';
+        _buildError = Error("duplicate symbol '%s'", (const char*)cstr); // cast is to work around va_list aliasing issue
+        return;
+    }
+
+    // node orders are 2*i+1 for the node created by the i'th entry and 2*i for the node it spliced in,
+    // the root is always first
+    std::vector<Node*> slots(2 * count + 1, nullptr);
+    Node* start = new Node("");
+    start->addSortedEntries(entryArray, sortedArray, sortedArray + count, slots.data());
+    slots[0] = start;
+    std::vector<Node*> allNodes;
+    allNodes.reserve(count * 2);
+    for ( Node* node : slots ) {
+        if ( node != nullptr )
+            allNodes.push_back(node);
+    }
+
+    // iterate node offsets until all uleb128 sizes have stabilized, starting from all offsets being zero
+    // like buildTrieBytesByInsertion() so that both find the same (smallest) layout
+    const size_t           nodeCount  = allNodes.size();
+    const size_t           chunkCount = (nodeCount + kChunkSize - 1) / kChunkSize;
+    Node* const*           nodeArray  = allNodes.data();
+    std::vector<uint32_t>  fixedSizes(nodeCount);
+    std::vector<uint32_t>  sizes(nodeCount);
+    std::vector<uint32_t>  chunkStarts(chunkCount + 1);
+    uint32_t*              fixedSizeArray  = fixedSizes.data();
+    uint32_t*              sizeArray       = sizes.data();
+    uint32_t*              chunkStartArray = chunkStarts.data();
+    dispatch_apply(chunkCount, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+        const size_t chunkEnd = std::min<size_t>(nodeCount, (chunk + 1) * kChunkSize);
+        for ( size_t i = chunk * kChunkSize; i < chunkEnd; ++i )
+            fixedSizeArray[i] = nodeArray[i]->sizeWithoutChildOffsets();
+    });
+    std::atomic<bool>  more;
+    std::atomic<bool>* morePtr = &more;
+    do {
+        more = false;
+        dispatch_apply(chunkCount, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+            const size_t chunkEnd  = std::min<size_t>(nodeCount, (chunk + 1) * kChunkSize);
+            uint32_t     chunkSize = 0;
+            for ( size_t i = chunk * kChunkSize; i < chunkEnd; ++i ) {
+                uint32_t nodeSize = fixedSizeArray[i];
+                for ( const Edge& edge : nodeArray[i]->children )
+                    nodeSize += uleb128_size(edge.child->trieOffset);
+                sizeArray[i] = nodeSize;
+                chunkSize += nodeSize;
+            }
+            chunkStartArray[chunk + 1] = chunkSize;
+        });
+        chunkStarts[0] = 0;
+        for ( size_t chunk = 0; chunk < chunkCount; ++chunk )
+            chunkStarts[chunk + 1] += chunkStarts[chunk];
+        dispatch_apply(chunkCount, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+            const size_t chunkEnd  = std::min<size_t>(nodeCount, (chunk + 1) * kChunkSize);
+            uint32_t     curOffset = chunkStartArray[chunk];
+            bool         changed   = false;
+            for ( size_t i = chunk * kChunkSize; i < chunkEnd; ++i ) {
+                if ( nodeArray[i]->trieOffset != curOffset ) {
+                    nodeArray[i]->trieOffset = curOffset;
+                    changed = true;
+                }
+                curOffset += sizeArray[i];
+            }
+            if ( changed )
+                *morePtr = true;
+        });
+    } while ( more );
+
+    // create trie stream, each node writes its own bytes, padded to be 8-byte aligned
+    const size_t trieSize = chunkStarts[chunkCount];
+    _trieBytes.resize((trieSize + 7) & (-8), 0);
+    uint8_t* trieBuffer = _trieBytes.data();
+    dispatch_apply(chunkCount, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+        const size_t chunkEnd = std::min<size_t>(nodeCount, (chunk + 1) * kChunkSize);
+        for ( size_t i = chunk * kChunkSize; i < chunkEnd; ++i )
+            nodeArray[i]->copyToBuffer(&trieBuffer[nodeArray[i]->trieOffset], terminalBuffer);
+    });
+
+    // delete nodes used during building
+    dispatch_apply(chunkCount, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+        const size_t chunkEnd = std::min<size_t>(nodeCount, (chunk + 1) * kChunkSize);
+        for ( size_t i = chunk * kChunkSize; i < chunkEnd; ++i )
+            delete nodeArray[i];
+    });
+}
+
+//
+// Adds the entries [first, last), which are sorted by name and all start with this node's
+// cummulative string, stores each new node in slots[order], and returns the smallest entry index
+// added.  Adding entries one at a time gives each node's edges in the order their first entry was
+// added, creates a node for the i'th entry, and splices in the node its name branches off at when
+// that node does not exist yet, which is when the node's second edge gets its first entry.  The
+// i'th entry's node ends up directly on the node for its name if no longer name was added before
+// it, or below that node on an empty edge if one was.
+//
+uint32_t GenericTrie::Node::addSortedEntries(const WriterEntry* entries, const uint32_t* first, const uint32_t* last, Node** slots)
+{
+    enum { kParallelThreshold = 0x1000 };
+    const size_t     depth    = cummulativeString.size();
+    const size_t     count    = last - first;
+    const uint32_t*  terminal = nullptr;
+    if ( entries[*first].name.size() == depth )
+        terminal = first++;
+
+    // each edge leads to the entries with the same next character, and ends where they stop sharing a prefix
+    struct Group { const uint32_t* first; const uint32_t* last; uint32_t minIndex; Edge edge; };
+    std::vector<Group> groups;
+    while ( first != last ) {
+        std::string_view name     = entries[*first].name;
+        const uint32_t*  groupEnd = std::partition_point(first + 1, last, [&](uint32_t index) {
+            return (entries[index].name[depth] == name[depth]);
+        });
+        std::string_view lastName   = entries[groupEnd[-1]].name;
+        size_t           childDepth = depth + 1;
+        if ( groupEnd - first == 1 )
+            childDepth = name.size();
+        while ( (childDepth < name.size()) && (childDepth < lastName.size()) && (name[childDepth] == lastName[childDepth]) )
+            ++childDepth;
+        groups.push_back({ first, groupEnd, 0, Edge(name.substr(depth, childDepth - depth), new Node(name.substr(0, childDepth))) });
+        first = groupEnd;
+    }
+    Group* groupArray = groups.data();
+    auto addGroup = ^(size_t groupIndex) {
+        Group& group   = groupArray[groupIndex];
+        group.minIndex = group.edge.child->addSortedEntries(entries, group.first, group.last, slots);
+        slots[group.edge.child->order] = group.edge.child;
+    };
+    if ( (count > kParallelThreshold) && (groups.size() > 1) )
+        dispatch_apply(groups.size(), DISPATCH_APPLY_AUTO, addGroup);
+    else {
+        for ( size_t groupIndex = 0; groupIndex < groups.size(); ++groupIndex )
+            addGroup(groupIndex);
+    }
+
+    uint32_t minIndex = UINT32_MAX;
+    for ( const Group& group : groups )
+        minIndex = std::min(minIndex, group.minIndex);
+    if ( terminal != nullptr ) {
+        if ( *terminal < minIndex ) {
+            terminalEntry = entries[*terminal];
+        }
+        else {
+            Node* leaf          = new Node(cummulativeString);
+            leaf->terminalEntry = entries[*terminal];
+            leaf->order         = 2 * (*terminal) + 1;
+            slots[leaf->order]  = leaf;
+            groups.push_back({ terminal, terminal + 1, *terminal, Edge(entries[*terminal].name.substr(depth), leaf) });
+        }
+        minIndex = std::min(minIndex, *terminal);
+    }
+
+    std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) {
+        return (a.minIndex < b.minIndex);
+    });
+    children.reserve(groups.size());
+    for ( const Group& group : groups )
+        children.push_back(group.edge);
+
+    if ( !terminalEntry.name.empty() )
+        order = 2 * (*terminal) + 1;
+    else if ( groups.size() > 1 )
+        order = 2 * groups[1].minIndex;
+    return minIndex;
 }
 
 Error GenericTrie::Node::addEntry(const WriterEntry& newEntry, const std::vector<uint8_t>& terminalBuffer, std::vector<Node*>& allNodes)
@@ -173,6 +449,19 @@ bool GenericTrie::Node::updateOffset(uint32_t& curOffset)
     return result;
 }
 
+uint32_t GenericTrie::Node::sizeWithoutChildOffsets() const
+{
+    uint32_t nodeSize = 1;
+    if ( !terminalEntry.name.empty() ) {
+        nodeSize = (uint32_t)terminalEntry.terminalStride.size;
+        nodeSize += uleb128_size(nodeSize);
+    }
+    ++nodeSize;
+    for ( const Edge& edge : this->children )
+        nodeSize += edge.partialString.size() + 1;
+    return nodeSize;
+}
+
 void GenericTrie::Node::appendToStream(GenericTrie& trie, const std::vector<uint8_t>& terminalBuffer)
 {
     if ( !terminalEntry.name.empty() ) {
@@ -193,6 +482,27 @@ void GenericTrie::Node::appendToStream(GenericTrie& trie, const std::vector<uint
     }
 }
 
+// same bytes as appendToStream(), written at the node's place in a buffer already sized for the trie
+void GenericTrie::Node::copyToBuffer(uint8_t* p, const std::vector<uint8_t>& terminalBuffer) const
+{
+    if ( !terminalEntry.name.empty() ) {
+        p = write_uleb128(terminalEntry.terminalStride.size, p);
+        std::span<const uint8_t> payload = terminalEntry.payload(terminalBuffer);
+        memcpy(p, payload.data(), payload.size());
+        p += payload.size();
+    }
+    else {
+        *p++ = 0;
+    }
+    *p++ = (uint8_t)children.size();
+    for ( const Edge& e : children ) {
+        memcpy(p, e.partialString.data(), e.partialString.size());
+        p += e.partialString.size();
+        *p++ = '\0';
+        p = write_uleb128(e.child->trieOffset, p);
+    }
+}
+
 void GenericTrie::append_uleb128(uint64_t value, std::vector<uint8_t>& out)
 {
     uint8_t byte;
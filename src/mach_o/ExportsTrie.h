@@ -72,6 +72,8 @@ public:
     Error&          buildError() { return _buildError; }
 protected:
     void            buildTrieBytes(size_t entryCount, const std::vector<uint8_t>& terminalBuffer, Getter);
+    void            buildTrieBytesByInsertion(const std::vector<WriterEntry>& entries, const std::vector<uint8_t>& terminalBuffer);
+    void            buildTrieBytesFromSorted(const std::vector<WriterEntry>& entries, const std::vector<uint8_t>& terminalBuffer);
 
     struct Node;
 
@@ -91,16 +93,21 @@ protected:
     struct Node
     {
                             Node(const std::string_view& s, std::vector<Node*>& owner) : cummulativeString(s) { owner.push_back(this); }
+                            Node(const std::string_view& s) : cummulativeString(s) { }
                             ~Node() = default;
 
         std::string_view         cummulativeString;
         std::vector<Edge>        children;
         WriterEntry             terminalEntry;
         uint32_t                 trieOffset = 0;
+        uint32_t                 order      = 0;    // position in allNodes when built by adding one entry at a time
 
         Error           addEntry(const WriterEntry& entry, const std::vector<uint8_t>& terminalBuffer, std::vector<Node*>& allNodes);
+        uint32_t        addSortedEntries(const WriterEntry* entries, const uint32_t* first, const uint32_t* last, Node** slots);
         bool            updateOffset(uint32_t& curOffset);
+        uint32_t        sizeWithoutChildOffsets() const;
         void            appendToStream(GenericTrie& trie, const std::vector<uint8_t>& terminalBuffer);
+        void            copyToBuffer(uint8_t* buffer, const std::vector<uint8_t>& terminalBuffer) const;
    };
 
     const uint8_t*       _trieStart;
@@ -0,0 +1,2 @@
+int bar() { return 3; }
+int onlyInBar() { return 4; }
@@ -0,0 +1,2 @@
+int foo() { return 1; }
+int bar() { return 2; }
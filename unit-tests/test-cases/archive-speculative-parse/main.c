@@ -0,0 +1,7 @@
+extern int foo();
+extern int bar();
+
+int main()
+{
+	return foo() + bar();
+}
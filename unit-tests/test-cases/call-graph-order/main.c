@@ -0,0 +1,13 @@
+int f1(void) { return 1; }
+int f2(void) { return 2; }
+int f3(void) { return 3; }
+int f4(void) { return 4; }
+int f5(void) { return 5; }
+int f6(void) { return 6; }
+int f7(void) { return 7; }
+int f8(void) { return 8; }
+
+int main()
+{
+	return f1() + f2() + f3() + f4() + f5() + f6() + f7() + f8();
+}
@@ -0,0 +1,17 @@
+// even<1>/odd<1> and even<2>/odd<2> call each other, so they can only
+// be found equal by assuming they are and checking nothing contradicts it
+template <int N> int even(int x);
+template <int N> int odd(int x)  { return (x == 0) ? 0 : even<N>(x - 1); }
+template <int N> int even(int x) { return (x == 0) ? 1 : odd<N>(x - 1); }
+
+// not auto-hide, only called
+static int twice1(int x) { return x * 2 + 1; }
+static int twice2(int x) { return x * 2 + 1; }
+
+static const int table1[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+static const int table2[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+int main(int argc, const char* argv[])
+{
+	return even<1>(argc) + even<2>(argc) + twice1(argc) + twice2(argc) + table1[argc & 7] + table2[argc & 7];
+}
@@ -0,0 +1,7 @@
+extern int bar(int);
+
+// functions with byte-identical CIE and FDE instructions
+#define F(n)	int foo##n(int x) { return bar(x + n) * 3; }
+#define F4(n)	F(n##0) F(n##1) F(n##2) F(n##3)
+
+F4(1) F4(2) F4(3) F4(4)
@@ -0,0 +1,9 @@
+int bar(int x) { return x; }
+
+extern int foo10(int);
+extern int foo43(int);
+
+int main()
+{
+	return foo10(1) + foo43(2);
+}
@@ -0,0 +1,26 @@
+extern int bar(int);
+
+// thousands of functions so unwind info spans many second level pages,
+// mixing frameless, frame based, and functions with an LSDA
+#define LEAF(n)		int leaf##n(int x) { return x * n; }
+#define FRAME(n)	int frame##n(int x) { return bar(x + n) + 1; }
+#define CATCH(n)	int catch##n(int x) { try { return bar(x - n); } catch (int e) { return e; } }
+#define F(n)		LEAF(n) FRAME(n) CATCH(n)
+#define F4(n)		F(n##0) F(n##1) F(n##2) F(n##3)
+#define F16(n)		F4(n##0) F4(n##1) F4(n##2) F4(n##3)
+#define F64(n)		F16(n##0) F16(n##1) F16(n##2) F16(n##3)
+#define F256(n)		F64(n##0) F64(n##1) F64(n##2) F64(n##3)
+
+F256(1) F256(2) F256(3) F256(4)
+
+int bar(int x)
+{
+	if ( x < 0 )
+		throw x;
+	return x;
+}
+
+int main()
+{
+	return frame10000(1) + catch43210(2);
+}
@@ -0,0 +1,6 @@
+extern int foo();
+
+int main()
+{
+	return foo();
+}
@@ -0,0 +1,4 @@
+#include "slots.h"
+
+#define BAR(n)	int bar##n = 1;
+SLOTS1100(BAR)
@@ -0,0 +1,4 @@
+#include "slots.h"
+
+#define FOO(n)	int foo##n(void) { return 1; }
+SLOTS1100(FOO)
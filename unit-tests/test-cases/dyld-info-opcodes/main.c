@@ -0,0 +1,29 @@
+#include "slots.h"
+
+struct entry {
+	void*		ptr;
+	long		pad[2];
+};
+
+#define DECL(n)		extern int foo##n(void); extern int bar##n; static int local##n;
+SLOTS1100(DECL)
+
+// rebases and binds to libfoo in __DATA_CONST
+#define LOCAL_PTR(n)	{ &local##n },
+#define FOO_PTR(n)		{ (void*)&foo##n },
+const struct entry constLocals[] = { SLOTS1100(LOCAL_PTR) };
+const struct entry constFoos[] = { SLOTS1100(FOO_PTR) };
+
+// rebases and binds to libbar in __DATA
+#define BAR_PTR(n)		{ &bar##n },
+struct entry locals[] = { SLOTS1100(LOCAL_PTR) };
+struct entry bars[] = { SLOTS1100(BAR_PTR) };
+
+int main()
+{
+	// lazy binds to libfoo
+	int sum = 0;
+#define CALL(n)	sum += foo##n();
+	SLOTS1100(CALL)
+	return (sum == 1100) && (constLocals[5].ptr == locals[5].ptr) && (bars[7].ptr == &bara007) ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+// expands m(n) for 1100 distinct names n
+#define SLOTS10(m, p)	m(p##0) m(p##1) m(p##2) m(p##3) m(p##4) m(p##5) m(p##6) m(p##7) m(p##8) m(p##9)
+#define SLOTS100(m, p)	SLOTS10(m, p##0) SLOTS10(m, p##1) SLOTS10(m, p##2) SLOTS10(m, p##3) SLOTS10(m, p##4) \
+						SLOTS10(m, p##5) SLOTS10(m, p##6) SLOTS10(m, p##7) SLOTS10(m, p##8) SLOTS10(m, p##9)
+#define SLOTS1000(m, p)	SLOTS100(m, p##0) SLOTS100(m, p##1) SLOTS100(m, p##2) SLOTS100(m, p##3) SLOTS100(m, p##4) \
+						SLOTS100(m, p##5) SLOTS100(m, p##6) SLOTS100(m, p##7) SLOTS100(m, p##8) SLOTS100(m, p##9)
+#define SLOTS1100(m)	SLOTS1000(m, a) SLOTS100(m, b)
@@ -0,0 +1,8 @@
+int hidden(void) { return 1; }
+
+__attribute__((weak)) int weakfunc(void) { return 2; }
+
+#define SYMBOL_NOT_HERE_IN_10_6(sym) \
+                 extern const char sym##_tmp __asm("$ld$hide$os10.6$_" #sym ); const char sym##_tmp = 0;
+
+SYMBOL_NOT_HERE_IN_10_6(hidden)
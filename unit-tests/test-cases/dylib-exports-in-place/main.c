@@ -0,0 +1,13 @@
+extern int f0(void);
+extern int f19999(void);
+extern int weakfunc(void);
+extern int hidden(void);
+
+int main()
+{
+	int result = f0() + f19999() + weakfunc();
+#if USE_HIDDEN
+	result += hidden();
+#endif
+	return result;
+}
@@ -0,0 +1,2 @@
+int table[COUNT];
+
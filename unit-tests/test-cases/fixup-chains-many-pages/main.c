@@ -0,0 +1,30 @@
+#include <stdlib.h>
+
+// one pointer per atom, with atoms large enough that a segment of them spans many pages
+struct Slot { void* ptr; char pad[1016]; };
+
+static int value;
+
+#define SLOTS10(m, p)	m(p##0) m(p##1) m(p##2) m(p##3) m(p##4) m(p##5) m(p##6) m(p##7) m(p##8) m(p##9)
+#define SLOTS100(m, p)	SLOTS10(m, p##0) SLOTS10(m, p##1) SLOTS10(m, p##2) SLOTS10(m, p##3) SLOTS10(m, p##4) \
+						SLOTS10(m, p##5) SLOTS10(m, p##6) SLOTS10(m, p##7) SLOTS10(m, p##8) SLOTS10(m, p##9)
+#define SLOTS1000(m, p)	SLOTS100(m, p##0) SLOTS100(m, p##1) SLOTS100(m, p##2) SLOTS100(m, p##3) SLOTS100(m, p##4) \
+						SLOTS100(m, p##5) SLOTS100(m, p##6) SLOTS100(m, p##7) SLOTS100(m, p##8) SLOTS100(m, p##9)
+#define SLOTS1100(m)	SLOTS1000(m, a) SLOTS100(m, b)
+
+// rebases in __DATA_CONST
+#define CONST_SLOT(n)	const struct Slot c##n = { &value };
+SLOTS1100(CONST_SLOT)
+
+// binds in __DATA
+#define BIND_SLOT(n)	struct Slot d##n = { (void*)&malloc };
+SLOTS1100(BIND_SLOT)
+
+// rebases in a segment of its own
+#define MORE_SLOT(n)	__attribute__((section("__MORE,__ptrs"))) struct Slot m##n = { &value };
+SLOTS1100(MORE_SLOT)
+
+int main()
+{
+	return ((ca000.ptr == &value) && (db99.ptr == (void*)&malloc) && (mb99.ptr == &value)) ? 0 : 1;
+}
@@ -0,0 +1,4 @@
+#if WEAK
+__attribute__((weak))
+#endif
+int shared(void) { return 3; }
@@ -0,0 +1,11 @@
+// enough functions and strings that each section is split into several ranges
+#define F(n)		const char* foo##n(void) { return "string\t" #n "\n"; }
+#define F4(n)		F(n##0) F(n##1) F(n##2) F(n##3)
+#define F16(n)		F4(n##0) F4(n##1) F4(n##2) F4(n##3)
+#define F64(n)		F16(n##0) F16(n##1) F16(n##2) F16(n##3)
+#define F256(n)		F64(n##0) F64(n##1) F64(n##2) F64(n##3)
+
+F256(1) F256(2) F256(3) F256(4) F256(5) F256(6) F256(7) F256(8)
+
+__attribute__((visibility("hidden")))
+const char* unused(void) { return "dead\n"; }
@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+static const char* message = "hello";
+int counter = 0;
+
+void foo(void)
+{
+	++counter;
+	printf("%s %d\n", message, counter);
+}
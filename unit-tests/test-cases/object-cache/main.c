@@ -0,0 +1,8 @@
+extern void foo(void);
+extern int counter;
+
+int main()
+{
+	foo();
+	return counter - 1;
+}
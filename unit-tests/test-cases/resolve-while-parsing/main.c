@@ -0,0 +1,8 @@
+extern int foo();
+extern int bar();
+extern int baz();
+
+int main()
+{
+	return foo() + bar() + baz();
+}
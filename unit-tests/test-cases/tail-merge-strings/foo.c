@@ -0,0 +1,5 @@
+int foo() { return 1; }
+int afoo() { return 2; }
+int xfoo() { return 3; }
+int bar() { return 4; }
+int abar() { return 5; }
@@ -0,0 +1,8 @@
+extern int foo(void);
+extern int bar(void);
+extern int weakfoo(void);
+
+int main()
+{
+	return foo() + bar() + weakfoo();
+}
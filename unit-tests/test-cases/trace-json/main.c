@@ -0,0 +1,6 @@
+extern int foo(void);
+
+int main()
+{
+	return foo();
+}